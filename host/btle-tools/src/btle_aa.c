@@ -0,0 +1,270 @@
+// Promiscuous access address discovery on data channels
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "btle_aa.h"
+#include "btle_pdu.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define NUM_WINDOW_BIT (NUM_PREAMBLE_ACCESS_BYTE*8)
+#define WINDOW_MASK ( (((uint64_t)1)<<NUM_WINDOW_BIT) - 1 )
+
+//----------------------------------access address rules----------------------------------
+int aa_is_valid(uint32_t access_addr) {
+  uint32_t diff = access_addr ^ ADV_ACCESS_ADDR;
+  uint32_t trans = access_addr ^ (access_addr>>1); // bit i: bits i and i+1 differ
+  int i, run, num_trans;
+
+  if ( diff == 0 || (diff & (diff-1)) == 0 ) { // advertising, or one bit away from it
+    return(0);
+  }
+  if ( ((access_addr>>24)&0xFF) == (access_addr&0xFF) && ((access_addr>>16)&0xFF) == (access_addr&0xFF) && ((access_addr>>8)&0xFF) == (access_addr&0xFF) ) {
+    return(0);
+  }
+  run = 1;
+  num_trans = 0;
+  for (i=0; i<31; i++) {
+    if ( (trans>>i)&1 ) {
+      num_trans++;
+      run = 1;
+    } else if (++run > 6) {
+      return(0);
+    }
+  }
+  if (num_trans > 24) {
+    return(0);
+  }
+  // transitions between bits 26~31
+  num_trans = 0;
+  for (i=26; i<31; i++) {
+    num_trans = num_trans + ((trans>>i)&1);
+  }
+  return( num_trans >= 2 );
+}
+//----------------------------------access address rules----------------------------------
+
+//----------------------------------search----------------------------------
+int aa_search_block(IQ_TYPE *rxp_in, int buf_len, int demod_buf_len, int channel_number, AA_HIT_HANDLER handler, void *arg) {
+  uint64_t win[SAMPLE_PER_SYMBOL]; // newest bit at NUM_WINDOW_BIT-1, so the low octet is the preamble
+  uint64_t win_pre;                // window of the sample before
+  AA_HIT hit;
+  IQ_TYPE *rxp;
+  uint32_t access_addr;
+  int i, j, phase_idx, num_bit, pkt_start, pkt_end, nesn, sn, md, i0, q0, i1, q1, search_start, resume;
+  // receiver_block's correlator ends LEN_DEMOD_BUF_PREAMBLE_ACCESS bits after the preamble
+  // start, this window NUM_WINDOW_BIT bits after it: the same preamble starts are searched
+  int search_end = buf_len + (NUM_WINDOW_BIT-LEN_DEMOD_BUF_PREAMBLE_ACCESS)*SAMPLE_PER_SYMBOL*2;
+
+  memset(win, 0, sizeof(win));
+  num_bit = 0;
+  search_start = 0;
+  i = 0;
+  while ( i < search_end && (i + SAMPLE_PER_SYMBOL*2 + 2) <= demod_buf_len ) {
+    num_bit++;
+    for (j=0; j<(SAMPLE_PER_SYMBOL*2); j=j+2) {
+      i0 = rxp_in[i+j];
+      q0 = rxp_in[i+j+1];
+      i1 = rxp_in[i+j+2];
+      q1 = rxp_in[i+j+3];
+
+      phase_idx = j/2;
+      win[phase_idx] = (win[phase_idx]>>1) | ( (uint64_t)((i0*q1 - i1*q0) > 0) << (NUM_WINDOW_BIT-1) );
+      // phase 0 follows the last phase of the symbol before, not updated yet
+      win_pre = win[(phase_idx+SAMPLE_PER_SYMBOL-1)%SAMPLE_PER_SYMBOL];
+      if (num_bit < NUM_WINDOW_BIT) {
+        continue;
+      }
+
+      // preamble alternates into the first access address bit. a sample near the symbol edge
+      // can meet that with a few access address bits wrong: the sample before must agree, if
+      // the block has one
+      access_addr = (uint32_t)(win[phase_idx]>>8);
+      if ( (win[phase_idx]&0xFF) != ((access_addr&1)? 0x55 : 0xAA) || (win[phase_idx] != win_pre && i + j > 0) || !aa_is_valid(access_addr) ) {
+        continue;
+      }
+
+      pkt_start = i + j - (NUM_WINDOW_BIT-1)*SAMPLE_PER_SYMBOL*2;
+      pkt_end = pkt_start + (NUM_WINDOW_BIT+2*8)*SAMPLE_PER_SYMBOL*2;
+      if (pkt_end > demod_buf_len) {
+        return(pkt_start);
+      }
+      rxp = rxp_in + pkt_start + NUM_WINDOW_BIT*SAMPLE_PER_SYMBOL*2;
+      demod_byte(rxp, 2, hit.byte);
+      scramble_byte(hit.byte, 2, scramble_table_ext[channel_number], hit.byte);
+      parse_data_pdu_header_byte(hit.byte, &(hit.llid), &nesn, &sn, &md, &(hit.payload_len));
+      if ( hit.llid == 0 || (hit.byte[0]&0xE0) != 0 || hit.payload_len > MAX_NUM_DATA_PAYLOAD_BYTE ) { // reserved LLID, RFU bits, too long
+        continue;
+      }
+
+      pkt_end = pkt_start + (NUM_WINDOW_BIT+(2+hit.payload_len+3)*8)*SAMPLE_PER_SYMBOL*2;
+      if (pkt_end > demod_buf_len) {
+        return(pkt_start);
+      }
+      demod_byte(rxp+2*8*SAMPLE_PER_SYMBOL*2, hit.payload_len+3, hit.byte+2);
+      scramble_byte(hit.byte+2, hit.payload_len+3, scramble_table_ext[channel_number]+2, hit.byte+2);
+
+      hit.pkt_start = pkt_start;
+      hit.pkt_end = pkt_end;
+      hit.channel_number = channel_number;
+      hit.access_addr = access_addr;
+      hit.empty_pdu = (hit.llid == LLID_DATA_CONT && hit.payload_len == 0);
+      hit.crc_init = crc_init_recover(hit.byte, hit.payload_len+2);
+      hit.rssi = calc_rssi(rxp_in+pkt_start, NUM_WINDOW_BIT*SAMPLE_PER_SYMBOL);
+      if (handler != NULL) {
+        (*handler)(&hit, arg);
+      }
+
+      // go on after the PDU, with empty windows
+      search_start = hit.pkt_end;
+      i = hit.pkt_end - SAMPLE_PER_SYMBOL*2;
+      memset(win, 0, sizeof(win));
+      num_bit = 0;
+      break;
+    }
+    i = i + SAMPLE_PER_SYMBOL*2;
+  }
+  if (i >= search_end) {
+    return(buf_len);
+  }
+  // demod_buf_len ended the windows early: the preambles from here on are not searched yet
+  resume = i - (NUM_WINDOW_BIT-1)*SAMPLE_PER_SYMBOL*2;
+  return( resume > search_start? resume : search_start );
+}
+//----------------------------------search----------------------------------
+
+//----------------------------------candidate table----------------------------------
+static inline int aa_hash(uint32_t access_addr) {
+  return( (int)( (access_addr*2654435761u) >> 22 ) & (LEN_AA_TABLE-1) );
+}
+
+void aa_table_init(AA_TABLE *t) {
+  memset(t, 0, sizeof(AA_TABLE));
+}
+
+AA_ENTRY* aa_table_find(AA_TABLE *t, uint32_t access_addr) {
+  AA_ENTRY *e;
+  int i, h = aa_hash(access_addr);
+
+  for (i=0; i<AA_PROBE; i++) {
+    e = t->entry + ((h+i)&(LEN_AA_TABLE-1));
+    if ( e->used && e->access_addr == access_addr ) {
+      return(e);
+    }
+  }
+  return(NULL);
+}
+
+AA_ENTRY* aa_table_add(AA_TABLE *t, AA_HIT *hit, int64_t time_ns, int *event) {
+  AA_ENTRY *e, *victim = NULL;
+  int i, h = aa_hash(hit->access_addr);
+
+  (*event) = 0;
+  t->num_hit++;
+  e = aa_table_find(t, hit->access_addr);
+  if (e == NULL) {
+    // a free slot, else the candidate seen longest ago. promoted ones stay
+    for (i=0; i<AA_PROBE; i++) {
+      e = t->entry + ((h+i)&(LEN_AA_TABLE-1));
+      if (!e->used) {
+        victim = e;
+        break;
+      }
+      if ( !e->promoted && (victim == NULL || e->last_ns < victim->last_ns) ) {
+        victim = e;
+      }
+    }
+    if (victim == NULL) {
+      return(NULL);
+    }
+    if (victim->used) {
+      t->num_evict++;
+    }
+    e = victim;
+    memset(e, 0, sizeof(AA_ENTRY));
+    e->used = 1;
+    e->access_addr = hit->access_addr;
+    e->first_ns = time_ns;
+  }
+
+  e->num_hit++;
+  e->chan_mask = e->chan_mask | (((uint64_t)1)<<hit->channel_number);
+  e->last_ns = time_ns;
+  if (hit->empty_pdu) {
+    e->num_empty++;
+    if ( !e->promoted && e->num_empty >= AA_PROMOTE_NUM_EMPTY ) {
+      e->promoted = 1;
+      t->num_promoted++;
+      (*event) = (*event) | AA_EVENT_PROMOTED;
+    }
+  }
+
+  // a confirmed CRCInit stays, hits that disagree with it had bit errors
+  if (e->crc_confirmed) {
+    if (hit->crc_init != e->crc_init) {
+      e->num_crc_err++;
+    }
+    return(e);
+  }
+  if (e->num_crc_agree > 0 && hit->crc_init == e->crc_init) {
+    e->num_crc_agree++;
+  } else {
+    e->crc_init = hit->crc_init;
+    e->num_crc_agree = 1;
+  }
+  if (e->num_crc_agree >= AA_CRC_CONFIRM_NUM) {
+    e->crc_confirmed = 1;
+    link_init(&(e->link), e->access_addr, e->crc_init);
+    t->num_crc_confirmed++;
+    (*event) = (*event) | AA_EVENT_CRC_INIT;
+  }
+  return(e);
+}
+
+int aa_crc_check(AA_ENTRY *e, AA_HIT *hit) {
+  if (!e->crc_confirmed) {
+    return(1);
+  }
+  return( crc_check(hit->byte, hit->payload_len+2, e->link.crc_init_byte) );
+}
+
+void aa_table_print(AA_TABLE *t, int min_empty) {
+  AA_ENTRY *e;
+  int i, j;
+
+  printf("AA: %llu hits, %d promoted, %d CRCInit confirmed, %llu candidates evicted\n", (unsigned long long)t->num_hit, t->num_promoted, t->num_crc_confirmed, (unsigned long long)t->num_evict);
+  for (i=0; i<LEN_AA_TABLE; i++) {
+    e = t->entry + i;
+    if ( !e->used || (!e->promoted && !e->crc_confirmed && (int)e->num_empty < min_empty) ) {
+      continue;
+    }
+    printf("AA:%08X%s hits %u empty %u ch", e->access_addr, (e->promoted? " promoted" : ""), e->num_hit, e->num_empty);
+    for (j=0; j<=MAX_CHANNEL_NUMBER; j++) {
+      if ( (e->chan_mask>>j)&1 ) {
+        printf(" %d", j);
+      }
+    }
+    printf(" over %.3fs", (e->last_ns - e->first_ns)/1e9);
+    if (e->crc_confirmed) {
+      printf(" CRCInit %06X, %u CRC errors since", e->crc_init, e->num_crc_err);
+    }
+    printf("\n");
+  }
+}
+//----------------------------------candidate table----------------------------------
@@ -0,0 +1,88 @@
+// Promiscuous access address discovery on data channels
+//
+// aa_search_block() demodulates every sample phase of a block into a 40 bit window packed in
+// a uint64_t, shifted one bit per symbol, and reports each 0x55/0xAA preamble followed by a
+// 32 bit word that is a legal connection access address and a plausible data channel PDU
+// header. The check is a mask and two compares per phase and symbol, cheaper than the
+// advertising correlator, so it can run on every board's channel.
+// Noise passes it a few hundred times a second, each time with a different word, so the
+// candidates are kept in a hash table with hit counts and an access address is promoted once
+// it recurs with AA_PROMOTE_NUM_EMPTY empty PDUs (LLID 1, length 0), which every connection
+// event without data carries.
+// Every hit also runs the CRC register back from the received CRC to its start, see
+// crc_init_recover(), a table lookup per octet. Once AA_CRC_CONFIRM_NUM hits in a row give the
+// same CRCInit, it is confirmed and the entry's link is set up with it: from then on the hits
+// of that access address are CRC checked packets like the ones -D receives.
+
+#ifndef BTLE_AA_H
+#define BTLE_AA_H
+
+#include "btle_phy.h"
+
+#define LEN_AA_TABLE 1024         // must be 2^x
+#define AA_PROBE 8                // slots looked at per access address, then the oldest is evicted
+#define AA_PROMOTE_NUM_EMPTY 3
+#define AA_CRC_CONFIRM_NUM 3
+
+// aa_table_add() event bits
+#define AA_EVENT_PROMOTED 1
+#define AA_EVENT_CRC_INIT 2
+
+typedef struct {
+  int pkt_start;          // offset (IQ_TYPE elements) of the preamble from the start of the block
+  int pkt_end;            // offset right after the CRC
+  int channel_number;
+  uint32_t access_addr;
+  int llid;
+  int payload_len;
+  int empty_pdu;          // llid 1, payload_len 0
+  uint8_t byte[2+MAX_NUM_DATA_PAYLOAD_BYTE+3]; // de-whitened header, payload and CRC
+  uint32_t crc_init;      // what this PDU's CRC was started with, see crc_init_recover
+  float rssi;             // dBFS over the preamble and access address
+} AA_HIT;
+
+typedef void (*AA_HIT_HANDLER)(AA_HIT *hit, void *arg);
+
+typedef struct {
+  uint32_t access_addr;
+  int used;
+  int promoted;
+  uint32_t num_hit;
+  uint32_t num_empty;
+  uint64_t chan_mask;     // bit n: seen on channel n
+  int64_t first_ns;       // caller's clock, e.g. sample time
+  int64_t last_ns;
+  uint32_t crc_init;      // recovered from the last hit
+  uint32_t num_crc_agree; // hits in a row that gave crc_init
+  int crc_confirmed;      // crc_init is the connection's, link is set up
+  uint32_t num_crc_err;   // hits after that with another CRCInit: bit errors
+  BTLE_LINK link;
+} AA_ENTRY;
+
+typedef struct {
+  AA_ENTRY entry[LEN_AA_TABLE];
+  uint64_t num_hit;
+  uint64_t num_evict;     // candidates pushed out before they recurred
+  int num_promoted;
+  int num_crc_confirmed;
+} AA_TABLE;
+
+// 1 if access_addr follows the rules for a connection access address (Core v4.0 Vol 6 Part B 2.1.2)
+int aa_is_valid(uint32_t access_addr);
+
+// receiver_init() first. buf_len and demod_buf_len as for receiver_block: the same preambles
+// are searched. the search goes on after the PDU of a hit and keeps no state between calls.
+// returns buf_len, or the pkt_start of the first hit whose PDU does not end within demod_buf_len
+int aa_search_block(IQ_TYPE *rxp_in, int buf_len, int demod_buf_len, int channel_number, AA_HIT_HANDLER handler, void *arg);
+
+void aa_table_init(AA_TABLE *t);
+// counts hit at time_ns. returns its entry, NULL if the table had no room. *event gets the
+// AA_EVENT_ bits of what this hit did to it
+AA_ENTRY* aa_table_add(AA_TABLE *t, AA_HIT *hit, int64_t time_ns, int *event);
+// 0: the hit passes the CRC of the confirmed CRCInit of e. 1: CRC error or none confirmed
+int aa_crc_check(AA_ENTRY *e, AA_HIT *hit);
+AA_ENTRY* aa_table_find(AA_TABLE *t, uint32_t access_addr);
+// promoted access addresses, and the candidates that had min_empty empty PDUs
+void aa_table_print(AA_TABLE *t, int min_empty);
+
+#endif
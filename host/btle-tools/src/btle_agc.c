@@ -0,0 +1,132 @@
+// Automatic gain control for the btle receiver
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "btle_agc.h"
+
+#include <math.h>
+
+#define LEN_NOISE_WINDOW (64) // IQ samples, 16us
+
+void agc_init(AGC_STATE *agc, int gain, int min_gain, int max_gain) {
+  agc->gain = gain;
+  agc->min_gain = min_gain;
+  agc->max_gain = max_gain;
+  agc->num_hold_block = 0;
+  agc->num_up_block = 0;
+  agc->num_pkt = 0;
+  agc->num_crc_err = 0;
+  agc->rssi_max = -1000.0f;
+}
+
+//----------------------------------block statistics----------------------------------
+void iq_block_stat(IQ_TYPE *rxp, int num_iq_sample, int *num_clip, float *noise_dbfs) {
+  int64_t power, power_min = INT64_MAX;
+  int i, j, clip = 0, num_window = num_iq_sample/LEN_NOISE_WINDOW;
+  int v0, v1;
+
+  for (i=0; i<num_window; i++) {
+    power = 0;
+    for (j=0; j<LEN_NOISE_WINDOW*2; j=j+2) {
+      v0 = rxp[j];
+      v1 = rxp[j+1];
+      power = power + v0*v0 + v1*v1;
+      clip = clip + (v0>=IQ_MAX || v0<=-IQ_MAX || v1>=IQ_MAX || v1<=-IQ_MAX);
+    }
+    if (power < power_min) {
+      power_min = power;
+    }
+    rxp = rxp + LEN_NOISE_WINDOW*2;
+  }
+
+  (*num_clip) = clip;
+  if (num_window == 0 || power_min == 0) {
+    (*noise_dbfs) = -127.0f;
+  } else {
+    (*noise_dbfs) = 10.0f*log10f( (float)power_min/((float)LEN_NOISE_WINDOW*IQ_MAX*IQ_MAX) );
+  }
+}
+
+//----------------------------------block statistics----------------------------------
+
+//----------------------------------gain decision----------------------------------
+void agc_pkt(AGC_STATE *agc, float rssi, int crc_flag) {
+  agc->num_pkt++;
+  if (crc_flag) {
+    agc->num_crc_err++;
+  }
+  if (rssi > agc->rssi_max) {
+    agc->rssi_max = rssi;
+  }
+}
+
+int agc_block(AGC_STATE *agc, int num_clip, int num_iq_sample, float noise_dbfs, AGC_REASON *reason) {
+  int want_up, gain = agc->gain;
+
+  (*reason) = AGC_KEEP;
+
+  if ( num_clip > AGC_CLIP_HIGH*num_iq_sample ) {
+    (*reason) = AGC_DOWN_CLIP;
+  } else if ( noise_dbfs > AGC_NOISE_HIGH ) {
+    (*reason) = AGC_DOWN_NOISE;
+  } else if ( agc->num_pkt != 0 && agc->rssi_max > AGC_RSSI_HIGH ) {
+    (*reason) = AGC_DOWN_RSSI;
+  }
+
+  // weak packets, or none at all, over a low noise floor. packets that all fail CRC count
+  // up to AGC_RSSI_CRC_ERR: more gain lifts them above the quantization noise
+  want_up = ( (*reason) == AGC_KEEP && num_clip == 0 && noise_dbfs < AGC_NOISE_LOW &&
+              (agc->num_pkt == 0 || agc->rssi_max < AGC_RSSI_LOW ||
+               (agc->num_crc_err == agc->num_pkt && agc->rssi_max < AGC_RSSI_CRC_ERR)) );
+  agc->num_up_block = ( want_up? agc->num_up_block+1 : 0 );
+
+  agc->num_pkt = 0;
+  agc->num_crc_err = 0;
+  agc->rssi_max = -1000.0f;
+
+  if (agc->num_hold_block > 0) {
+    agc->num_hold_block--;
+    (*reason) = AGC_KEEP;
+    return(agc->gain);
+  }
+
+  if ( (*reason) != AGC_KEEP ) {
+    gain = agc->gain - AGC_STEP_DOWN;
+  } else if ( agc->num_up_block >= AGC_NUM_UP_BLOCK ) {
+    (*reason) = AGC_UP;
+    gain = agc->gain + AGC_STEP_UP;
+  }
+
+  if (gain < agc->min_gain) {
+    gain = agc->min_gain;
+  }
+  if (gain > agc->max_gain) {
+    gain = agc->max_gain;
+  }
+  if (gain == agc->gain) {
+    (*reason) = AGC_KEEP;
+  }
+  return(gain);
+}
+
+void agc_set(AGC_STATE *agc, int gain) {
+  agc->gain = gain;
+  agc->num_hold_block = AGC_NUM_HOLD_BLOCK;
+  agc->num_up_block = 0;
+}
+//----------------------------------gain decision----------------------------------
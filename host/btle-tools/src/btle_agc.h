@@ -0,0 +1,57 @@
+// Automatic gain control for the btle receiver
+//
+// Runs in the demod thread once per block. Inputs are the clipping rate and the noise floor
+// (quietest window) of the block's I/Q samples, plus RSSI and CRC result of every packet
+// found in it. Gain goes down as soon as a block clips, the noise floor is high, or packets
+// arrive close to full scale. It only goes up after AGC_NUM_UP_BLOCK blocks in a row asked for
+// it: no clipping, a low noise floor and only weak packets, or only packets failing CRC while
+// below AGC_RSSI_CRC_ERR.
+// The gap between the down and up thresholds and the hold time after each change keep it
+// from oscillating. When to actually retune the board is left to the caller.
+
+#ifndef BTLE_AGC_H
+#define BTLE_AGC_H
+
+#include "btle_phy.h"
+
+#define AGC_CLIP_HIGH (0.001f)      // clipped share of samples that forces the gain down
+#define AGC_NOISE_HIGH (-12.0f)     // dBFS. noise floor above this: gain down
+#define AGC_NOISE_LOW (-30.0f)      // dBFS. noise floor below this: gain may go up
+#define AGC_RSSI_HIGH (-3.0f)       // dBFS. packets above this: gain down
+#define AGC_RSSI_LOW (-20.0f)       // dBFS. packets below this: gain may go up
+#define AGC_RSSI_CRC_ERR (-10.0f)   // dBFS. packets below this, all failing CRC: gain may go up
+#define AGC_STEP_DOWN (8)           // dB
+#define AGC_STEP_UP (4)             // dB
+#define AGC_NUM_UP_BLOCK (16)       // blocks in a row (~64ms) before the gain goes up
+#define AGC_NUM_HOLD_BLOCK (4)      // blocks after a change before the next one
+
+typedef enum {
+  AGC_KEEP,
+  AGC_DOWN_CLIP,
+  AGC_DOWN_NOISE,
+  AGC_DOWN_RSSI,
+  AGC_UP
+} AGC_REASON;
+
+typedef struct {
+  int gain;                 // dB, as set on the board
+  int min_gain;
+  int max_gain;
+  int num_hold_block;       // blocks left before the next change is allowed
+  int num_up_block;         // blocks in a row that asked for more gain
+  // packets of the current block, see agc_pkt()
+  int num_pkt;
+  int num_crc_err;
+  float rssi_max;
+} AGC_STATE;
+
+void agc_init(AGC_STATE *agc, int gain, int min_gain, int max_gain);
+// num_clip: samples with I or Q at full scale. noise_dbfs: power of the quietest 64 sample window
+void iq_block_stat(IQ_TYPE *rxp, int num_iq_sample, int *num_clip, float *noise_dbfs);
+void agc_pkt(AGC_STATE *agc, float rssi, int crc_flag);
+// end of a block: returns the gain wanted from now on (agc->gain: keep) and why
+int agc_block(AGC_STATE *agc, int num_clip, int num_iq_sample, float noise_dbfs, AGC_REASON *reason);
+// the board has been retuned to gain
+void agc_set(AGC_STATE *agc, int gain);
+
+#endif
@@ -0,0 +1,446 @@
+// Microbenchmark of the BTLE DSP kernels
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+// Times search_unique_bits, aa_search_block, demod_byte, crc_update, crc_init_recover, scramble_byte, gen_sample_from_phy_byte
+// follow_table_fill, the IQ correction, the decimator, cte_extract and toa_estimate one by one on fixed inputs, pinned to one core, after warmup. Output is CSV, one row per
+// kernel, so results of different builds and CPUs can be diffed or plotted directly.
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+
+#include "common.h"
+#include "btle_phy.h"
+#include "btle_iqcorr.h"
+#include "btle_decim.h"
+#include "btle_aa.h"
+#include "btle_follow.h"
+#include "btle_cte.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#include <intrin.h>
+#define HAVE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+//----------------------------------print_usage----------------------------------
+static void print_usage() {
+	printf("Usage:\n");
+  printf("    -h --help\n");
+  printf("      print this help screen\n");
+  printf("    -c --cpu\n");
+  printf("      pin to this CPU core. default 0. -1 to not pin\n");
+  printf("    -w --warmup\n");
+  printf("      warmup repetitions per kernel, not measured. default 3\n");
+  printf("    -n --num-rep\n");
+  printf("      measured repetitions per kernel. default 20\n");
+  printf("    -k --kernel\n");
+  printf("      only run kernels whose name contains this string. default all\n");
+  printf("\nOutput: CSV. cycles are TSC reference cycles (-1 where no TSC). a packet is a maximum length\n");
+  printf("advertising packet (%d octets on air, %d IQ samples).\n", MAX_NUM_PHY_BYTE, MAX_NUM_PHY_BYTE*8*SAMPLE_PER_SYMBOL);
+}
+//----------------------------------print_usage----------------------------------
+
+//----------------------------------timing----------------------------------
+#define LEN_BLOCK (8*4096) // IQ_TYPE elements, same as a btle_rx block
+#define NUM_PKT_SAMPLE (MAX_NUM_PHY_BYTE*8*SAMPLE_PER_SYMBOL)
+#define MAX_NUM_REP (1000)
+
+static inline uint64_t time_ns(void) {
+#ifdef _MSC_VER
+  LARGE_INTEGER count, freq;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&freq);
+  return( (uint64_t)( (double)count.QuadPart*1e9/(double)freq.QuadPart ) );
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return( (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec );
+#endif
+}
+
+static inline uint64_t time_cycle(void) {
+#ifdef HAVE_TSC
+  return( __rdtsc() );
+#else
+  return(0);
+#endif
+}
+
+static int cmp_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return( x<y? -1 : (x>y? 1 : 0) );
+}
+
+static int pin_cpu(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if ( sched_setaffinity(0, sizeof(set), &set) != 0 ) {
+    fprintf(stderr, "pin_cpu: sched_setaffinity to cpu %d failed!\n", cpu);
+    return(-1);
+  }
+  return(0);
+#else
+  fprintf(stderr, "pin_cpu: not supported on this platform. running unpinned.\n");
+  return(-1);
+#endif
+}
+//----------------------------------timing----------------------------------
+
+//----------------------------------kernels under test----------------------------------
+// inputs shared by all kernels, generated once in init_input()
+static IQ_TYPE noise_block[LEN_BLOCK + 64*SAMPLE_PER_SYMBOL*2];
+static IQ_TYPE pkt_sample[2*(MAX_NUM_PHY_BYTE*8+LEN_GAUSS_FILTER)*SAMPLE_PER_SYMBOL];
+static int8_t mod_sample[2*(MAX_NUM_PHY_BYTE*8+LEN_GAUSS_FILTER)*SAMPLE_PER_SYMBOL];
+static uint8_t phy_byte[MAX_NUM_PHY_BYTE];
+static uint8_t out_byte[MAX_NUM_PHY_BYTE];
+static IQ_TYPE corr_block[LEN_BLOCK];
+static IQ_TYPE noise_block_8m[2*LEN_BLOCK];
+static volatile uint64_t sink; // keeps results alive
+
+typedef struct {
+  const char *name;
+  int num_call;         // calls per repetition
+  int num_sample;       // IQ samples covered by one call
+  void (*run)(int num_call);
+} KERNEL;
+
+static void run_search_unique_bits(int num_call) {
+  int i;
+  // noise only: the whole block is scanned, the common case on a quiet channel
+  for (i=0; i<num_call; i++) {
+    sink += search_unique_bits(noise_block, LEN_BLOCK/(SAMPLE_PER_SYMBOL*2), preamble_access_bit, LEN_DEMOD_BUF_PREAMBLE_ACCESS);
+  }
+}
+
+static void run_aa_search_block(int num_call) {
+  int i;
+  // noise only, any access address on data channel 9
+  for (i=0; i<num_call; i++) {
+    aa_search_block(noise_block, LEN_BLOCK, LEN_BLOCK+64*SAMPLE_PER_SYMBOL*2, 9, NULL, NULL);
+  }
+}
+
+static void run_demod_byte(int num_call) {
+  int i;
+  for (i=0; i<num_call; i++) {
+    demod_byte(pkt_sample, MAX_NUM_PHY_BYTE, out_byte);
+    sink += out_byte[i%MAX_NUM_PHY_BYTE];
+  }
+}
+
+static void run_crc_update(int num_call) {
+  int i;
+  for (i=0; i<num_call; i++) {
+    sink += crc_update(0xAAAAAA+i, phy_byte+NUM_PREAMBLE_ACCESS_BYTE, MAX_NUM_PHY_BYTE-NUM_PREAMBLE_ACCESS_BYTE-3);
+  }
+}
+
+static void run_crc_init_recover(int num_call) {
+  int i;
+  for (i=0; i<num_call; i++) {
+    phy_byte[MAX_NUM_PHY_BYTE-1] = i;
+    sink += crc_init_recover(phy_byte+NUM_PREAMBLE_ACCESS_BYTE, MAX_NUM_PHY_BYTE-NUM_PREAMBLE_ACCESS_BYTE-3);
+  }
+}
+
+// CSA#2, one new event per call as the follower does behind every retune
+static void run_follow_table_fill(int num_call) {
+  static FOLLOW_CONN f;
+  static uint32_t event;
+  int i;
+  if (f.csa == 0) {
+    follow_init(&f, 0x60850A1B, 0xA77B22, 24, 24.0*CONN_UNIT_SAMPLE, 0x1FF0FFFFFFULL, 0);
+    follow_csa2(&f, 0);
+  }
+  for (i=0; i<num_call; i++) {
+    event++;
+    follow_table_fill(&f, event);
+    sink += follow_channel(&f, event);
+  }
+}
+
+static void run_scramble_byte(int num_call) {
+  int i;
+  for (i=0; i<num_call; i++) {
+    scramble_byte(phy_byte+NUM_PREAMBLE_ACCESS_BYTE, MAX_NUM_PHY_BYTE-NUM_PREAMBLE_ACCESS_BYTE, scramble_table[i%40], out_byte);
+    sink += out_byte[0];
+  }
+}
+
+static void run_gen_sample_from_phy_byte(int num_call) {
+  int i;
+  for (i=0; i<num_call; i++) {
+    sink += gen_sample_from_phy_byte(phy_byte, mod_sample, MAX_NUM_PHY_BYTE);
+  }
+}
+
+static void run_iq_corr_estimate(int num_call) {
+  IQ_CORR c;
+  int i;
+  iq_corr_init(&c);
+  for (i=0; i<num_call; i++) {
+    iq_corr_estimate(&c, noise_block, LEN_BLOCK/2);
+  }
+  sink += c.coef_qq;
+}
+
+static void run_iq_corr_apply(int num_call) {
+  IQ_CORR c;
+  int i;
+  // some DC and imbalance. in place, branch free: the drifting content does not change the speed
+  iq_corr_init(&c);
+  c.dc_i = 3;
+  c.dc_q = -2;
+  c.coef_qi = 300;
+  c.coef_qq = 17000;
+  for (i=0; i<num_call; i++) {
+    iq_corr_apply(&c, corr_block, LEN_BLOCK/2);
+  }
+  sink += corr_block[0];
+}
+
+static DECIMATOR decim;
+
+static void run_decim_block(int num_call) {
+  int i;
+  // 2*LEN_BLOCK elements at 8Msps in, one btle_rx block out
+  for (i=0; i<num_call; i++) {
+    decim_block(&decim, noise_block_8m, LEN_BLOCK, corr_block);
+  }
+  sink += corr_block[0];
+}
+
+static IQ_TYPE cte_iq[2*MAX_NUM_CTE_IQ];
+
+static void run_cte_extract(int num_call) {
+  CTE_LAYOUT l;
+  int i;
+  // the longest CTE, AoD in 1us slots, with the tone removed
+  cte_layout(0x40|CTE_MAX_TIME, CTE_AOA_SLOT_US, &l);
+  for (i=0; i<num_call; i++) {
+    sink += (uint64_t)cte_extract(noise_block, &l, 1, cte_iq);
+  }
+  sink += cte_iq[0];
+}
+
+static void run_toa_estimate(int num_call) {
+  static BTLE_LINK link;
+  int i;
+  // the modulated packet, preamble found on its sample: 9 lags of 160 IQ samples
+  if (link.access_addr == 0) {
+    link_init(&link, ADV_ACCESS_ADDR, ADV_CRC_INIT);
+  }
+  for (i=0; i<num_call; i++) {
+    sink += (uint64_t)toa_estimate(pkt_sample, 2*(LEN_GAUSS_FILTER/2)*SAMPLE_PER_SYMBOL, &link);
+  }
+}
+
+static KERNEL kernel_list[] = {
+  {"search_unique_bits",       20,   LEN_BLOCK/2,    run_search_unique_bits},
+  {"aa_search_block",          20,   LEN_BLOCK/2,    run_aa_search_block},
+  {"demod_byte",               2000, NUM_PKT_SAMPLE, run_demod_byte},
+  {"crc_update",               20000, NUM_PKT_SAMPLE, run_crc_update},
+  {"crc_init_recover",         20000, NUM_PKT_SAMPLE, run_crc_init_recover},
+  {"follow_table_fill",        20000, NUM_PKT_SAMPLE, run_follow_table_fill},
+  {"scramble_byte",            20000, NUM_PKT_SAMPLE, run_scramble_byte},
+  {"gen_sample_from_phy_byte", 1000, NUM_PKT_SAMPLE, run_gen_sample_from_phy_byte},
+  {"iq_corr_estimate",         20,   LEN_BLOCK/2,    run_iq_corr_estimate},
+  {"iq_corr_apply",            20,   LEN_BLOCK/2,    run_iq_corr_apply},
+  {"decim_block",              20,   LEN_BLOCK/2,    run_decim_block},
+  {"cte_extract",              20000, CTE_MAX_TIME*8*SAMPLE_PER_SYMBOL, run_cte_extract},
+  {"toa_estimate",             20000, TOA_NUM_REF,    run_toa_estimate},
+};
+#define NUM_KERNEL ( (int)(sizeof(kernel_list)/sizeof(kernel_list[0])) )
+
+static void init_input(void) {
+  uint32_t r = 12345;
+  int i, num_sample;
+
+  receiver_init();
+
+  // uniform noise in the int8 range (bladeRF scale is irrelevant for speed)
+  for (i=0; i<(int)(sizeof(noise_block)/sizeof(IQ_TYPE)); i++) {
+    r = r*1103515245 + 12345;
+    noise_block[i] = (IQ_TYPE)( (int)((r>>16)&0xFF) - 128 );
+  }
+
+  memcpy(phy_byte, preamble_access_byte, NUM_PREAMBLE_ACCESS_BYTE);
+  for (i=NUM_PREAMBLE_ACCESS_BYTE; i<MAX_NUM_PHY_BYTE; i++) {
+    r = r*1103515245 + 12345;
+    phy_byte[i] = (uint8_t)(r>>16);
+  }
+
+  num_sample = gen_sample_from_phy_byte(phy_byte, mod_sample, MAX_NUM_PHY_BYTE);
+  for (i=0; i<2*num_sample; i++) {
+    pkt_sample[i] = mod_sample[i];
+  }
+
+  memcpy(corr_block, noise_block, sizeof(corr_block));
+  memcpy(noise_block_8m, noise_block, LEN_BLOCK*sizeof(IQ_TYPE));
+  memcpy(noise_block_8m+LEN_BLOCK, noise_block, LEN_BLOCK*sizeof(IQ_TYPE));
+  decim_init(&decim);
+}
+//----------------------------------kernels under test----------------------------------
+
+//----------------------------------command line parameters----------------------------------
+void parse_commandline(
+  // Inputs
+  int argc,
+  char * const argv[],
+  // Outputs
+  int* cpu,
+  int* num_warmup,
+  int* num_rep,
+  char** kernel_filter
+) {
+  // Default values
+  (*cpu) = 0;
+  (*num_warmup) = 3;
+  (*num_rep) = 20;
+  (*kernel_filter) = NULL;
+
+  while (1) {
+    static struct option long_options[] = {
+      {"help",         no_argument,       0, 'h'},
+      {"cpu",          required_argument, 0, 'c'},
+      {"warmup",       required_argument, 0, 'w'},
+      {"num-rep",      required_argument, 0, 'n'},
+      {"kernel",       required_argument, 0, 'k'},
+      {0, 0, 0, 0}
+    };
+    /* getopt_long stores the option index here. */
+    int option_index = 0;
+    int c = getopt_long (argc, argv, "hc:w:n:k:",
+                     long_options, &option_index);
+
+    /* Detect the end of the options. */
+    if (c == -1)
+      break;
+
+    switch (c) {
+      char * endp;
+      case 'c':
+        (*cpu) = strtol(optarg,&endp,10);
+        break;
+
+      case 'w':
+        (*num_warmup) = strtol(optarg,&endp,10);
+        break;
+
+      case 'n':
+        (*num_rep) = strtol(optarg,&endp,10);
+        break;
+
+      case 'k':
+        (*kernel_filter) = optarg;
+        break;
+
+      case 'h':
+      case '?':
+      default:
+        goto abnormal_quit;
+    }
+  }
+
+  if ( (*num_warmup)<0 || (*num_rep)<1 || (*num_rep)>MAX_NUM_REP ) {
+    printf("warmup must be >=0 and repetitions within 1~%d!\n", MAX_NUM_REP);
+    goto abnormal_quit;
+  }
+
+  if (optind < argc) {
+    printf("Error: unknown/extra arguments specified on command line\n");
+    goto abnormal_quit;
+  }
+
+  return;
+
+abnormal_quit:
+  print_usage();
+  exit(-1);
+}
+//----------------------------------command line parameters----------------------------------
+
+int main(int argc, char** argv) {
+  static uint64_t rep_ns[MAX_NUM_REP], rep_cycle[MAX_NUM_REP];
+  int cpu, num_warmup, num_rep, i, k, pinned;
+  char *kernel_filter;
+  uint64_t ns_start, cycle_start;
+  double ns_per_call, ns_per_call_min, cycle_per_sample;
+  KERNEL *kern;
+
+  parse_commandline(argc, argv, &cpu, &num_warmup, &num_rep, &kernel_filter);
+
+  pinned = 0;
+  if (cpu >= 0) {
+    pinned = ( pin_cpu(cpu) == 0 );
+  }
+
+  init_input();
+
+  printf("kernel,iq_type,cpu,reps,calls_per_rep,samples_per_call,ns_per_call_median,ns_per_call_min,cycles_per_sample,ns_per_packet\n");
+  for (k=0; k<NUM_KERNEL; k++) {
+    kern = kernel_list + k;
+    if ( kernel_filter != NULL && strstr(kern->name, kernel_filter) == NULL ) {
+      continue;
+    }
+
+    for (i=0; i<num_warmup; i++) {
+      kern->run(kern->num_call);
+    }
+
+    for (i=0; i<num_rep; i++) {
+      ns_start = time_ns();
+      cycle_start = time_cycle();
+      kern->run(kern->num_call);
+      rep_cycle[i] = time_cycle() - cycle_start;
+      rep_ns[i] = time_ns() - ns_start;
+    }
+    qsort(rep_ns, num_rep, sizeof(uint64_t), cmp_u64);
+    qsort(rep_cycle, num_rep, sizeof(uint64_t), cmp_u64);
+
+    ns_per_call = (double)rep_ns[num_rep/2]/kern->num_call;
+    ns_per_call_min = (double)rep_ns[0]/kern->num_call;
+  #ifdef HAVE_TSC
+    cycle_per_sample = (double)rep_cycle[num_rep/2]/kern->num_call/kern->num_sample;
+  #else
+    cycle_per_sample = -1;
+  #endif
+
+    printf("%s,%s,%d,%d,%d,%d,%.1f,%.1f,%.3f,%.1f\n", kern->name, (sizeof(IQ_TYPE)==1? "int8" : "int16"), (pinned? cpu : -1),
+      num_rep, kern->num_call, kern->num_sample, ns_per_call, ns_per_call_min, cycle_per_sample,
+      ns_per_call*NUM_PKT_SAMPLE/kern->num_sample);
+    fflush(stdout);
+  }
+
+  return( sink==0x5a5a5a5a5a5a5a5aull ); // never true, only reads sink
+}
@@ -0,0 +1,598 @@
+// Synthetic packet error rate vs. SNR benchmark for the BTLE receiver
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+// Random advertising packets are built and modulated with the btle_tx GFSK modulator,
+// then get a fractional timing offset, carrier frequency offset, AWGN and optionally HackRF
+// like DC offset and IQ imbalance, are quantized to IQ_TYPE and run through receiver_block()
+// in the same block layout as btle_rx (with -k after the btle_rx -d correction).
+// -a adds a second, independent packet stream on the neighbour channel (+2MHz). -O runs
+// everything at 8Msps through the btle_rx -R 8 channel filter and decimator.
+// No hardware needed, so every receiver change can be checked for speed and sensitivity.
+
+#include "common.h"
+#include "btle_phy.h"
+#include "btle_iqcorr.h"
+#include "btle_decim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <getopt.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//----------------------------------print_usage----------------------------------
+static void print_usage() {
+	printf("Usage:\n");
+  printf("    -h --help\n");
+  printf("      print this help screen\n");
+  printf("    -n --num-pkt\n");
+  printf("      packets per SNR point. default 1000\n");
+  printf("    -s --snr\n");
+  printf("      SNR sweep in dB, start:stop:step. default 0:20:2. SNR is measured in the 4MHz sampling bandwidth\n");
+  printf("    -f --cfo\n");
+  printf("      carrier frequency offset in kHz. default 0\n");
+  printf("    -t --timing\n");
+  printf("      maximum fractional timing offset in samples, uniformly distributed. default 1.0\n");
+  printf("    -d --dc\n");
+  printf("      DC offset in percent of full scale, i:q. default 0:0\n");
+  printf("    -i --iq-imb\n");
+  printf("      IQ imbalance, Q gain in dB:Q phase error in degrees. default 0:0\n");
+  printf("    -k --iq-corr\n");
+  printf("      run the btle_rx -d DC and IQ imbalance correction before the receiver\n");
+  printf("    -a --acr\n");
+  printf("      power of a neighbour channel (+2MHz) packet stream relative to the wanted one, in dB. default off\n");
+  printf("    -O --oversample\n");
+  printf("      generate at 8Msps and receive through the btle_rx -R 8 channel filter and decimator\n");
+  printf("    -c --chan\n");
+  printf("      channel number for whitening. default 37. valid range 0~39\n");
+  printf("    -r --seed\n");
+  printf("      random seed. default 1\n");
+  printf("\nOutput: one line per SNR point, columns are listed in the line starting with #.\n");
+}
+//----------------------------------print_usage----------------------------------
+
+//----------------------------------signal definition----------------------------------
+#define SAMPLE_RATE (SAMPLE_PER_SYMBOL*1000000.0)
+
+// same block layout as btle_rx: LEN_BUF/2 per receiver call, plus the demod tail
+#define LEN_BLOCK (8*4096)
+#define LEN_BLOCK_TAIL (2*MAX_NUM_EXT_PHY_BYTE*8*SAMPLE_PER_SYMBOL)
+
+#define SIGNAL_AMPLITUDE (IQ_MAX/4.0) // headroom for noise before clipping
+#define LEN_TRANSFER (4096) // IQ samples per correction call, as a HackRF USB transfer
+#define ACR_OFF (-1000.0)
+#define ADJ_CHANNEL_HZ (2000000.0)
+#define LEN_INTERP_FILTER (63) // 4 to 8Msps interpolator for -O
+
+#define MIN_GAP_SAMPLE (64)
+#define MAX_GAP_SAMPLE (512)
+#define MAX_PKT_SAMPLE ((MAX_NUM_PHY_BYTE*8+LEN_GAUSS_FILTER)*SAMPLE_PER_SYMBOL)
+
+typedef struct {
+  int start;              // IQ_TYPE element index of the first modulated sample
+  int num_byte;           // PDU header + payload + CRC
+  uint8_t byte[2+37+3];   // before whitening
+  int found;
+} PKT_EXPECTED;
+
+typedef struct {
+  int start;              // IQ_TYPE element index of the preamble found by the receiver
+  int crc_flag;
+  int num_byte;
+  uint8_t byte[2+MAX_NUM_EXT_PAYLOAD_BYTE+3]; // noise may pass as an extended header
+} PKT_FOUND;
+//----------------------------------signal definition----------------------------------
+
+//----------------------------------random numbers----------------------------------
+// xorshift64*, so that a seed gives the same packets on every platform
+static uint64_t rng_state = 1;
+
+static uint64_t rng_u64(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return( rng_state * 2685821657736338717ull );
+}
+
+static double rng_uniform(void) { // [0, 1)
+  return( (double)(rng_u64()>>11)*(1.0/9007199254740992.0) );
+}
+
+static double rng_gauss(void) {
+  double u1 = rng_uniform(), u2 = rng_uniform();
+  if (u1 < 1e-300) {
+    u1 = 1e-300;
+  }
+  return( sqrt(-2.0*log(u1))*cos(2.0*M_PI*u2) );
+}
+//----------------------------------random numbers----------------------------------
+
+//----------------------------------command line parameters----------------------------------
+void parse_commandline(
+  // Inputs
+  int argc,
+  char * const argv[],
+  // Outputs
+  int* num_pkt,
+  double* snr_start,
+  double* snr_stop,
+  double* snr_step,
+  double* cfo_khz,
+  double* timing,
+  double* dc_i,
+  double* dc_q,
+  double* imb_gain_db,
+  double* imb_phase_deg,
+  int* iq_corr,
+  double* acr_db,
+  int* oversample,
+  int* chan,
+  uint64_t* seed
+) {
+  // Default values
+  (*num_pkt) = 1000;
+  (*snr_start) = 0;
+  (*snr_stop) = 20;
+  (*snr_step) = 2;
+  (*cfo_khz) = 0;
+  (*timing) = 1.0;
+  (*dc_i) = 0;
+  (*dc_q) = 0;
+  (*imb_gain_db) = 0;
+  (*imb_phase_deg) = 0;
+  (*iq_corr) = 0;
+  (*acr_db) = ACR_OFF;
+  (*oversample) = 0;
+  (*chan) = 37;
+  (*seed) = 1;
+
+  while (1) {
+    static struct option long_options[] = {
+      {"help",         no_argument,       0, 'h'},
+      {"num-pkt",      required_argument, 0, 'n'},
+      {"snr",          required_argument, 0, 's'},
+      {"cfo",          required_argument, 0, 'f'},
+      {"timing",       required_argument, 0, 't'},
+      {"dc",           required_argument, 0, 'd'},
+      {"iq-imb",       required_argument, 0, 'i'},
+      {"iq-corr",      no_argument,       0, 'k'},
+      {"acr",          required_argument, 0, 'a'},
+      {"oversample",   no_argument,       0, 'O'},
+      {"chan",         required_argument, 0, 'c'},
+      {"seed",         required_argument, 0, 'r'},
+      {0, 0, 0, 0}
+    };
+    /* getopt_long stores the option index here. */
+    int option_index = 0;
+    int c = getopt_long (argc, argv, "hn:s:f:t:d:i:ka:Oc:r:",
+                     long_options, &option_index);
+
+    /* Detect the end of the options. */
+    if (c == -1)
+      break;
+
+    switch (c) {
+      char * endp;
+      case 'n':
+        (*num_pkt) = strtol(optarg,&endp,10);
+        break;
+
+      case 's':
+        if ( sscanf(optarg, "%lf:%lf:%lf", snr_start, snr_stop, snr_step) != 3 ) {
+          printf("SNR sweep must be start:stop:step!\n");
+          goto abnormal_quit;
+        }
+        break;
+
+      case 'f':
+        (*cfo_khz) = strtod(optarg,&endp);
+        break;
+
+      case 't':
+        (*timing) = strtod(optarg,&endp);
+        break;
+
+      case 'd':
+        if ( sscanf(optarg, "%lf:%lf", dc_i, dc_q) != 2 ) {
+          printf("DC offset must be i:q!\n");
+          goto abnormal_quit;
+        }
+        break;
+
+      case 'i':
+        if ( sscanf(optarg, "%lf:%lf", imb_gain_db, imb_phase_deg) != 2 ) {
+          printf("IQ imbalance must be gain_db:phase_deg!\n");
+          goto abnormal_quit;
+        }
+        break;
+
+      case 'k':
+        (*iq_corr) = 1;
+        break;
+
+      case 'a':
+        (*acr_db) = strtod(optarg,&endp);
+        break;
+
+      case 'O':
+        (*oversample) = 1;
+        break;
+
+      case 'c':
+        (*chan) = strtol(optarg,&endp,10);
+        break;
+
+      case 'r':
+        (*seed) = strtoull(optarg,&endp,10);
+        break;
+
+      case 'h':
+      case '?':
+      default:
+        goto abnormal_quit;
+    }
+  }
+
+  if ( (*num_pkt)<=0 ) {
+    printf("number of packets must be positive!\n");
+    goto abnormal_quit;
+  }
+
+  if ( (*snr_step)<=0 || (*snr_stop)<(*snr_start) ) {
+    printf("SNR sweep needs start<=stop and step>0!\n");
+    goto abnormal_quit;
+  }
+
+  if ( (*timing)<0 || (*timing)>1.0 ) {
+    printf("timing offset must be within 0~1 sample!\n");
+    goto abnormal_quit;
+  }
+
+  if ( (*chan)<0 || (*chan)>39 ) {
+    printf("channel number must be within 0~39!\n");
+    goto abnormal_quit;
+  }
+
+  if ( (*seed)==0 ) {
+    (*seed) = 1; // xorshift stays at 0 forever
+  }
+
+  if (optind < argc) {
+    printf("Error: unknown/extra arguments specified on command line\n");
+    goto abnormal_quit;
+  }
+
+  return;
+
+abnormal_quit:
+  print_usage();
+  exit(-1);
+}
+//----------------------------------command line parameters----------------------------------
+
+//----------------------------------signal generation----------------------------------
+// random ADV_IND/ADV_NONCONN_IND/SCAN_RSP/ADV_SCAN_IND, so every payload length 6~37 is valid
+static int gen_random_pkt(int channel_number, PKT_EXPECTED *pkt, int8_t *phy_sample) {
+  const int pdu_type_list[4] = {0, 2, 4, 6};
+  uint8_t phy_byte[MAX_NUM_PHY_BYTE];
+  int payload_len, i;
+  uint_fast32_t crc;
+
+  payload_len = 6 + (int)(rng_u64()%32);
+  pkt->byte[0] = pdu_type_list[rng_u64()&3] | ((rng_u64()&1)<<6) | ((rng_u64()&1)<<7);
+  pkt->byte[1] = payload_len;
+  for (i=0; i<payload_len; i++) {
+    pkt->byte[2+i] = (uint8_t)rng_u64();
+  }
+  crc = crc24_byte(pkt->byte, payload_len+2, 0xAAAAAA);
+  pkt->byte[payload_len+2] = crc & 0xFF;
+  pkt->byte[payload_len+3] = (crc>>8) & 0xFF;
+  pkt->byte[payload_len+4] = (crc>>16) & 0xFF;
+  pkt->num_byte = payload_len+5;
+  pkt->found = 0;
+
+  memcpy(phy_byte, preamble_access_byte, NUM_PREAMBLE_ACCESS_BYTE);
+  scramble_byte(pkt->byte, pkt->num_byte, scramble_table[channel_number], phy_byte+NUM_PREAMBLE_ACCESS_BYTE);
+
+  return( gen_sample_from_phy_byte(phy_byte, phy_sample, NUM_PREAMBLE_ACCESS_BYTE+pkt->num_byte) );
+}
+
+// builds num_pkt packets separated by random gaps into sig (I/Q float, unit amplitude).
+// returns the number of IQ samples used
+static int gen_clean_signal(int channel_number, int num_pkt, double timing, PKT_EXPECTED *pkt, float *sig) {
+  int8_t phy_sample[2*(MAX_PKT_SAMPLE+1)];
+  int i, j, sp, num_sample;
+  double mu, i0, q0, i1, q1;
+
+  sp = 0;
+  for (i=0; i<num_pkt; i++) {
+    sp = sp + MIN_GAP_SAMPLE + (int)(rng_u64()%(MAX_GAP_SAMPLE-MIN_GAP_SAMPLE));
+    num_sample = gen_random_pkt(channel_number, pkt+i, phy_sample);
+    pkt[i].start = sp*2;
+
+    // fractional delay mu by linear interpolation: y[n] = (1-mu)*x[n] + mu*x[n-1]
+    mu = timing*rng_uniform();
+    i0 = 0; q0 = 0;
+    for (j=0; j<num_sample; j++) {
+      i1 = phy_sample[2*j]/127.0;
+      q1 = phy_sample[2*j+1]/127.0;
+      sig[2*(sp+j)]   = (float)( (1.0-mu)*i1 + mu*i0 );
+      sig[2*(sp+j)+1] = (float)( (1.0-mu)*q1 + mu*q0 );
+      i0 = i1; q0 = q1;
+    }
+    sp = sp + num_sample;
+  }
+
+  return(sp + MAX_GAP_SAMPLE);
+}
+
+static inline IQ_TYPE saturate(double a) {
+  long v = lround(a);
+  return( (IQ_TYPE)( v>IQ_MAX? IQ_MAX : (v<-IQ_MAX? -IQ_MAX : v) ) );
+}
+
+typedef struct {
+  double dc_i, dc_q;        // IQ_TYPE units
+  double q_gain;            // Q' = q_gain*(sin(phase)*I + cos(phase)*Q)
+  double q_phase;           // rad
+} FRONTEND_IMPAIRMENT;
+
+// zero stuffing and a Hann windowed sinc at 2MHz: num_sample IQ at 4Msps to 2*num_sample at 8Msps
+static void upsample2(float *in, int num_sample, float *out) {
+  double h[LEN_INTERP_FILTER], x, acc_i, acc_q;
+  int half = (LEN_INTERP_FILTER-1)/2, k, m, j;
+
+  for (k=0; k<LEN_INTERP_FILTER; k++) {
+    x = (k-half)/2.0;
+    h[k] = (k==half? 1.0 : sin(M_PI*x)/(M_PI*x))*( 0.5 - 0.5*cos(2.0*M_PI*(k+1)/(LEN_INTERP_FILTER+1)) );
+  }
+  // out[m] = sum_k h[k]*u[m+half-k], u[2j] = in[j], u[2j+1] = 0
+  for (m=0; m<2*num_sample; m++) {
+    acc_i = 0;
+    acc_q = 0;
+    for (k=(m+half)&1; k<LEN_INTERP_FILTER; k=k+2) {
+      j = (m+half-k)/2;
+      if (j >= 0 && j < num_sample) {
+        acc_i = acc_i + h[k]*in[2*j];
+        acc_q = acc_q + h[k]*in[2*j+1];
+      }
+    }
+    out[2*m] = (float)acc_i;
+    out[2*m+1] = (float)acc_q;
+  }
+}
+
+// CFO, neighbour channel, AWGN, IQ imbalance, DC offset and quantization at fs. SNR is signal
+// power over noise power in the SAMPLE_RATE bandwidth. sig_adj may be NULL. the wanted signal
+// is scaled down so that both together keep the headroom of SIGNAL_AMPLITUDE, as an AGC would
+static void gen_rx_signal(float *sig, float *sig_adj, double acr_db, int num_sample, double fs, double snr_db, double cfo_hz, FRONTEND_IMPAIRMENT *imp, IQ_TYPE *rx) {
+  double amp = ( sig_adj != NULL? SIGNAL_AMPLITUDE/(1.0 + pow(10.0, acr_db/20.0)) : SIGNAL_AMPLITUDE );
+  double sigma = amp*sqrt( 0.5/pow(10.0, snr_db/10.0) )*sqrt(fs/SAMPLE_RATE);
+  double phase_step = 2.0*M_PI*cfo_hz/fs, adj_step = 2.0*M_PI*ADJ_CHANNEL_HZ/fs;
+  double adj_amp = amp*pow(10.0, acr_db/20.0);
+  double imb_i = imp->q_gain*sin(imp->q_phase), imb_q = imp->q_gain*cos(imp->q_phase);
+  double c, s, i, q;
+  int n;
+
+  for (n=0; n<num_sample; n++) {
+    c = cos(phase_step*n);
+    s = sin(phase_step*n);
+    i = amp*(sig[2*n]*c - sig[2*n+1]*s) + sigma*rng_gauss();
+    q = amp*(sig[2*n]*s + sig[2*n+1]*c) + sigma*rng_gauss();
+    if (sig_adj != NULL) {
+      c = cos(adj_step*n);
+      s = sin(adj_step*n);
+      i = i + adj_amp*(sig_adj[2*n]*c - sig_adj[2*n+1]*s);
+      q = q + adj_amp*(sig_adj[2*n]*s + sig_adj[2*n+1]*c);
+    }
+    rx[2*n]   = saturate(i + imp->dc_i);
+    rx[2*n+1] = saturate(imb_i*i + imb_q*q + imp->dc_q);
+  }
+}
+//----------------------------------signal generation----------------------------------
+
+//----------------------------------receiving and scoring----------------------------------
+typedef struct {
+  int block_start;
+  int num_found;
+  int max_num_found;
+  PKT_FOUND *found;
+} FOUND_LIST;
+
+static void collect_pkt(BTLE_PKT *pkt, void *arg) {
+  FOUND_LIST *list = (FOUND_LIST *)arg;
+  PKT_FOUND *f;
+
+  if (list->num_found == list->max_num_found) {
+    return;
+  }
+  f = list->found + list->num_found;
+  f->start = list->block_start + pkt->pkt_start;
+  f->crc_flag = pkt->crc_flag;
+  f->num_byte = pkt->payload_len+5;
+  memcpy(f->byte, pkt->byte, f->num_byte);
+  list->num_found++;
+}
+
+// first expected packet whose start is >= start
+static int search_expected(PKT_EXPECTED *pkt, int num_pkt, int start) {
+  int lo = 0, hi = num_pkt, mid;
+  while (lo < hi) {
+    mid = (lo+hi)/2;
+    if (pkt[mid].start < start) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return(lo);
+}
+
+// a CRC-OK packet counts if it carries the bytes of the packet modulated around that position
+static void score(PKT_EXPECTED *pkt, int num_pkt, FOUND_LIST *list, int *num_ok, int *num_false_ok) {
+  const int tolerance = (LEN_GAUSS_FILTER+2)*SAMPLE_PER_SYMBOL*2;
+  int i, k;
+
+  (*num_ok) = 0;
+  (*num_false_ok) = 0;
+  for (i=0; i<list->num_found; i++) {
+    if (list->found[i].crc_flag) {
+      continue;
+    }
+    k = search_expected(pkt, num_pkt, list->found[i].start - tolerance);
+    if ( k<num_pkt && pkt[k].start <= (list->found[i].start + tolerance) &&
+         pkt[k].num_byte == list->found[i].num_byte && memcmp(pkt[k].byte, list->found[i].byte, pkt[k].num_byte) == 0 &&
+         pkt[k].found == 0 ) {
+      pkt[k].found = 1;
+      (*num_ok)++;
+    } else {
+      (*num_false_ok)++;
+    }
+  }
+}
+//----------------------------------receiving and scoring----------------------------------
+
+int main(int argc, char** argv) {
+  int num_pkt, chan, num_sample, num_block, i, num_ok, num_false_ok, iq_corr, oversample;
+  double snr_start, snr_stop, snr_step, snr_db, cfo_khz, timing, demod_s, dc_i, dc_q, imb_gain_db, imb_phase_deg, acr_db;
+  FRONTEND_IMPAIRMENT imp;
+  IQ_CORR corr;
+  DECIMATOR *decim = NULL;
+  uint64_t seed;
+  float *sig, *sig_adj = NULL, *sig_8m = NULL, *sig_adj_8m = NULL;
+  IQ_TYPE *rx, *rx_8m = NULL;
+  PKT_EXPECTED *pkt, *pkt_adj = NULL;
+  FOUND_LIST list;
+  BTLE_RX_STAT stat;
+  clock_t clk_start, clk_end;
+  size_t max_num_sample;
+
+  parse_commandline(argc, argv, &num_pkt, &snr_start, &snr_stop, &snr_step, &cfo_khz, &timing, &dc_i, &dc_q, &imb_gain_db, &imb_phase_deg, &iq_corr, &acr_db, &oversample, &chan, &seed);
+  rng_state = seed;
+  imp.dc_i = dc_i*IQ_MAX/100.0;
+  imp.dc_q = dc_q*IQ_MAX/100.0;
+  imp.q_gain = pow(10.0, imb_gain_db/20.0);
+  imp.q_phase = imb_phase_deg*M_PI/180.0;
+
+  max_num_sample = (size_t)num_pkt*(MAX_GAP_SAMPLE+MAX_PKT_SAMPLE) + MAX_GAP_SAMPLE;
+  max_num_sample = ( (max_num_sample*2 + LEN_BLOCK - 1)/LEN_BLOCK )*LEN_BLOCK/2; // whole blocks
+  sig = (float *)calloc(2*max_num_sample, sizeof(float));
+  rx = (IQ_TYPE *)malloc( (2*max_num_sample + LEN_BLOCK_TAIL)*sizeof(IQ_TYPE) );
+  pkt = (PKT_EXPECTED *)malloc(num_pkt*sizeof(PKT_EXPECTED));
+  list.max_num_found = 4*num_pkt;
+  list.found = (PKT_FOUND *)malloc(list.max_num_found*sizeof(PKT_FOUND));
+  if (acr_db != ACR_OFF) {
+    sig_adj = (float *)calloc(2*max_num_sample, sizeof(float));
+    pkt_adj = (PKT_EXPECTED *)malloc(num_pkt*sizeof(PKT_EXPECTED));
+  }
+  if (oversample) {
+    sig_8m = (float *)malloc(4*max_num_sample*sizeof(float));
+    sig_adj_8m = ( sig_adj != NULL? (float *)malloc(4*max_num_sample*sizeof(float)) : NULL );
+    rx_8m = (IQ_TYPE *)malloc(4*max_num_sample*sizeof(IQ_TYPE));
+    decim = (DECIMATOR *)malloc(sizeof(DECIMATOR));
+  }
+  if (sig == NULL || rx == NULL || pkt == NULL || list.found == NULL ||
+      (acr_db != ACR_OFF && (sig_adj == NULL || pkt_adj == NULL)) ||
+      (oversample && (sig_8m == NULL || rx_8m == NULL || decim == NULL || (sig_adj != NULL && sig_adj_8m == NULL))) ) {
+    printf("main: malloc failed!\n");
+    return(1);
+  }
+
+  receiver_init();
+
+  num_sample = gen_clean_signal(chan, num_pkt, timing, pkt, sig);
+  num_block = (2*num_sample + LEN_BLOCK - 1)/LEN_BLOCK;
+  memset(rx + 2*max_num_sample, 0, LEN_BLOCK_TAIL*sizeof(IQ_TYPE));
+  if (sig_adj != NULL) { // after the wanted packets, so that they stay the same for a seed
+    gen_clean_signal(chan, num_pkt, timing, pkt_adj, sig_adj);
+  }
+  if (oversample) {
+    upsample2(sig, (int)max_num_sample, sig_8m);
+    if (sig_adj != NULL) {
+      upsample2(sig_adj, (int)max_num_sample, sig_adj_8m);
+    }
+  }
+
+  printf("# btle_bench_per: %d packets per point, channel %d, CFO %.1fkHz, timing offset 0~%.2f sample, seed %llu, %s IQ\n",
+    num_pkt, chan, cfo_khz, timing, (unsigned long long)seed, (sizeof(IQ_TYPE)==1? "int8" : "int16"));
+  printf("# DC %.1f%%:%.1f%%, IQ imbalance %.2fdB:%.2fdeg, IQ correction %s\n", dc_i, dc_q, imb_gain_db, imb_phase_deg, (iq_corr? "on" : "off"));
+  if (acr_db != ACR_OFF || oversample) {
+    printf("# neighbour channel %s%.1fdB, %s\n", (acr_db != ACR_OFF? "" : "off "), (acr_db != ACR_OFF? acr_db : 0.0),
+      (oversample? "8Msps through the channel filter and decimator" : "4Msps, no channel filter"));
+  }
+  printf("# snr_db num_pkt num_ok per num_crc_err num_false_ok num_hit num_header_reject demod_msps x_realtime\n");
+
+  for (snr_db=snr_start; snr_db<=(snr_stop+1e-9); snr_db=snr_db+snr_step) {
+    if (oversample) {
+      gen_rx_signal(sig_8m, sig_adj_8m, acr_db, 2*(int)max_num_sample, 2*SAMPLE_RATE, snr_db, cfo_khz*1000.0, &imp, rx_8m);
+    } else {
+      gen_rx_signal(sig, sig_adj, acr_db, (int)max_num_sample, SAMPLE_RATE, snr_db, cfo_khz*1000.0, &imp, rx);
+    }
+    for (i=0; i<num_pkt; i++) {
+      pkt[i].found = 0;
+    }
+    memset(&stat, 0, sizeof(stat));
+    list.num_found = 0;
+
+    clk_start = clock();
+    if (oversample) { // as btle_rx -R 8 does before the correction
+      decim_init(decim);
+      decim_block(decim, rx_8m, 2*(int)max_num_sample, rx);
+    }
+    if (iq_corr) { // streaming, as in the btle_rx rx callback
+      iq_corr_init(&corr);
+      for (i=0; i<(int)max_num_sample; i=i+LEN_TRANSFER) {
+        iq_corr_estimate(&corr, rx+2*i, LEN_TRANSFER);
+        iq_corr_apply(&corr, rx+2*i, LEN_TRANSFER);
+      }
+    }
+    for (i=0; i<num_block; i++) {
+      list.block_start = i*LEN_BLOCK;
+      receiver_block(rx+i*LEN_BLOCK, (LEN_DEMOD_BUF_PREAMBLE_ACCESS-1)*2*SAMPLE_PER_SYMBOL+LEN_BLOCK, LEN_BLOCK+LEN_BLOCK_TAIL, chan, NULL, NULL, &stat, collect_pkt, &list);
+    }
+    clk_end = clock();
+    demod_s = (double)(clk_end-clk_start)/CLOCKS_PER_SEC;
+
+    score(pkt, num_pkt, &list, &num_ok, &num_false_ok);
+
+    printf("%.1f %d %d %.5f %llu %d %llu %llu %.2f %.1f\n", snr_db, num_pkt, num_ok, 1.0-(double)num_ok/num_pkt,
+      (unsigned long long)stat.num_crc_err, num_false_ok, (unsigned long long)stat.num_hit, (unsigned long long)stat.num_header_reject,
+      demod_s>0? (num_block*(LEN_BLOCK/2))/demod_s/1e6 : 0.0,
+      demod_s>0? (num_block*(LEN_BLOCK/2))/SAMPLE_RATE/demod_s : 0.0);
+    fflush(stdout);
+  }
+
+  free(sig);
+  free(rx);
+  free(pkt);
+  free(list.found);
+  free(sig_adj);
+  free(pkt_adj);
+  free(sig_8m);
+  free(sig_adj_8m);
+  free(rx_8m);
+  free(decim);
+  return(0);
+}
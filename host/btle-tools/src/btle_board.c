@@ -0,0 +1,788 @@
+// RF board I/O shared by the btle tools
+
+/*
+ * Copyright 2012 Jared Boone <jared@sharebrained.com>
+ * Copyright 2013-2014 Benjamin Vernoux <titanmkd@gmail.com>
+ *
+ * This file is part of HackRF and bladeRF.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "btle_board.h"
+
+#ifdef USE_BLADERF
+#include <libbladeRF.h>
+#include <pthread.h>
+#else
+#include <hackrf.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef USE_BLADERF //--------------------------------------BladeRF-----------------------
+char *board_name = "BladeRF";
+
+#define NUM_BLADERF_BUF_SAMPLE 4096 // per bladerf_sync_rx/tx call
+#define NUM_BLADERF_RX_BUF_SAMPLE (8*4096) // bladerf_sync_config buffer size for RX
+// low_latency RX: USB buffers and reads as small as a HackRF transfer (512us at 4Msps), with
+// enough of them in flight for the sample rate
+#define NUM_BLADERF_LL_BUF_SAMPLE 2048
+#define NUM_BLADERF_LL_BUFFERS 32
+#define NUM_BLADERF_LL_TRANSFERS 16
+
+typedef struct {
+  struct bladerf *dev;
+  BOARD_RX_CALLBACK callback;
+  void *arg;
+  pthread_t thread;
+  volatile int stop;
+  int num_sample;       // per bladerf_sync_rx call
+  IQ_TYPE buf[NUM_BLADERF_BUF_SAMPLE*2];
+} BOARD_RX;
+
+typedef struct {
+  struct bladerf *dev;
+  int16_t buf[NUM_BLADERF_BUF_SAMPLE*2];
+} BOARD_TX;
+
+static inline const char *backend2str(bladerf_backend b)
+{
+    switch (b) {
+        case BLADERF_BACKEND_LIBUSB:
+            return "libusb";
+        case BLADERF_BACKEND_LINUX:
+            return "Linux kernel driver";
+        default:
+            return "Unknown";
+    }
+}
+
+// opens the bladeRF with serial number serial (the first one if NULL) and sets sample rate
+// and a default frequency on module
+static int init_board(const char *serial, bladerf_module module, struct bladerf **dev_out) {
+  struct bladerf_devinfo *dev_info = NULL;
+  struct bladerf *dev = NULL;
+  char dev_id[16+BLADERF_SERIAL_LENGTH];
+  int n_devices = bladerf_get_device_list(&dev_info), i;
+
+  (*dev_out) = NULL;
+  if (n_devices < 0) {
+    if (n_devices == BLADERF_ERR_NODEV) {
+        printf("init_board: No bladeRF devices found.\n");
+    } else {
+        printf("init_board: Failed to probe for bladeRF devices: %s\n", bladerf_strerror(n_devices));
+    }
+		return(-1);
+  }
+
+  i = 0;
+  if (serial != NULL) {
+    for (i=0; i<n_devices; i++) {
+      if (strcmp(dev_info[i].serial, serial) == 0) {
+        break;
+      }
+    }
+    if (i == n_devices) {
+      printf("init_board: no bladeRF with serial %s among %d devices found!\n", serial, n_devices);
+      bladerf_free_device_list(dev_info);
+      return(-1);
+    }
+    printf("init_board: %d bladeRF devices found! %s will be used:\n", n_devices, serial);
+  } else {
+    printf("init_board: %d bladeRF devices found! The 1st one will be used:\n", n_devices);
+  }
+  printf("    Backend:        %s\n", backend2str(dev_info[i].backend));
+  printf("    Serial:         %s\n", dev_info[i].serial);
+  printf("    USB Bus:        %d\n", dev_info[i].usb_bus);
+  printf("    USB Address:    %d\n", dev_info[i].usb_addr);
+  bladerf_free_device_list(dev_info);
+
+  int fpga_loaded;
+  int status;
+  if (serial != NULL) {
+    snprintf(dev_id, sizeof(dev_id), "*:serial=%s", serial);
+    status = bladerf_open(&dev, dev_id);
+  } else {
+    status = bladerf_open(&dev, NULL);
+  }
+  if (status != 0) {
+    printf("init_board: Failed to open bladeRF device: %s\n",
+            bladerf_strerror(status));
+    return(-1);
+  }
+
+  fpga_loaded = bladerf_is_fpga_configured(dev);
+  if (fpga_loaded < 0) {
+      printf("init_board: Failed to check FPGA state: %s\n",
+                bladerf_strerror(fpga_loaded));
+      status = -1;
+      goto initialize_device_out_point;
+  } else if (fpga_loaded == 0) {
+      printf("init_board: The device's FPGA is not loaded.\n");
+      status = -1;
+      goto initialize_device_out_point;
+  }
+
+  unsigned int actual_sample_rate;
+  status = bladerf_set_sample_rate(dev, module, SAMPLE_PER_SYMBOL*1000000ul, &actual_sample_rate);
+  if (status != 0) {
+      printf("init_board: Failed to set samplerate: %s\n",
+              bladerf_strerror(status));
+      goto initialize_device_out_point;
+  }
+
+  status = bladerf_set_frequency(dev, module, 2402000000ul);
+  if (status != 0) {
+      printf("init_board: Failed to set frequency: %s\n",
+              bladerf_strerror(status));
+      goto initialize_device_out_point;
+  }
+
+  unsigned int actual_frequency;
+  status = bladerf_get_frequency(dev, module, &actual_frequency);
+  if (status != 0) {
+      printf("init_board: Failed to read back frequency: %s\n",
+              bladerf_strerror(status));
+      goto initialize_device_out_point;
+  }
+
+initialize_device_out_point:
+  if (status != 0) {
+      bladerf_close(dev);
+      return(-1);
+  }
+
+  printf("init_board: set bladeRF to %f MHz %u sps BLADERF_LB_NONE.\n", (float)actual_frequency/1000000.0f, actual_sample_rate);
+  (*dev_out) = dev;
+  return(0);
+}
+
+static int open_board(struct bladerf *dev, bladerf_module module, uint64_t freq_hz, int gain, unsigned int num_buffers, unsigned int buffer_size, unsigned int num_transfers) {
+  int status;
+
+  status = bladerf_set_frequency(dev, module, freq_hz);
+  if (status != 0) {
+    printf("open_board: Failed to set frequency: %s\n",
+            bladerf_strerror(status));
+    return(-1);
+  }
+
+  status = bladerf_set_gain(dev, module, gain);
+  if (status != 0) {
+    printf("open_board: Failed to set gain: %s\n",
+            bladerf_strerror(status));
+    return(-1);
+  }
+
+  status = bladerf_sync_config(dev, module, BLADERF_FORMAT_SC16_Q11, num_buffers, buffer_size, num_transfers, 3500);
+  if (status != 0) {
+     printf("open_board: Failed to configure sync interface: %s\n",
+             bladerf_strerror(status));
+     return(-1);
+  }
+
+  status = bladerf_enable_module(dev, module, true);
+  if (status != 0) {
+     printf("open_board: Failed to enable module: %s\n",
+             bladerf_strerror(status));
+     return(-1);
+  }
+
+  return(0);
+}
+
+static int close_board(struct bladerf *dev, bladerf_module module) {
+  // Disable the module, shutting down our underlying stream
+  int status = bladerf_enable_module(dev, module, false);
+  if (status != 0) {
+    printf("close_board: Failed to disable module: %s\n",
+             bladerf_strerror(status));
+    return(-1);
+  }
+
+  return(0);
+}
+
+//----------------------------------RX----------------------------------
+// init_board() has set SAMPLE_PER_SYMBOL Msps. oversampled: the LMS filter only has to stop aliasing
+static int set_rx_sample_rate(struct bladerf *dev, unsigned int sample_rate) {
+  unsigned int actual;
+  int status;
+
+  if (sample_rate == SAMPLE_PER_SYMBOL*1000000ul) {
+    return(0);
+  }
+
+  status = bladerf_set_sample_rate(dev, BLADERF_MODULE_RX, sample_rate, &actual);
+  if (status != 0) {
+    printf("set_rx_sample_rate: Failed to set samplerate: %s\n", bladerf_strerror(status));
+    return(-1);
+  }
+  status = bladerf_set_bandwidth(dev, BLADERF_MODULE_RX, sample_rate*3/4, &actual);
+  if (status != 0) {
+    printf("set_rx_sample_rate: Failed to set bandwidth: %s\n", bladerf_strerror(status));
+    return(-1);
+  }
+  return(0);
+}
+
+// libbladeRF has no rx callback: read in a thread of our own, like libhackrf does internally
+static void *rx_thread(void *arg) {
+  BOARD_RX *rx = (BOARD_RX *)arg;
+  int status;
+
+  while (rx->stop == 0) {
+    status = bladerf_sync_rx(rx->dev, (void *)(rx->buf), rx->num_sample, NULL, 3500);
+    if (status != 0) {
+      printf("rx_thread: Failed to RX samples: %s\n", bladerf_strerror(status));
+      break;
+    }
+    if ( (*(rx->callback))(rx->buf, rx->num_sample*2, rx->num_sample*2, rx->arg) != 0 ) {
+      break;
+    }
+  }
+
+  return(NULL);
+}
+
+int config_run_board(const char *serial, uint64_t freq_hz, unsigned int sample_rate, int gain, int low_latency, BOARD_RX_CALLBACK callback, void *arg, void **rf_dev) {
+  BOARD_RX *rx;
+
+  (*rf_dev) = NULL;
+
+  rx = (BOARD_RX *)calloc(1, sizeof(BOARD_RX));
+  if (rx == NULL) {
+    printf("config_run_board: calloc failed!\n");
+    return(-1);
+  }
+  rx->callback = callback;
+  rx->arg = arg;
+  rx->num_sample = (low_latency? NUM_BLADERF_LL_BUF_SAMPLE : NUM_BLADERF_BUF_SAMPLE);
+
+  if (init_board(serial, BLADERF_MODULE_RX, &(rx->dev)) != 0) {
+    free(rx);
+    return(-1);
+  }
+
+  if ( set_rx_sample_rate(rx->dev, sample_rate) != 0 ||
+       ( low_latency? open_board(rx->dev, BLADERF_MODULE_RX, freq_hz, gain, NUM_BLADERF_LL_BUFFERS, NUM_BLADERF_LL_BUF_SAMPLE, NUM_BLADERF_LL_TRANSFERS) :
+                      open_board(rx->dev, BLADERF_MODULE_RX, freq_hz, gain, 2, NUM_BLADERF_RX_BUF_SAMPLE, 1) ) != 0 ) {
+    bladerf_close(rx->dev);
+    free(rx);
+    return(-1);
+  }
+
+  if ( pthread_create(&(rx->thread), NULL, rx_thread, (void *)rx) != 0 ) {
+    printf("config_run_board: pthread_create failed!\n");
+    close_board(rx->dev, BLADERF_MODULE_RX);
+    bladerf_close(rx->dev);
+    free(rx);
+    return(-1);
+  }
+
+  (*rf_dev) = rx;
+  return(0);
+}
+
+void stop_close_board(void *rf_dev) {
+  BOARD_RX *rx = (BOARD_RX *)rf_dev;
+
+  if (rx == NULL) {
+    return;
+  }
+
+  rx->stop = 1;
+  pthread_join(rx->thread, NULL);
+  close_board(rx->dev, BLADERF_MODULE_RX);
+  bladerf_close(rx->dev);
+  free(rx);
+}
+
+int set_board_rx_gain(void *rf_dev, int gain) {
+  BOARD_RX *rx = (BOARD_RX *)rf_dev;
+  int status;
+
+  status = bladerf_set_gain(rx->dev, BLADERF_MODULE_RX, gain);
+  if (status != 0) {
+    printf("set_board_rx_gain: Failed to set gain: %s\n", bladerf_strerror(status));
+    return(-1);
+  }
+  return(0);
+}
+
+int set_board_rx_freq(void *rf_dev, uint64_t freq_hz) {
+  BOARD_RX *rx = (BOARD_RX *)rf_dev;
+  int status;
+
+  status = bladerf_set_frequency(rx->dev, BLADERF_MODULE_RX, freq_hz);
+  if (status != 0) {
+    printf("set_board_rx_freq: Failed to set frequency: %s\n", bladerf_strerror(status));
+    return(-1);
+  }
+  return(0);
+}
+
+//----------------------------------TX----------------------------------
+int init_board_tx(void **rf_dev) {
+  BOARD_TX *tx;
+
+  (*rf_dev) = NULL;
+
+  tx = (BOARD_TX *)calloc(1, sizeof(BOARD_TX));
+  if (tx == NULL) {
+    printf("init_board_tx: calloc failed!\n");
+    return(-1);
+  }
+
+  if (init_board(NULL, BLADERF_MODULE_TX, &(tx->dev)) != 0) {
+    free(tx);
+    return(-1);
+  }
+
+  (*rf_dev) = tx;
+  return(0);
+}
+
+int flush_board_tx(void *rf_dev, uint64_t freq_hz, volatile int *do_exit) {
+  return(0);
+}
+
+int tx_one_buf(void *rf_dev, char *buf, int length, uint64_t freq_hz, volatile int *do_exit) {
+  BOARD_TX *tx = (BOARD_TX *)rf_dev;
+  int status, i;
+
+  memset( (void *)(tx->buf), 0, NUM_BLADERF_BUF_SAMPLE*2*sizeof(tx->buf[0]) );
+
+  for (i=(NUM_BLADERF_BUF_SAMPLE*2-length); i<(NUM_BLADERF_BUF_SAMPLE*2); i++) {
+    tx->buf[i] = ( (int)( buf[i-(NUM_BLADERF_BUF_SAMPLE*2-length)] ) )*16;
+  }
+
+  // open the board-----------------------------------------
+  if (open_board(tx->dev, BLADERF_MODULE_TX, freq_hz, 60, 2, NUM_BLADERF_BUF_SAMPLE, 1) == -1) {
+    printf("tx_one_buf: open_board() failed\n");
+    close_board(tx->dev, BLADERF_MODULE_TX);
+    return(-1);
+  }
+
+  // Transmit samples
+  status = bladerf_sync_tx(tx->dev, (void *)(tx->buf), NUM_BLADERF_BUF_SAMPLE, NULL, 3500);
+  if (status != 0) {
+    printf("tx_one_buf: Failed to TX samples 1: %s\n",
+             bladerf_strerror(status));
+    close_board(tx->dev, BLADERF_MODULE_TX);
+    return(-1);
+  }
+
+  if (*do_exit)
+  {
+    printf("\ntx_one_buf: Exiting...\n");
+    close_board(tx->dev, BLADERF_MODULE_TX);
+    return(-1);
+  }
+
+  // close the board---------------------------------------
+  if (close_board(tx->dev, BLADERF_MODULE_TX) == -1) {
+    printf("tx_one_buf: close_board() failed\n");
+    return(-1);
+  }
+
+  return(0);
+}
+
+void exit_board_tx(void *rf_dev) {
+  BOARD_TX *tx = (BOARD_TX *)rf_dev;
+
+  if (tx == NULL) {
+    return;
+  }
+
+  bladerf_close(tx->dev);
+  free(tx);
+}
+
+#else //-----------------------------the board is HACKRF-----------------------------
+char *board_name = "HACKRF";
+
+#define MAX_LNA_GAIN 40
+
+#define NUM_PRE_SEND_DATA (256)
+#define HACKRF_ONBOARD_BUF_SIZE (32768) // in usb_bulk_buffer.h
+#define HACKRF_USB_BUF_SIZE (4096) // in hackrf.c lib_device->buffer_size
+
+typedef struct {
+  hackrf_device *device;
+  BOARD_RX_CALLBACK callback;
+  void *arg;
+} BOARD_RX;
+
+typedef struct {
+  hackrf_device *device;
+  volatile char *tx_buf;
+  volatile int tx_len;
+  volatile int stop_tx;
+} BOARD_TX;
+
+static char tx_zeros[HACKRF_USB_BUF_SIZE-NUM_PRE_SEND_DATA] = {0};
+
+static int num_rx_board = 0; // hackrf_init()/hackrf_exit() only around the first/last open RX board
+
+static int close_board(hackrf_device *device, int is_tx) {
+  int result;
+
+	if(device != NULL)
+	{
+    result = (is_tx? hackrf_stop_tx(device) : hackrf_stop_rx(device));
+    if( result != HACKRF_SUCCESS ) {
+      printf("close_board: hackrf_stop_%s() failed: %s (%d)\n", (is_tx? "tx" : "rx"), hackrf_error_name(result), result);
+      return(-1);
+    }
+
+		result = hackrf_close(device);
+		if( result != HACKRF_SUCCESS )
+		{
+			printf("close_board: hackrf_close() failed: %s (%d)\n", hackrf_error_name(result), result);
+			return(-1);
+		}
+
+    return(0);
+	} else {
+	  return(-1);
+	}
+}
+
+//----------------------------------RX----------------------------------
+static int rx_callback(hackrf_transfer* transfer) {
+  BOARD_RX *rx = (BOARD_RX *)(transfer->rx_ctx);
+  //transfer->valid_length is 262144 in old driver. Now it is 4096. Defined in hackrf.c lib_device->buffer_size
+  return( (*(rx->callback))((IQ_TYPE *)(transfer->buffer), transfer->valid_length, transfer->buffer_length, rx->arg) );
+}
+
+static int open_board(const char *serial, uint64_t freq_hz, unsigned int sample_rate, int gain, hackrf_device** device) {
+  int result;
+
+  if (serial != NULL) {
+    result = hackrf_open_by_serial(serial, device);
+  } else {
+    result = hackrf_open(device);
+  }
+	if( result != HACKRF_SUCCESS ) {
+		printf("open_board: hackrf_open%s() failed: %s (%d)\n", (serial != NULL? "_by_serial" : ""), hackrf_error_name(result), result);
+    (*device) = NULL;
+		return(-1);
+	}
+
+  result = hackrf_set_freq(*device, freq_hz);
+  if( result != HACKRF_SUCCESS ) {
+    printf("open_board: hackrf_set_freq() failed: %s (%d)\n", hackrf_error_name(result), result);
+    return(-1);
+  }
+
+  result = hackrf_set_sample_rate(*device, sample_rate);
+  if( result != HACKRF_SUCCESS ) {
+    printf("open_board: hackrf_set_sample_rate() failed: %s (%d)\n", hackrf_error_name(result), result);
+    return(-1);
+  }
+
+  // at SAMPLE_PER_SYMBOL Msps the analog filter is the channel filter. oversampled it only has
+  // to stop aliasing (6MHz at 8Msps), the channel filter is digital then
+  result = hackrf_set_baseband_filter_bandwidth(*device, (sample_rate == SAMPLE_PER_SYMBOL*1000000ul? sample_rate/2 : sample_rate*3/4));
+  if( result != HACKRF_SUCCESS ) {
+    printf("open_board: hackrf_set_baseband_filter_bandwidth() failed: %s (%d)\n", hackrf_error_name(result), result);
+    return(-1);
+  }
+
+  result = hackrf_set_vga_gain(*device, gain);
+	result |= hackrf_set_lna_gain(*device, MAX_LNA_GAIN);
+  if( result != HACKRF_SUCCESS ) {
+    printf("open_board: hackrf_set_txvga_gain() failed: %s (%d)\n", hackrf_error_name(result), result);
+    return(-1);
+  }
+
+  return(0);
+}
+
+static int run_board(BOARD_RX *rx) {
+  int result;
+
+	result = hackrf_stop_rx(rx->device);
+	if( result != HACKRF_SUCCESS ) {
+		printf("run_board: hackrf_stop_rx() failed: %s (%d)\n", hackrf_error_name(result), result);
+		return(-1);
+	}
+
+  result = hackrf_start_rx(rx->device, rx_callback, (void *)rx);
+  if( result != HACKRF_SUCCESS ) {
+    printf("run_board: hackrf_start_rx() failed: %s (%d)\n", hackrf_error_name(result), result);
+    return(-1);
+  }
+
+  return(0);
+}
+
+int config_run_board(const char *serial, uint64_t freq_hz, unsigned int sample_rate, int gain, int low_latency, BOARD_RX_CALLBACK callback, void *arg, void **rf_dev) {
+  BOARD_RX *rx;
+  int result;
+
+  (*rf_dev) = NULL;
+
+  rx = (BOARD_RX *)calloc(1, sizeof(BOARD_RX));
+  if (rx == NULL) {
+    printf("config_run_board: calloc failed!\n");
+    return(-1);
+  }
+  rx->callback = callback;
+  rx->arg = arg;
+
+  if (num_rx_board == 0) {
+    result = hackrf_init();
+    if( result != HACKRF_SUCCESS ) {
+      printf("config_run_board: hackrf_init() failed: %s (%d)\n", hackrf_error_name(result), result);
+      free(rx);
+      return(-1);
+    }
+  }
+  num_rx_board++;
+
+  // low_latency: nothing to do, a transfer is HACKRF_USB_BUF_SIZE bytes (512us at 4Msps)
+  if ( open_board(serial, freq_hz, sample_rate, gain, &(rx->device)) != 0 || run_board(rx) != 0 ) {
+    stop_close_board(rx);
+    return(-1);
+  }
+
+  (*rf_dev) = rx;
+  return(0);
+}
+
+void stop_close_board(void *rf_dev) {
+  BOARD_RX *rx = (BOARD_RX *)rf_dev;
+
+  if (rx == NULL) {
+    return;
+  }
+
+  if (rx->device != NULL) {
+    close_board(rx->device, 0);
+  }
+  num_rx_board--;
+  if (num_rx_board == 0) {
+    hackrf_exit();
+    printf("hackrf_exit() done\n");
+  }
+  free(rx);
+}
+
+int set_board_rx_gain(void *rf_dev, int gain) {
+  BOARD_RX *rx = (BOARD_RX *)rf_dev;
+  int result;
+
+  result = hackrf_set_vga_gain(rx->device, gain);
+  if( result != HACKRF_SUCCESS ) {
+    printf("set_board_rx_gain: hackrf_set_vga_gain() failed: %s (%d)\n", hackrf_error_name(result), result);
+    return(-1);
+  }
+  return(0);
+}
+
+int set_board_rx_freq(void *rf_dev, uint64_t freq_hz) {
+  BOARD_RX *rx = (BOARD_RX *)rf_dev;
+  int result;
+
+  result = hackrf_set_freq(rx->device, freq_hz);
+  if( result != HACKRF_SUCCESS ) {
+    printf("set_board_rx_freq: hackrf_set_freq() failed: %s (%d)\n", hackrf_error_name(result), result);
+    return(-1);
+  }
+  return(0);
+}
+
+//----------------------------------TX----------------------------------
+static int tx_callback(hackrf_transfer* transfer) {
+  BOARD_TX *tx = (BOARD_TX *)(transfer->tx_ctx);
+
+  // don't feed data to the beginning of transfer->buffer, because tx needs warming up
+  if (~(tx->stop_tx)) {
+    memset(transfer->buffer, 0, NUM_PRE_SEND_DATA);
+    memcpy(transfer->buffer+NUM_PRE_SEND_DATA, (char *)(tx->tx_buf), tx->tx_len);
+    tx->stop_tx = 1;
+  } else {
+    memset(transfer->buffer, 0, transfer->valid_length);
+  }
+
+  return(0);
+}
+
+static int open_board_tx(BOARD_TX *tx, uint64_t freq_hz) {
+  int result;
+
+	result = hackrf_open(&(tx->device));
+	if( result != HACKRF_SUCCESS ) {
+		printf("open_board: hackrf_open() failed: %s (%d)\n", hackrf_error_name(result), result);
+    tx->device = NULL;
+		return(-1);
+	}
+
+  result = hackrf_set_freq(tx->device, freq_hz);
+  if( result != HACKRF_SUCCESS ) {
+    printf("open_board: hackrf_set_freq() failed: %s (%d)\n", hackrf_error_name(result), result);
+    return(-1);
+  }
+
+  result = hackrf_set_sample_rate(tx->device, SAMPLE_PER_SYMBOL*1000000ul);
+  if( result != HACKRF_SUCCESS ) {
+    printf("open_board: hackrf_set_sample_rate() failed: %s (%d)\n", hackrf_error_name(result), result);
+    return(-1);
+  }
+
+  /* range 0-47 step 1db */
+  result = hackrf_set_txvga_gain(tx->device, 47);
+  if( result != HACKRF_SUCCESS ) {
+    printf("open_board: hackrf_set_txvga_gain() failed: %s (%d)\n", hackrf_error_name(result), result);
+    return(-1);
+  }
+
+  return(0);
+}
+
+// hands the buffer to tx_callback once and waits until it has been taken
+static int tx_round(BOARD_TX *tx, volatile int *do_exit) {
+  int result;
+
+  tx->stop_tx = 0;
+
+  result = hackrf_start_tx(tx->device, tx_callback, (void *)tx);
+  if( result != HACKRF_SUCCESS ) {
+    printf("tx_one_buf: hackrf_start_tx() failed: %s (%d)\n", hackrf_error_name(result), result);
+    return(-1);
+  }
+
+  while( (hackrf_is_streaming(tx->device) == HACKRF_TRUE) &&
+      ((*do_exit) == 0) )
+  {
+    if (tx->stop_tx==1) {
+      break;
+    }
+  }
+
+  if (*do_exit)
+  {
+    printf("\ntx_one_buf: Exiting...\n");
+    return(-1);
+  }
+
+  return(0);
+}
+
+int init_board_tx(void **rf_dev) {
+  BOARD_TX *tx;
+  int result;
+
+  (*rf_dev) = NULL;
+
+  tx = (BOARD_TX *)calloc(1, sizeof(BOARD_TX));
+  if (tx == NULL) {
+    printf("init_board_tx: calloc failed!\n");
+    return(-1);
+  }
+
+	result = hackrf_init();
+	if( result != HACKRF_SUCCESS ) {
+		printf("init_board_tx: hackrf_init() failed: %s (%d)\n", hackrf_error_name(result), result);
+    free(tx);
+		return(-1);
+	}
+
+  (*rf_dev) = tx;
+  return(0);
+}
+
+int flush_board_tx(void *rf_dev, uint64_t freq_hz, volatile int *do_exit) {
+  int i;
+
+  for(i=0; i<(HACKRF_ONBOARD_BUF_SIZE/HACKRF_USB_BUF_SIZE)+5; i++) {
+    if ( tx_one_buf(rf_dev, tx_zeros, HACKRF_USB_BUF_SIZE-NUM_PRE_SEND_DATA, freq_hz, do_exit) == -1 ) {
+      return(-1);
+    }
+  }
+
+  return(0);
+}
+
+// the board is opened and closed around every buffer
+int tx_one_buf(void *rf_dev, char *buf, int length, uint64_t freq_hz, volatile int *do_exit) {
+  BOARD_TX *tx = (BOARD_TX *)rf_dev;
+  int result;
+
+  tx->tx_buf = buf;
+  tx->tx_len = length;
+
+  // open the board-----------------------------------------
+  if (open_board_tx(tx, freq_hz) == -1) {
+    printf("tx_one_buf: open_board() failed\n");
+    goto tx_one_buf_fail;
+  }
+
+  // first round useless TX---------------------------------
+  if (tx_round(tx, do_exit) != 0) {
+    goto tx_one_buf_fail;
+  }
+
+  result = hackrf_stop_tx(tx->device);
+  if( result != HACKRF_SUCCESS ) {
+    printf("tx_one_buf: hackrf_stop_tx() failed: %s (%d)\n", hackrf_error_name(result), result);
+    goto tx_one_buf_fail;
+  }
+
+  (*do_exit) = 0;
+
+  // second round actual TX-----------------------------------
+  if (tx_round(tx, do_exit) != 0) {
+    goto tx_one_buf_fail;
+  }
+
+  // close the board---------------------------------------
+  if (close_board(tx->device, 1) == -1) {
+    printf("tx_one_buf: close_board() failed\n");
+    tx->device = NULL;
+    return(-1);
+  }
+  tx->device = NULL;
+
+  (*do_exit) = 0;
+
+  return(0);
+
+tx_one_buf_fail:
+  close_board(tx->device, 1);
+  tx->device = NULL;
+  return(-1);
+}
+
+void exit_board_tx(void *rf_dev) {
+  BOARD_TX *tx = (BOARD_TX *)rf_dev;
+
+  if (tx == NULL) {
+    return;
+  }
+
+  hackrf_exit();
+  printf("hackrf_exit() done\n");
+  free(tx);
+}
+
+#endif  //#ifdef USE_BLADERF
@@ -0,0 +1,51 @@
+// RF board I/O shared by the btle tools
+//
+// HackRF or bladeRF, selected at build time (common.h). RX delivers samples to a callback
+// from the board's streaming thread: libhackrf's transfer thread, or a bladerf_sync_rx
+// reader thread for bladeRF. TX sends one buffer of int8 I/Q per call.
+
+#ifndef BTLE_BOARD_H
+#define BTLE_BOARD_H
+
+#include <stdint.h>
+
+#include "btle_phy.h"
+
+#ifdef USE_BLADERF
+#define MAX_RX_GAIN 66
+#define DEFAULT_RX_GAIN 66
+#else
+#define MAX_RX_GAIN 62
+#define DEFAULT_RX_GAIN 10
+#endif
+
+extern char *board_name;
+
+// buf holds valid_length IQ_TYPE elements (I and Q counted separately) of a buffer_length
+// transfer. valid only during the call. return 0 to keep streaming
+typedef int (*BOARD_RX_CALLBACK)(IQ_TYPE *buf, int valid_length, int buffer_length, void *arg);
+
+//----------------------------------RX----------------------------------
+// opens the board with serial number serial (NULL: the first one found), tunes it and starts
+// streaming into callback. may be called again for more boards, each streaming in its own
+// thread. sample_rate is SAMPLE_PER_SYMBOL Msps, or a multiple for oversampled capture.
+// low_latency: small USB buffers, so that callback gets samples within ~1ms of the air
+// (libhackrf transfers are that small anyway, bladeRF buffers 8ms by default).
+// on failure everything is released again and *rf_dev is NULL
+int config_run_board(const char *serial, uint64_t freq_hz, unsigned int sample_rate, int gain, int low_latency, BOARD_RX_CALLBACK callback, void *arg, void **rf_dev);
+void stop_close_board(void *rf_dev);
+// retunes a streaming board. gain as for config_run_board: VGA for HackRF (LNA stays at 40dB)
+int set_board_rx_gain(void *rf_dev, int gain);
+// retunes a streaming board to freq_hz. samples keep flowing, the ones around the call are
+// on either frequency
+int set_board_rx_freq(void *rf_dev, uint64_t freq_hz);
+
+//----------------------------------TX----------------------------------
+int init_board_tx(void **rf_dev);
+// pushes stale samples out of the HackRF onboard buffer. nothing to do for bladeRF
+int flush_board_tx(void *rf_dev, uint64_t freq_hz, volatile int *do_exit);
+// buf holds length int8 I/Q elements. returns -1 on error, or when *do_exit gets set meanwhile
+int tx_one_buf(void *rf_dev, char *buf, int length, uint64_t freq_hz, volatile int *do_exit);
+void exit_board_tx(void *rf_dev);
+
+#endif
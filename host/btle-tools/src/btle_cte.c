@@ -0,0 +1,201 @@
+// Constant Tone Extension (BLE 5.1 direction finding) for the btle receiver
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "btle_cte.h"
+#include "btle_pdu.h"
+#include "btle_iqfile.h"
+
+#include <math.h>
+#include <string.h>
+
+#define CTE_FILE_VERSION (1)
+#define LEN_CTE_FILE_HEADER (64)
+#define LEN_CTE_RECORD_HEADER (32)
+
+static const uint8_t CTE_FILE_MAGIC[6] = {'B', 'T', 'L', 'E', 'C', 'T'};
+
+//----------------------------------CTEInfo----------------------------------
+int cte_time_us(int cte_info) {
+  int cte_time = (cte_info&0x1F);
+
+  if ( (cte_info>>6) > CTE_TYPE_AOD_2US || cte_time < CTE_MIN_TIME || cte_time > CTE_MAX_TIME ) {
+    return(-1);
+  }
+  return(cte_time*8);
+}
+
+int cte_info_ext_adv(const uint8_t *payload_byte, int payload_len) {
+  int ext_hdr_len, flags, i;
+
+  if (payload_len < 2) {
+    return(-1);
+  }
+  ext_hdr_len = (payload_byte[0]&0x3F);
+  if ( ext_hdr_len < 1 || 1 + ext_hdr_len > payload_len ) {
+    return(-1);
+  }
+  flags = payload_byte[1];
+  if ( (flags&EXT_HDR_CTEINFO) == 0 ) {
+    return(-1);
+  }
+  // AdvA and TargetA come first, see parse_ext_adv
+  i = 2 + ( (flags&EXT_HDR_ADVA)? 6 : 0 ) + ( (flags&EXT_HDR_TARGETA)? 6 : 0 );
+  if (i >= 1 + ext_hdr_len) {
+    return(-1);
+  }
+  return(payload_byte[i]);
+}
+
+int cte_layout(int cte_info, int aoa_slot_us, CTE_LAYOUT *l) {
+  l->time_us = cte_time_us(cte_info);
+  if (l->time_us < 0) {
+    return(-1);
+  }
+  l->type = (cte_info>>6);
+  l->slot_us = ( l->type == CTE_TYPE_AOD_1US? 1 : (l->type == CTE_TYPE_AOD_2US? 2 : aoa_slot_us) );
+  l->num_ref = CTE_REF_US*SAMPLE_PER_SYMBOL;
+  l->num_slot = (l->time_us - CTE_GUARD_US - CTE_REF_US)/(2*l->slot_us);
+  l->slot_iq = l->slot_us*SAMPLE_PER_SYMBOL;
+  return(0);
+}
+//----------------------------------CTEInfo----------------------------------
+
+//----------------------------------extraction----------------------------------
+static inline IQ_TYPE cte_sat(int v) {
+  return( (IQ_TYPE)( v > IQ_MAX? IQ_MAX : (v < -IQ_MAX? -IQ_MAX : v) ) );
+}
+
+// num_iq samples of in, the first one n samples after the start of the reference period, times
+// exp(j*phase) with phase n*step in 1/2^32 turns. cos/sin_table_int8 are 127 full scale
+static void cte_derotate(const IQ_TYPE *in, int num_iq, uint32_t n, uint32_t step, IQ_TYPE *out) {
+  uint32_t phase;
+  int i, c, s, idx;
+
+  for (i=0; i<num_iq; i++) {
+    phase = (n + i)*step;
+    idx = ( (phase + (1u<<21))>>22 )&1023;
+    c = cos_table_int8[idx];
+    s = sin_table_int8[idx];
+    out[2*i+0] = cte_sat( (in[2*i]*c - in[2*i+1]*s + 64)>>7 );
+    out[2*i+1] = cte_sat( (in[2*i]*s + in[2*i+1]*c + 64)>>7 );
+  }
+}
+
+float cte_extract(const IQ_TYPE *cte, const CTE_LAYOUT *l, int cfo_remove, IQ_TYPE *out) {
+  const IQ_TYPE *ref = cte + 2*CTE_GUARD_US*SAMPLE_PER_SYMBOL;
+  const int lag = l->num_ref/2;
+  int64_t acc_i = 0, acc_q = 0, acc_lag_i = 0, acc_lag_q = 0;
+  uint32_t step;
+  float w, w_lag;
+  int i, k, slot_start;
+
+  // phase advance per sample of the tone: the angle of x[n+1]*conj(x[n]) summed over the
+  // reference, then refined by x[n+lag]*conj(x[n]), lag times more precise once unwrapped by it
+  for (i=0; i<l->num_ref-1; i++) {
+    acc_i += ref[2*i+2]*ref[2*i] + ref[2*i+3]*ref[2*i+1];
+    acc_q += ref[2*i+3]*ref[2*i] - ref[2*i+2]*ref[2*i+1];
+  }
+  for (i=0; i<l->num_ref-lag; i++) {
+    acc_lag_i += ref[2*(i+lag)]*ref[2*i] + ref[2*(i+lag)+1]*ref[2*i+1];
+    acc_lag_q += ref[2*(i+lag)+1]*ref[2*i] - ref[2*(i+lag)]*ref[2*i+1];
+  }
+  w = atan2f((float)acc_q, (float)acc_i);
+  w_lag = atan2f((float)acc_lag_q, (float)acc_lag_i) - lag*w;
+  w_lag = w_lag - 2.0f*(float)M_PI*floorf(w_lag/(2.0f*(float)M_PI) + 0.5f);
+  w = w + w_lag/lag;
+
+  step = (uint32_t)(int64_t)lrintf( -w*(4294967296.0f/(2.0f*(float)M_PI)) );
+  for (k=0; k<=l->num_slot; k++) {
+    // k == 0: the reference period. sample slot k-1 follows switch slot k-1
+    slot_start = ( k == 0? 0 : (CTE_REF_US + l->slot_us*(2*k-1))*SAMPLE_PER_SYMBOL );
+    if (cfo_remove) {
+      cte_derotate(ref + 2*slot_start, (k == 0? l->num_ref : l->slot_iq), (uint32_t)slot_start, step, out);
+    } else {
+      memcpy(out, ref + 2*slot_start, 2*(k == 0? l->num_ref : l->slot_iq)*sizeof(IQ_TYPE));
+    }
+    out = out + 2*(k == 0? l->num_ref : l->slot_iq);
+  }
+
+  return( w*(SAMPLE_PER_SYMBOL*1000000.0f)/(2.0f*(float)M_PI) - CTE_TONE_HZ );
+}
+//----------------------------------extraction----------------------------------
+
+//----------------------------------CTE file----------------------------------
+static void put_le(uint8_t *p, uint64_t v, int num_byte) {
+  int i;
+  for (i=0; i<num_byte; i++) {
+    p[i] = (uint8_t)(v>>(8*i));
+  }
+}
+
+int cte_file_create(CTE_FILE *f, const char *name) {
+  uint8_t header[LEN_CTE_FILE_HEADER];
+
+  memset(f, 0, sizeof(CTE_FILE));
+  f->fp = fopen(name, "wb");
+  if (f->fp == NULL) {
+    printf("cte_file_create: fopen %s failed!\n", name);
+    return(-1);
+  }
+  memset(header, 0, sizeof(header));
+  memcpy(header, CTE_FILE_MAGIC, sizeof(CTE_FILE_MAGIC));
+  put_le(header+6, CTE_FILE_VERSION, 2);
+  put_le(header+8, LEN_CTE_FILE_HEADER, 4);
+  put_le(header+12, IQ_FORMAT_NATIVE, 4);
+  put_le(header+16, SAMPLE_PER_SYMBOL*1000000ull, 8);
+  if ( fwrite(header, 1, sizeof(header), f->fp) != sizeof(header) ) {
+    printf("cte_file_create: fwrite failed!\n");
+    cte_file_close(f);
+    return(-1);
+  }
+  return(0);
+}
+
+int cte_file_write(CTE_FILE *f, const CTE_RECORD *r, const IQ_TYPE *iq) {
+  uint8_t header[LEN_CTE_RECORD_HEADER];
+  size_t num_byte = 2*( r->layout.num_ref + r->layout.num_slot*r->layout.slot_iq )*sizeof(IQ_TYPE);
+
+  memset(header, 0, sizeof(header));
+  put_le(header+0, LEN_CTE_RECORD_HEADER + num_byte, 4);
+  put_le(header+4, r->access_addr, 4);
+  put_le(header+8, (uint64_t)r->time_ns, 8);
+  put_le(header+16, r->channel_number, 1);
+  put_le(header+17, r->cte_info, 1);
+  put_le(header+18, r->layout.slot_us, 1);
+  put_le(header+19, r->flags, 1);
+  put_le(header+20, (uint32_t)(int32_t)lrintf(r->cfo_hz), 4);
+  put_le(header+24, r->layout.num_ref, 2);
+  put_le(header+26, r->layout.num_slot, 2);
+  put_le(header+28, r->layout.slot_iq, 2);
+  // the samples go out from where the caller keeps them, the stdio buffer is the only copy
+  if ( fwrite(header, 1, sizeof(header), f->fp) != sizeof(header) || fwrite(iq, 1, num_byte, f->fp) != num_byte ) {
+    printf("cte_file_write: fwrite failed!\n");
+    return(-1);
+  }
+  f->num_record++;
+  return(0);
+}
+
+void cte_file_close(CTE_FILE *f) {
+  if (f->fp != NULL) {
+    fclose(f->fp);
+    f->fp = NULL;
+  }
+}
+//----------------------------------CTE file----------------------------------
@@ -0,0 +1,97 @@
+// Constant Tone Extension (BLE 5.1 direction finding) for the btle receiver
+//
+// A packet announces a CTE with the CP bit of its data PDU header (CTEInfo octet right after
+// the header) or the CTEInfo field of its extended header (AUX_SYNC_IND and friends). The CTE
+// follows the CRC unwhitened: a 4us guard, an 8us reference period, then switch and sample
+// slots of 1us or 2us taking turns, a switch slot first, up to CTETime x 8us in total. The
+// transmitter sends a plain 1 bit stream, a tone 250kHz above the channel center.
+// cte_extract() keeps the reference period and the sample slots, dropping the guard and the
+// switch slots, in one pass straight from the sample buffer. The reference period gives the
+// tone as the receiver sees it; removing it leaves the reference as a constant phasor and
+// each sample slot with the phase its antenna adds, which is what AoA/AoD estimation works on.
+// The CTE file (-E of btle_rx) is a 64 byte little endian header:
+//   0  "BTLECT" + uint16 version
+//   8  uint32 header length
+//   12 uint32 format of the IQ samples, IQ_FORMAT
+//   16 uint64 sample rate in Hz
+// then one record per packet, a 32 byte little endian record header and its IQ samples:
+//   0  uint32 record length in bytes, the record header included
+//   4  uint32 access address
+//   8  int64  host time of the preamble, ns since the epoch
+//   16 uint8  channel
+//   17 uint8  CTEInfo
+//   18 uint8  slot duration in us
+//   19 uint8  CTE_FLAG_ bits
+//   20 int32  carrier offset in Hz, the tone minus 250kHz
+//   24 uint16 IQ samples of the reference period
+//   26 uint16 sample slots
+//   28 uint16 IQ samples per sample slot
+//   30 uint16 0
+//   32 the reference period, then the sample slots, interleaved I/Q
+
+#ifndef BTLE_CTE_H
+#define BTLE_CTE_H
+
+#include "btle_phy.h"
+
+#include <stdio.h>
+
+#define CTE_TYPE_AOA      0
+#define CTE_TYPE_AOD_1US  1
+#define CTE_TYPE_AOD_2US  2
+
+#define CTE_GUARD_US      4
+#define CTE_REF_US        8
+#define CTE_MIN_TIME      2    // CTETime, 8us units
+#define CTE_MAX_TIME      20
+#define CTE_TONE_HZ       250000
+#define CTE_AOA_SLOT_US   2    // AoA slots are the receiver's choice, not in CTEInfo. 2us: the one all support
+#define MAX_NUM_CTE_SAMPLE (CTE_MAX_TIME*8*SAMPLE_PER_SYMBOL) // IQ samples of the longest CTE, on air after the CRC
+// the sample slots of 1us and of 2us both add up to half of what follows the reference period
+#define MAX_NUM_CTE_IQ    (CTE_REF_US*SAMPLE_PER_SYMBOL + (CTE_MAX_TIME*8-CTE_GUARD_US-CTE_REF_US)/2*SAMPLE_PER_SYMBOL)
+
+#define CTE_FLAG_CFO_REMOVED  0x01  // the IQ samples are derotated by the tone of the reference period
+#define CTE_FLAG_TORN         0x02  // rx_buf was overwritten while the packet was demodulated
+
+typedef struct {
+  int type;       // CTE_TYPE_
+  int time_us;    // whole CTE, guard included
+  int slot_us;    // 1 or 2
+  int num_ref;    // IQ samples of the reference period
+  int num_slot;   // sample slots
+  int slot_iq;    // IQ samples per sample slot
+} CTE_LAYOUT;
+
+// length of the CTE a CTEInfo octet announces in us, -1 if CTETime is out of range or CTEType RFU
+int cte_time_us(int cte_info);
+// CTEInfo of an extended advertising payload (payload_byte: after the 2 header octets), -1: none
+int cte_info_ext_adv(const uint8_t *payload_byte, int payload_len);
+// aoa_slot_us: the slot duration of an AoA CTE, which the receiver chooses (1 or 2). -1: invalid cte_info
+int cte_layout(int cte_info, int aoa_slot_us, CTE_LAYOUT *l);
+// cte: the IQ_TYPE elements right after the CRC, l->time_us long. writes l->num_ref +
+// l->num_slot*l->slot_iq IQ samples to out, derotated by the tone of the reference period with
+// cfo_remove. returns the carrier offset in Hz
+float cte_extract(const IQ_TYPE *cte, const CTE_LAYOUT *l, int cfo_remove, IQ_TYPE *out);
+
+typedef struct {
+  FILE *fp;
+  uint64_t num_record;
+} CTE_FILE;
+
+typedef struct {
+  uint32_t access_addr;
+  int64_t time_ns;
+  int channel_number;
+  int cte_info;
+  int flags;          // CTE_FLAG_
+  float cfo_hz;
+  CTE_LAYOUT layout;
+} CTE_RECORD;
+
+// returns -1 on failure
+int cte_file_create(CTE_FILE *f, const char *name);
+// iq: as cte_extract() wrote it
+int cte_file_write(CTE_FILE *f, const CTE_RECORD *r, const IQ_TYPE *iq);
+void cte_file_close(CTE_FILE *f);
+
+#endif
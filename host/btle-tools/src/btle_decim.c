@@ -0,0 +1,83 @@
+// Decimating channel filter for oversampled capture
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "btle_decim.h"
+
+#include <string.h>
+
+// Kaiser window (beta 4.5) sinc, cutoff fs_in/8
+const int16_t decim_coef[LEN_DECIM_FILTER] = {
+  -28, -75, -88, 0, 196, 390, 376, 0, -670, -1252, -1177, 0, 2270, 5034, 7311,
+  8194,
+  7311, 5034, 2270, 0, -1177, -1252, -670, 0, 376, 390, 196, 0, -88, -75, -28
+};
+
+void decim_init(DECIMATOR *d) {
+  memset(d, 0, sizeof(DECIMATOR));
+}
+
+// out[n] = sum_k coef[k]*x[2n+k]. x[2n+k] is x_even[n+k/2] for even k, x_odd[n+k/2] for odd k,
+// and taps k and LEN_DECIM_FILTER-1-k (same phase) share a coefficient. one expression per
+// output keeps the sum in registers; the coefficients are constants, the zero ones drop out
+#define DECIM_TAP(x, k) ( (int32_t)decim_coef[k]*(int16_t)( x[(k)&1][n+(k)/2] + x[(k)&1][n+(LEN_DECIM_FILTER-1-(k))/2] ) )
+#define DECIM_SUM(x) ( DECIM_TAP(x, 0) + DECIM_TAP(x, 1) + DECIM_TAP(x, 2) + DECIM_TAP(x, 3) + \
+                       DECIM_TAP(x, 4) + DECIM_TAP(x, 5) + DECIM_TAP(x, 6) + DECIM_TAP(x, 7) + \
+                       DECIM_TAP(x, 8) + DECIM_TAP(x, 9) + DECIM_TAP(x, 10) + DECIM_TAP(x, 11) + \
+                       DECIM_TAP(x, 12) + DECIM_TAP(x, 13) + DECIM_TAP(x, 14) + \
+                       (int32_t)decim_coef[LEN_DECIM_HIST]*x[LEN_DECIM_HIST&1][n+LEN_DECIM_HIST/2] + \
+                       (1<<(DECIM_COEF_SHIFT-1)) )
+
+static void decim_chunk(int16_t (*x)[LEN_DECIM_HIST + LEN_DECIM_CHUNK], IQ_TYPE *out, int num_out) {
+  int32_t v;
+  int n;
+
+  // contiguous int16 loads, int16 x int16 widening multiply, int32 sum: vectorizes
+  for (n=0; n<num_out; n++) {
+    v = DECIM_SUM(x)>>DECIM_COEF_SHIFT;
+    v = (v > IQ_MAX? IQ_MAX : v);
+    v = (v < -IQ_MAX? -IQ_MAX : v);
+    out[2*n] = (IQ_TYPE)v;
+  }
+}
+
+int decim_block(DECIMATOR *d, IQ_TYPE *in, int num_iq_in, IQ_TYPE *out) {
+  int num_out, i, j, c, p;
+
+  for (i=0; i<num_iq_in/2; i=i+num_out) {
+    num_out = num_iq_in/2 - i;
+    num_out = (num_out > LEN_DECIM_CHUNK? LEN_DECIM_CHUNK : num_out);
+
+    // split into I/Q and even/odd samples after the history
+    for (j=0; j<num_out; j++) {
+      d->x[0][0][LEN_DECIM_HIST+j] = in[4*(i+j)];
+      d->x[1][0][LEN_DECIM_HIST+j] = in[4*(i+j)+1];
+      d->x[0][1][LEN_DECIM_HIST+j] = in[4*(i+j)+2];
+      d->x[1][1][LEN_DECIM_HIST+j] = in[4*(i+j)+3];
+    }
+
+    for (c=0; c<2; c++) {
+      decim_chunk(d->x[c], out+2*i+c, num_out);
+      for (p=0; p<2; p++) {
+        memmove(d->x[c][p], d->x[c][p]+num_out, LEN_DECIM_HIST*sizeof(int16_t));
+      }
+    }
+  }
+
+  return(num_iq_in/2);
+}
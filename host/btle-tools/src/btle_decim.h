@@ -0,0 +1,34 @@
+// Decimating channel filter for oversampled capture
+//
+// With btle_rx -R 8 the board runs at 8Msps, its analog filter only guards against aliasing,
+// and channel selection is done here: a 31 tap FIR (cutoff 1MHz, flat to 0.6MHz, 50dB down
+// from 1.4MHz, so the neighbour channels at +-2MHz are removed) computed only at every second
+// input sample, which brings the stream down to the SAMPLE_PER_SYMBOL Msps the receiver runs
+// at. Polyphase form: the input is split into even and odd samples (int16), and each tap pair
+// of the symmetric filter adds one contiguous vector multiply-accumulate over the whole chunk.
+// A halfband would put its transition band right on the neighbour channel, so the cutoff is at
+// a quarter of the Nyquist band instead; every fourth tap is still zero and skipped.
+
+#ifndef BTLE_DECIM_H
+#define BTLE_DECIM_H
+
+#include "btle_phy.h"
+
+#define LEN_DECIM_FILTER (31)
+#define DECIM_COEF_SHIFT (15)           // coefficients are Q15, sum 1.0
+#define LEN_DECIM_HIST ((LEN_DECIM_FILTER-1)/2) // per phase
+#define LEN_DECIM_CHUNK (4096)          // output IQ samples per inner pass
+
+extern const int16_t decim_coef[LEN_DECIM_FILTER];
+
+typedef struct {
+  // [I/Q][even/odd phase]: LEN_DECIM_HIST samples of history, then the chunk being filtered
+  int16_t x[2][2][LEN_DECIM_HIST + LEN_DECIM_CHUNK];
+} DECIMATOR;
+
+void decim_init(DECIMATOR *d);
+// filters num_iq_in I/Q (even) into num_iq_in/2 I/Q at out, saturating to +-IQ_MAX. the
+// filter state carries over to the next call. returns the number of I/Q written
+int decim_block(DECIMATOR *d, IQ_TYPE *in, int num_iq_in, IQ_TYPE *out);
+
+#endif
@@ -0,0 +1,369 @@
+// Early packet filter for the btle receiver
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "btle_filter.h"
+#include "btle_pdu.h"
+#include "btle_misc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define ALL_CHAN_MASK ( (((uint64_t)1)<<(MAX_CHANNEL_NUMBER+1)) - 1 )
+#define ALL_PDU_TYPE_MASK (0xFFFF)
+#define MAX_LEN_FILTER_EXPR (1024)
+
+char *FILTER_STAGE_STR[NUM_FILTER_STAGE] = {
+    "type",
+    "rssi",
+    "addr",
+    "data"
+};
+
+//----------------------------------address field offsets----------------------------------
+// offset of AdvA in the payload, -1 if the PDU type has none
+static int adv_addr_offset(int pdu_type) {
+  if (pdu_type == 0 || pdu_type == 1 || pdu_type == 2 || pdu_type == 4 || pdu_type == 6) {
+    return(0);
+  } else if (pdu_type == 3 || pdu_type == 5) { // ScanA/InitA comes first
+    return(6);
+  }
+  return(-1);
+}
+
+// offset of InitA (TargetA of ADV_DIRECT_IND) in the payload, -1 if the PDU type has none
+static int init_addr_offset(int pdu_type) {
+  if (pdu_type == 1) {
+    return(6);
+  } else if (pdu_type == 5) {
+    return(0);
+  }
+  return(-1);
+}
+
+static int match_addr(uint8_t *addr, uint8_t (*list)[6], int num_addr) {
+  int i;
+  for (i=0; i<num_addr; i++) {
+    if ( memcmp(addr, list[i], 6) == 0 ) {
+      return(1);
+    }
+  }
+  return(0);
+}
+//----------------------------------address field offsets----------------------------------
+
+//----------------------------------stages----------------------------------
+int filter_pdu_type(BTLE_FILTER *filter, int pdu_type) {
+  return( (filter->pdu_type_mask>>pdu_type)&1 );
+}
+
+int filter_num_addr_byte(BTLE_FILTER *filter, int pdu_type) {
+  int num_byte = 0, offset;
+
+  if (filter->num_adv_addr != 0) {
+    offset = adv_addr_offset(pdu_type);
+    if (offset >= 0 && (offset+6) > num_byte) {
+      num_byte = offset+6;
+    }
+  }
+  if (filter->num_init_addr != 0) {
+    offset = init_addr_offset(pdu_type);
+    if (offset >= 0 && (offset+6) > num_byte) {
+      num_byte = offset+6;
+    }
+  }
+  return(num_byte);
+}
+
+// payload_byte holds at least filter_num_addr_byte() de-whitened octets
+int filter_addr(BTLE_FILTER *filter, uint8_t *payload_byte, int pdu_type) {
+  int offset;
+
+  if (filter->num_adv_addr != 0) {
+    offset = adv_addr_offset(pdu_type);
+    if ( offset < 0 || match_addr(payload_byte+offset, filter->adv_addr, filter->num_adv_addr) == 0 ) {
+      return(0);
+    }
+  }
+  if (filter->num_init_addr != 0) {
+    offset = init_addr_offset(pdu_type);
+    if ( offset < 0 || match_addr(payload_byte+offset, filter->init_addr, filter->num_init_addr) == 0 ) {
+      return(0);
+    }
+  }
+  return(1);
+}
+
+int filter_data(BTLE_FILTER *filter, uint8_t *payload_byte, int payload_len, int pdu_type) {
+  FILTER_DATA_PATTERN *pattern;
+  uint8_t *data = payload_byte+6;
+  int num_data = payload_len-6;
+  int i, j, k;
+
+  if (filter->num_data == 0) {
+    return(1);
+  }
+  // AdvData or ScanRspData
+  if ( !(pdu_type == 0 || pdu_type == 2 || pdu_type == 4 || pdu_type == 6) ) {
+    return(0);
+  }
+
+  for (i=0; i<filter->num_data; i++) {
+    pattern = filter->data+i;
+    for (j=0; j<=(num_data-pattern->len); j++) {
+      for (k=0; k<pattern->len; k++) {
+        if ( (data[j+k]&pattern->mask[k]) != pattern->byte[k] ) {
+          break;
+        }
+      }
+      if (k == pattern->len) {
+        return(1);
+      }
+    }
+  }
+  return(0);
+}
+
+int filter_pkt(BTLE_FILTER *filter, int channel_number, int pdu_type, float rssi, uint8_t *payload_byte, int payload_len) {
+  if ( ((filter->chan_mask>>channel_number)&1) == 0 || filter_pdu_type(filter, pdu_type) == 0 || rssi < filter->rssi_th ) {
+    return(0);
+  }
+  if ( payload_len < filter_num_addr_byte(filter, pdu_type) || filter_addr(filter, payload_byte, pdu_type) == 0 ) {
+    return(0);
+  }
+  return( filter_data(filter, payload_byte, payload_len, pdu_type) );
+}
+//----------------------------------stages----------------------------------
+
+//----------------------------------expression parser----------------------------------
+void filter_init(BTLE_FILTER *filter) {
+  memset(filter, 0, sizeof(BTLE_FILTER));
+  filter->chan_mask = ALL_CHAN_MASK;
+  filter->pdu_type_mask = ALL_PDU_TYPE_MASK;
+  filter->rssi_th = FILTER_RSSI_OFF;
+}
+
+int filter_is_active(BTLE_FILTER *filter) {
+  return( filter->chan_mask != ALL_CHAN_MASK || filter->pdu_type_mask != ALL_PDU_TYPE_MASK ||
+          filter->rssi_th != FILTER_RSSI_OFF || filter->num_adv_addr != 0 ||
+          filter->num_init_addr != 0 || filter->num_data != 0 );
+}
+
+static int hex_digit(char c) {
+  if (c >= '0' && c <= '9') {
+    return(c-'0');
+  } else if (c >= 'a' && c <= 'f') {
+    return(c-'a'+10);
+  } else if (c >= 'A' && c <= 'F') {
+    return(c-'A'+10);
+  }
+  return(-1);
+}
+
+// "010203040506" or "01:02:03:04:05:06", most significant octet first as btle_rx prints it
+static int parse_addr(char *str, uint8_t *addr) {
+  int num_digit = 0, d;
+  uint8_t tmp[6];
+
+  for (; (*str) != 0; str++) {
+    if ((*str) == ':') {
+      continue;
+    }
+    d = hex_digit(*str);
+    if (d < 0 || num_digit == 12) {
+      return(-1);
+    }
+    if (num_digit%2 == 0) {
+      tmp[num_digit/2] = (d<<4);
+    } else {
+      tmp[num_digit/2] = tmp[num_digit/2] | d;
+    }
+    num_digit++;
+  }
+  if (num_digit != 12) {
+    return(-1);
+  }
+
+  // to air order
+  for (d=0; d<6; d++) {
+    addr[d] = tmp[5-d];
+  }
+  return(0);
+}
+
+static int parse_data_pattern(char *str, FILTER_DATA_PATTERN *pattern) {
+  int len = strlen(str), i, d0, d1;
+
+  if (len == 0 || len%2 != 0 || len/2 > MAX_LEN_FILTER_DATA) {
+    return(-1);
+  }
+
+  pattern->len = len/2;
+  for (i=0; i<pattern->len; i++) {
+    if (str[2*i] == '?' && str[2*i+1] == '?') {
+      pattern->byte[i] = 0;
+      pattern->mask[i] = 0;
+      continue;
+    }
+    d0 = hex_digit(str[2*i]);
+    d1 = hex_digit(str[2*i+1]);
+    if (d0 < 0 || d1 < 0) {
+      return(-1);
+    }
+    pattern->byte[i] = (d0<<4) | d1;
+    pattern->mask[i] = 0xFF;
+  }
+  return(0);
+}
+
+static int parse_pdu_type(char *str) {
+  char name[32];
+  char *endp;
+  int i, pdu_type;
+
+  if ( isdigit((int)str[0]) ) {
+    pdu_type = strtol(str, &endp, 10);
+    return( ((*endp) != 0 || pdu_type > 15)? -1 : pdu_type );
+  }
+
+  if (strlen(str) >= sizeof(name)) {
+    return(-1);
+  }
+  toupper_str(str, name);
+  for (i=0; i<16; i++) {
+    if (strcmp(name, PDU_TYPE_STR[i]) == 0) {
+      return(i);
+    }
+  }
+  return(-1);
+}
+
+// one "key=value,value" term
+static int parse_filter_term(char *term, BTLE_FILTER *filter, uint64_t *chan_mask, uint32_t *pdu_type_mask) {
+  char *key = term, *val, *next;
+  char *endp;
+  int n;
+
+  val = strchr(term, '=');
+  if (val == NULL) {
+    printf("parse_filter: %s is not key=value!\n", term);
+    return(-1);
+  }
+  (*val) = 0;
+  val++;
+
+  if (strcmp(key, "rssi") == 0) {
+    filter->rssi_th = strtol(val, &endp, 10);
+    if ((*endp) != 0 || val[0] == 0) {
+      printf("parse_filter: invalid rssi %s!\n", val);
+      return(-1);
+    }
+    return(0);
+  }
+
+  for (; val != NULL; val = next) {
+    next = strchr(val, ',');
+    if (next != NULL) {
+      (*next) = 0;
+      next++;
+    }
+
+    if (strcmp(key, "chan") == 0) {
+      n = strtol(val, &endp, 10);
+      if ((*endp) != 0 || val[0] == 0 || n < 0 || n > MAX_CHANNEL_NUMBER) {
+        printf("parse_filter: invalid channel %s!\n", val);
+        return(-1);
+      }
+      (*chan_mask) = (*chan_mask) | (((uint64_t)1)<<n);
+    } else if (strcmp(key, "type") == 0) {
+      n = parse_pdu_type(val);
+      if (n < 0) {
+        printf("parse_filter: invalid PDU type %s!\n", val);
+        return(-1);
+      }
+      (*pdu_type_mask) = (*pdu_type_mask) | (1<<n);
+    } else if (strcmp(key, "adva") == 0 || strcmp(key, "inita") == 0) {
+      int is_adv = (key[0] == 'a');
+      int *num_addr = (is_adv? &(filter->num_adv_addr) : &(filter->num_init_addr));
+      if ((*num_addr) == MAX_NUM_FILTER_ADDR) {
+        printf("parse_filter: too many %s addresses! max %d\n", key, MAX_NUM_FILTER_ADDR);
+        return(-1);
+      }
+      if ( parse_addr(val, (is_adv? filter->adv_addr[*num_addr] : filter->init_addr[*num_addr])) != 0 ) {
+        printf("parse_filter: invalid address %s!\n", val);
+        return(-1);
+      }
+      (*num_addr)++;
+    } else if (strcmp(key, "data") == 0) {
+      if (filter->num_data == MAX_NUM_FILTER_DATA) {
+        printf("parse_filter: too many data patterns! max %d\n", MAX_NUM_FILTER_DATA);
+        return(-1);
+      }
+      if ( parse_data_pattern(val, filter->data+filter->num_data) != 0 ) {
+        printf("parse_filter: invalid data pattern %s! hex octets or ??, at most %d\n", val, MAX_LEN_FILTER_DATA);
+        return(-1);
+      }
+      filter->num_data++;
+    } else {
+      printf("parse_filter: unknown key %s!\n", key);
+      return(-1);
+    }
+  }
+
+  return(0);
+}
+
+int parse_filter(char *expr, BTLE_FILTER *filter) {
+  char buf[MAX_LEN_FILTER_EXPR];
+  char *term, *next;
+  uint64_t chan_mask = 0;
+  uint32_t pdu_type_mask = 0;
+
+  if (strlen(expr) >= sizeof(buf)) {
+    printf("parse_filter: expression is too long!\n");
+    return(-1);
+  }
+  strcpy(buf, expr);
+
+  for (term = buf; term != NULL; term = next) {
+    next = strchr(term, ';');
+    if (next != NULL) {
+      (*next) = 0;
+      next++;
+    }
+    if (term[0] == 0) {
+      continue;
+    }
+    if ( parse_filter_term(term, filter, &chan_mask, &pdu_type_mask) != 0 ) {
+      return(-1);
+    }
+  }
+
+  // lists narrow the accept-all default. repeated expressions add to the list
+  if (chan_mask != 0) {
+    filter->chan_mask = ( filter->chan_mask == ALL_CHAN_MASK? chan_mask : (filter->chan_mask|chan_mask) );
+  }
+  if (pdu_type_mask != 0) {
+    filter->pdu_type_mask = ( filter->pdu_type_mask == ALL_PDU_TYPE_MASK? pdu_type_mask : (filter->pdu_type_mask|pdu_type_mask) );
+  }
+
+  return(0);
+}
+//----------------------------------expression parser----------------------------------
@@ -0,0 +1,71 @@
+// Early packet filter for the btle receiver
+//
+// receiver_block() evaluates the filter stage by stage while it demodulates: channel before
+// the preamble search, PDU type right after the 2 header octets, RSSI on the preamble and
+// access address samples, AdvA/InitA after the first 6 or 12 payload octets, AdvData patterns
+// after the rest. A packet rejected at any stage is not demodulated further and never reaches
+// the packet handler. All configured terms must match; within a list any entry may match.
+//
+// Filter expression: terms "key=value[,value...]" separated by ';'
+//   chan=37,38           channel numbers
+//   type=ADV_IND,4       PDU types, by name or number
+//   rssi=-60             minimum RSSI in dBFS
+//   adva=010203040506    advertiser addresses, as printed by btle_rx
+//   inita=0708090a0b0c   initiator (CONNECT_REQ) / target (ADV_DIRECT_IND) addresses
+//   data=4c000215,ff??4c AdvData/ScanRspData contains the bytes. ?? matches any byte
+
+#ifndef BTLE_FILTER_H
+#define BTLE_FILTER_H
+
+#include <stdint.h>
+
+#define MAX_NUM_FILTER_ADDR (16)
+#define MAX_NUM_FILTER_DATA (8)
+#define MAX_LEN_FILTER_DATA (31)
+#define FILTER_RSSI_OFF (-1000)
+
+typedef enum {
+  FILTER_STAGE_TYPE,
+  FILTER_STAGE_RSSI,
+  FILTER_STAGE_ADDR,
+  FILTER_STAGE_DATA,
+  NUM_FILTER_STAGE
+} FILTER_STAGE;
+
+extern char *FILTER_STAGE_STR[NUM_FILTER_STAGE];
+
+typedef struct {
+  int len;
+  uint8_t byte[MAX_LEN_FILTER_DATA];
+  uint8_t mask[MAX_LEN_FILTER_DATA];    // 0xFF: compare. 0: wildcard
+} FILTER_DATA_PATTERN;
+
+typedef struct {
+  uint64_t chan_mask;                   // bit n: accept channel n
+  uint32_t pdu_type_mask;               // bit n: accept PDU type n
+  int rssi_th;                          // dBFS. FILTER_RSSI_OFF: no threshold
+  int num_adv_addr;
+  uint8_t adv_addr[MAX_NUM_FILTER_ADDR][6];   // air order, LSB first
+  int num_init_addr;
+  uint8_t init_addr[MAX_NUM_FILTER_ADDR][6];  // air order, LSB first
+  int num_data;
+  FILTER_DATA_PATTERN data[MAX_NUM_FILTER_DATA];
+} BTLE_FILTER;
+
+// accept everything
+void filter_init(BTLE_FILTER *filter);
+// adds the terms of expr to filter. returns -1 on a syntax error
+int parse_filter(char *expr, BTLE_FILTER *filter);
+// 1 if anything would be rejected
+int filter_is_active(BTLE_FILTER *filter);
+
+// stages, called by receiver_block(). 1: accept
+int filter_pdu_type(BTLE_FILTER *filter, int pdu_type);
+// payload octets the address stage needs: 0, 6 or 12
+int filter_num_addr_byte(BTLE_FILTER *filter, int pdu_type);
+int filter_addr(BTLE_FILTER *filter, uint8_t *payload_byte, int pdu_type);
+int filter_data(BTLE_FILTER *filter, uint8_t *payload_byte, int payload_len, int pdu_type);
+// all stages at once on a demodulated packet. 1: accept
+int filter_pkt(BTLE_FILTER *filter, int channel_number, int pdu_type, float rssi, uint8_t *payload_byte, int payload_len);
+
+#endif
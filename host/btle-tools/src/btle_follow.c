@@ -0,0 +1,616 @@
+// Following a running connection over its channel hops
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "btle_follow.h"
+
+#include <string.h>
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b) {
+  uint32_t t;
+  while (b != 0) {
+    t = a%b;
+    a = b;
+    b = t;
+  }
+  return(a);
+}
+
+// x*y == 1 mod NUM_DATA_CHANNEL, which is prime. x must not be 0
+static int inv_mod_channel(int x) {
+  int y;
+  for (y=1; y<NUM_DATA_CHANNEL; y++) {
+    if ( (x*y)%NUM_DATA_CHANNEL == 1 ) {
+      return(y);
+    }
+  }
+  return(0);
+}
+
+// how far d (IQ_TYPE elements) may be off a whole number of units before it is no revisit
+static inline uint64_t hop_tolerance(uint64_t d) {
+  return( HOP_JITTER_SAMPLE + d/1000000*HOP_DRIFT_PPM );
+}
+
+//----------------------------------CSA#2----------------------------------
+uint16_t csa2_chan_id(uint32_t access_addr) {
+  return( (uint16_t)( (access_addr>>16)^(access_addr&0xFFFF) ) );
+}
+
+// bit order of each octet reversed
+static inline uint16_t csa2_perm(uint16_t x) {
+  x = ( (x&0x5555)<<1 ) | ( (x>>1)&0x5555 );
+  x = ( (x&0x3333)<<2 ) | ( (x>>2)&0x3333 );
+  x = ( (x&0x0F0F)<<4 ) | ( (x>>4)&0x0F0F );
+  return(x);
+}
+
+uint16_t csa2_prn_e(uint16_t counter, uint16_t chan_id) {
+  uint16_t prn_s = counter^chan_id;
+  int i;
+
+  for (i=0; i<3; i++) {
+    prn_s = csa2_perm(prn_s);
+    prn_s = (uint16_t)( 17*(uint32_t)prn_s + chan_id );
+  }
+  return( prn_s^chan_id );
+}
+//----------------------------------CSA#2----------------------------------
+
+//----------------------------------estimator----------------------------------
+void hop_est_init(HOP_EST *e, uint32_t access_addr, int csa) {
+  memset(e, 0, sizeof(HOP_EST));
+  e->access_addr = access_addr;
+  e->csa = csa;
+  e->last_chan = -1;
+}
+
+// the longest stretch on one channel over the events it holds
+static void hop_est_interval_sample(HOP_EST *e) {
+  uint64_t span, span_max = 0;
+  int i, chan_max = -1;
+
+  for (i=0; i<NUM_DATA_CHANNEL; i++) {
+    span = e->chan_last_idx[i] - e->chan_first_idx[i];
+    if (e->chan_num_event[i] > 1 && span > span_max) {
+      span_max = span;
+      chan_max = i;
+    }
+  }
+  if (chan_max >= 0) {
+    e->interval_sample = (double)span_max/(double)( (span_max + (e->interval*CONN_UNIT_SAMPLE)/2)/(e->interval*CONN_UNIT_SAMPLE) );
+  }
+}
+
+static int hop_est_revisit(HOP_EST *e, int channel_number, uint64_t sample_idx) {
+  uint64_t d = sample_idx - e->chan_last_idx[channel_number];
+  uint64_t u = (d + CONN_UNIT_SAMPLE/2)/CONN_UNIT_SAMPLE;
+  uint64_t err = ( d > u*CONN_UNIT_SAMPLE? d - u*CONN_UNIT_SAMPLE : u*CONN_UNIT_SAMPLE - d );
+  uint32_t g;
+  int interval;
+
+  if ( u == 0 || u > 0xFFFFFFFF || err > hop_tolerance(d) ) {
+    return(0);
+  }
+  g = gcd_u32(e->revisit_gcd, (uint32_t)u);
+  e->num_revisit++;
+  if ( e->revisit_gcd == g && e->num_revisit > 1 ) {
+    e->num_stable++;
+  } else {
+    e->num_stable = 0;
+  }
+  e->revisit_gcd = g;
+  // CSA#2 revisits are random multiples of connInterval: a few of them may share a factor
+  if ( e->num_stable < (e->csa == 2? HOP_CSA2_STABLE_REVISIT : 1) ) {
+    return(0);
+  }
+
+  // CSA#1 with all channels used: a channel comes back every 37 events. else the remapped
+  // visits make it a gcd of other event counts
+  interval = ( (e->csa == 1 && (g%NUM_DATA_CHANNEL) == 0)? (int)(g/NUM_DATA_CHANNEL) : (int)g );
+  if ( interval < MIN_CONN_INTERVAL || interval > MAX_CONN_INTERVAL ) {
+    e->revisit_gcd = 0;
+    e->num_revisit = 0;
+    e->num_stable = 0;
+    return(0);
+  }
+  e->interval = interval;
+  return(HOP_EVENT_INTERVAL);
+}
+
+// the event just added against the nearest one on another channel
+static int hop_est_pair(HOP_EST *e, int channel_number, uint64_t sample_idx) {
+  uint64_t d, d_min = 0, i_sample;
+  int i, n, chan_a, chan_b, other = -1, hop;
+
+  for (i=0; i<NUM_DATA_CHANNEL; i++) {
+    if ( i == channel_number || e->chan_num_event[i] == 0 ) {
+      continue;
+    }
+    d = ( sample_idx > e->chan_last_idx[i]? sample_idx - e->chan_last_idx[i] : e->chan_last_idx[i] - sample_idx );
+    if (other < 0 || d < d_min) {
+      d_min = d;
+      other = i;
+    }
+  }
+  if (other < 0) {
+    return(0);
+  }
+
+  n = (int)( (d_min + (uint64_t)(e->interval_sample/2))/(uint64_t)e->interval_sample );
+  i_sample = (uint64_t)( n*e->interval_sample + 0.5 );
+  if ( (n%NUM_DATA_CHANNEL) == 0 || ( d_min > i_sample? d_min - i_sample : i_sample - d_min ) > hop_tolerance(d_min) ) {
+    return(0);
+  }
+  if (sample_idx > e->chan_last_idx[other]) {
+    chan_a = other;
+    chan_b = channel_number;
+  } else {
+    chan_a = channel_number;
+    chan_b = other;
+  }
+  hop = ( (chan_b - chan_a + NUM_DATA_CHANNEL)*inv_mod_channel(n%NUM_DATA_CHANNEL) )%NUM_DATA_CHANNEL;
+  if ( hop < MIN_HOP || hop > MAX_HOP ) {
+    return(0);
+  }
+  e->hop = hop;
+  e->hop_chan_a = chan_a;
+  e->hop_chan_b = chan_b;
+  e->hop_num_event = n;
+  return(HOP_EVENT_INCREMENT);
+}
+
+// the counter of the latest event whose CSA#2 channels fit all events kept, full channel map
+static int hop_est_counter(HOP_EST *e) {
+  int num_event[HOP_CSA2_HIST_LEN];
+  uint64_t d, i_sample;
+  uint16_t chan_id = csa2_chan_id(e->access_addr);
+  int i, k, n, fit = 0;
+  uint32_t x;
+
+  n = ( e->num_hist < HOP_CSA2_HIST_LEN? e->num_hist : HOP_CSA2_HIST_LEN );
+  if (n < HOP_CSA2_MIN_EVENT) {
+    return(0);
+  }
+  for (k=0; k<n; k++) {
+    d = e->last_idx - e->hist_idx[k];
+    num_event[k] = (int)( (d + (uint64_t)(e->interval_sample/2))/(uint64_t)e->interval_sample );
+    i_sample = (uint64_t)( num_event[k]*e->interval_sample + 0.5 );
+    if ( ( d > i_sample? d - i_sample : i_sample - d ) > hop_tolerance(d) ) {
+      return(0);
+    }
+  }
+
+  for (x=0; x<NUM_CSA2_COUNTER; x++) {
+    for (k=0; k<n; k++) {
+      i = (int)( csa2_prn_e((uint16_t)(x - num_event[k]), chan_id)%NUM_DATA_CHANNEL );
+      if (i != e->hist_chan[k]) {
+        break;
+      }
+    }
+    if (k == n) {
+      e->counter = (uint16_t)x;
+      fit++;
+    }
+  }
+  e->num_counter_fit = fit;
+
+  if (fit == 0) { // the events are not where connInterval puts them: start over
+    e->interval = 0;
+    e->revisit_gcd = 0;
+    e->num_revisit = 0;
+    e->num_stable = 0;
+    e->num_hist = 0;
+    return(0);
+  }
+  return( fit == 1? HOP_EVENT_COUNTER : 0 );
+}
+
+int hop_est_add(HOP_EST *e, uint32_t access_addr, int channel_number, uint64_t sample_idx) {
+  int event = 0;
+
+  if (e->access_addr == 0) {
+    e->access_addr = access_addr;
+  }
+  if ( access_addr != e->access_addr || channel_number < 0 || channel_number >= NUM_DATA_CHANNEL ) {
+    return(0);
+  }
+  // boards hand their packets over block by block, so another channel may come in out of
+  // order. on one channel only later events count
+  if ( e->chan_num_event[channel_number] > 0 && sample_idx < e->chan_last_idx[channel_number] + HOP_EVENT_SAMPLE ) {
+    return(0);
+  }
+
+  if (e->num_event == 0) {
+    e->first_idx = sample_idx;
+  }
+  e->num_event++;
+  if ( e->interval == 0 && e->chan_num_event[channel_number] > 0 ) {
+    event = hop_est_revisit(e, channel_number, sample_idx);
+  }
+
+  if (e->chan_num_event[channel_number] == 0) {
+    e->chan_first_idx[channel_number] = sample_idx;
+  }
+  e->chan_last_idx[channel_number] = sample_idx;
+  e->chan_num_event[channel_number]++;
+  if ( e->last_chan < 0 || sample_idx > e->last_idx ) {
+    e->last_chan = channel_number;
+    e->last_idx = sample_idx;
+  }
+  if (e->csa == 2) {
+    e->hist_idx[e->num_hist%HOP_CSA2_HIST_LEN] = sample_idx;
+    e->hist_chan[e->num_hist%HOP_CSA2_HIST_LEN] = channel_number;
+    e->num_hist++;
+  }
+
+  if (e->interval != 0) {
+    hop_est_interval_sample(e);
+    if (e->csa == 2) {
+      event = event | hop_est_counter(e);
+    } else if (e->hop == 0) {
+      event = event | hop_est_pair(e, channel_number, sample_idx);
+    }
+  }
+  return(event);
+}
+
+int hop_est_probe_channel(HOP_EST *e) {
+  return( (e->last_chan+1)%NUM_DATA_CHANNEL );
+}
+//----------------------------------estimator----------------------------------
+
+//----------------------------------follower----------------------------------
+int csa1_channel(FOLLOW_CONN *f, int unmapped) {
+  if ( (f->chan_map>>unmapped)&1 ) {
+    return(unmapped);
+  }
+  return( f->used[unmapped%f->num_used] );
+}
+
+int csa2_channel(FOLLOW_CONN *f, uint16_t counter) {
+  uint16_t prn_e = csa2_prn_e(counter, f->chan_id);
+  int unmapped = prn_e%NUM_DATA_CHANNEL;
+
+  if ( (f->chan_map>>unmapped)&1 ) {
+    return(unmapped);
+  }
+  return( f->used[(f->num_used*(uint32_t)prn_e)>>16] );
+}
+
+static int follow_calc_channel(FOLLOW_CONN *f, uint32_t event) {
+  int n;
+
+  if (f->csa == 2) {
+    return( csa2_channel(f, (uint16_t)(f->counter_base + event)) );
+  }
+  n = (int)( ((int64_t)event - (int64_t)f->anchor_event)%NUM_DATA_CHANNEL );
+  if (n < 0) {
+    n = n + NUM_DATA_CHANNEL;
+  }
+  return( csa1_channel(f, (f->anchor_unmapped + n*f->hop)%NUM_DATA_CHANNEL) );
+}
+
+static void follow_table_reset(FOLLOW_CONN *f) {
+  uint32_t event;
+
+  for (event=0; event<FOLLOW_TABLE_LEN; event++) {
+    f->chan_table[event] = follow_calc_channel(f, event);
+  }
+  f->table_event = 0;
+}
+
+void follow_init(FOLLOW_CONN *f, uint32_t access_addr, uint32_t crc_init, int interval, double interval_sample, uint64_t chan_map, uint64_t anchor_idx) {
+  int i;
+
+  memset(f, 0, sizeof(FOLLOW_CONN));
+  link_init(&(f->link), access_addr, crc_init);
+  f->interval = interval;
+  f->interval_sample = interval_sample;
+  f->chan_map = chan_map;
+  for (i=0; i<NUM_DATA_CHANNEL; i++) {
+    if ( (chan_map>>i)&1 ) {
+      f->used[f->num_used] = i;
+      f->num_used++;
+    }
+  }
+  f->anchor_idx = anchor_idx;
+  f->anchor_event = 0;
+  f->last_pkt_event = 0;
+}
+
+void follow_csa1(FOLLOW_CONN *f, int hop, int anchor_unmapped) {
+  f->csa = 1;
+  f->hop = hop;
+  f->anchor_unmapped = anchor_unmapped;
+  follow_table_reset(f);
+}
+
+void follow_csa2(FOLLOW_CONN *f, uint16_t counter) {
+  f->csa = 2;
+  f->chan_id = csa2_chan_id(f->link.access_addr);
+  f->counter_base = counter;
+  follow_table_reset(f);
+}
+
+void follow_init_from_est(FOLLOW_CONN *f, HOP_EST *e, uint32_t crc_init) {
+  follow_init(f, e->access_addr, crc_init, e->interval, e->interval_sample, (((uint64_t)1)<<NUM_DATA_CHANNEL)-1, e->last_idx);
+  if (e->csa == 2) {
+    follow_csa2(f, e->counter);
+  } else {
+    follow_csa1(f, e->hop, e->last_chan);
+  }
+}
+
+void follow_sync(FOLLOW_CONN *f, uint32_t access_addr, uint32_t crc_init, int interval, uint64_t chan_map, uint16_t counter, uint64_t anchor_idx, uint64_t window_sample) {
+  follow_init(f, access_addr, crc_init, interval, (double)interval*CONN_UNIT_SAMPLE, chan_map, anchor_idx);
+  link_init_sync(&(f->link), access_addr, crc_init);
+  f->window_sample = window_sample;
+  follow_csa2(f, counter);
+}
+
+void follow_table_fill(FOLLOW_CONN *f, uint32_t event) {
+  uint32_t next = f->table_event + FOLLOW_TABLE_LEN; // first event not in the table
+
+  if ( (int32_t)(event - f->table_event) < 0 || (int32_t)(event - next) > 0 ) {
+    next = event;
+  }
+  for (; (int32_t)(event + FOLLOW_TABLE_LEN - next) > 0; next++) {
+    f->chan_table[next&(FOLLOW_TABLE_LEN-1)] = follow_calc_channel(f, next);
+  }
+  f->table_event = event;
+}
+
+int follow_channel(FOLLOW_CONN *f, uint32_t event) {
+  if ( event - f->table_event < FOLLOW_TABLE_LEN ) {
+    return( f->chan_table[event&(FOLLOW_TABLE_LEN-1)] );
+  }
+  return( follow_calc_channel(f, event) );
+}
+
+uint64_t follow_anchor_idx(FOLLOW_CONN *f, uint32_t event) {
+  return( f->anchor_idx + (uint64_t)( (event - f->anchor_event)*f->interval_sample + 0.5 ) );
+}
+
+uint32_t follow_event_after(FOLLOW_CONN *f, uint64_t sample_idx) {
+  uint32_t event;
+
+  if (sample_idx <= f->anchor_idx) {
+    return(f->anchor_event);
+  }
+  event = f->anchor_event + (uint32_t)( (sample_idx - f->anchor_idx)/f->interval_sample );
+  while (follow_anchor_idx(f, event) < sample_idx) {
+    event++;
+  }
+  return(event);
+}
+
+int64_t follow_pkt(FOLLOW_CONN *f, uint64_t sample_idx) {
+  uint64_t anchor_idx, d;
+  uint32_t event;
+  int first = ( f->num_anchor == 0 && f->window_sample != 0 );
+
+  if ( sample_idx + (uint64_t)(f->interval_sample/2) < f->anchor_idx ) {
+    return(-1);
+  }
+  f->num_pkt++;
+  event = f->anchor_event;
+  if (sample_idx > f->anchor_idx) {
+    event = event + (uint32_t)( (sample_idx - f->anchor_idx + (uint64_t)(f->interval_sample/2))/f->interval_sample );
+  }
+  if ( event == f->last_pkt_event && f->num_anchor > 0 ) {
+    return(event);
+  }
+  f->last_pkt_event = event;
+
+  // the slave answers 150us after the master's packet: the window stays well short of that
+  anchor_idx = follow_anchor_idx(f, event);
+  d = ( sample_idx > anchor_idx? sample_idx - anchor_idx : anchor_idx - sample_idx );
+  if (first) { // anchor_idx is only known to the window. interval_sample stays nominal
+    if (d > f->window_sample) {
+      return(event);
+    }
+  } else if ( event == f->anchor_event || d > hop_tolerance(sample_idx > f->anchor_idx? sample_idx - f->anchor_idx : 0) ) {
+    return(event);
+  } else {
+    f->interval_sample = f->interval_sample + ( (double)(sample_idx - f->anchor_idx)/(double)(event - f->anchor_event) - f->interval_sample )/FOLLOW_INTERVAL_GAIN;
+  }
+  f->anchor_unmapped = ( f->anchor_unmapped + ((event - f->anchor_event)%NUM_DATA_CHANNEL)*f->hop )%NUM_DATA_CHANNEL;
+  f->anchor_idx = sample_idx;
+  f->anchor_event = event;
+  f->num_anchor++;
+  return(event);
+}
+
+int follow_sched(FOLLOW_CONN **f, int num_f, uint64_t sample_idx, uint64_t guard_sample, uint32_t *event) {
+  uint64_t anchor_idx[FOLLOW_MAX_SCHED];
+  uint32_t next_event[FOLLOW_MAX_SCHED];
+  int i, m = -1;
+
+  if (num_f > FOLLOW_MAX_SCHED) {
+    num_f = FOLLOW_MAX_SCHED;
+  }
+  for (i=0; i<num_f; i++) {
+    next_event[i] = follow_event_after(f[i], sample_idx);
+    anchor_idx[i] = follow_anchor_idx(f[i], next_event[i]);
+    if (m < 0 || anchor_idx[i] < anchor_idx[m]) {
+      m = i;
+    }
+  }
+  if (m < 0) {
+    return(-1);
+  }
+  for (i=0; i<num_f; i++) {
+    if ( i != m && anchor_idx[i] < anchor_idx[m] + guard_sample && f[i]->anchor_idx < f[m]->anchor_idx ) {
+      m = i;
+    }
+  }
+  (*event) = next_event[m];
+  return(m);
+}
+//----------------------------------follower----------------------------------
+
+//----------------------------------BIG----------------------------------
+uint32_t bis_access_addr(uint32_t seed_access_addr, int bis) {
+  uint32_t d = (uint32_t)(35*bis + 42)&0x7F, dw;
+
+  // D0 x6, D1, D6 | D1, 0, D5, D4, 0, D3, D2, 0 in the upper 16 bits
+  dw = ( (d&1)? 0xFC : 0 ) | (d&0x02) | ((d>>6)&1);
+  dw = (dw<<8) | ((d&0x02)<<6) | (d&0x30) | ((d&0x0C)>>1);
+  return( seed_access_addr^(dw<<16) );
+}
+
+uint32_t bis_crc_init(uint16_t base_crc_init, int bis) {
+  // BaseCRCInit above the BIS number, in the octet order CONNECT_REQ carries a CRCInit
+  return( ((uint32_t)(bis&0xFF)<<16) | ((uint32_t)(base_crc_init&0xFF)<<8) | (base_crc_init>>8) );
+}
+
+void follow_big(FOLLOW_BIG *g, const BIG_INFO *b, uint64_t anchor_idx, uint64_t window_sample) {
+  uint32_t access_addr;
+  int i;
+
+  memset(g, 0, sizeof(FOLLOW_BIG));
+  g->iso_interval = b->iso_interval;
+  g->interval_sample = (double)b->iso_interval*CONN_UNIT_SAMPLE;
+  g->num_bis = ( b->num_bis > BIG_MAX_BIS? BIG_MAX_BIS : b->num_bis );
+  g->nse = ( b->nse < 1? 1 : b->nse );
+  g->bn = ( b->bn < 1? 1 : b->bn );
+  g->irc = b->irc;
+  g->pto = b->pto;
+  g->sub_interval_sample = (uint64_t)b->sub_interval_us*US_SAMPLE;
+  g->bis_spacing_sample = (uint64_t)b->bis_spacing_us*US_SAMPLE;
+  g->max_pdu = b->max_pdu;
+  g->chan_map = b->chan_map;
+  for (i=0; i<NUM_DATA_CHANNEL; i++) {
+    if ( (b->chan_map>>i)&1 ) {
+      g->used_index[i] = g->num_used;
+      g->used[g->num_used] = i;
+      g->num_used++;
+    }
+  }
+  for (i=0; i<g->num_bis; i++) {
+    access_addr = bis_access_addr(b->seed_access_addr, i+1);
+    link_init_bis(g->link+i, access_addr, bis_crc_init(b->base_crc_init, i+1));
+    g->chan_id[i] = csa2_chan_id(access_addr);
+  }
+  g->event_counter_base = b->payload_count/g->bn;
+  g->anchor_idx = anchor_idx;
+  g->window_sample = window_sample;
+}
+
+void big_channels(FOLLOW_BIG *g, int bis, uint32_t event, uint8_t *chan) {
+  uint16_t chan_id = g->chan_id[bis-1];
+  uint16_t prn_e = csa2_prn_e((uint16_t)(g->event_counter_base + event), chan_id);
+  uint16_t prn_lu = prn_e^chan_id; // prn_s, the last used one of the subevents
+  int n = g->num_used, d, idx, se;
+
+  idx = prn_e%NUM_DATA_CHANNEL;
+  if ( (g->chan_map>>idx)&1 ) {
+    idx = g->used_index[idx];
+  } else {
+    idx = (n*(uint32_t)prn_e)>>16;
+  }
+  chan[0] = g->used[idx];
+
+  // a later subevent is at least d channel map positions from the previous one
+  d = ( n-5 < 3? n-5 : 3 );
+  if ( (n-10)/2 > d ) {
+    d = ( (n-10)/2 < 11? (n-10)/2 : 11 );
+  }
+  if (d < 1) {
+    d = 1;
+  }
+  for (se=1; se<g->nse; se++) {
+    prn_lu = csa2_perm(prn_lu);
+    prn_lu = (uint16_t)( 17*(uint32_t)prn_lu + chan_id );
+    idx = ( idx + d + ((uint32_t)(prn_lu^chan_id)*(n - 2*d + 1)>>16) )%n;
+    chan[se] = g->used[idx];
+  }
+}
+
+uint64_t big_anchor_idx(FOLLOW_BIG *g, uint32_t event) {
+  return( g->anchor_idx + (uint64_t)( (event - g->anchor_event)*g->interval_sample + 0.5 ) );
+}
+
+uint64_t big_subevent_offset(FOLLOW_BIG *g, int bis, int se) {
+  return( (uint64_t)(bis-1)*g->bis_spacing_sample + (uint64_t)se*g->sub_interval_sample );
+}
+
+uint32_t big_event_after(FOLLOW_BIG *g, uint64_t sample_idx) {
+  uint32_t event;
+
+  if (sample_idx <= g->anchor_idx) {
+    return(g->anchor_event);
+  }
+  event = g->anchor_event + (uint32_t)( (sample_idx - g->anchor_idx)/g->interval_sample );
+  while (big_anchor_idx(g, event) < sample_idx) {
+    event++;
+  }
+  return(event);
+}
+
+uint64_t big_payload(FOLLOW_BIG *g, uint32_t event, int se) {
+  uint64_t counter = g->event_counter_base + event;
+  int group = se/g->bn;
+
+  if (group >= g->irc) {
+    counter = counter + (uint64_t)g->pto*(group - g->irc + 1);
+  }
+  return( counter*g->bn + se%g->bn );
+}
+
+int64_t big_pkt(FOLLOW_BIG *g, int bis, uint64_t sample_idx, int *se) {
+  uint64_t offset = big_subevent_offset(g, bis, 0), base, anchor_idx, tolerance, d;
+  int64_t rel;
+  uint32_t event;
+  int first = ( g->num_anchor == 0 && g->window_sample != 0 );
+
+  tolerance = ( first? g->window_sample : hop_tolerance(sample_idx > g->anchor_idx? sample_idx - g->anchor_idx : 0) );
+  if ( sample_idx + tolerance < g->anchor_idx + offset ) {
+    return(-1);
+  }
+  base = sample_idx - offset;
+  event = g->anchor_event;
+  if (base + tolerance > g->anchor_idx) {
+    event = event + (uint32_t)( (base + tolerance - g->anchor_idx)/g->interval_sample );
+  }
+  rel = (int64_t)base - (int64_t)big_anchor_idx(g, event);
+  (*se) = 0;
+  if (g->sub_interval_sample != 0 && rel > 0) {
+    (*se) = (int)( (rel + (int64_t)(g->sub_interval_sample/2))/(int64_t)g->sub_interval_sample );
+  }
+  if ( (*se) >= g->nse ) {
+    return(-1);
+  }
+  rel = rel - (int64_t)((*se)*g->sub_interval_sample);
+  d = (uint64_t)( rel < 0? -rel : rel );
+  if (d > tolerance) {
+    return(-1);
+  }
+
+  g->num_pkt++;
+  anchor_idx = base - (*se)*g->sub_interval_sample;
+  if ( !first && event != g->anchor_event ) {
+    g->interval_sample = g->interval_sample + ( (double)(anchor_idx - g->anchor_idx)/(double)(event - g->anchor_event) - g->interval_sample )/FOLLOW_INTERVAL_GAIN;
+  }
+  g->anchor_idx = anchor_idx;
+  g->anchor_event = event;
+  g->num_anchor++;
+  return(event);
+}
+//----------------------------------BIG----------------------------------
@@ -0,0 +1,198 @@
+// Following a running connection over its channel hops
+//
+// A connection picked up without its CONNECT_REQ (-D, or -p once the CRCInit is confirmed)
+// still lacks connInterval and the CSA#1 hop increment. hop_est_*() recovers both from the
+// sample indices of the connection's packets on one or more data channels:
+// - with all 37 channels used, CSA#1 comes back to a channel every 37 events exactly. The
+//   gcd of the revisit times in 1.25ms units is 37 x connInterval; once a second revisit
+//   leaves it unchanged, connInterval is known. Two revisits take 2x37 events, ~2.2s at 30ms.
+// - an event on channel b, n events after one on channel a, gives b = a + n*hop mod 37, so
+//   hop = (b-a)/n mod 37. Boards on different channels see such pairs all the time. A single
+//   board is moved to the next channel (hop_est_probe_channel), which it meets within 37 events.
+// follow_*() then gives the channel and anchor sample index of every later event, and is put
+// back in step by every packet received, so the board can be retuned ahead of each event.
+// connEventCounter is not on the air, so events are counted from the hand over.
+// CSA#2 (BLE 5) has no hop increment: the channel is a hash of the event counter and the
+// access address. Its revisits are irregular, so their gcd is connInterval itself, and the
+// counter is then the one of the 65536 whose channels fit the events seen (hop_est_counter).
+// The follower keeps the channels of the next FOLLOW_TABLE_LEN events in a table, refilled one
+// event at a time behind each retune, so a retune only reads it.
+// A periodic advertising train (AUX_SYNC_IND) is followed the same way, CSA#2 with the counter,
+// interval and channel map its SyncInfo gives (follow_sync). follow_sched() shares one radio
+// between several of them by their anchors in samples.
+// The BISes of a BIG (LE Audio broadcast) share the anchor of each BIG event, announced by the
+// BIGInfo of a train. BIS n sends NSE subevents, BIS_Spacing x (n-1) + Sub_Interval x se after
+// it, each on its own channel: CSA#2 picks the first, and every later one moves on from the
+// previous one's index in the channel map (follow_big, big_channels).
+
+#ifndef BTLE_FOLLOW_H
+#define BTLE_FOLLOW_H
+
+#include "btle_phy.h"
+#include "btle_pdu.h"
+
+#define NUM_DATA_CHANNEL 37
+#define CONN_UNIT_SAMPLE (1250*SAMPLE_PER_SYMBOL*2)  // IQ_TYPE elements in 1.25ms
+#define MIN_CONN_INTERVAL 6                           // 1.25ms units, 7.5ms
+#define MAX_CONN_INTERVAL 3200                        // 4s
+#define MIN_HOP 5
+#define MAX_HOP 16
+#define HOP_EVENT_SAMPLE (5000*SAMPLE_PER_SYMBOL*2)   // packets closer than 5ms to the first one are the same event
+#define HOP_JITTER_SAMPLE (50*SAMPLE_PER_SYMBOL*2)    // anchor jitter, 50us
+#define HOP_DRIFT_PPM 250                             // sleep clock and board crystal together
+#define FOLLOW_INTERVAL_GAIN 8                        // interval_sample moves 1/8 of the way to each measurement
+#define FOLLOW_TABLE_LEN 64                           // events ahead with their channel precomputed, power of 2
+#define NUM_CSA2_COUNTER 65536
+#define FOLLOW_MAX_SCHED 8                            // trains follow_sched() looks at
+#define HOP_CSA2_STABLE_REVISIT 3                     // revisits that leave the gcd unchanged before it is taken
+#define HOP_CSA2_HIST_LEN 16                          // latest events kept for the counter search
+#define HOP_CSA2_MIN_EVENT 5                          // 37^4 > 65536: one counter left over most of the time
+#define BIG_MAX_BIS 31
+#define BIG_MAX_SE 31                                 // NSE
+#define US_SAMPLE (SAMPLE_PER_SYMBOL*2)               // IQ_TYPE elements per us
+
+// hop_est_add() events
+#define HOP_EVENT_INTERVAL 1
+#define HOP_EVENT_INCREMENT 2
+#define HOP_EVENT_COUNTER 4   // CSA#2
+
+typedef struct {
+  uint32_t access_addr;
+  int csa;                                // channel selection algorithm, 1 or 2
+  int num_event;                          // events seen, packets of one event counted once
+  uint64_t first_idx;                     // first event seen
+  uint64_t chan_first_idx[NUM_DATA_CHANNEL]; // first event on each channel
+  uint64_t chan_last_idx[NUM_DATA_CHANNEL];  // latest event on each channel
+  uint32_t chan_num_event[NUM_DATA_CHANNEL];
+  int last_chan;                          // latest event, -1: none yet
+  uint64_t last_idx;
+
+  uint32_t revisit_gcd;                   // gcd of the revisit times, 1.25ms units
+  int num_revisit;
+  int num_stable;                         // revisits in a row that left revisit_gcd unchanged
+  int interval;                           // connInterval, 1.25ms units. 0: not known yet
+  double interval_sample;                 // IQ_TYPE elements per event, measured
+
+  int hop;                                // 0: not known yet
+  int hop_chan_a, hop_chan_b;             // the pair it came from
+  int hop_num_event;                      // events between them
+
+  uint64_t hist_idx[HOP_CSA2_HIST_LEN];   // CSA#2: latest events, by num_hist%HOP_CSA2_HIST_LEN
+  uint8_t hist_chan[HOP_CSA2_HIST_LEN];
+  int num_hist;
+  uint16_t counter;                       // CSA#2 event counter of last_idx, once found
+  int num_counter_fit;                    // counters that fit in the last search
+} HOP_EST;
+
+typedef struct {
+  BTLE_LINK link;
+  int interval;                           // connInterval, 1.25ms units
+  double interval_sample;                 // IQ_TYPE elements per event, follows the clock of the master
+  int csa;                                // channel selection algorithm, 1 or 2
+  int hop;                                // CSA#1
+  uint16_t chan_id;                       // CSA#2 channelIdentifier, from the access address
+  uint16_t counter_base;                  // CSA#2 event counter of event 0
+  uint64_t chan_map;                      // bit n: data channel n used
+  int num_used;
+  uint8_t used[NUM_DATA_CHANNEL];         // used channels in ascending order
+  uint64_t anchor_idx;                    // IQ_TYPE element index of the anchor of event anchor_event
+  uint32_t anchor_event;                  // events since the hand over
+  int anchor_unmapped;                    // CSA#1 unmapped channel of anchor_event
+  uint32_t table_event;                   // chan_table holds events table_event ~ table_event+FOLLOW_TABLE_LEN-1
+  uint8_t chan_table[FOLLOW_TABLE_LEN];   // by event%FOLLOW_TABLE_LEN
+  uint32_t last_pkt_event;                // event of the latest packet, its first packet set the anchor
+  uint64_t window_sample;                 // how far the first packet may be off anchor_idx. 0: as any other
+  uint64_t num_pkt;
+  uint64_t num_anchor;                    // events that were received
+} FOLLOW_CONN;
+
+typedef struct {
+  int iso_interval;                       // 1.25ms units
+  double interval_sample;                 // IQ_TYPE elements per BIG event, follows the clock of the broadcaster
+  int num_bis;
+  int nse, bn, irc, pto;
+  uint64_t sub_interval_sample;
+  uint64_t bis_spacing_sample;
+  int max_pdu;
+  uint64_t chan_map;                      // bit n: data channel n used
+  int num_used;
+  uint8_t used[NUM_DATA_CHANNEL];         // used channels in ascending order
+  uint8_t used_index[NUM_DATA_CHANNEL];   // position of a used channel in used[]
+  BTLE_LINK link[BIG_MAX_BIS];            // BIS n in link[n-1]
+  uint16_t chan_id[BIG_MAX_BIS];
+  uint64_t event_counter_base;            // bisEventCounter of event 0
+  uint64_t anchor_idx;                    // IQ_TYPE element index of the anchor of BIG event anchor_event
+  uint32_t anchor_event;                  // events since the BIGInfo
+  uint64_t window_sample;                 // how far the first packet may be off its subevent. then HOP_JITTER_SAMPLE
+  uint64_t num_pkt;
+  uint64_t num_anchor;                    // packets that put the anchor back in step
+} FOLLOW_BIG;
+
+//----------------------------------CSA#2----------------------------------
+uint16_t csa2_chan_id(uint32_t access_addr);
+// prn_e of the spec: 3 rounds of permutation and multiply-add on counter^chan_id
+uint16_t csa2_prn_e(uint16_t counter, uint16_t chan_id);
+
+//----------------------------------estimator----------------------------------
+// access_addr 0: the first one fed in is taken. csa: 1 or 2
+void hop_est_init(HOP_EST *e, uint32_t access_addr, int csa);
+// a CRC-OK packet on data channel channel_number at sample_idx. packets of other access
+// addresses are ignored. returns the HOP_EVENT_ bits of what it completed
+int hop_est_add(HOP_EST *e, uint32_t access_addr, int channel_number, uint64_t sample_idx);
+// with only one channel observed: where to go once connInterval is known (CSA#1)
+int hop_est_probe_channel(HOP_EST *e);
+
+//----------------------------------follower----------------------------------
+int csa1_channel(FOLLOW_CONN *f, int unmapped);
+int csa2_channel(FOLLOW_CONN *f, uint16_t counter);
+// anchor_idx: an event the estimator saw, event 0. follow_csa1 or follow_csa2 must follow
+void follow_init(FOLLOW_CONN *f, uint32_t access_addr, uint32_t crc_init, int interval, double interval_sample, uint64_t chan_map, uint64_t anchor_idx);
+// anchor_unmapped: unmapped channel of event 0
+void follow_csa1(FOLLOW_CONN *f, int hop, int anchor_unmapped);
+// counter: event counter of event 0
+void follow_csa2(FOLLOW_CONN *f, uint16_t counter);
+// full channel map, event 0 at the latest event the estimator saw
+void follow_init_from_est(FOLLOW_CONN *f, HOP_EST *e, uint32_t crc_init);
+// a periodic advertising train: advertising PDUs on access_addr, CSA#2. event 0 (paEventCounter
+// counter) starts within window_sample either side of anchor_idx
+void follow_sync(FOLLOW_CONN *f, uint32_t access_addr, uint32_t crc_init, int interval, uint64_t chan_map, uint16_t counter, uint64_t anchor_idx, uint64_t window_sample);
+// computes the channels up to event+FOLLOW_TABLE_LEN-1 that chan_table lacks, dropping the
+// ones before event. one new entry when called once per event
+void follow_table_fill(FOLLOW_CONN *f, uint32_t event);
+// a table read for events follow_table_fill covered, computed otherwise
+int follow_channel(FOLLOW_CONN *f, uint32_t event);
+uint64_t follow_anchor_idx(FOLLOW_CONN *f, uint32_t event);
+// first event whose anchor is at or after sample_idx
+uint32_t follow_event_after(FOLLOW_CONN *f, uint64_t sample_idx);
+// a CRC-OK packet at sample_idx. returns its event, -1 if it is before anchor_event. the first
+// packet of an event within the widened window around its anchor (the master's) moves the
+// anchor there and corrects interval_sample
+int64_t follow_pkt(FOLLOW_CONN *f, uint64_t sample_idx);
+// the earliest next event of the num_f trains at or after sample_idx. another one's event
+// starting less than guard_sample after it can not be received too: of the two, the train whose
+// last received anchor is older wins. returns the index into f (-1: num_f 0), *event its event
+int follow_sched(FOLLOW_CONN **f, int num_f, uint64_t sample_idx, uint64_t guard_sample, uint32_t *event);
+
+//----------------------------------BIG----------------------------------
+// access address and CRCInit (as BTLE_LINK crc_init) of BIS bis, 1~31. bis 0: BIG control
+uint32_t bis_access_addr(uint32_t seed_access_addr, int bis);
+uint32_t bis_crc_init(uint16_t base_crc_init, int bis);
+// anchor_idx: the BIG event that b->payload_count belongs to, event 0, known to window_sample
+// either side
+void follow_big(FOLLOW_BIG *g, const BIG_INFO *b, uint64_t anchor_idx, uint64_t window_sample);
+// the channels of the NSE subevents of BIS bis (1~num_bis) in event, into chan
+void big_channels(FOLLOW_BIG *g, int bis, uint32_t event, uint8_t *chan);
+uint64_t big_anchor_idx(FOLLOW_BIG *g, uint32_t event);
+// from the anchor of a BIG event to the start of subevent se (0~NSE-1) of BIS bis
+uint64_t big_subevent_offset(FOLLOW_BIG *g, int bis, int se);
+// first event whose anchor is at or after sample_idx
+uint32_t big_event_after(FOLLOW_BIG *g, uint64_t sample_idx);
+// bisPayloadCount of the PDU subevent se of event carries: the first IRC groups of BN subevents
+// repeat the payloads of the event, the others send those PTO events ahead
+uint64_t big_payload(FOLLOW_BIG *g, uint32_t event, int se);
+// a CRC-OK PDU of BIS bis at sample_idx. returns its event and *se its subevent, -1 if it fits
+// none. it moves the anchor there and, a later event, corrects interval_sample
+int64_t big_pkt(FOLLOW_BIG *g, int bis, uint64_t sample_idx, int *se);
+//----------------------------------BIG----------------------------------
+
+#endif
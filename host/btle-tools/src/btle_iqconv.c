@@ -0,0 +1,258 @@
+// IQ capture conversion and MATLAB export for the btle tools
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+// Reads any capture btle_iqfile knows (cs8/cs16/cf32, with or without header), optionally
+// cuts a time range out of it, and writes it in another format, or as MATLAB text: the
+// I/Q values separated by spaces with a "..." continuation every 64 values, the same text
+// btle_rx and btle_tx used to write as *_for_matlab.txt. Samples pass through IQ_TYPE, so
+// cf32 to cf32 is quantized to the receiver's resolution.
+
+#include "common.h"
+#include "btle_phy.h"
+#include "btle_pdu.h"
+#include "btle_iqfile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+
+//----------------------------------print_usage----------------------------------
+static void print_usage() {
+	printf("Usage: btle_iqconv [options] in.cs8|cs16|cf32 out\n");
+  printf("    -h --help\n");
+  printf("      print this help screen\n");
+  printf("    -f --format\n");
+  printf("      cs8, cs16 or cf32. default: extension of out, else the format of in\n");
+  printf("    -n --no-header\n");
+  printf("      raw samples only, e.g. for hackrf_transfer -t. default: with header\n");
+  printf("    -m --matlab\n");
+  printf("      MATLAB text instead of binary samples\n");
+  printf("    -s --start\n");
+  printf("      ms from the start of in. default 0\n");
+  printf("    -l --length\n");
+  printf("      ms to convert. default: to the end\n");
+  printf("    -c --chan\n");
+  printf("      channel number the capture was taken on, for the header when in has none\n");
+  printf("\nSee README for detailed information.\n");
+}
+//----------------------------------print_usage----------------------------------
+
+#define LEN_CONV_BLOCK (65536) // IQ samples per block
+
+//----------------------------------command line parameters----------------------------------
+void parse_commandline(
+  // Inputs
+  int argc,
+  char * const argv[],
+  // Outputs
+  char** in_name,
+  char** out_name,
+  int* format,
+  int* header,
+  int* matlab,
+  double* start_ms,
+  double* len_ms,
+  int* chan
+) {
+  // Default values
+  (*format) = -1;
+
+  (*header) = 1;
+
+  (*matlab) = 0;
+
+  (*start_ms) = 0;
+
+  (*len_ms) = -1;
+
+  (*chan) = -1;
+
+  while (1) {
+    static struct option long_options[] = {
+      {"help",         no_argument,       0, 'h'},
+      {"format",       required_argument, 0, 'f'},
+      {"no-header",    no_argument,       0, 'n'},
+      {"matlab",       no_argument,       0, 'm'},
+      {"start",        required_argument, 0, 's'},
+      {"length",       required_argument, 0, 'l'},
+      {"chan",         required_argument, 0, 'c'},
+      {0, 0, 0, 0}
+    };
+    /* getopt_long stores the option index here. */
+    int option_index = 0;
+    int c = getopt_long (argc, argv, "hf:nms:l:c:",
+                     long_options, &option_index);
+
+    /* Detect the end of the options. */
+    if (c == -1)
+      break;
+
+    switch (c) {
+      char * endp;
+      case 'f':
+        (*format) = iq_format_by_str(optarg);
+        if ( (*format) < 0 ) {
+          printf("format must be cs8, cs16 or cf32!\n");
+          goto abnormal_quit;
+        }
+        break;
+
+      case 'n':
+        (*header) = 0;
+        break;
+
+      case 'm':
+        (*matlab) = 1;
+        break;
+
+      case 's':
+        (*start_ms) = strtod(optarg,&endp);
+        break;
+
+      case 'l':
+        (*len_ms) = strtod(optarg,&endp);
+        break;
+
+      case 'c':
+        (*chan) = strtol(optarg,&endp,10);
+        break;
+
+      case 'h':
+      case '?':
+      default:
+        goto abnormal_quit;
+    }
+  }
+
+  if ( (*chan)<-1 || (*chan)>MAX_CHANNEL_NUMBER ) {
+    printf("channel number must be within 0~%d!\n", MAX_CHANNEL_NUMBER);
+    goto abnormal_quit;
+  }
+
+  if ( (*start_ms)<0 ) {
+    printf("start must not be negative!\n");
+    goto abnormal_quit;
+  }
+
+  if (optind != argc-2) {
+    printf("Error: input and output file expected\n");
+    goto abnormal_quit;
+  }
+  (*in_name) = argv[optind];
+  (*out_name) = argv[optind+1];
+
+  return;
+
+abnormal_quit:
+  print_usage();
+  exit(-1);
+}
+//----------------------------------command line parameters----------------------------------
+
+static int write_matlab(FILE *fp, IQ_TYPE *buf, int n, uint64_t *num_written) {
+  int i;
+  for (i=0; i<n; i++) {
+    if ( ((*num_written)+i)%64 == 0 ) {
+      fprintf(fp, "...\n");
+    }
+    fprintf(fp, "%d ", buf[i]);
+  }
+  (*num_written) = (*num_written) + n;
+  return( ferror(fp)? -1 : 0 );
+}
+
+int main(int argc, char** argv) {
+  char *in_name, *out_name;
+  int format, header, matlab, chan, n, ret = 0;
+  double start_ms, len_ms;
+  uint64_t first, last, pos, num_written = 0;
+  IQ_FILE in, out;
+  IQ_FILE_INFO info;
+  IQ_TYPE *buf;
+  FILE *fp = NULL;
+
+  parse_commandline(argc, argv, &in_name, &out_name, &format, &header, &matlab, &start_ms, &len_ms, &chan);
+
+  if ( iq_file_open(&in, in_name) != 0 ) {
+    return(1);
+  }
+  first = (uint64_t)( start_ms*in.info.sample_rate/1000.0 );
+  last = ( len_ms < 0? in.num_iq : first + (uint64_t)( len_ms*in.info.sample_rate/1000.0 ) );
+  last = ( last > in.num_iq? in.num_iq : last );
+  if (first >= last) {
+    printf("main: nothing to convert, %s has %.3fms\n", in_name, in.num_iq*1000.0/in.info.sample_rate);
+    iq_file_close(&in);
+    return(1);
+  }
+
+  info = in.info;
+  if (format < 0) {
+    format = iq_format_by_name(out_name);
+  }
+  info.format = (IQ_FORMAT)( format < 0? in.info.format : format );
+  if (chan >= 0) {
+    info.freq_hz = get_freq_by_channel_number(chan);
+  }
+  if (info.start_ns != 0) {
+    info.start_ns = info.start_ns + (int64_t)( first*1000000000.0/info.sample_rate );
+  }
+
+  buf = (IQ_TYPE *)malloc(2*LEN_CONV_BLOCK*sizeof(IQ_TYPE));
+  if (buf == NULL) {
+    printf("main: out of memory!\n");
+    iq_file_close(&in);
+    return(1);
+  }
+  if (matlab) {
+    fp = fopen(out_name, "w");
+    if (fp == NULL) {
+      printf("main: can not create %s!\n", out_name);
+      ret = 1;
+    }
+  } else if ( iq_file_create(&out, out_name, &info, header) != 0 ) {
+    ret = 1;
+  }
+
+  for (pos=first; ret == 0 && pos<last; pos=pos+n) {
+    n = (int)( (last - pos) > LEN_CONV_BLOCK? LEN_CONV_BLOCK : (last - pos) );
+    iq_file_read(&in, pos, n, buf);
+    if (matlab) {
+      ret = ( write_matlab(fp, buf, 2*n, &num_written) != 0 );
+    } else {
+      ret = ( iq_file_write(&out, buf, n) != 0 );
+    }
+  }
+
+  if (matlab && fp != NULL) {
+    fprintf(fp, "\n");
+    fclose(fp);
+  } else if (!matlab) {
+    iq_file_close(&out);
+  }
+  if (ret == 0) {
+    printf("%s: %s%s, %.3fms from %.3fms -> %s: %s\n", in_name, IQ_FORMAT_STR[in.info.format], (in.has_header? " with header" : ""),
+      (last - first)*1000.0/in.info.sample_rate, first*1000.0/in.info.sample_rate, out_name,
+      (matlab? "MATLAB text" : IQ_FORMAT_STR[info.format]));
+  }
+  free(buf);
+  iq_file_close(&in);
+  return(ret);
+}
@@ -0,0 +1,133 @@
+// DC offset and IQ imbalance correction for the btle receiver
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "btle_iqcorr.h"
+
+#include <math.h>
+
+#define MAX_IQ_CORR_SCALE (1.9f)    // Q gain correction beyond this is not an imbalance. keeps coef_qq < 2^15
+#define MAX_IQ_CORR_CROSS (1.9f)    // the same for the share of I taken out of Q. keeps |coef_qi| < 2^15
+// IQ samples summed up in int32 before going into the int64 totals: 256*2*IQ_MAX^2 < 2^31
+#define LEN_IQ_CORR_CHUNK ( (IQ_MAX > 127)? 256 : 32768 )
+
+void iq_corr_init(IQ_CORR *c) {
+  c->num_block = 0;
+  c->mean_i = 0;
+  c->mean_q = 0;
+  c->pow_i = 0;
+  c->pow_q = 0;
+  c->corr_iq = 0;
+  c->dc_i = 0;
+  c->dc_q = 0;
+  c->coef_qi = 0;
+  c->coef_qq = (1<<IQ_CORR_COEF_SHIFT);
+}
+
+//----------------------------------estimation----------------------------------
+void iq_corr_estimate(IQ_CORR *c, IQ_TYPE *rxp, int num_iq_sample) {
+  int64_t sum_i = 0, sum_q = 0, sum_ii = 0, sum_qq = 0, sum_iq = 0;
+  int32_t s_i, s_q, s_ii, s_qq, s_iq;
+  float mean_i, mean_q, pow_i, pow_q, corr_iq, w, k, scale;
+  int i, j, len, v0, v1;
+
+  if (num_iq_sample <= 0) {
+    return;
+  }
+
+  for (j=0; j<num_iq_sample*2; j=j+len) {
+    len = num_iq_sample*2 - j;
+    len = (len > LEN_IQ_CORR_CHUNK*2? LEN_IQ_CORR_CHUNK*2 : len);
+    s_i = 0; s_q = 0; s_ii = 0; s_qq = 0; s_iq = 0;
+    // plain int32 sums, no dependency between samples: vectorizes
+    for (i=j; i<j+len; i=i+2) {
+      v0 = rxp[i];
+      v1 = rxp[i+1];
+      s_i = s_i + v0;
+      s_q = s_q + v1;
+      s_ii = s_ii + v0*v0;
+      s_qq = s_qq + v1*v1;
+      s_iq = s_iq + v0*v1;
+    }
+    sum_i = sum_i + s_i;
+    sum_q = sum_q + s_q;
+    sum_ii = sum_ii + s_ii;
+    sum_qq = sum_qq + s_qq;
+    sum_iq = sum_iq + s_iq;
+  }
+
+  mean_i = (float)sum_i/num_iq_sample;
+  mean_q = (float)sum_q/num_iq_sample;
+  pow_i = (float)sum_ii/num_iq_sample - mean_i*mean_i;
+  pow_q = (float)sum_qq/num_iq_sample - mean_q*mean_q;
+  corr_iq = (float)sum_iq/num_iq_sample - mean_i*mean_q;
+
+  // plain average until IQ_CORR_AVG blocks are in, EWMA after that
+  c->num_block++;
+  w = 1.0f/(float)( c->num_block < IQ_CORR_AVG? c->num_block : IQ_CORR_AVG );
+  c->mean_i = c->mean_i + w*(mean_i - c->mean_i);
+  c->mean_q = c->mean_q + w*(mean_q - c->mean_q);
+  c->pow_i = c->pow_i + w*(pow_i - c->pow_i);
+  c->pow_q = c->pow_q + w*(pow_q - c->pow_q);
+  c->corr_iq = c->corr_iq + w*(corr_iq - c->corr_iq);
+
+  c->dc_i = (int)lrintf(c->mean_i);
+  c->dc_q = (int)lrintf(c->mean_q);
+
+  // Q - k*I is orthogonal to I. scale brings its power to that of I
+  if (c->pow_i <= 0) {
+    return;
+  }
+  k = c->corr_iq/c->pow_i;
+  pow_q = c->pow_q - k*c->corr_iq;
+  if (pow_q <= 0) {
+    return;
+  }
+  scale = sqrtf(c->pow_i/pow_q);
+  if (scale > MAX_IQ_CORR_SCALE || scale < 1.0f/MAX_IQ_CORR_SCALE) {
+    return;
+  }
+  if (fabsf(k*scale) > MAX_IQ_CORR_CROSS) {
+    return;
+  }
+  c->coef_qi = (int)lrintf( -k*scale*(1<<IQ_CORR_COEF_SHIFT) );
+  c->coef_qq = (int)lrintf( scale*(1<<IQ_CORR_COEF_SHIFT) );
+}
+//----------------------------------estimation----------------------------------
+
+//----------------------------------correction----------------------------------
+void iq_corr_apply(IQ_CORR *c, IQ_TYPE *rxp, int num_iq_sample) {
+  const int16_t dc_i = c->dc_i, dc_q = c->dc_q, coef_qi = c->coef_qi, coef_qq = c->coef_qq;
+  int16_t v0, v1;
+  int32_t q;
+  int i;
+
+  // branch free, int16 operands into int32 products (pmaddwd on x86): vectorizes
+  for (i=0; i<num_iq_sample*2; i=i+2) {
+    v0 = rxp[i] - dc_i;
+    v1 = rxp[i+1] - dc_q;
+    q = ( (int32_t)coef_qi*v0 + (int32_t)coef_qq*v1 + (1<<(IQ_CORR_COEF_SHIFT-1)) )>>IQ_CORR_COEF_SHIFT;
+    v0 = (v0 > IQ_MAX? IQ_MAX : v0);
+    v0 = (v0 < -IQ_MAX? -IQ_MAX : v0);
+    q = (q > IQ_MAX? IQ_MAX : q);
+    q = (q < -IQ_MAX? -IQ_MAX : q);
+    rxp[i] = (IQ_TYPE)v0;
+    rxp[i+1] = (IQ_TYPE)q;
+  }
+}
+//----------------------------------correction----------------------------------
@@ -0,0 +1,39 @@
+// DC offset and IQ imbalance correction for the btle receiver
+//
+// HackRF tunes exactly onto the channel center, so its LO leakage (DC spike) and I/Q gain and
+// phase mismatch sit right in the middle of the GFSK signal and bias the I0*Q1-I1*Q0
+// discriminator. The estimator keeps running first and second moments of the raw samples:
+// the mean is the DC offset; after removing it, I and Q of a circular signal (noise, GFSK
+// around DC) have equal power and no correlation. The correction keeps I and rebuilds Q from
+// the part of Q orthogonal to I, scaled to the power of I:
+//   I' = I - dc_i
+//   Q' = coef_qi*I' + coef_qq*(Q - dc_q)
+// Estimation and correction are separate block kernels on plain integer arrays, so the
+// compiler can vectorize both.
+
+#ifndef BTLE_IQCORR_H
+#define BTLE_IQCORR_H
+
+#include "btle_phy.h"
+
+#define IQ_CORR_AVG (64)            // blocks the moments are averaged over (EWMA)
+#define IQ_CORR_COEF_SHIFT (14)     // coef_qi and coef_qq are Q14
+
+typedef struct {
+  int num_block;                    // blocks estimated so far
+  // running moments of the raw samples, in IQ_TYPE units
+  float mean_i, mean_q;
+  float pow_i, pow_q, corr_iq;      // second moments about the mean
+  // correction applied by iq_corr_apply()
+  int dc_i, dc_q;
+  int coef_qi, coef_qq;
+} IQ_CORR;
+
+// identity correction
+void iq_corr_init(IQ_CORR *c);
+// adds the moments of num_iq_sample raw I/Q to the running estimate and updates the correction
+void iq_corr_estimate(IQ_CORR *c, IQ_TYPE *rxp, int num_iq_sample);
+// corrects num_iq_sample I/Q in place, saturating to +-IQ_MAX
+void iq_corr_apply(IQ_CORR *c, IQ_TYPE *rxp, int num_iq_sample);
+
+#endif
@@ -0,0 +1,347 @@
+// Binary IQ capture files for the btle tools
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "btle_iqfile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define IQ_FILE_VERSION (1)
+
+char *IQ_FORMAT_STR[NUM_IQ_FORMAT] = {
+    "cs8",
+    "cs16",
+    "cf32"
+};
+
+int IQ_FORMAT_BYTE[NUM_IQ_FORMAT] = {2, 4, 8};
+
+static const uint8_t IQ_FILE_MAGIC[6] = {'B', 'T', 'L', 'E', 'I', 'Q'};
+
+int iq_format_by_str(const char *str) {
+  int i;
+  for (i=0; i<NUM_IQ_FORMAT; i++) {
+    if (strcmp(str, IQ_FORMAT_STR[i]) == 0) {
+      return(i);
+    }
+  }
+  return(-1);
+}
+
+int iq_format_by_name(const char *name) {
+  const char *ext = strrchr(name, '.');
+  return( ext == NULL? -1 : iq_format_by_str(ext+1) );
+}
+
+//----------------------------------format conversion----------------------------------
+// IQ_TYPE is cs8 with HackRF and SC16 Q11 with bladeRF; int8 and Q11 are a 4 bit shift apart
+void cs8_to_iq(const int8_t *in, IQ_TYPE *out, int n) {
+  int i;
+  for (i=0; i<n; i++) {
+#ifdef USE_BLADERF
+    out[i] = (IQ_TYPE)(in[i]*16);
+#else
+    out[i] = in[i];
+#endif
+  }
+}
+
+void cs16_to_iq(const int16_t *in, IQ_TYPE *out, int n) {
+  int i;
+  for (i=0; i<n; i++) {
+#ifdef USE_BLADERF
+    out[i] = in[i];
+#else
+    int v = in[i]>>4;
+    out[i] = (IQ_TYPE)( v > IQ_MAX? IQ_MAX : v );
+#endif
+  }
+}
+
+void cf32_to_iq(const float *in, IQ_TYPE *out, int n) {
+  int i;
+  float v;
+  for (i=0; i<n; i++) {
+    v = in[i]*(IQ_MAX+1);
+    v = ( v > IQ_MAX? IQ_MAX : v );
+    v = ( v < -IQ_MAX? -IQ_MAX : v );
+    out[i] = (IQ_TYPE)( v + (v < 0? -0.5f : 0.5f) );
+  }
+}
+
+void iq_to_cs8(const IQ_TYPE *in, int8_t *out, int n) {
+  int i;
+  for (i=0; i<n; i++) {
+#ifdef USE_BLADERF
+    int v = in[i]>>4;
+    out[i] = (int8_t)( v > 127? 127 : v );
+#else
+    out[i] = in[i];
+#endif
+  }
+}
+
+void iq_to_cs16(const IQ_TYPE *in, int16_t *out, int n) {
+  int i;
+  for (i=0; i<n; i++) {
+#ifdef USE_BLADERF
+    out[i] = in[i];
+#else
+    out[i] = (int16_t)(in[i]*16);
+#endif
+  }
+}
+
+void iq_to_cf32(const IQ_TYPE *in, float *out, int n) {
+  const float scale = 1.0f/(IQ_MAX+1);
+  int i;
+  for (i=0; i<n; i++) {
+    out[i] = in[i]*scale;
+  }
+}
+//----------------------------------format conversion----------------------------------
+
+//----------------------------------header----------------------------------
+static void put_le(uint8_t *p, uint64_t v, int num_byte) {
+  int i;
+  for (i=0; i<num_byte; i++) {
+    p[i] = (uint8_t)(v>>(8*i));
+  }
+}
+
+static uint64_t get_le(const uint8_t *p, int num_byte) {
+  uint64_t v = 0;
+  int i;
+  for (i=num_byte-1; i>=0; i--) {
+    v = (v<<8) | p[i];
+  }
+  return(v);
+}
+
+int iq_file_write_header(FILE *fp, IQ_FILE_INFO *info) {
+  uint8_t header[LEN_IQ_FILE_HEADER];
+
+  memset(header, 0, sizeof(header));
+  memcpy(header, IQ_FILE_MAGIC, sizeof(IQ_FILE_MAGIC));
+  put_le(header+6, IQ_FILE_VERSION, 2);
+  put_le(header+8, LEN_IQ_FILE_HEADER, 4);
+  put_le(header+12, info->format, 4);
+  put_le(header+16, info->sample_rate, 8);
+  put_le(header+24, info->freq_hz, 8);
+  put_le(header+32, (uint64_t)info->start_ns, 8);
+  if ( fwrite(header, 1, sizeof(header), fp) != sizeof(header) ) {
+    printf("iq_file_write_header: fwrite failed!\n");
+    return(-1);
+  }
+  return(0);
+}
+
+// 0: no header. -1: a header that can not be used
+static int parse_header(IQ_FILE *f) {
+  uint64_t len_header;
+
+  if ( f->len_map < LEN_IQ_FILE_HEADER || memcmp(f->map, IQ_FILE_MAGIC, sizeof(IQ_FILE_MAGIC)) != 0 ) {
+    return(0);
+  }
+  len_header = get_le(f->map+8, 4);
+  f->info.format = (IQ_FORMAT)get_le(f->map+12, 4);
+  f->info.sample_rate = get_le(f->map+16, 8);
+  f->info.freq_hz = get_le(f->map+24, 8);
+  f->info.start_ns = (int64_t)get_le(f->map+32, 8);
+  if ( len_header < LEN_IQ_FILE_HEADER || len_header > f->len_map || len_header%8 != 0 || (int)f->info.format >= NUM_IQ_FORMAT ) {
+    printf("iq_file_open: invalid header!\n");
+    return(-1);
+  }
+  f->data = f->map + len_header;
+  f->has_header = 1;
+  return(1);
+}
+//----------------------------------header----------------------------------
+
+//----------------------------------reader----------------------------------
+int iq_file_open(IQ_FILE *f, const char *name) {
+  int format;
+
+  memset(f, 0, sizeof(IQ_FILE));
+#ifndef _WIN32
+  {
+    struct stat st;
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) {
+      printf("iq_file_open: open %s failed!\n", name);
+      return(-1);
+    }
+    if ( fstat(fd, &st) != 0 || st.st_size == 0 ) {
+      printf("iq_file_open: %s is empty!\n", name);
+      close(fd);
+      return(-1);
+    }
+    f->len_map = (uint64_t)st.st_size;
+    f->map = (uint8_t *)mmap(NULL, (size_t)f->len_map, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ( f->map == (uint8_t *)MAP_FAILED ) {
+      f->map = NULL;
+      printf("iq_file_open: mmap %s failed!\n", name);
+      return(-1);
+    }
+  #ifdef MADV_SEQUENTIAL
+    madvise(f->map, (size_t)f->len_map, MADV_SEQUENTIAL);
+  #endif
+  }
+#else
+  {
+    FILE *fp = fopen(name, "rb");
+    if (fp == NULL) {
+      printf("iq_file_open: open %s failed!\n", name);
+      return(-1);
+    }
+    fseek(fp, 0, SEEK_END);
+    f->len_map = (uint64_t)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    f->map = (uint8_t *)malloc((size_t)f->len_map);
+    if ( f->map == NULL || fread(f->map, 1, (size_t)f->len_map, fp) != f->len_map ) {
+      printf("iq_file_open: reading %s failed!\n", name);
+      fclose(fp);
+      iq_file_close(f);
+      return(-1);
+    }
+    fclose(fp);
+  }
+#endif
+
+  switch ( parse_header(f) ) {
+    case 1:
+      break;
+    case 0:
+      format = iq_format_by_name(name);
+      f->info.format = (IQ_FORMAT)( format < 0? IQ_FORMAT_CS8 : format );
+      f->info.sample_rate = SAMPLE_PER_SYMBOL*1000000ull;
+      f->data = f->map;
+      break;
+    default:
+      iq_file_close(f);
+      return(-1);
+  }
+  f->num_iq = (f->len_map - (uint64_t)(f->data - f->map))/IQ_FORMAT_BYTE[f->info.format];
+  return(0);
+}
+
+IQ_TYPE* iq_file_ptr(IQ_FILE *f, uint64_t iq_offset) {
+  if (f->info.format != IQ_FORMAT_NATIVE) {
+    return(NULL);
+  }
+  return( (IQ_TYPE *)( f->data + iq_offset*IQ_FORMAT_BYTE[IQ_FORMAT_NATIVE] ) );
+}
+
+void iq_file_read(IQ_FILE *f, uint64_t iq_offset, int num_iq, IQ_TYPE *out) {
+  uint8_t *p = f->data + iq_offset*IQ_FORMAT_BYTE[f->info.format];
+
+  switch (f->info.format) {
+    case IQ_FORMAT_CS8:
+      cs8_to_iq((const int8_t *)p, out, 2*num_iq);
+      break;
+    case IQ_FORMAT_CS16:
+      cs16_to_iq((const int16_t *)p, out, 2*num_iq);
+      break;
+    default:
+      cf32_to_iq((const float *)p, out, 2*num_iq);
+      break;
+  }
+}
+//----------------------------------reader----------------------------------
+
+//----------------------------------writer----------------------------------
+int iq_file_create(IQ_FILE *f, const char *name, IQ_FILE_INFO *info, int header) {
+  memset(f, 0, sizeof(IQ_FILE));
+  f->info = (*info);
+  f->has_header = header;
+
+  f->fp = fopen(name, "wb");
+  if (f->fp == NULL) {
+    printf("iq_file_create: can not create %s!\n", name);
+    return(-1);
+  }
+  if (info->format != IQ_FORMAT_NATIVE) {
+    f->conv_buf = malloc(LEN_IQ_FILE_CONV*IQ_FORMAT_BYTE[info->format]);
+    if (f->conv_buf == NULL) {
+      printf("iq_file_create: out of memory!\n");
+      iq_file_close(f);
+      return(-1);
+    }
+  }
+  if ( header && iq_file_write_header(f->fp, info) != 0 ) {
+    iq_file_close(f);
+    return(-1);
+  }
+  return(0);
+}
+
+int iq_file_write(IQ_FILE *f, IQ_TYPE *buf, int num_iq) {
+  int n;
+  size_t num_byte;
+
+  if (f->info.format == IQ_FORMAT_NATIVE) {
+    num_byte = (size_t)num_iq*IQ_FORMAT_BYTE[IQ_FORMAT_NATIVE];
+    if ( fwrite(buf, 1, num_byte, f->fp) != num_byte ) {
+      printf("iq_file_write: fwrite failed!\n");
+      return(-1);
+    }
+    return(0);
+  }
+
+  for (; num_iq>0; num_iq=num_iq-n, buf=buf+2*n) {
+    n = ( num_iq > LEN_IQ_FILE_CONV? LEN_IQ_FILE_CONV : num_iq );
+    if (f->info.format == IQ_FORMAT_CS8) {
+      iq_to_cs8(buf, (int8_t *)f->conv_buf, 2*n);
+    } else if (f->info.format == IQ_FORMAT_CS16) {
+      iq_to_cs16(buf, (int16_t *)f->conv_buf, 2*n);
+    } else {
+      iq_to_cf32(buf, (float *)f->conv_buf, 2*n);
+    }
+    num_byte = (size_t)n*IQ_FORMAT_BYTE[f->info.format];
+    if ( fwrite(f->conv_buf, 1, num_byte, f->fp) != num_byte ) {
+      printf("iq_file_write: fwrite failed!\n");
+      return(-1);
+    }
+  }
+  return(0);
+}
+//----------------------------------writer----------------------------------
+
+void iq_file_close(IQ_FILE *f) {
+  if (f->map != NULL) {
+#ifndef _WIN32
+    munmap(f->map, (size_t)f->len_map);
+#else
+    free(f->map);
+#endif
+  }
+  if (f->fp != NULL) {
+    fclose(f->fp);
+  }
+  free(f->conv_buf);
+  memset(f, 0, sizeof(IQ_FILE));
+}
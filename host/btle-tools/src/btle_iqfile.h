@@ -0,0 +1,91 @@
+// Binary IQ capture files for the btle tools
+//
+// Interleaved I/Q as cs8 (int8, hackrf_transfer), cs16 (int16 SC16 Q11, bladeRF) or cf32
+// (float, full scale 1.0), optionally behind a 64 byte little endian header:
+//   0  "BTLEIQ" + uint16 version
+//   8  uint32 header length
+//   12 uint32 format, IQ_FORMAT
+//   16 uint64 sample rate in Hz
+//   24 uint64 center frequency in Hz
+//   32 int64  host time of the first sample, ns since the epoch. 0: unknown
+// Files without the header are read as the format their extension names (.cs16, .cf32,
+// anything else cs8) at SAMPLE_PER_SYMBOL Msps.
+// Reading maps the whole file. When the file holds IQ_TYPE already (cs8 with HackRF, cs16
+// with bladeRF) iq_file_ptr() hands out the mapping itself; otherwise iq_file_read() converts
+// with plain loops the compiler vectorizes.
+
+#ifndef BTLE_IQFILE_H
+#define BTLE_IQFILE_H
+
+#include "btle_phy.h"
+
+#include <stdio.h>
+
+#define LEN_IQ_FILE_HEADER (64)
+#define LEN_IQ_FILE_CONV (65536) // IQ samples converted per fwrite
+
+typedef enum {
+  IQ_FORMAT_CS8,
+  IQ_FORMAT_CS16,
+  IQ_FORMAT_CF32,
+  NUM_IQ_FORMAT
+} IQ_FORMAT;
+
+#ifdef USE_BLADERF
+#define IQ_FORMAT_NATIVE IQ_FORMAT_CS16
+#else
+#define IQ_FORMAT_NATIVE IQ_FORMAT_CS8
+#endif
+
+extern char *IQ_FORMAT_STR[NUM_IQ_FORMAT];
+extern int IQ_FORMAT_BYTE[NUM_IQ_FORMAT];  // bytes per IQ sample
+
+typedef struct {
+  IQ_FORMAT format;
+  uint64_t sample_rate;   // Hz
+  uint64_t freq_hz;       // 0: unknown
+  int64_t start_ns;       // 0: unknown
+} IQ_FILE_INFO;
+
+typedef struct {
+  IQ_FILE_INFO info;
+  int has_header;
+  // reader
+  uint8_t *map;
+  uint64_t len_map;
+  uint8_t *data;
+  uint64_t num_iq;
+  // writer
+  FILE *fp;
+  void *conv_buf;
+} IQ_FILE;
+
+// by extension: .cs8, .cs16, .cf32. -1: none of them
+int iq_format_by_name(const char *name);
+// "cs8", "cs16" or "cf32". -1: none of them
+int iq_format_by_str(const char *str);
+
+// maps name for reading. returns -1 on failure
+int iq_file_open(IQ_FILE *f, const char *name);
+// num_iq samples at iq_offset without copying, or NULL if the file is not IQ_TYPE
+IQ_TYPE* iq_file_ptr(IQ_FILE *f, uint64_t iq_offset);
+// converts num_iq samples at iq_offset to IQ_TYPE
+void iq_file_read(IQ_FILE *f, uint64_t iq_offset, int num_iq, IQ_TYPE *out);
+
+// new file in info->format. header 0: raw samples only. returns -1 on failure
+int iq_file_create(IQ_FILE *f, const char *name, IQ_FILE_INFO *info, int header);
+int iq_file_write(IQ_FILE *f, IQ_TYPE *buf, int num_iq);
+// for writers that produce the bytes themselves
+int iq_file_write_header(FILE *fp, IQ_FILE_INFO *info);
+
+void iq_file_close(IQ_FILE *f);
+
+// format conversion, n IQ_TYPE elements (I and Q counted separately)
+void cs8_to_iq(const int8_t *in, IQ_TYPE *out, int n);
+void cs16_to_iq(const int16_t *in, IQ_TYPE *out, int n);
+void cf32_to_iq(const float *in, IQ_TYPE *out, int n);
+void iq_to_cs8(const IQ_TYPE *in, int8_t *out, int n);
+void iq_to_cs16(const IQ_TYPE *in, int16_t *out, int n);
+void iq_to_cf32(const IQ_TYPE *in, float *out, int n);
+
+#endif
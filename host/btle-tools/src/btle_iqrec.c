@@ -0,0 +1,399 @@
+// Raw IQ ring recorder with triggered snippets for the btle receiver
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _WIN32
+#define _GNU_SOURCE // O_DIRECT
+#endif
+
+#include "btle_iqrec.h"
+#include "btle_iqfile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+#define LEN_PEAK_WINDOW (64)                          // IQ samples, 16us
+#define IQREC_ELEMENT_PER_MS (2*SAMPLE_PER_SYMBOL*1000) // IQ_TYPE elements at SAMPLE_PER_SYMBOL Msps
+#define IQREC_ALIGN (4096)                            // O_DIRECT buffer, offset and length alignment
+
+char *IQREC_TRIG_STR[NUM_IQREC_TRIG] = {
+    "pkt",
+    "crc",
+    "energy"
+};
+
+float iq_block_peak_dbfs(IQ_TYPE *rxp, int num_iq_sample, int *peak_offset) {
+  int64_t power, power_max = 0;
+  int i, j, v0, v1, num_window = num_iq_sample/LEN_PEAK_WINDOW;
+
+  (*peak_offset) = 0;
+  for (i=0; i<num_window; i++) {
+    power = 0;
+    for (j=0; j<LEN_PEAK_WINDOW*2; j=j+2) {
+      v0 = rxp[j];
+      v1 = rxp[j+1];
+      power = power + v0*v0 + v1*v1;
+    }
+    if (power > power_max) {
+      power_max = power;
+      (*peak_offset) = i*LEN_PEAK_WINDOW*2;
+    }
+    rxp = rxp + LEN_PEAK_WINDOW*2;
+  }
+
+  if (power_max == 0) {
+    return(-127.0f);
+  }
+  return( 10.0f*log10f( (float)power_max/((float)LEN_PEAK_WINDOW*IQ_MAX*IQ_MAX) ) );
+}
+
+#ifndef _WIN32
+
+#define memory_barrier() __sync_synchronize()
+
+// idx: IQ_TYPE elements at the board's rate
+static inline double idx_to_ms(IQ_REC *rec, uint64_t idx) {
+  return( (double)idx/(IQREC_ELEMENT_PER_MS*rec->oversample) );
+}
+
+//----------------------------------rx callback and demod thread----------------------------------
+void iq_rec_write(IQ_REC *rec, IQ_TYPE *buf, int len) {
+  uint64_t num_byte = len*sizeof(IQ_TYPE), offset = rec->head%LEN_IQREC_STAGE, n;
+
+  n = LEN_IQREC_STAGE - offset;
+  n = (n > num_byte? num_byte : n);
+  memcpy(rec->stage+offset, buf, n);
+  memcpy(rec->stage, ((uint8_t *)buf)+n, num_byte-n);
+  memory_barrier(); // content before head
+  rec->head = rec->head + num_byte;
+}
+
+void iq_rec_trigger(IQ_REC *rec, uint64_t sample_idx, int len, IQREC_TRIG_TYPE type) {
+  IQREC_WINDOW *w;
+
+  if (sample_idx < rec->trig_end[type]) {
+    return;
+  }
+  if ( (rec->trig_head - rec->trig_tail) >= LEN_IQREC_TRIGGER ) {
+    rec->num_trig_drop++;
+    return;
+  }
+
+  w = rec->trig + (rec->trig_head&(LEN_IQREC_TRIGGER-1));
+  w->trig_idx = sample_idx*rec->oversample;
+  w->start = ( w->trig_idx > rec->len_pre? (w->trig_idx - rec->len_pre)&(~((uint64_t)1)) : 0 );
+  w->end = w->trig_idx + (uint64_t)len*rec->oversample + rec->len_post;
+  w->type = type;
+  rec->trig_end[type] = sample_idx + len + rec->len_post/rec->oversample;
+  memory_barrier(); // window before head
+  rec->trig_head = rec->trig_head + 1;
+}
+//----------------------------------rx callback and demod thread----------------------------------
+
+//----------------------------------writer thread----------------------------------
+// bytes [start, end) of the stream, all on disk, to a new file with the btle_iqfile header
+static int write_range(IQ_REC *rec, const char *name, uint64_t start, uint64_t end) {
+  FILE *fp = fopen(name, "wb");
+  IQ_FILE_INFO info;
+  uint64_t pos, offset;
+  size_t n;
+
+  if (fp == NULL) {
+    printf("iq_rec: can not create %s!\n", name);
+    return(-1);
+  }
+  info.format = IQ_FORMAT_NATIVE;
+  info.sample_rate = SAMPLE_PER_SYMBOL*1000000ull*rec->oversample;
+  info.freq_hz = rec->freq_hz;
+  info.start_ns = 0;
+  if ( (*(rec->t0_us)) != 0 ) {
+    info.start_ns = (*(rec->t0_us))*1000 + (int64_t)( (start/sizeof(IQ_TYPE))*1000000/(IQREC_ELEMENT_PER_MS*rec->oversample) );
+  }
+  if ( iq_file_write_header(fp, &info) != 0 ) {
+    fclose(fp);
+    return(-1);
+  }
+  for (pos=start; pos<end; pos=pos+n) {
+    offset = pos%rec->len_ring;
+    n = (size_t)( end - pos );
+    n = ( n > LEN_IQREC_CHUNK? LEN_IQREC_CHUNK : n );
+    n = ( n > (rec->len_ring - offset)? (size_t)(rec->len_ring - offset) : n );
+    if ( pread(rec->fd_read, rec->cut_buf, n, (off_t)offset) != (ssize_t)n || fwrite(rec->cut_buf, 1, n, fp) != n ) {
+      printf("iq_rec: writing %s failed!\n", name);
+      fclose(fp);
+      return(-1);
+    }
+  }
+  fclose(fp);
+  return(0);
+}
+
+// what of [start, end) is still on disk
+static void clamp_range(IQ_REC *rec, uint64_t *start, uint64_t *end) {
+  if ( (*start) < rec->valid_start ) {
+    (*start) = rec->valid_start;
+  }
+  if ( rec->written > rec->len_ring && (*start) < (rec->written - rec->len_ring) ) {
+    (*start) = rec->written - rec->len_ring;
+  }
+  if ( (*end) > rec->written ) {
+    (*end) = rec->written;
+  }
+}
+
+static void cut_snippet(IQ_REC *rec, IQREC_WINDOW *w) {
+  char name[MAX_LEN_IQREC_PREFIX+32];
+  uint64_t start = w->start*sizeof(IQ_TYPE), end = w->end*sizeof(IQ_TYPE);
+
+  clamp_range(rec, &start, &end);
+  if (end <= start) {
+    printf("Record: %s trigger at %.3fms, samples no longer on disk\n", IQREC_TRIG_STR[w->type], idx_to_ms(rec, w->trig_idx));
+    return;
+  }
+
+  snprintf(name, sizeof(name), "%s_%04llu_%s.%s", rec->prefix, (unsigned long long)rec->num_snippet, IQREC_TRIG_STR[w->type], IQ_FORMAT_STR[IQ_FORMAT_NATIVE]);
+  if ( write_range(rec, name, start, end) != 0 ) {
+    return;
+  }
+  printf("Record: %s, %s trigger at %.3fms, %.3fms~%.3fms\n", name, IQREC_TRIG_STR[w->type], idx_to_ms(rec, w->trig_idx),
+    idx_to_ms(rec, start/sizeof(IQ_TYPE)), idx_to_ms(rec, end/sizeof(IQ_TYPE)));
+  rec->num_snippet++;
+}
+
+// windows whose samples are all on disk. when flushing, whatever is there
+static void cut_snippets(IQ_REC *rec, int flush) {
+  uint64_t tail = rec->trig_tail, head = rec->trig_head;
+  IQREC_WINDOW w, *next;
+
+  memory_barrier(); // head before windows
+  while (tail != head) {
+    w = rec->trig[tail&(LEN_IQREC_TRIGGER-1)];
+    // overlapping windows of different types become one snippet
+    while ( (tail+1) != head ) {
+      next = rec->trig + ((tail+1)&(LEN_IQREC_TRIGGER-1));
+      if (next->start > w.end) {
+        break;
+      }
+      w.end = ( next->end > w.end? next->end : w.end );
+      tail++;
+    }
+    if ( !flush && w.end*sizeof(IQ_TYPE) > rec->written ) {
+      break;
+    }
+    cut_snippet(rec, &w);
+    tail++;
+    memory_barrier(); // done with the windows before handing the slots back
+    rec->trig_tail = tail;
+  }
+}
+
+static void lose(IQ_REC *rec, uint64_t num_byte) {
+  rec->num_lost_sample = rec->num_lost_sample + num_byte/(2*sizeof(IQ_TYPE));
+}
+
+// n bytes from written on. n is LEN_IQREC_CHUNK, only the last write at close may be shorter
+static void write_chunk(IQ_REC *rec, uint64_t n) {
+  uint64_t written = rec->written;
+  size_t len = (size_t)( (n + IQREC_ALIGN - 1)&(~((uint64_t)IQREC_ALIGN-1)) );
+
+  if ( pwrite(rec->fd_write, rec->stage + written%LEN_IQREC_STAGE, len, (off_t)(written%rec->len_ring)) != (ssize_t)len ) {
+    if (rec->valid_start <= written) {
+      printf("iq_rec: write failed at %.3fms! (%s)\n", idx_to_ms(rec, written/sizeof(IQ_TYPE)), strerror(errno));
+    }
+    lose(rec, n);
+    rec->valid_start = written + n;
+  } else if ( rec->head > (written + LEN_IQREC_STAGE - LEN_IQREC_CHUNK) ) {
+    // the rx callback got into the chunk while it was being written
+    lose(rec, n);
+    rec->valid_start = written + n;
+  }
+  rec->written = written + n;
+}
+
+static void *iq_rec_thread(void *arg) {
+  IQ_REC *rec = (IQ_REC *)arg;
+  uint64_t head, written_new;
+  int stop;
+
+  while (1) {
+    stop = rec->stop;
+    memory_barrier(); // stop before head: nothing is written after stop is set
+    head = rec->head;
+
+    // lapped: skip to the middle of the staging ring, the callback writes far from there
+    if ( head > (rec->written + LEN_IQREC_STAGE - LEN_IQREC_CHUNK) ) {
+      written_new = ( head&(~((uint64_t)LEN_IQREC_CHUNK-1)) ) - LEN_IQREC_STAGE/2;
+      printf("Record: disk too slow, %llu IQ samples skipped %.3fms~%.3fms\n", (unsigned long long)((written_new - rec->written)/(2*sizeof(IQ_TYPE))),
+        idx_to_ms(rec, rec->written/sizeof(IQ_TYPE)), idx_to_ms(rec, written_new/sizeof(IQ_TYPE)));
+      lose(rec, written_new - rec->written);
+      rec->written = written_new;
+      rec->valid_start = written_new;
+      continue;
+    }
+    if ( (head - rec->written) >= LEN_IQREC_CHUNK ) {
+      write_chunk(rec, LEN_IQREC_CHUNK);
+      continue;
+    }
+
+    if (stop) {
+      if (head != rec->written) {
+        write_chunk(rec, head - rec->written);
+      }
+      cut_snippets(rec, 1);
+      break;
+    }
+    cut_snippets(rec, 0);
+    usleep(1000);
+  }
+  return(NULL);
+}
+//----------------------------------writer thread----------------------------------
+
+//----------------------------------open and close----------------------------------
+int iq_rec_open(IQ_REC *rec, const char *prefix, int seconds, int pre_ms, int post_ms, int oversample, uint64_t freq_hz, volatile int64_t *t0_us, RT_MEM_MODE mem_mode) {
+  char name[MAX_LEN_IQREC_PREFIX+32];
+  uint64_t element_per_ms = (uint64_t)IQREC_ELEMENT_PER_MS*oversample;
+  uint64_t len_window = (uint64_t)(pre_ms + post_ms)*element_per_ms*sizeof(IQ_TYPE);
+
+  memset(rec, 0, sizeof(IQ_REC));
+  rec->fd_write = -1;
+  rec->fd_read = -1;
+  if (strlen(prefix) >= MAX_LEN_IQREC_PREFIX) {
+    printf("iq_rec_open: prefix %s is too long!\n", prefix);
+    return(-1);
+  }
+  strcpy(rec->prefix, prefix);
+  rec->freq_hz = freq_hz;
+  rec->t0_us = t0_us;
+  rec->oversample = oversample;
+  rec->len_ring = (uint64_t)seconds*1000*element_per_ms*sizeof(IQ_TYPE);
+  rec->len_ring = (rec->len_ring + LEN_IQREC_CHUNK - 1)&(~((uint64_t)LEN_IQREC_CHUNK-1));
+  rec->len_pre = (uint64_t)pre_ms*element_per_ms;
+  rec->len_post = (uint64_t)post_ms*element_per_ms;
+  if ( len_window > rec->len_ring/2 ) {
+    printf("iq_rec_open: trigger window %dms longer than half the ring %ds!\n", pre_ms + post_ms, seconds);
+    return(-1);
+  }
+
+  // stage is touched once by rt_alloc, so that the rx callback never takes a page fault on it
+  if ( rt_alloc(&(rec->stage_mem), LEN_IQREC_STAGE, mem_mode) != 0 ||
+       posix_memalign((void **)&(rec->cut_buf), IQREC_ALIGN, LEN_IQREC_CHUNK) != 0 ) {
+    printf("iq_rec_open: out of memory!\n");
+    iq_rec_close(rec);
+    return(-1);
+  }
+  rec->stage = (uint8_t *)rec->stage_mem.p;
+
+  snprintf(name, sizeof(name), "%s.ring", prefix);
+#ifdef O_DIRECT
+  rec->fd_write = open(name, O_WRONLY|O_CREAT|O_TRUNC|O_DIRECT, 0644);
+  rec->direct_io = (rec->fd_write >= 0);
+#endif
+  if (rec->fd_write < 0) { // tmpfs and others refuse O_DIRECT
+    rec->fd_write = open(name, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  }
+  if (rec->fd_write < 0) {
+    printf("iq_rec_open: can not create %s! (%s)\n", name, strerror(errno));
+    iq_rec_close(rec);
+    return(-1);
+  }
+  // allocated up front: no ENOSPC and no block allocation on the write path later
+  if ( posix_fallocate(rec->fd_write, 0, (off_t)rec->len_ring) != 0 && ftruncate(rec->fd_write, (off_t)rec->len_ring) != 0 ) {
+    printf("iq_rec_open: can not allocate %llu bytes for %s!\n", (unsigned long long)rec->len_ring, name);
+    iq_rec_close(rec);
+    return(-1);
+  }
+  rec->fd_read = open(name, O_RDONLY);
+  if (rec->fd_read < 0) {
+    printf("iq_rec_open: can not read %s!\n", name);
+    iq_rec_close(rec);
+    return(-1);
+  }
+
+  if ( pthread_create(&(rec->thread), NULL, iq_rec_thread, (void *)rec) != 0 ) {
+    printf("iq_rec_open: pthread_create failed!\n");
+    iq_rec_close(rec);
+    return(-1);
+  }
+  rec->running = 1;
+
+  return(0);
+}
+
+void iq_rec_close(IQ_REC *rec) {
+  char name[MAX_LEN_IQREC_PREFIX+32];
+  uint64_t start = 0, end = ~((uint64_t)0);
+
+  if (rec->running) {
+    rec->running = 0;
+    memory_barrier();
+    rec->stop = 1;
+    pthread_join(rec->thread, NULL);
+
+    clamp_range(rec, &start, &end);
+    snprintf(name, sizeof(name), "%s_last.%s", rec->prefix, IQ_FORMAT_STR[IQ_FORMAT_NATIVE]);
+    if ( end > start && write_range(rec, name, start, end) == 0 ) {
+      printf("Record: %s, last %.3fms (%.3fms~%.3fms)\n", name, idx_to_ms(rec, (end - start)/sizeof(IQ_TYPE)),
+        idx_to_ms(rec, start/sizeof(IQ_TYPE)), idx_to_ms(rec, end/sizeof(IQ_TYPE)));
+    }
+  }
+
+  if (rec->fd_read >= 0) {
+    close(rec->fd_read);
+  }
+  if (rec->fd_write >= 0) {
+    close(rec->fd_write);
+    snprintf(name, sizeof(name), "%s.ring", rec->prefix);
+    unlink(name);
+  }
+  rec->fd_read = -1;
+  rec->fd_write = -1;
+  rt_free(&(rec->stage_mem));
+  free(rec->cut_buf);
+  rec->stage = NULL;
+  rec->cut_buf = NULL;
+}
+//----------------------------------open and close----------------------------------
+
+#else
+
+int iq_rec_open(IQ_REC *rec, const char *prefix, int seconds, int pre_ms, int post_ms, int oversample, uint64_t freq_hz, volatile int64_t *t0_us, RT_MEM_MODE mem_mode) {
+  printf("iq_rec_open: not supported on Windows!\n");
+  return(-1);
+}
+
+void iq_rec_write(IQ_REC *rec, IQ_TYPE *buf, int len) {
+}
+
+void iq_rec_trigger(IQ_REC *rec, uint64_t sample_idx, int len, IQREC_TRIG_TYPE type) {
+}
+
+void iq_rec_close(IQ_REC *rec) {
+}
+
+#endif
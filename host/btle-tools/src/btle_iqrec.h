@@ -0,0 +1,94 @@
+// Raw IQ ring recorder with triggered snippets for the btle receiver
+//
+// Keeps the last seconds of the samples as the board delivered them (before -d and -R, at the
+// board's rate) in a ring file on disk, prefix.ring, and cuts a window around every trigger
+// into its own capture, prefix_NNNN_type.cs8 (cs16 with bladeRF, both with the btle_iqfile
+// header), which btle_replay reads back when they are at 4Msps. At close the ring is written out in time order to prefix_last.cs8
+// and removed.
+//
+// The rx callback only copies into a staging ring in memory (iq_rec_write), the demod thread
+// only queues trigger windows (iq_rec_trigger); neither ever waits for the disk. A writer
+// thread moves the staging ring to the ring file in LEN_IQREC_CHUNK writes, aligned in memory
+// and on disk so that they can bypass the page cache (O_DIRECT where the file system allows
+// it), and cuts a snippet once the disk holds its whole window. When the disk falls more than
+// the staging ring behind, samples are skipped and counted, as the demod thread does.
+
+#ifndef BTLE_IQREC_H
+#define BTLE_IQREC_H
+
+#include "btle_phy.h"
+#include "btle_rt.h"
+
+#include <pthread.h>
+
+#define LEN_IQREC_CHUNK (1<<20)               // bytes per disk write. multiple of the O_DIRECT alignment
+#define LEN_IQREC_STAGE (16*LEN_IQREC_CHUNK)  // bytes of staging ring, ~2s of cs8 at 4Msps
+#define LEN_IQREC_TRIGGER 64                  // trigger windows queued for the writer, must be 2^x
+#define MAX_LEN_IQREC_PREFIX 240
+
+typedef enum {
+  IQREC_TRIG_PKT,     // packet matched the trigger filter
+  IQREC_TRIG_CRC,     // burst of CRC failures
+  IQREC_TRIG_ENERGY,  // signal above the energy threshold
+  NUM_IQREC_TRIG
+} IQREC_TRIG_TYPE;
+
+extern char *IQREC_TRIG_STR[NUM_IQREC_TRIG];
+
+typedef struct {
+  uint64_t start;     // IQ_TYPE element index at the board's rate, absolute
+  uint64_t end;
+  uint64_t trig_idx;  // where it fired
+  IQREC_TRIG_TYPE type;
+} IQREC_WINDOW;
+
+typedef struct {
+  char prefix[MAX_LEN_IQREC_PREFIX];
+  uint64_t len_ring;                  // bytes in the ring file, multiple of LEN_IQREC_CHUNK
+  int oversample;                     // board rate / SAMPLE_PER_SYMBOL Msps
+  uint64_t len_pre, len_post;         // IQ_TYPE elements around a trigger, at the board's rate
+  uint64_t freq_hz;                   // for the file header
+  volatile int64_t *t0_us;            // host time of sample 0, 0 while unknown. see account_transfer
+  int fd_write, fd_read;
+  int direct_io;
+
+  // rx callback
+  uint8_t *stage;
+  RT_MEM stage_mem;
+  volatile uint64_t head;             // bytes written to stage
+
+  // demod thread
+  IQREC_WINDOW trig[LEN_IQREC_TRIGGER];
+  volatile uint64_t trig_head;
+  uint64_t trig_end[NUM_IQREC_TRIG];  // a trigger inside the window of the last one of its type is ignored
+  volatile uint64_t num_trig_drop;    // trigger queue full
+
+  // writer thread
+  volatile uint64_t trig_tail;
+  volatile uint64_t written;          // bytes on disk
+  uint64_t valid_start;               // first byte after the last skip
+  uint8_t *cut_buf;
+  volatile uint64_t num_snippet;
+  volatile uint64_t num_lost_sample;  // IQ samples skipped because the disk was too slow
+  volatile int stop;
+  int running;                        // iq_rec_open succeeded
+  pthread_t thread;
+} IQ_REC;
+
+// creates prefix.ring for the last `seconds` and starts the writer. oversample: the board
+// streams at oversample*SAMPLE_PER_SYMBOL Msps. mem_mode for the staging ring, see btle_rt.h.
+// returns -1 on failure
+int iq_rec_open(IQ_REC *rec, const char *prefix, int seconds, int pre_ms, int post_ms, int oversample, uint64_t freq_hz, volatile int64_t *t0_us, RT_MEM_MODE mem_mode);
+// rx callback: len IQ_TYPE elements of a transfer, untouched, before anything else uses it
+void iq_rec_write(IQ_REC *rec, IQ_TYPE *buf, int len);
+// demod thread: sample_idx and len (IQ_TYPE elements at SAMPLE_PER_SYMBOL Msps, as rx_buf
+// counts them) of what fired, widened by pre/post
+void iq_rec_trigger(IQ_REC *rec, uint64_t sample_idx, int len, IQREC_TRIG_TYPE type);
+// flushes, cuts what is still queued, writes prefix_last and stops the writer
+void iq_rec_close(IQ_REC *rec);
+
+// energy trigger: power of the loudest 64 sample window in dBFS, *peak_offset its first
+// IQ_TYPE element
+float iq_block_peak_dbfs(IQ_TYPE *rxp, int num_iq_sample, int *peak_offset);
+
+#endif
@@ -0,0 +1,190 @@
+// Hex string and bit array helpers shared by the btle tools
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "btle_misc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+//----------------------------------MISC MISC MISC----------------------------------
+char* toupper_str(char *input_str, char *output_str) {
+  int len_str = strlen(input_str);
+  int i;
+
+  for (i=0; i<=len_str; i++) {
+    output_str[i] = toupper( input_str[i] );
+  }
+
+  return(output_str);
+}
+
+void octet_hex_to_bit(char *hex, char *bit) {
+  char tmp_hex[3];
+
+  tmp_hex[0] = hex[0];
+  tmp_hex[1] = hex[1];
+  tmp_hex[2] = 0;
+
+  int n = strtol(tmp_hex, NULL, 16);
+
+  bit[0] = 0x01&(n>>0);
+  bit[1] = 0x01&(n>>1);
+  bit[2] = 0x01&(n>>2);
+  bit[3] = 0x01&(n>>3);
+  bit[4] = 0x01&(n>>4);
+  bit[5] = 0x01&(n>>5);
+  bit[6] = 0x01&(n>>6);
+  bit[7] = 0x01&(n>>7);
+}
+
+int bit_to_int(char *bit) {
+  int n = 0;
+  int i;
+  for(i=0; i<8; i++) {
+    n = ( (n<<1) | bit[7-i] );
+  }
+  return(n);
+}
+
+void int_to_bit(int n, char *bit) {
+  bit[0] = 0x01&(n>>0);
+  bit[1] = 0x01&(n>>1);
+  bit[2] = 0x01&(n>>2);
+  bit[3] = 0x01&(n>>3);
+  bit[4] = 0x01&(n>>4);
+  bit[5] = 0x01&(n>>5);
+  bit[6] = 0x01&(n>>6);
+  bit[7] = 0x01&(n>>7);
+}
+
+void byte_array_to_bit_array(uint8_t *byte_in, int num_byte, char *bit) {
+  int i, j;
+  j=0;
+  for(i=0; i<num_byte*8; i=i+8) {
+    int_to_bit(byte_in[j], bit+i);
+    j++;
+  }
+}
+
+int convert_hex_to_bit(char *hex, char *bit){
+  int num_hex = strlen(hex);
+  while(hex[num_hex-1]<=32 || hex[num_hex-1]>=127) {
+    num_hex--;
+  }
+
+  if (num_hex%2 != 0) {
+    printf("convert_hex_to_bit: Half octet is encountered! num_hex %d\n", num_hex);
+    printf("%s\n", hex);
+    return(-1);
+  }
+
+  int num_bit = num_hex*4;
+
+  int i, j;
+  for (i=0; i<num_hex; i=i+2) {
+    j = i*4;
+    octet_hex_to_bit(hex+i, bit+j);
+  }
+
+  return(num_bit);
+}
+
+int convert_hex_to_byte(char *hex, uint8_t *byte){
+  char tmp_hex[3];
+  int num_hex = strlen(hex);
+  while(num_hex > 0 && (hex[num_hex-1]<=32 || hex[num_hex-1]>=127)) {
+    num_hex--;
+  }
+
+  if (num_hex%2 != 0) {
+    printf("convert_hex_to_byte: Half octet is encountered! num_hex %d\n", num_hex);
+    printf("%s\n", hex);
+    return(-1);
+  }
+
+  int i;
+  tmp_hex[2] = 0;
+  for (i=0; i<num_hex; i=i+2) {
+    tmp_hex[0] = hex[i];
+    tmp_hex[1] = hex[i+1];
+    byte[i/2] = strtol(tmp_hex, NULL, 16);
+  }
+
+  return(num_hex/2);
+}
+
+void disp_bit(char *bit, int num_bit)
+{
+  int i, bit_val;
+  for(i=0; i<num_bit; i++) {
+    bit_val = bit[i];
+    if (i%8 == 0 && i != 0) {
+      printf(" ");
+    } else if (i%4 == 0 && i != 0) {
+      printf("-");
+    }
+    printf("%d", bit_val);
+  }
+  printf("\n");
+}
+
+void disp_bit_in_hex(char *bit, int num_bit)
+{
+  int i, a;
+  for(i=0; i<num_bit; i=i+8) {
+    a = bit[i] + bit[i+1]*2 + bit[i+2]*4 + bit[i+3]*8 + bit[i+4]*16 + bit[i+5]*32 + bit[i+6]*64 + bit[i+7]*128;
+    //a = bit[i+7] + bit[i+6]*2 + bit[i+5]*4 + bit[i+4]*8 + bit[i+3]*16 + bit[i+2]*32 + bit[i+1]*64 + bit[i]*128;
+    printf("%02x", a);
+  }
+  printf("\n");
+}
+
+void disp_hex(uint8_t *hex, int num_hex)
+{
+  int i;
+  for(i=0; i<num_hex; i++)
+  {
+     printf("%02x", hex[i]);
+  }
+  printf("\n");
+}
+
+void disp_hex_in_bit(uint8_t *hex, int num_hex)
+{
+  int i, j, bit_val;
+
+  for(j=0; j<num_hex; j++) {
+
+    for(i=0; i<8; i++) {
+      bit_val = (hex[j]>>i)&0x01;
+      if (i==4) {
+        printf("-");
+      }
+      printf("%d", bit_val);
+    }
+
+    printf(" ");
+
+  }
+
+  printf("\n");
+}
+//----------------------------------MISC MISC MISC----------------------------------
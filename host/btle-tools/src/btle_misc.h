@@ -0,0 +1,26 @@
+// Hex string and bit array helpers shared by the btle tools
+//
+// A bit array holds one bit per char, LSB of each octet first, as the packet descriptor
+// parser of btle_tx and the air interface order expect.
+
+#ifndef BTLE_MISC_H
+#define BTLE_MISC_H
+
+#include <stdint.h>
+
+char* toupper_str(char *input_str, char *output_str);
+void octet_hex_to_bit(char *hex, char *bit);
+int bit_to_int(char *bit);
+void int_to_bit(int n, char *bit);
+void byte_array_to_bit_array(uint8_t *byte_in, int num_byte, char *bit);
+// returns the number of bits, -1 on an odd number of hex digits
+int convert_hex_to_bit(char *hex, char *bit);
+// octets in the order of the hex digits. returns their number, -1 on an odd number of hex digits
+int convert_hex_to_byte(char *hex, uint8_t *byte);
+
+void disp_bit(char *bit, int num_bit);
+void disp_bit_in_hex(char *bit, int num_bit);
+void disp_hex(uint8_t *hex, int num_hex);
+void disp_hex_in_bit(uint8_t *hex, int num_hex);
+
+#endif
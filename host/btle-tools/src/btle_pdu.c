@@ -0,0 +1,996 @@
+// BTLE link layer PDU helpers shared by the btle tools
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "btle_pdu.h"
+#include "btle_misc.h"
+
+#include <stdio.h>
+#include <string.h>
+
+char *PDU_TYPE_STR[16] = {
+    "ADV_IND",
+    "ADV_DIRECT_IND",
+    "ADV_NONCONN_IND",
+    "SCAN_REQ",
+    "SCAN_RSP",
+    "CONNECT_REQ",
+    "ADV_SCAN_IND",
+    "ADV_EXT_IND",
+    "RESERVED1",
+    "RESERVED2",
+    "RESERVED3",
+    "RESERVED4",
+    "RESERVED5",
+    "RESERVED6",
+    "RESERVED7",
+    "RESERVED8"
+};
+
+//----------------------------------BTLE SPEC related--------------------------------
+uint64_t get_freq_by_channel_number(int channel_number) {
+  uint64_t freq_hz;
+  if ( channel_number == 37 ) {
+    freq_hz = 2402000000ull;
+  } else if (channel_number == 38) {
+    freq_hz = 2426000000ull;
+  } else if (channel_number == 39) {
+    freq_hz = 2480000000ull;
+  } else if (channel_number >=0 && channel_number <= 10 ) {
+    freq_hz = 2404000000ull + channel_number*2000000ull;
+  } else if (channel_number >=11 && channel_number <= 36 ) {
+    freq_hz = 2428000000ull + (channel_number-11)*2000000ull;
+  } else {
+    freq_hz = 0xffffffffffffffff;
+  }
+  return(freq_hz);
+}
+//----------------------------------BTLE SPEC related--------------------------------
+
+//----------------------------------PDU building----------------------------------
+void fill_adv_pdu_header_byte(int pdu_type, int txadd, int rxadd, int payload_len, uint8_t *byte_out) {
+  if (pdu_type >= 0 && pdu_type <= 6) {
+    byte_out[0] = pdu_type;
+  } else {
+    byte_out[0] = 0xF;
+    printf("Warning! Reserved TYPE!\n");
+  }
+
+  byte_out[0] =  byte_out[0] | (txadd << 6);
+  byte_out[0] =  byte_out[0] | (rxadd << 7);
+
+  byte_out[1] = payload_len;
+}
+
+void fill_data_pdu_header_byte(int llid, int nesn, int sn, int md, int payload_len, uint8_t *byte_out) {
+  byte_out[0] = (llid&0x03) | ((nesn&1)<<2) | ((sn&1)<<3) | ((md&1)<<4);
+  byte_out[1] = payload_len;
+}
+
+int build_adv_pdu(int pdu_type, int txadd, int rxadd, const uint8_t *payload, int payload_len, uint8_t *pdu) {
+  fill_adv_pdu_header_byte(pdu_type, txadd, rxadd, payload_len, pdu);
+  memcpy(pdu+2, payload, payload_len);
+  return(2+payload_len);
+}
+
+int build_data_pdu(int llid, int nesn, int sn, int md, const uint8_t *payload, int payload_len, uint8_t *pdu) {
+  fill_data_pdu_header_byte(llid, nesn, sn, md, payload_len, pdu);
+  memcpy(pdu+2, payload, payload_len);
+  return(2+payload_len);
+}
+
+int build_connect_req_payload(const ADV_PDU_PAYLOAD_TYPE_5 *p, uint8_t *payload_byte) {
+  int i;
+
+  for (i=0; i<6; i++) {
+    payload_byte[i] = p->InitA[5-i];
+    payload_byte[6+i] = p->AdvA[5-i];
+  }
+  for (i=0; i<4; i++) {
+    payload_byte[12+i] = p->AA[3-i];
+  }
+  payload_byte[16] = (p->CRCInit>>16) & 0xFF;
+  payload_byte[17] = (p->CRCInit>>8) & 0xFF;
+  payload_byte[18] = p->CRCInit & 0xFF;
+  payload_byte[19] = p->WinSize;
+  payload_byte[20] = p->WinOffset & 0xFF;
+  payload_byte[21] = p->WinOffset >> 8;
+  payload_byte[22] = p->Interval & 0xFF;
+  payload_byte[23] = p->Interval >> 8;
+  payload_byte[24] = p->Latency & 0xFF;
+  payload_byte[25] = p->Latency >> 8;
+  payload_byte[26] = p->Timeout & 0xFF;
+  payload_byte[27] = p->Timeout >> 8;
+  for (i=0; i<5; i++) {
+    payload_byte[28+i] = p->ChM[4-i];
+  }
+  payload_byte[33] = (p->Hop&0x1F) | ((p->SCA&0x07)<<5);
+  return(34);
+}
+//----------------------------------PDU building----------------------------------
+
+//----------------------------------PDU parsing----------------------------------
+int parse_adv_pdu_payload_byte(uint8_t *payload_byte, int num_payload_byte, int pdu_type, void *adv_pdu_payload) {
+  int i;
+  ADV_PDU_PAYLOAD_TYPE_0_2_4_6 *payload_type_0_2_4_6 = NULL;
+  ADV_PDU_PAYLOAD_TYPE_1_3 *payload_type_1_3 = NULL;
+  ADV_PDU_PAYLOAD_TYPE_5 *payload_type_5 = NULL;
+  ADV_PDU_PAYLOAD_TYPE_R *payload_type_R = NULL;
+  if (num_payload_byte<6) {
+      //payload_parse_result_str = ['Payload Too Short (only ' num2str(length(payload_bits)) ' bits)'];
+      printf("Error: Payload Too Short (only %d bytes)\n", num_payload_byte);
+      return(-1);
+  }
+
+  if (pdu_type == 0 || pdu_type == 2 || pdu_type == 4 || pdu_type == 6) {
+      payload_type_0_2_4_6 = (ADV_PDU_PAYLOAD_TYPE_0_2_4_6 *)adv_pdu_payload;
+      
+      //AdvA = reorder_bytes_str( payload_bytes(1 : (2*6)) );
+      payload_type_0_2_4_6->AdvA[0] = payload_byte[5];
+      payload_type_0_2_4_6->AdvA[1] = payload_byte[4];
+      payload_type_0_2_4_6->AdvA[2] = payload_byte[3];
+      payload_type_0_2_4_6->AdvA[3] = payload_byte[2];
+      payload_type_0_2_4_6->AdvA[4] = payload_byte[1];
+      payload_type_0_2_4_6->AdvA[5] = payload_byte[0];
+      
+      //AdvData = payload_bytes((2*6+1):end);
+      for(i=0; i<(num_payload_byte-6); i++) {
+        payload_type_0_2_4_6->Data[i] = payload_byte[6+i];
+      }
+      
+      //payload_parse_result_str = ['AdvA:' AdvA ' AdvData:' AdvData];
+  } else if (pdu_type == 1 || pdu_type == 3) {
+      if (num_payload_byte!=12) {
+          printf("Error: Payload length %d bytes. Need to be 12 for PDU Type %d\n", num_payload_byte, pdu_type);
+          return(-1);
+      }
+      payload_type_1_3 = (ADV_PDU_PAYLOAD_TYPE_1_3 *)adv_pdu_payload;
+      
+      //AdvA = reorder_bytes_str( payload_bytes(1 : (2*6)) );
+      payload_type_1_3->A0[0] = payload_byte[5];
+      payload_type_1_3->A0[1] = payload_byte[4];
+      payload_type_1_3->A0[2] = payload_byte[3];
+      payload_type_1_3->A0[3] = payload_byte[2];
+      payload_type_1_3->A0[4] = payload_byte[1];
+      payload_type_1_3->A0[5] = payload_byte[0];
+      
+      //InitA = reorder_bytes_str( payload_bytes((2*6+1):end) );
+      payload_type_1_3->A1[0] = payload_byte[11];
+      payload_type_1_3->A1[1] = payload_byte[10];
+      payload_type_1_3->A1[2] = payload_byte[9];
+      payload_type_1_3->A1[3] = payload_byte[8];
+      payload_type_1_3->A1[4] = payload_byte[7];
+      payload_type_1_3->A1[5] = payload_byte[6];
+      
+      //payload_parse_result_str = ['AdvA:' AdvA ' InitA:' InitA];
+  } else if (pdu_type == 5) {
+      if (num_payload_byte!=34) {
+          printf("Error: Payload length %d bytes. Need to be 34 for PDU Type %d\n", num_payload_byte, pdu_type);
+          return(-1);
+      }
+      payload_type_5 = (ADV_PDU_PAYLOAD_TYPE_5 *)adv_pdu_payload;
+      
+      //InitA = reorder_bytes_str( payload_bytes(1 : (2*6)) );
+      payload_type_5->InitA[0] = payload_byte[5];
+      payload_type_5->InitA[1] = payload_byte[4];
+      payload_type_5->InitA[2] = payload_byte[3];
+      payload_type_5->InitA[3] = payload_byte[2];
+      payload_type_5->InitA[4] = payload_byte[1];
+      payload_type_5->InitA[5] = payload_byte[0];
+      
+      //AdvA = reorder_bytes_str( payload_bytes((2*6+1):(2*6+2*6)) );
+      payload_type_5->AdvA[0] = payload_byte[11];
+      payload_type_5->AdvA[1] = payload_byte[10];
+      payload_type_5->AdvA[2] = payload_byte[9];
+      payload_type_5->AdvA[3] = payload_byte[8];
+      payload_type_5->AdvA[4] = payload_byte[7];
+      payload_type_5->AdvA[5] = payload_byte[6];
+      
+      //AA = reorder_bytes_str( payload_bytes((2*6+2*6+1):(2*6+2*6+2*4)) );
+      payload_type_5->AA[0] = payload_byte[15];
+      payload_type_5->AA[1] = payload_byte[14];
+      payload_type_5->AA[2] = payload_byte[13];
+      payload_type_5->AA[3] = payload_byte[12];
+      
+      //CRCInit = payload_bytes((2*6+2*6+2*4+1):(2*6+2*6+2*4+2*3));
+      payload_type_5->CRCInit = 0;
+      payload_type_5->CRCInit = ( (payload_type_5->CRCInit << 8) | payload_byte[16] );
+      payload_type_5->CRCInit = ( (payload_type_5->CRCInit << 8) | payload_byte[17] );
+      payload_type_5->CRCInit = ( (payload_type_5->CRCInit << 8) | payload_byte[18] );
+      
+      //WinSize = payload_bytes((2*6+2*6+2*4+2*3+1):(2*6+2*6+2*4+2*3+2*1));
+      payload_type_5->WinSize = payload_byte[19];
+      
+      //WinOffset = reorder_bytes_str( payload_bytes((2*6+2*6+2*4+2*3+2*1+1):(2*6+2*6+2*4+2*3+2*1+2*2)) );
+      payload_type_5->WinOffset = 0;
+      payload_type_5->WinOffset = ( (payload_type_5->WinOffset << 8) | payload_byte[21] );
+      payload_type_5->WinOffset = ( (payload_type_5->WinOffset << 8) | payload_byte[20] );
+      
+      //Interval = reorder_bytes_str( payload_bytes((2*6+2*6+2*4+2*3+2*1+2*2+1):(2*6+2*6+2*4+2*3+2*1+2*2+2*2)) );
+      payload_type_5->Interval = 0;
+      payload_type_5->Interval = ( (payload_type_5->Interval << 8) | payload_byte[23] );
+      payload_type_5->Interval = ( (payload_type_5->Interval << 8) | payload_byte[22] );
+      
+      //Latency = reorder_bytes_str( payload_bytes((2*6+2*6+2*4+2*3+2*1+2*2+2*2+1):(2*6+2*6+2*4+2*3+2*1+2*2+2*2+2*2)) );
+      payload_type_5->Latency = 0;
+      payload_type_5->Latency = ( (payload_type_5->Latency << 8) | payload_byte[25] );
+      payload_type_5->Latency = ( (payload_type_5->Latency << 8) | payload_byte[24] );
+      
+      //Timeout = reorder_bytes_str( payload_bytes((2*6+2*6+2*4+2*3+2*1+2*2+2*2+2*2+1):(2*6+2*6+2*4+2*3+2*1+2*2+2*2+2*2+2*2)) );
+      payload_type_5->Timeout = 0;
+      payload_type_5->Timeout = ( (payload_type_5->Timeout << 8) | payload_byte[27] );
+      payload_type_5->Timeout = ( (payload_type_5->Timeout << 8) | payload_byte[26] );
+      
+      //ChM = reorder_bytes_str( payload_bytes((2*6+2*6+2*4+2*3+2*1+2*2+2*2+2*2+2*2+1):(2*6+2*6+2*4+2*3+2*1+2*2+2*2+2*2+2*2+2*5)) );
+      payload_type_5->ChM[0] = payload_byte[32];
+      payload_type_5->ChM[1] = payload_byte[31];
+      payload_type_5->ChM[2] = payload_byte[30];
+      payload_type_5->ChM[3] = payload_byte[29];
+      payload_type_5->ChM[4] = payload_byte[28];
+      
+      //tmp_bits = payload_bits((end-7) : end);
+      //Hop = num2str( bi2de(tmp_bits(1:5), 'right-msb') );
+      //SCA = num2str( bi2de(tmp_bits(6:end), 'right-msb') );
+      payload_type_5->Hop = (payload_byte[33]&0x1F);
+      payload_type_5->SCA = ((payload_byte[33]>>5)&0x07);
+  } else {
+      payload_type_R = (ADV_PDU_PAYLOAD_TYPE_R *)adv_pdu_payload;
+
+      for(i=0; i<(num_payload_byte); i++) {
+        payload_type_R->payload_byte[i] = payload_byte[i];
+      }
+      //printf("Warning: Reserved PDU type %d\n", pdu_type);
+      //return(-1);
+  }
+  
+  return(0);
+}
+
+void print_pdu_payload(void *adv_pdu_payload, int pdu_type, int payload_len, int crc_flag, int torn_flag, int ad_flag) {
+    int i;
+    ADV_PDU_PAYLOAD_TYPE_5 *adv_pdu_payload_5;
+    ADV_PDU_PAYLOAD_TYPE_1_3 *adv_pdu_payload_1_3;
+    ADV_PDU_PAYLOAD_TYPE_0_2_4_6 *adv_pdu_payload_0_2_4_6;
+    ADV_PDU_PAYLOAD_TYPE_R *adv_pdu_payload_R;
+    // print payload out
+    if (pdu_type==0 || pdu_type==2 || pdu_type==4 || pdu_type==6) {
+      adv_pdu_payload_0_2_4_6 = (ADV_PDU_PAYLOAD_TYPE_0_2_4_6 *)(adv_pdu_payload);
+      printf("AdvA:");
+      for(i=0; i<6; i++) {
+        printf("%02x", adv_pdu_payload_0_2_4_6->AdvA[i]);
+      }
+      printf(" Data:");
+      for(i=0; i<(payload_len-6); i++) {
+        printf("%02x", adv_pdu_payload_0_2_4_6->Data[i]);
+      }
+      if (ad_flag) {
+        print_adv_data(adv_pdu_payload_0_2_4_6->Data, payload_len-6);
+      }
+    } else if (pdu_type==1 || pdu_type==3) {
+      adv_pdu_payload_1_3 = (ADV_PDU_PAYLOAD_TYPE_1_3 *)(adv_pdu_payload);
+      printf("A0:");
+      for(i=0; i<6; i++) {
+        printf("%02x", adv_pdu_payload_1_3->A0[i]);
+      }
+      printf(" A1:");
+      for(i=0; i<6; i++) {
+        printf("%02x", adv_pdu_payload_1_3->A1[i]);
+      }
+    } else if (pdu_type==5) {
+      adv_pdu_payload_5 = (ADV_PDU_PAYLOAD_TYPE_5 *)(adv_pdu_payload);
+      printf("InitA:");
+      for(i=0; i<6; i++) {
+        printf("%02x", adv_pdu_payload_5->InitA[i]);
+      }
+      printf(" AdvA:");
+      for(i=0; i<6; i++) {
+        printf("%02x", adv_pdu_payload_5->AdvA[i]);
+      }
+      printf(" AA:");
+      for(i=0; i<4; i++) {
+        printf("%02x", adv_pdu_payload_5->AA[i]);
+      }
+      printf(" CRCInit:%06x WSize:%d WOffset:%d Interval:%d Latency:%d Timeout:%d", adv_pdu_payload_5->CRCInit, adv_pdu_payload_5->WinSize, adv_pdu_payload_5->WinOffset, adv_pdu_payload_5->Interval, adv_pdu_payload_5->Latency, adv_pdu_payload_5->Timeout);
+      printf(" ChM:");
+      for(i=0; i<5; i++) {
+        printf("%02x", adv_pdu_payload_5->ChM[i]);
+      }
+      printf(" Hop:%d SCA:%d", adv_pdu_payload_5->Hop, adv_pdu_payload_5->SCA);
+    } else {
+      adv_pdu_payload_R = (ADV_PDU_PAYLOAD_TYPE_R *)(adv_pdu_payload);
+      printf("Byte:");
+      for(i=0; i<(payload_len); i++) {
+        printf("%02x", adv_pdu_payload_R->payload_byte[i]);
+      }
+    }
+    printf(" CRC%d%s\n", crc_flag, torn_flag? " TORN" : "");
+}
+//----------------------------------PDU parsing----------------------------------
+
+static inline uint16_t get_u16_le(const uint8_t *p) {
+  return( (uint16_t)(p[0] | (p[1]<<8)) );
+}
+
+static inline uint16_t get_u16_be(const uint8_t *p) {
+  return( (uint16_t)((p[0]<<8) | p[1]) );
+}
+
+static inline uint32_t get_u32_le(const uint8_t *p) {
+  return( (uint32_t)p[0] | ((uint32_t)p[1]<<8) | ((uint32_t)p[2]<<16) | ((uint32_t)p[3]<<24) );
+}
+
+static inline uint32_t get_u32_be(const uint8_t *p) {
+  return( ((uint32_t)p[0]<<24) | ((uint32_t)p[1]<<16) | ((uint32_t)p[2]<<8) | p[3] );
+}
+
+//----------------------------------extended advertising----------------------------------
+char *PHY_STR[4] = {"1M", "2M", "Coded", "PHY3"};
+
+int parse_ext_adv(const uint8_t *payload_byte, int payload_len, EXT_ADV *x) {
+  const uint8_t *p, *end;
+  int ext_hdr_len;
+  uint16_t v;
+
+  memset(x, 0, sizeof(EXT_ADV));
+  x->cte_info = -1;
+  x->did = x->sid = -1;
+  x->aux_ptr.chan = -1;
+  x->tx_power = 127;
+  if (payload_len < 1) {
+    return(-1);
+  }
+  ext_hdr_len = (payload_byte[0]&0x3F);
+  x->adv_mode = (payload_byte[0]>>6);
+  if (1 + ext_hdr_len > payload_len) {
+    return(-1);
+  }
+  x->adv_data = payload_byte + 1 + ext_hdr_len;
+  x->adv_data_len = payload_len - 1 - ext_hdr_len;
+  if (ext_hdr_len == 0) {
+    return(0);
+  }
+
+  x->flags = payload_byte[1];
+  p = payload_byte + 2;
+  end = payload_byte + 1 + ext_hdr_len;
+  if (x->flags&EXT_HDR_ADVA) {
+    if (p + 6 > end) {
+      return(-1);
+    }
+    x->adv_a = p;
+    p = p + 6;
+  }
+  if (x->flags&EXT_HDR_TARGETA) {
+    if (p + 6 > end) {
+      return(-1);
+    }
+    x->target_a = p;
+    p = p + 6;
+  }
+  if (x->flags&EXT_HDR_CTEINFO) {
+    if (p + 1 > end) {
+      return(-1);
+    }
+    x->cte_info = p[0];
+    p = p + 1;
+  }
+  if (x->flags&EXT_HDR_ADI) {
+    if (p + 2 > end) {
+      return(-1);
+    }
+    v = get_u16_le(p);
+    x->did = (v&0x0FFF);
+    x->sid = (v>>12);
+    p = p + 2;
+  }
+  if (x->flags&EXT_HDR_AUXPTR) {
+    if (p + 3 > end) {
+      return(-1);
+    }
+    x->aux_ptr.chan = (p[0]&0x3F);
+    x->aux_ptr.ca = ( (p[0]>>6)&1 );
+    x->aux_ptr.offset_unit_us = ( (p[0]&0x80)? 300 : 30 );
+    v = get_u16_le(p+1);
+    x->aux_ptr.offset_us = (uint32_t)(v&0x1FFF)*x->aux_ptr.offset_unit_us;
+    x->aux_ptr.phy = (v>>13)&0x03;
+    p = p + 3;
+  }
+  if (x->flags&EXT_HDR_SYNCINFO) {
+    if (p + SYNC_INFO_LEN > end) {
+      return(-1);
+    }
+    v = get_u16_le(p);
+    x->sync_info.offset_unit_us = ( (v&0x2000)? 300 : 30 );
+    x->sync_info.offset_us = (uint32_t)(v&0x1FFF)*x->sync_info.offset_unit_us + ( (v&0x4000)? SYNC_OFFSET_ADJUST_US : 0 );
+    x->sync_info.interval = get_u16_le(p+2);
+    x->sync_info.chan_map = (uint64_t)p[4] | ((uint64_t)p[5]<<8) | ((uint64_t)p[6]<<16) | ((uint64_t)p[7]<<24) | ((uint64_t)(p[8]&0x1F)<<32);
+    x->sync_info.sca = (p[8]>>5);
+    x->sync_info.access_addr = (uint32_t)p[9] | ((uint32_t)p[10]<<8) | ((uint32_t)p[11]<<16) | ((uint32_t)p[12]<<24);
+    x->sync_info.crc_init = ((uint32_t)p[13]<<16) | ((uint32_t)p[14]<<8) | p[15]; // as CONNECT_REQ
+    x->sync_info.pa_event_counter = get_u16_le(p+16);
+    p = p + SYNC_INFO_LEN;
+  }
+  if (x->flags&EXT_HDR_TXPOWER) {
+    if (p + 1 > end) {
+      return(-1);
+    }
+    x->tx_power = (int8_t)p[0];
+    p = p + 1;
+  }
+  x->acad = p;
+  x->acad_len = (int)(end - p);
+  return(0);
+}
+
+int parse_big_info(const uint8_t *acad, int acad_len, BIG_INFO *b) {
+  AD_ITER it;
+  AD_FIELD f;
+  const uint8_t *p;
+  uint32_t v;
+
+  ad_iter_init(&it, acad, acad_len);
+  while (ad_iter_next(&it, &f) == 1) {
+    if ( f.type != AD_BIGINFO || (f.len != BIG_INFO_LEN && f.len != BIG_INFO_LEN+24) ) {
+      continue;
+    }
+    p = f.data;
+    v = get_u32_le(p);
+    b->offset_unit_us = ( (v&0x4000)? 300 : 30 );
+    b->offset_us = (v&0x3FFF)*b->offset_unit_us;
+    b->iso_interval = (v>>15)&0xFFF;
+    b->num_bis = (v>>27);
+    v = get_u32_le(p+4);
+    b->nse = (v&0x1F);
+    b->bn = (v>>5)&0x07;
+    b->sub_interval_us = (v>>8)&0xFFFFF;
+    b->pto = (v>>28);
+    v = get_u32_le(p+8);
+    b->bis_spacing_us = (v&0xFFFFF);
+    b->irc = (v>>20)&0x0F;
+    b->max_pdu = (v>>24);
+    b->seed_access_addr = get_u32_le(p+13);
+    v = get_u32_le(p+17);
+    b->sdu_interval_us = (v&0xFFFFF);
+    b->max_sdu = (v>>20);
+    b->base_crc_init = get_u16_le(p+21);
+    b->chan_map = (uint64_t)get_u32_le(p+23) | ((uint64_t)(p[27]&0x1F)<<32);
+    b->phy = (p[27]>>5);
+    b->payload_count = (uint64_t)get_u32_le(p+28) | ((uint64_t)(p[32]&0x7F)<<32);
+    b->framing = (p[32]>>7);
+    b->encrypted = (f.len != BIG_INFO_LEN);
+    return(0);
+  }
+  return(-1);
+}
+
+void addr_str(const uint8_t *addr, char *out) {
+  int i;
+  for (i=0; i<6; i++) {
+    sprintf(out+2*i, "%02x", addr[5-i]);
+  }
+}
+
+static void print_hex(const uint8_t *p, int len) {
+  int i;
+  for (i=0; i<len; i++) {
+    printf("%02x", p[i]);
+  }
+}
+
+void print_ext_adv(const uint8_t *payload_byte, int payload_len, int crc_flag, int torn_flag, int ad_flag) {
+  EXT_ADV x;
+  BIG_INFO b;
+  char addr[13];
+
+  if ( parse_ext_adv(payload_byte, payload_len, &x) != 0 ) {
+    printf("Byte:");
+    print_hex(payload_byte, payload_len);
+    printf(" ExtHdr:malformed CRC%d%s\n", crc_flag, torn_flag? " TORN" : "");
+    return;
+  }
+  printf("Mode%d", x.adv_mode);
+  if (x.adv_a != NULL) {
+    addr_str(x.adv_a, addr);
+    printf(" AdvA:%s", addr);
+  }
+  if (x.target_a != NULL) {
+    addr_str(x.target_a, addr);
+    printf(" TargetA:%s", addr);
+  }
+  if (x.cte_info >= 0) {
+    printf(" CTEInfo:%02x", x.cte_info);
+  }
+  if (x.did >= 0) {
+    printf(" ADI:%03x/%x", x.did, x.sid);
+  }
+  if (x.aux_ptr.chan >= 0) {
+    printf(" AuxPtr:ch%d,%s,+%uus", x.aux_ptr.chan, PHY_STR[x.aux_ptr.phy], x.aux_ptr.offset_us);
+  }
+  if (x.flags&EXT_HDR_SYNCINFO) {
+    printf(" SyncInfo:AA=%08X,CRCInit=%06x,Interval=%d,ChM=%010llx,Event=%u,+%uus", x.sync_info.access_addr, x.sync_info.crc_init, x.sync_info.interval,
+      (unsigned long long)x.sync_info.chan_map, x.sync_info.pa_event_counter, x.sync_info.offset_us);
+  }
+  if (x.tx_power != 127) {
+    printf(" TxPower:%d", x.tx_power);
+  }
+  if ( x.acad_len > 0 && parse_big_info(x.acad, x.acad_len, &b) == 0 ) {
+    printf(" BIGInfo:ISO=%d,BIS=%d,NSE=%d,BN=%d,IRC=%d,PTO=%d,SubInt=%uus,Spacing=%uus,PDU=%d,SAA=%08X,CRC=%04x,ChM=%010llx,%s,Payload=%llu,+%uus%s",
+      b.iso_interval, b.num_bis, b.nse, b.bn, b.irc, b.pto, b.sub_interval_us, b.bis_spacing_us, b.max_pdu, b.seed_access_addr, b.base_crc_init,
+      (unsigned long long)b.chan_map, PHY_STR[b.phy&3], (unsigned long long)b.payload_count, b.offset_us, b.encrypted? ",Enc" : "");
+  } else if (x.acad_len > 0) {
+    printf(" ACAD:");
+    print_hex(x.acad, x.acad_len);
+  }
+  printf(" Data:");
+  print_hex(x.adv_data, x.adv_data_len);
+  if (ad_flag) {
+    print_adv_data(x.adv_data, x.adv_data_len);
+  }
+  printf(" CRC%d%s\n", crc_flag, torn_flag? " TORN" : "");
+}
+//----------------------------------extended advertising----------------------------------
+
+//----------------------------------isochronous PDUs----------------------------------
+char *ISO_LLID_STR[4] = {"UNFRAMED", "UNFRAMED_CONT", "FRAMED", "RFU"};
+
+void print_bis_pdu(const uint8_t *byte, int crc_flag, int torn_flag) {
+  int llid = (byte[0]&0x03), payload_len = byte[1];
+
+  printf("LLID%d:%s CSSN%d CSTF%d PloadL%d ", llid, ISO_LLID_STR[llid], (byte[0]>>2)&0x07, (byte[0]>>5)&1, payload_len);
+  if (payload_len == 0) {
+    printf("Empty");
+  } else {
+    printf("Data:");
+    print_hex(byte+2, payload_len);
+  }
+  printf(" CRC%d%s\n", crc_flag, torn_flag? " TORN" : "");
+}
+//----------------------------------isochronous PDUs----------------------------------
+
+//----------------------------------AD structures----------------------------------
+char *AD_BEACON_STR[NUM_AD_BEACON] = {
+    "",
+    "iBeacon",
+    "EddystoneUID",
+    "EddystoneURL",
+    "EddystoneTLM",
+    "EddystoneEID"
+};
+
+static const char *EDDYSTONE_URL_SCHEME[4] = {"http://www.", "https://www.", "http://", "https://"};
+static const char *EDDYSTONE_URL_CODE[14] = {".com/", ".org/", ".edu/", ".net/", ".info/", ".biz/", ".gov/",
+                                             ".com", ".org", ".edu", ".net", ".info", ".biz", ".gov"};
+
+void ad_iter_init(AD_ITER *it, const uint8_t *adv_data, int len) {
+  it->p = adv_data;
+  it->end = adv_data + (len > 0? len : 0);
+}
+
+int ad_iter_next(AD_ITER *it, AD_FIELD *f) {
+  int len;
+
+  // a zero length octet starts the padding up to the end of the PDU
+  if ( it->p >= it->end || it->p[0] == 0 ) {
+    return(0);
+  }
+  len = it->p[0];
+  if ( it->p + 1 + len > it->end ) {
+    it->p = it->end;
+    return(-1);
+  }
+  f->type = it->p[1];
+  f->data = it->p + 2;
+  f->len = len - 1;
+  it->p = it->p + 1 + len;
+  return(1);
+}
+
+int ad_uuid_list(const AD_FIELD *f, int *uuid_len) {
+  switch (f->type) {
+    case AD_UUID16_MORE: case AD_UUID16: case AD_SOLICIT16:
+      (*uuid_len) = 2;
+      break;
+    case AD_UUID32_MORE: case AD_UUID32:
+      (*uuid_len) = 4;
+      break;
+    case AD_UUID128_MORE: case AD_UUID128: case AD_SOLICIT128:
+      (*uuid_len) = 16;
+      break;
+    default:
+      (*uuid_len) = 0;
+      return(0);
+  }
+  return( f->len/(*uuid_len) );
+}
+
+int ad_service_data_uuid_len(const AD_FIELD *f) {
+  int len = ( f->type == AD_SERVICE_DATA16? 2 : (f->type == AD_SERVICE_DATA32? 4 : (f->type == AD_SERVICE_DATA128? 16 : 0)) );
+  return( f->len >= len? len : 0 );
+}
+
+int ad_append(uint8_t *adv_data, int len, int max_len, int type, const uint8_t *data, int data_len) {
+  if (len+2+data_len > max_len) {
+    return(-1);
+  }
+  adv_data[len] = data_len+1;
+  adv_data[len+1] = type;
+  memcpy(adv_data+len+2, data, data_len);
+  return(len+2+data_len);
+}
+
+int ad_append_ibeacon(uint8_t *adv_data, int len, int max_len, const uint8_t *uuid, uint16_t major, uint16_t minor, int tx_power) {
+  uint8_t d[25];
+
+  d[0] = COMPANY_ID_APPLE & 0xFF;
+  d[1] = COMPANY_ID_APPLE >> 8;
+  d[2] = 0x02;
+  d[3] = 0x15;
+  memcpy(d+4, uuid, 16);
+  d[20] = major >> 8;
+  d[21] = major & 0xFF;
+  d[22] = minor >> 8;
+  d[23] = minor & 0xFF;
+  d[24] = (uint8_t)tx_power;
+  return( ad_append(adv_data, len, max_len, AD_MANUF_DATA, d, 25) );
+}
+
+AD_BEACON_TYPE ad_beacon(const AD_FIELD *f, AD_BEACON *b) {
+  const uint8_t *d = f->data;
+
+  memset(b, 0, sizeof(AD_BEACON));
+  if ( f->type == AD_MANUF_DATA && f->len >= 25 && get_u16_le(d) == COMPANY_ID_APPLE && d[2] == 0x02 && d[3] == 0x15 ) {
+    b->type = AD_BEACON_IBEACON;
+    b->id = d + 4;
+    b->len_id = 16;
+    b->major = get_u16_be(d+20);
+    b->minor = get_u16_be(d+22);
+    b->tx_power = (int8_t)d[24];
+    return(b->type);
+  }
+  if ( f->type != AD_SERVICE_DATA16 || f->len < 4 || get_u16_le(d) != UUID16_EDDYSTONE ) {
+    return(AD_BEACON_NONE);
+  }
+  d = d + 2; // frame type
+  if ( d[0] == 0x00 && f->len >= 2+18 ) {
+    b->type = AD_BEACON_EDDYSTONE_UID;
+    b->tx_power = (int8_t)d[1];
+    b->id = d + 2;
+    b->len_id = 16;
+  } else if ( d[0] == 0x10 && f->len >= 2+3 ) {
+    b->type = AD_BEACON_EDDYSTONE_URL;
+    b->tx_power = (int8_t)d[1];
+    b->url = d + 2;
+    b->len_url = f->len - 2 - 2;
+  } else if ( d[0] == 0x20 && d[1] == 0x00 && f->len >= 2+14 ) {
+    b->type = AD_BEACON_EDDYSTONE_TLM;
+    b->vbatt_mv = get_u16_be(d+2);
+    b->temp_c = (int16_t)get_u16_be(d+4)/256.0f;
+    b->adv_cnt = get_u32_be(d+6);
+    b->sec_cnt = get_u32_be(d+10);
+  } else if ( d[0] == 0x30 && f->len >= 2+10 ) {
+    b->type = AD_BEACON_EDDYSTONE_EID;
+    b->tx_power = (int8_t)d[1];
+    b->id = d + 2;
+    b->len_id = 8;
+  }
+  return(b->type);
+}
+
+int ad_eddystone_url(const AD_BEACON *b, char *out, int len_out) {
+  const char *part;
+  int i, n = 0, len;
+
+  if ( b->type != AD_BEACON_EDDYSTONE_URL || len_out < 1 ) {
+    return(0);
+  }
+  // url[0] is the scheme, every other octet below 14 an expansion
+  for (i=0; i<b->len_url; i++) {
+    if (i == 0) {
+      part = ( b->url[0] < 4? EDDYSTONE_URL_SCHEME[b->url[0]] : "" );
+      len = (int)strlen(part);
+    } else if (b->url[i] < 14) {
+      part = EDDYSTONE_URL_CODE[b->url[i]];
+      len = (int)strlen(part);
+    } else {
+      part = (const char *)(b->url + i);
+      len = 1;
+    }
+    if (n + len >= len_out) {
+      break;
+    }
+    memcpy(out+n, part, len);
+    n = n + len;
+  }
+  out[n] = 0;
+  return(n);
+}
+
+const char* company_id_str(uint16_t company_id) {
+  switch (company_id) {
+    case COMPANY_ID_APPLE:
+      return("Apple");
+    case COMPANY_ID_MICROSOFT:
+      return("Microsoft");
+    default:
+      return(NULL);
+  }
+}
+
+// UUIDs are little endian on air. 16 octets in the usual 8-4-4-4-12 form
+static void print_uuid(const uint8_t *p, int len) {
+  int i;
+  for (i=len-1; i>=0; i--) {
+    printf("%02x", p[i]);
+    if ( len == 16 && (i == 12 || i == 10 || i == 8 || i == 6) ) {
+      printf("-");
+    }
+  }
+}
+
+// iBeacon proximity UUIDs are big endian
+static void print_uuid_be(const uint8_t *p) {
+  int i;
+  for (i=0; i<16; i++) {
+    printf("%02x", p[i]);
+    if (i == 3 || i == 5 || i == 7 || i == 9) {
+      printf("-");
+    }
+  }
+}
+
+static void print_name(const uint8_t *p, int len) {
+  int i;
+  printf("\"");
+  for (i=0; i<len; i++) {
+    if ( p[i] >= 0x20 && p[i] < 0x7F && p[i] != '"' && p[i] != '\\' ) {
+      printf("%c", p[i]);
+    } else {
+      printf("\\x%02x", p[i]);
+    }
+  }
+  printf("\"");
+}
+
+static void print_beacon(AD_BEACON *b) {
+  char url[128];
+
+  printf(" %s:", AD_BEACON_STR[b->type]);
+  switch (b->type) {
+    case AD_BEACON_IBEACON:
+      print_uuid_be(b->id);
+      printf(",major=%d,minor=%d,tx=%d", b->major, b->minor, b->tx_power);
+      break;
+    case AD_BEACON_EDDYSTONE_UID:
+      print_hex(b->id, 10);
+      printf("/");
+      print_hex(b->id+10, 6);
+      printf(",tx=%d", b->tx_power);
+      break;
+    case AD_BEACON_EDDYSTONE_URL:
+      ad_eddystone_url(b, url, sizeof(url));
+      printf("%s,tx=%d", url, b->tx_power);
+      break;
+    case AD_BEACON_EDDYSTONE_TLM:
+      printf("batt=%dmV,temp=%.2fC,adv=%u,sec=%.1f", b->vbatt_mv, b->temp_c, b->adv_cnt, b->sec_cnt/10.0);
+      break;
+    default:
+      print_hex(b->id, b->len_id);
+      printf(",tx=%d", b->tx_power);
+      break;
+  }
+}
+
+void print_adv_data(const uint8_t *adv_data, int len) {
+  AD_ITER it;
+  AD_FIELD f;
+  AD_BEACON b;
+  const char *company;
+  int i, num, uuid_len, ret;
+
+  ad_iter_init(&it, adv_data, len);
+  while ( (ret = ad_iter_next(&it, &f)) == 1 ) {
+    if ( ad_beacon(&f, &b) != AD_BEACON_NONE ) {
+      print_beacon(&b);
+      continue;
+    }
+    num = ad_uuid_list(&f, &uuid_len);
+    if (uuid_len != 0) {
+      printf(" %s%d:", ( f.type == AD_SOLICIT16 || f.type == AD_SOLICIT128? "Solicit" : "UUID" ), uuid_len*8);
+      for (i=0; i<num; i++) {
+        printf("%s", (i? "," : ""));
+        print_uuid(f.data + i*uuid_len, uuid_len);
+      }
+      if ( f.type == AD_UUID16_MORE || f.type == AD_UUID32_MORE || f.type == AD_UUID128_MORE ) {
+        printf("%s...", (num? "," : ""));
+      }
+      continue;
+    }
+    uuid_len = ad_service_data_uuid_len(&f);
+    if (uuid_len != 0) {
+      printf(" SvcData%d:", uuid_len*8);
+      print_uuid(f.data, uuid_len);
+      printf("=");
+      print_hex(f.data + uuid_len, f.len - uuid_len);
+      continue;
+    }
+    if (f.type == AD_FLAGS) {
+      printf(" Flags:");
+      print_hex(f.data, f.len);
+    } else if (f.type == AD_NAME || f.type == AD_SHORT_NAME) {
+      printf(" %s:", (f.type == AD_NAME? "Name" : "ShortName"));
+      print_name(f.data, f.len);
+    } else if (f.type == AD_TX_POWER && f.len == 1) {
+      printf(" TxPower:%d", (int8_t)f.data[0]);
+    } else if (f.type == AD_CONN_INTERVAL && f.len == 4) {
+      printf(" ConnInterval:%.2f-%.2fms", get_u16_le(f.data)*1.25, get_u16_le(f.data+2)*1.25);
+    } else if (f.type == AD_MANUF_DATA && f.len >= 2) {
+      company = company_id_str(get_u16_le(f.data));
+      printf(" Manuf:%04x%s%s%s=", get_u16_le(f.data), (company? "(" : ""), (company? company : ""), (company? ")" : ""));
+      print_hex(f.data+2, f.len-2);
+    } else { // unknown, or too short for its type
+      printf(" AD%02x:", f.type);
+      print_hex(f.data, f.len);
+    }
+  }
+  if (ret < 0) {
+    printf(" AD:malformed");
+  }
+}
+//----------------------------------AD structures----------------------------------
+
+//----------------------------------data channel PDUs----------------------------------
+char *LLID_STR[4] = {
+    "RESERVED",
+    "LL_DATA_CONT",
+    "LL_DATA_START",
+    "LL_CTRL"
+};
+
+// CtrData after the opcode octet, Bluetooth Core v5.0 Vol 6 Part B 2.4.2
+const LL_CTRL_PDU LL_CTRL_PDU_TABLE[NUM_LL_CTRL_OPCODE] = {
+    {"LL_CONNECTION_UPDATE_REQ", 6, {{"WinSize", 1, LL_FIELD_DEC}, {"WinOffset", 2, LL_FIELD_DEC}, {"Interval", 2, LL_FIELD_DEC},
+                                     {"Latency", 2, LL_FIELD_DEC}, {"Timeout", 2, LL_FIELD_DEC}, {"Instant", 2, LL_FIELD_DEC}}},
+    {"LL_CHANNEL_MAP_REQ", 2, {{"ChM", 5, LL_FIELD_HEX}, {"Instant", 2, LL_FIELD_DEC}}},
+    {"LL_TERMINATE_IND", 1, {{"ErrorCode", 1, LL_FIELD_HEX}}},
+    {"LL_ENC_REQ", 4, {{"Rand", 8, LL_FIELD_HEX}, {"EDIV", 2, LL_FIELD_HEX}, {"SKDm", 8, LL_FIELD_BYTE}, {"IVm", 4, LL_FIELD_BYTE}}},
+    {"LL_ENC_RSP", 2, {{"SKDs", 8, LL_FIELD_BYTE}, {"IVs", 4, LL_FIELD_BYTE}}},
+    {"LL_START_ENC_REQ", 0, {{NULL, 0, LL_FIELD_DEC}}},
+    {"LL_START_ENC_RSP", 0, {{NULL, 0, LL_FIELD_DEC}}},
+    {"LL_UNKNOWN_RSP", 1, {{"UnknownType", 1, LL_FIELD_HEX}}},
+    {"LL_FEATURE_REQ", 1, {{"FeatureSet", 8, LL_FIELD_HEX}}},
+    {"LL_FEATURE_RSP", 1, {{"FeatureSet", 8, LL_FIELD_HEX}}},
+    {"LL_PAUSE_ENC_REQ", 0, {{NULL, 0, LL_FIELD_DEC}}},
+    {"LL_PAUSE_ENC_RSP", 0, {{NULL, 0, LL_FIELD_DEC}}},
+    {"LL_VERSION_IND", 3, {{"VersNr", 1, LL_FIELD_HEX}, {"CompId", 2, LL_FIELD_HEX}, {"SubVersNr", 2, LL_FIELD_HEX}}},
+    {"LL_REJECT_IND", 1, {{"ErrorCode", 1, LL_FIELD_HEX}}},
+    {"LL_SLAVE_FEATURE_REQ", 1, {{"FeatureSet", 8, LL_FIELD_HEX}}},
+    {"LL_CONNECTION_PARAM_REQ", 12, {{"IntervalMin", 2, LL_FIELD_DEC}, {"IntervalMax", 2, LL_FIELD_DEC}, {"Latency", 2, LL_FIELD_DEC},
+                                     {"Timeout", 2, LL_FIELD_DEC}, {"Periodicity", 1, LL_FIELD_DEC}, {"RefConnEventCount", 2, LL_FIELD_DEC},
+                                     {"Offset0", 2, LL_FIELD_DEC}, {"Offset1", 2, LL_FIELD_DEC}, {"Offset2", 2, LL_FIELD_DEC},
+                                     {"Offset3", 2, LL_FIELD_DEC}, {"Offset4", 2, LL_FIELD_DEC}, {"Offset5", 2, LL_FIELD_DEC}}},
+    {"LL_CONNECTION_PARAM_RSP", 12, {{"IntervalMin", 2, LL_FIELD_DEC}, {"IntervalMax", 2, LL_FIELD_DEC}, {"Latency", 2, LL_FIELD_DEC},
+                                     {"Timeout", 2, LL_FIELD_DEC}, {"Periodicity", 1, LL_FIELD_DEC}, {"RefConnEventCount", 2, LL_FIELD_DEC},
+                                     {"Offset0", 2, LL_FIELD_DEC}, {"Offset1", 2, LL_FIELD_DEC}, {"Offset2", 2, LL_FIELD_DEC},
+                                     {"Offset3", 2, LL_FIELD_DEC}, {"Offset4", 2, LL_FIELD_DEC}, {"Offset5", 2, LL_FIELD_DEC}}},
+    {"LL_REJECT_EXT_IND", 2, {{"RejectOpcode", 1, LL_FIELD_HEX}, {"ErrorCode", 1, LL_FIELD_HEX}}},
+    {"LL_PING_REQ", 0, {{NULL, 0, LL_FIELD_DEC}}},
+    {"LL_PING_RSP", 0, {{NULL, 0, LL_FIELD_DEC}}},
+    {"LL_LENGTH_REQ", 4, {{"MaxRxOctets", 2, LL_FIELD_DEC}, {"MaxRxTime", 2, LL_FIELD_DEC}, {"MaxTxOctets", 2, LL_FIELD_DEC}, {"MaxTxTime", 2, LL_FIELD_DEC}}},
+    {"LL_LENGTH_RSP", 4, {{"MaxRxOctets", 2, LL_FIELD_DEC}, {"MaxRxTime", 2, LL_FIELD_DEC}, {"MaxTxOctets", 2, LL_FIELD_DEC}, {"MaxTxTime", 2, LL_FIELD_DEC}}},
+    {"LL_PHY_REQ", 2, {{"TxPhys", 1, LL_FIELD_HEX}, {"RxPhys", 1, LL_FIELD_HEX}}},
+    {"LL_PHY_RSP", 2, {{"TxPhys", 1, LL_FIELD_HEX}, {"RxPhys", 1, LL_FIELD_HEX}}},
+    {"LL_PHY_UPDATE_IND", 3, {{"MToSPhy", 1, LL_FIELD_HEX}, {"SToMPhy", 1, LL_FIELD_HEX}, {"Instant", 2, LL_FIELD_DEC}}},
+    {"LL_MIN_USED_CHANNELS_IND", 2, {{"Phys", 1, LL_FIELD_HEX}, {"MinUsedChannels", 1, LL_FIELD_DEC}}}
+};
+
+int ll_ctrl_data_len(int opcode) {
+  const LL_CTRL_PDU *pdu;
+  int i, len = 0;
+
+  if (opcode < 0 || opcode >= NUM_LL_CTRL_OPCODE) {
+    return(-1);
+  }
+  pdu = LL_CTRL_PDU_TABLE + opcode;
+  for (i=0; i<pdu->num_field; i++) {
+    len = len + pdu->field[i].len;
+  }
+  return(len);
+}
+
+int ll_ctrl_opcode(const char *name) {
+  int i;
+
+  for (i=0; i<NUM_LL_CTRL_OPCODE; i++) {
+    if (strcmp(LL_CTRL_PDU_TABLE[i].name, name) == 0) {
+      return(i);
+    }
+  }
+  return(-1);
+}
+
+int l2cap_header(const uint8_t *payload_byte, int payload_len, int *l2cap_len, int *cid) {
+  if (payload_len < 4) {
+    return(-1);
+  }
+  (*l2cap_len) = get_u16_le(payload_byte);
+  (*cid) = get_u16_le(payload_byte+2);
+  return(0);
+}
+
+const char* l2cap_cid_str(int cid) {
+  if (cid == L2CAP_CID_ATT) {
+    return("ATT");
+  } else if (cid == L2CAP_CID_LE_SIG) {
+    return("LE_SIG");
+  } else if (cid == L2CAP_CID_SMP) {
+    return("SMP");
+  }
+  return(NULL);
+}
+
+static void print_ll_field(const LL_CTRL_FIELD *f, const uint8_t *p) {
+  int i;
+
+  printf(" %s:", f->name);
+  if (f->format == LL_FIELD_DEC) {
+    printf("%d", (f->len == 1? p[0] : get_u16_le(p)));
+  } else if (f->format == LL_FIELD_HEX) {
+    for (i=f->len-1; i>=0; i--) {
+      printf("%02x", p[i]);
+    }
+  } else {
+    print_hex(p, f->len);
+  }
+}
+
+void print_data_pdu_payload(const uint8_t *payload_byte, int llid, int payload_len, int crc_flag, int torn_flag) {
+  const LL_CTRL_PDU *pdu;
+  const char *cid_str;
+  int opcode, i, offset, l2cap_len, cid;
+
+  if (llid == LLID_CTRL && payload_len > 0) {
+    opcode = payload_byte[0];
+    if ( ll_ctrl_data_len(opcode) < 0 || ll_ctrl_data_len(opcode) > payload_len-1 ) {
+      printf("LL_CTRL_%02x CtrData:", opcode);
+      print_hex(payload_byte+1, payload_len-1);
+    } else {
+      pdu = LL_CTRL_PDU_TABLE + opcode;
+      printf("%s", pdu->name);
+      offset = 1;
+      for (i=0; i<pdu->num_field; i++) {
+        print_ll_field(pdu->field+i, payload_byte+offset);
+        offset = offset + pdu->field[i].len;
+      }
+      if (offset < payload_len) { // longer in a later spec version
+        printf(" More:");
+        print_hex(payload_byte+offset, payload_len-offset);
+      }
+    }
+  } else if (llid == LLID_DATA_START && l2cap_header(payload_byte, payload_len, &l2cap_len, &cid) == 0) {
+    cid_str = l2cap_cid_str(cid);
+    printf("L2CAP:len=%d,cid=%04x%s%s%s Data:", l2cap_len, cid, (cid_str? "(" : ""), (cid_str? cid_str : ""), (cid_str? ")" : ""));
+    print_hex(payload_byte+4, payload_len-4);
+  } else if (payload_len == 0) {
+    printf("Empty");
+  } else {
+    printf("Data:");
+    print_hex(payload_byte, payload_len);
+  }
+  printf(" CRC%d%s\n", crc_flag, torn_flag? " TORN" : "");
+}
+//----------------------------------data channel PDUs----------------------------------
@@ -0,0 +1,316 @@
+// BTLE link layer PDU helpers shared by the btle tools
+//
+// Channel to frequency mapping, building of advertising and data channel PDUs, advertising
+// channel payload parsing, the extended advertising payload of BLE 5, and the decoder of data
+// channel PDUs.
+
+#ifndef BTLE_PDU_H
+#define BTLE_PDU_H
+
+#include <stdint.h>
+
+#define MAX_CHANNEL_NUMBER 39
+
+extern char *PDU_TYPE_STR[16];
+
+typedef struct {
+  uint8_t AdvA[6];
+  uint8_t Data[31];
+} ADV_PDU_PAYLOAD_TYPE_0_2_4_6;
+
+typedef struct {
+  uint8_t A0[6];
+  uint8_t A1[6];
+} ADV_PDU_PAYLOAD_TYPE_1_3;
+
+typedef struct {
+  uint8_t InitA[6];
+  uint8_t AdvA[6];
+  uint8_t AA[4];
+  uint32_t CRCInit;
+  uint8_t WinSize;
+  uint16_t WinOffset;
+  uint16_t Interval;
+  uint16_t Latency;
+  uint16_t Timeout;
+  uint8_t ChM[5];
+  uint8_t Hop;
+  uint8_t SCA;
+} ADV_PDU_PAYLOAD_TYPE_5;
+
+typedef struct {
+  uint8_t payload_byte[37];
+} ADV_PDU_PAYLOAD_TYPE_R;
+
+// ADV_PDU_PAYLOAD_TYPE_5 is the largest, use it as storage for any of them
+typedef ADV_PDU_PAYLOAD_TYPE_5 ADV_PDU_PAYLOAD;
+
+// 0xffffffffffffffff for an invalid channel number
+uint64_t get_freq_by_channel_number(int channel_number);
+
+// pdu_type 0~6 (ADV_IND ~ ADV_SCAN_IND), anything else is written as reserved type 0xF
+void fill_adv_pdu_header_byte(int pdu_type, int txadd, int rxadd, int payload_len, uint8_t *byte_out);
+// LLID, NESN, SN, MD and the length of a data channel PDU, see parse_data_pdu_header_byte
+void fill_data_pdu_header_byte(int llid, int nesn, int sn, int md, int payload_len, uint8_t *byte_out);
+
+// The builders write a PDU, header then payload, as gen_phy_byte() takes it, and return its
+// length: 2+payload_len
+int build_adv_pdu(int pdu_type, int txadd, int rxadd, const uint8_t *payload, int payload_len, uint8_t *pdu);
+int build_data_pdu(int llid, int nesn, int sn, int md, const uint8_t *payload, int payload_len, uint8_t *pdu);
+// the 34 octet CONNECT_REQ payload of p, filled as parse_adv_pdu_payload_byte fills it. returns 34
+int build_connect_req_payload(const ADV_PDU_PAYLOAD_TYPE_5 *p, uint8_t *payload_byte);
+
+// payload_byte: de-whitened payload after the 2 header octets. adv_pdu_payload: see ADV_PDU_PAYLOAD
+int parse_adv_pdu_payload_byte(uint8_t *payload_byte, int num_payload_byte, int pdu_type, void *adv_pdu_payload);
+// ad_flag: AdvData of ADV_IND, ADV_NONCONN_IND, SCAN_RSP and ADV_SCAN_IND is also printed
+// decoded, AD structure by AD structure, see print_adv_data
+void print_pdu_payload(void *adv_pdu_payload, int pdu_type, int payload_len, int crc_flag, int torn_flag, int ad_flag);
+
+//----------------------------------AD structures----------------------------------
+// AdvData is a sequence of length-type-value AD structures. The iterator and the decoders
+// below only point into the payload, nothing is copied or allocated.
+
+// AD types, the ones btle_tx encodes (AD_TYPE_VAL) and a few more
+#define AD_FLAGS            0x01
+#define AD_UUID16_MORE      0x02  // incomplete list
+#define AD_UUID16           0x03
+#define AD_UUID32_MORE      0x04
+#define AD_UUID32           0x05
+#define AD_UUID128_MORE     0x06
+#define AD_UUID128          0x07
+#define AD_SHORT_NAME       0x08
+#define AD_NAME             0x09
+#define AD_TX_POWER         0x0A
+#define AD_CONN_INTERVAL    0x12
+#define AD_SOLICIT16        0x14
+#define AD_SOLICIT128       0x15
+#define AD_SERVICE_DATA16   0x16
+#define AD_SERVICE_DATA32   0x20
+#define AD_SERVICE_DATA128  0x21
+#define AD_MANUF_DATA       0xFF
+
+#define COMPANY_ID_MICROSOFT 0x0006
+#define COMPANY_ID_APPLE     0x004C
+#define UUID16_EDDYSTONE     0xFEAA
+
+typedef struct {
+  const uint8_t *p;
+  const uint8_t *end;
+} AD_ITER;
+
+typedef struct {
+  int type;
+  const uint8_t *data;    // after the type octet, inside the payload
+  int len;
+} AD_FIELD;
+
+typedef enum {
+  AD_BEACON_NONE,
+  AD_BEACON_IBEACON,
+  AD_BEACON_EDDYSTONE_UID,
+  AD_BEACON_EDDYSTONE_URL,
+  AD_BEACON_EDDYSTONE_TLM,
+  AD_BEACON_EDDYSTONE_EID,
+  NUM_AD_BEACON
+} AD_BEACON_TYPE;
+
+extern char *AD_BEACON_STR[NUM_AD_BEACON];
+
+typedef struct {
+  AD_BEACON_TYPE type;
+  int tx_power;           // dBm at 1m (iBeacon) or 0m (Eddystone UID/URL/EID)
+  const uint8_t *id;      // iBeacon proximity UUID (16), Eddystone namespace+instance (10+6) or EID (8)
+  int len_id;
+  uint16_t major, minor;  // iBeacon
+  const uint8_t *url;     // Eddystone URL: scheme code, then encoded URL. see ad_eddystone_url
+  int len_url;
+  uint16_t vbatt_mv;      // Eddystone TLM, unencrypted
+  float temp_c;
+  uint32_t adv_cnt, sec_cnt;
+} AD_BEACON;
+
+void ad_iter_init(AD_ITER *it, const uint8_t *adv_data, int len);
+// 1: *f is the next AD structure. 0: no more. -1: a length runs past the end, iteration stops
+int ad_iter_next(AD_ITER *it, AD_FIELD *f);
+
+// number of UUIDs in a UUID list or solicitation field, *uuid_len their octets (2, 4 or 16)
+int ad_uuid_list(const AD_FIELD *f, int *uuid_len);
+// service data: UUID octets (2, 4, 16) in front of the data. 0: not service data
+int ad_service_data_uuid_len(const AD_FIELD *f);
+// iBeacon in manufacturer data or Eddystone in service data. AD_BEACON_NONE: neither
+AD_BEACON_TYPE ad_beacon(const AD_FIELD *f, AD_BEACON *b);
+// expands scheme and TLD codes into out (NUL terminated). returns the length written
+int ad_eddystone_url(const AD_BEACON *b, char *out, int len_out);
+// appends an AD structure of data_len octets to the len octets of adv_data. returns the new
+// length, -1 if it does not fit in max_len
+int ad_append(uint8_t *adv_data, int len, int max_len, int type, const uint8_t *data, int data_len);
+// appends the iBeacon manufacturer data, as ad_beacon decodes it. uuid: 16 octets
+int ad_append_ibeacon(uint8_t *adv_data, int len, int max_len, const uint8_t *uuid, uint16_t major, uint16_t minor, int tx_power);
+// "Apple", "Microsoft", or NULL
+const char* company_id_str(uint16_t company_id);
+
+// prints AdvData as " Flags:06 Name:"..." UUID16:180f,..." etc., see README
+void print_adv_data(const uint8_t *adv_data, int len);
+//----------------------------------AD structures----------------------------------
+
+//----------------------------------extended advertising----------------------------------
+// ADV_EXT_IND, AUX_ADV_IND, AUX_SYNC_IND etc. (PDU type 7) share one payload format: extended
+// header length and AdvMode, a flags octet naming the fields present, the fields in a fixed
+// order, the rest of the extended header (ACAD), then AdvData. parse_ext_adv points into the
+// payload, nothing is copied.
+
+#define EXT_HDR_ADVA      0x01
+#define EXT_HDR_TARGETA   0x02
+#define EXT_HDR_CTEINFO   0x04
+#define EXT_HDR_ADI       0x08
+#define EXT_HDR_AUXPTR    0x10
+#define EXT_HDR_SYNCINFO  0x20
+#define EXT_HDR_TXPOWER   0x40
+
+#define SYNC_INFO_LEN 18
+#define SYNC_OFFSET_ADJUST_US 2457600 // offset adjust bit: the offset is this much longer
+
+extern char *PHY_STR[4];
+
+typedef struct {
+  int chan;                 // -1: no AuxPtr
+  int ca;                   // clock accuracy 0: 51~500ppm, 1: 0~50ppm
+  int offset_unit_us;       // 30 or 300
+  uint32_t offset_us;       // start of this packet to the start of the aux packet, lower bound
+  int phy;                  // 0 1M, 1 2M, 2 coded
+} EXT_AUX_PTR;
+
+typedef struct {
+  uint32_t offset_us;       // start of this packet to the AUX_SYNC_IND of pa_event_counter, lower bound
+  int offset_unit_us;       // 30 or 300: the AUX_SYNC_IND starts within this much after offset_us
+  int interval;             // 1.25ms units
+  uint64_t chan_map;        // bit n: data channel n used
+  int sca;
+  uint32_t access_addr;
+  uint32_t crc_init;        // as BTLE_LINK crc_init
+  uint16_t pa_event_counter;
+} EXT_SYNC_INFO;
+
+typedef struct {
+  int adv_mode;             // 0 non-connectable non-scannable, 1 connectable, 2 scannable
+  int flags;                // EXT_HDR_ bits of the fields present
+  const uint8_t *adv_a;     // air order (LSB first), NULL if absent
+  const uint8_t *target_a;
+  int cte_info;             // -1: absent
+  int did, sid;             // ADI, -1: absent
+  EXT_AUX_PTR aux_ptr;
+  EXT_SYNC_INFO sync_info;  // valid with EXT_HDR_SYNCINFO
+  int tx_power;             // dBm, 127: absent
+  const uint8_t *acad;      // additional controller advertising data, e.g. BIGInfo
+  int acad_len;
+  const uint8_t *adv_data;
+  int adv_data_len;
+} EXT_ADV;
+
+// BIGInfo, in the ACAD of the AUX_SYNC_IND of a periodic train announcing a BIG
+#define AD_BIGINFO 0x2C
+#define BIG_INFO_LEN 33     // 57 with the GIV and GSKD of an encrypted BIG
+
+typedef struct {
+  uint32_t offset_us;       // start of the AUX_SYNC_IND to the anchor of the BIG event of payload_count, lower bound
+  int offset_unit_us;       // 30 or 300
+  int iso_interval;         // 1.25ms units
+  int num_bis;
+  int nse;                  // subevents of each BIS in a BIG event
+  int bn;                   // new payloads of each BIS in a BIG event
+  uint32_t sub_interval_us; // between two subevents of a BIS
+  int pto;                  // pre-transmission offset, BIG events
+  uint32_t bis_spacing_us;  // between the first subevents of two BISes
+  int irc;                  // groups of BN subevents that repeat the payloads of the event
+  int max_pdu;
+  uint32_t seed_access_addr;
+  uint32_t sdu_interval_us;
+  int max_sdu;
+  uint16_t base_crc_init;
+  uint64_t chan_map;        // bit n: data channel n used
+  int phy;                  // 0 1M, 1 2M, 2 coded
+  uint64_t payload_count;   // bisPayloadCount of the first payload of that BIG event, 39 bits
+  int framing;
+  int encrypted;            // GIV and GSKD present
+} BIG_INFO;
+
+// payload_byte: de-whitened payload after the 2 header octets. -1: the extended header runs
+// past payload_len
+int parse_ext_adv(const uint8_t *payload_byte, int payload_len, EXT_ADV *x);
+// the BIGInfo among the AD structures of acad. -1: none, or malformed
+int parse_big_info(const uint8_t *acad, int acad_len, BIG_INFO *b);
+// 6 octets in air order as printed in AdvA:, most significant first. out: 13 characters
+void addr_str(const uint8_t *addr, char *out);
+// prints e.g. "Mode0 AdvA:... ADI:001/2 AuxPtr:ch5,1M,+1230us SyncInfo:AA=...,Data:...", then the CRC
+void print_ext_adv(const uint8_t *payload_byte, int payload_len, int crc_flag, int torn_flag, int ad_flag);
+//----------------------------------extended advertising----------------------------------
+
+//----------------------------------isochronous PDUs----------------------------------
+// A BIS PDU header carries LLID, CSSN and CSTF (control subevent sequence number and
+// transmission flag of the BIG) and an 8 bit length: up to 251 octets, 4 more of MIC when
+// the BIG is encrypted.
+
+#define ISO_LLID_UNFRAMED_END   0   // an unframed SDU, complete or its last fragment
+#define ISO_LLID_UNFRAMED_CONT  1   // the start or a continuation of an unframed SDU
+#define ISO_LLID_FRAMED         2
+
+extern char *ISO_LLID_STR[4];
+
+// byte: de-whitened header and payload. prints e.g. "LLID0:UNFRAMED CSSN0 CSTF0 PloadL40
+// Data:...", or Empty for a padding PDU, then the CRC
+void print_bis_pdu(const uint8_t *byte, int crc_flag, int torn_flag);
+//----------------------------------isochronous PDUs----------------------------------
+
+//----------------------------------data channel PDUs----------------------------------
+// The header carries LLID, NESN, SN and MD, see parse_data_pdu_header_byte. LLID 1 is an
+// empty PDU or the continuation of an L2CAP frame, LLID 2 the start of one (its basic header:
+// length and channel ID), LLID 3 an LL control PDU: opcode and fields, see LL_CTRL_PDU.
+
+#define LLID_DATA_CONT  1
+#define LLID_DATA_START 2
+#define LLID_CTRL       3
+
+#define NUM_LL_CTRL_OPCODE 0x1A   // LL_CONNECTION_UPDATE_REQ ~ LL_MIN_USED_CHANNELS_IND
+#define MAX_NUM_LL_CTRL_FIELD 12
+
+#define L2CAP_CID_ATT     0x0004
+#define L2CAP_CID_LE_SIG  0x0005
+#define L2CAP_CID_SMP     0x0006
+
+extern char *LLID_STR[4];
+
+typedef enum {
+  LL_FIELD_DEC,     // little endian integer, printed in decimal
+  LL_FIELD_HEX,     // little endian integer of any length, printed in hex most significant octet first
+  LL_FIELD_BYTE     // octets in air order, e.g. SKDm
+} LL_FIELD_FORMAT;
+
+typedef struct {
+  const char *name;
+  int len;
+  LL_FIELD_FORMAT format;
+} LL_CTRL_FIELD;
+
+typedef struct {
+  const char *name;
+  int num_field;
+  LL_CTRL_FIELD field[MAX_NUM_LL_CTRL_FIELD];
+} LL_CTRL_PDU;
+
+extern const LL_CTRL_PDU LL_CTRL_PDU_TABLE[NUM_LL_CTRL_OPCODE];
+
+// opcode of an LL control PDU named as in LL_CTRL_PDU_TABLE, e.g. "LL_TERMINATE_IND". -1: none
+int ll_ctrl_opcode(const char *name);
+// octets of CtrData the opcode takes. -1: unknown opcode
+int ll_ctrl_data_len(int opcode);
+// L2CAP basic header of a start fragment. returns -1 if payload_len is too short for it
+int l2cap_header(const uint8_t *payload_byte, int payload_len, int *l2cap_len, int *cid);
+// "ATT", "LE_SIG", "SMP", or NULL
+const char* l2cap_cid_str(int cid);
+
+// payload_byte: de-whitened payload after the 2 header octets. prints e.g.
+// "LL_TERMINATE_IND ErrorCode:13", "L2CAP:len=7,cid=0004(ATT) Data:..." or "Empty", then the CRC
+void print_data_pdu_payload(const uint8_t *payload_byte, int llid, int payload_len, int crc_flag, int torn_flag);
+//----------------------------------data channel PDUs----------------------------------
+
+#endif
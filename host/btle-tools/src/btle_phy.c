@@ -0,0 +1,671 @@
+// BTLE physical layer shared by btle_tx, btle_rx and the benchmarks
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "btle_phy.h"
+#include "btle_cte.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gauss_cos_sin_table.h"
+#include "scramble_table.h"
+
+uint8_t preamble_access_byte[NUM_PREAMBLE_ACCESS_BYTE] = {0xAA, 0xD6, 0xBE, 0x89, 0x8E};
+uint8_t preamble_access_bit[NUM_PREAMBLE_ACCESS_BYTE*8];
+
+//----------------------------------CRC and whitening----------------------------------
+/**
+ * Static table used for the table_driven implementation.
+ *****************************************************************************/
+static const uint_fast32_t crc_table[256] = {
+    0x000000, 0x01b4c0, 0x036980, 0x02dd40, 0x06d300, 0x0767c0, 0x05ba80, 0x040e40,
+    0x0da600, 0x0c12c0, 0x0ecf80, 0x0f7b40, 0x0b7500, 0x0ac1c0, 0x081c80, 0x09a840,
+    0x1b4c00, 0x1af8c0, 0x182580, 0x199140, 0x1d9f00, 0x1c2bc0, 0x1ef680, 0x1f4240,
+    0x16ea00, 0x175ec0, 0x158380, 0x143740, 0x103900, 0x118dc0, 0x135080, 0x12e440,
+    0x369800, 0x372cc0, 0x35f180, 0x344540, 0x304b00, 0x31ffc0, 0x332280, 0x329640,
+    0x3b3e00, 0x3a8ac0, 0x385780, 0x39e340, 0x3ded00, 0x3c59c0, 0x3e8480, 0x3f3040,
+    0x2dd400, 0x2c60c0, 0x2ebd80, 0x2f0940, 0x2b0700, 0x2ab3c0, 0x286e80, 0x29da40,
+    0x207200, 0x21c6c0, 0x231b80, 0x22af40, 0x26a100, 0x2715c0, 0x25c880, 0x247c40,
+    0x6d3000, 0x6c84c0, 0x6e5980, 0x6fed40, 0x6be300, 0x6a57c0, 0x688a80, 0x693e40,
+    0x609600, 0x6122c0, 0x63ff80, 0x624b40, 0x664500, 0x67f1c0, 0x652c80, 0x649840,
+    0x767c00, 0x77c8c0, 0x751580, 0x74a140, 0x70af00, 0x711bc0, 0x73c680, 0x727240,
+    0x7bda00, 0x7a6ec0, 0x78b380, 0x790740, 0x7d0900, 0x7cbdc0, 0x7e6080, 0x7fd440,
+    0x5ba800, 0x5a1cc0, 0x58c180, 0x597540, 0x5d7b00, 0x5ccfc0, 0x5e1280, 0x5fa640,
+    0x560e00, 0x57bac0, 0x556780, 0x54d340, 0x50dd00, 0x5169c0, 0x53b480, 0x520040,
+    0x40e400, 0x4150c0, 0x438d80, 0x423940, 0x463700, 0x4783c0, 0x455e80, 0x44ea40,
+    0x4d4200, 0x4cf6c0, 0x4e2b80, 0x4f9f40, 0x4b9100, 0x4a25c0, 0x48f880, 0x494c40,
+    0xda6000, 0xdbd4c0, 0xd90980, 0xd8bd40, 0xdcb300, 0xdd07c0, 0xdfda80, 0xde6e40,
+    0xd7c600, 0xd672c0, 0xd4af80, 0xd51b40, 0xd11500, 0xd0a1c0, 0xd27c80, 0xd3c840,
+    0xc12c00, 0xc098c0, 0xc24580, 0xc3f140, 0xc7ff00, 0xc64bc0, 0xc49680, 0xc52240,
+    0xcc8a00, 0xcd3ec0, 0xcfe380, 0xce5740, 0xca5900, 0xcbedc0, 0xc93080, 0xc88440,
+    0xecf800, 0xed4cc0, 0xef9180, 0xee2540, 0xea2b00, 0xeb9fc0, 0xe94280, 0xe8f640,
+    0xe15e00, 0xe0eac0, 0xe23780, 0xe38340, 0xe78d00, 0xe639c0, 0xe4e480, 0xe55040,
+    0xf7b400, 0xf600c0, 0xf4dd80, 0xf56940, 0xf16700, 0xf0d3c0, 0xf20e80, 0xf3ba40,
+    0xfa1200, 0xfba6c0, 0xf97b80, 0xf8cf40, 0xfcc100, 0xfd75c0, 0xffa880, 0xfe1c40,
+    0xb75000, 0xb6e4c0, 0xb43980, 0xb58d40, 0xb18300, 0xb037c0, 0xb2ea80, 0xb35e40,
+    0xbaf600, 0xbb42c0, 0xb99f80, 0xb82b40, 0xbc2500, 0xbd91c0, 0xbf4c80, 0xbef840,
+    0xac1c00, 0xada8c0, 0xaf7580, 0xaec140, 0xaacf00, 0xab7bc0, 0xa9a680, 0xa81240,
+    0xa1ba00, 0xa00ec0, 0xa2d380, 0xa36740, 0xa76900, 0xa6ddc0, 0xa40080, 0xa5b440,
+    0x81c800, 0x807cc0, 0x82a180, 0x831540, 0x871b00, 0x86afc0, 0x847280, 0x85c640,
+    0x8c6e00, 0x8ddac0, 0x8f0780, 0x8eb340, 0x8abd00, 0x8b09c0, 0x89d480, 0x886040,
+    0x9a8400, 0x9b30c0, 0x99ed80, 0x985940, 0x9c5700, 0x9de3c0, 0x9f3e80, 0x9e8a40,
+    0x972200, 0x9696c0, 0x944b80, 0x95ff40, 0x91f100, 0x9045c0, 0x929880, 0x932c40
+};
+
+/**
+ * Update the crc value with new data.
+ *
+ * \param crc      The current crc value.
+ * \param data     Pointer to a buffer of \a data_len bytes.
+ * \param data_len Number of bytes in the \a data buffer.
+ * \return         The updated crc value.
+ *****************************************************************************/
+uint_fast32_t crc_update(uint_fast32_t crc, const void *data, size_t data_len) {
+    const unsigned char *d = (const unsigned char *)data;
+    unsigned int tbl_idx;
+
+    while (data_len--) {
+            tbl_idx = (crc ^ *d) & 0xff;
+            crc = (crc_table[tbl_idx] ^ (crc >> 8)) & 0xffffff;
+
+        d++;
+    }
+    return crc & 0xffffff;
+}
+
+uint_fast32_t crc24_byte(uint8_t *byte_in, int num_byte, int init_hex) {
+  uint_fast32_t crc = init_hex;
+
+  crc = crc_update(crc, byte_in, num_byte);
+
+  return(crc);
+}
+
+void scramble_byte(uint8_t *byte_in, int num_byte, const uint8_t *scramble_table_byte, uint8_t *byte_out) {
+  int i;
+  for(i=0; i<num_byte; i++){
+    byte_out[i] = byte_in[i]^scramble_table_byte[i];
+  }
+}
+
+int crc_check(uint8_t *tmp_byte, int body_len, uint32_t crc_init_byte) {
+    int crc24_checksum, crc24_received;
+    crc24_checksum = crc24_byte(tmp_byte, body_len, crc_init_byte);
+    crc24_received = 0;
+    crc24_received = ( (crc24_received << 8) | tmp_byte[body_len+2] );
+    crc24_received = ( (crc24_received << 8) | tmp_byte[body_len+1] );
+    crc24_received = ( (crc24_received << 8) | tmp_byte[body_len+0] );
+    return(crc24_checksum!=crc24_received);
+}
+
+// crc24_byte shifts the register the other way than btle_tx loads the CRC init into it:
+// every octet goes in bit reversed, e.g. 555555 -> AAAAAA
+static uint32_t bit_reverse_octet(uint32_t x) {
+  uint32_t y = 0;
+  int i;
+  for (i=0; i<24; i++) {
+    y = y | ( ((x>>i)&1) << ((i&~7) + 7 - (i&7)) );
+  }
+  return(y);
+}
+
+// index into crc_table by the top octet of the entry: the top octets are all different, so
+// crc_update can be undone one octet at a time
+static const uint8_t crc_table_idx[256] = {
+    0x00, 0x01, 0x03, 0x02, 0x07, 0x06, 0x04, 0x05, 0x0e, 0x0f, 0x0d, 0x0c, 0x09, 0x08, 0x0a, 0x0b,
+    0x1c, 0x1d, 0x1f, 0x1e, 0x1b, 0x1a, 0x18, 0x19, 0x12, 0x13, 0x11, 0x10, 0x15, 0x14, 0x16, 0x17,
+    0x38, 0x39, 0x3b, 0x3a, 0x3f, 0x3e, 0x3c, 0x3d, 0x36, 0x37, 0x35, 0x34, 0x31, 0x30, 0x32, 0x33,
+    0x24, 0x25, 0x27, 0x26, 0x23, 0x22, 0x20, 0x21, 0x2a, 0x2b, 0x29, 0x28, 0x2d, 0x2c, 0x2e, 0x2f,
+    0x70, 0x71, 0x73, 0x72, 0x77, 0x76, 0x74, 0x75, 0x7e, 0x7f, 0x7d, 0x7c, 0x79, 0x78, 0x7a, 0x7b,
+    0x6c, 0x6d, 0x6f, 0x6e, 0x6b, 0x6a, 0x68, 0x69, 0x62, 0x63, 0x61, 0x60, 0x65, 0x64, 0x66, 0x67,
+    0x48, 0x49, 0x4b, 0x4a, 0x4f, 0x4e, 0x4c, 0x4d, 0x46, 0x47, 0x45, 0x44, 0x41, 0x40, 0x42, 0x43,
+    0x54, 0x55, 0x57, 0x56, 0x53, 0x52, 0x50, 0x51, 0x5a, 0x5b, 0x59, 0x58, 0x5d, 0x5c, 0x5e, 0x5f,
+    0xe1, 0xe0, 0xe2, 0xe3, 0xe6, 0xe7, 0xe5, 0xe4, 0xef, 0xee, 0xec, 0xed, 0xe8, 0xe9, 0xeb, 0xea,
+    0xfd, 0xfc, 0xfe, 0xff, 0xfa, 0xfb, 0xf9, 0xf8, 0xf3, 0xf2, 0xf0, 0xf1, 0xf4, 0xf5, 0xf7, 0xf6,
+    0xd9, 0xd8, 0xda, 0xdb, 0xde, 0xdf, 0xdd, 0xdc, 0xd7, 0xd6, 0xd4, 0xd5, 0xd0, 0xd1, 0xd3, 0xd2,
+    0xc5, 0xc4, 0xc6, 0xc7, 0xc2, 0xc3, 0xc1, 0xc0, 0xcb, 0xca, 0xc8, 0xc9, 0xcc, 0xcd, 0xcf, 0xce,
+    0x91, 0x90, 0x92, 0x93, 0x96, 0x97, 0x95, 0x94, 0x9f, 0x9e, 0x9c, 0x9d, 0x98, 0x99, 0x9b, 0x9a,
+    0x8d, 0x8c, 0x8e, 0x8f, 0x8a, 0x8b, 0x89, 0x88, 0x83, 0x82, 0x80, 0x81, 0x84, 0x85, 0x87, 0x86,
+    0xa9, 0xa8, 0xaa, 0xab, 0xae, 0xaf, 0xad, 0xac, 0xa7, 0xa6, 0xa4, 0xa5, 0xa0, 0xa1, 0xa3, 0xa2,
+    0xb5, 0xb4, 0xb6, 0xb7, 0xb2, 0xb3, 0xb1, 0xb0, 0xbb, 0xba, 0xb8, 0xb9, 0xbc, 0xbd, 0xbf, 0xbe
+};
+
+uint32_t crc_init_recover(uint8_t *tmp_byte, int body_len) {
+  uint_fast32_t crc, tbl_idx;
+  int i;
+
+  crc = tmp_byte[body_len+0] | (tmp_byte[body_len+1]<<8) | (tmp_byte[body_len+2]<<16);
+  // crc_update: crc = crc_table[(crc_pre^d)&0xff] ^ (crc_pre>>8), the top octet comes from the table alone
+  for (i=body_len-1; i>=0; i--) {
+    tbl_idx = crc_table_idx[crc>>16];
+    crc = ( ((crc^crc_table[tbl_idx])<<8) | (tbl_idx^tmp_byte[i]) ) & 0xffffff;
+  }
+  return(bit_reverse_octet(crc));
+}
+//----------------------------------CRC and whitening----------------------------------
+
+//----------------------------------modulator----------------------------------
+int gen_sample_from_phy_byte(uint8_t *byte,  int8_t *sample, int num_byte) {
+  // bit expansion scratch: one +-1 followed by SAMPLE_PER_SYMBOL-1 zeros per bit, plus filter head/tail
+  int8_t tmp_phy_bit_over_sampling_int8[(MAX_NUM_PHY_BYTE*8+2*LEN_GAUSS_FILTER)*SAMPLE_PER_SYMBOL + sizeof(int)];
+  int num_bit = num_byte*8;
+  int num_sample = (num_bit*SAMPLE_PER_SYMBOL)+(LEN_GAUSS_FILTER*SAMPLE_PER_SYMBOL);
+
+  int i, j, overall_bit_idx, sub_bit_idx;
+
+  for (i=0; i<(LEN_GAUSS_FILTER*SAMPLE_PER_SYMBOL-1); i++) {
+    tmp_phy_bit_over_sampling_int8[i] = 0;
+  }
+  for (i=(LEN_GAUSS_FILTER*SAMPLE_PER_SYMBOL-1+num_bit*SAMPLE_PER_SYMBOL); i<(2*LEN_GAUSS_FILTER*SAMPLE_PER_SYMBOL-2+num_bit*SAMPLE_PER_SYMBOL); i++) {
+    tmp_phy_bit_over_sampling_int8[i] = 0;
+  }
+  for(j=0; j<num_byte; j++) {
+    sub_bit_idx = 0;
+    for (i=0; i<(8*SAMPLE_PER_SYMBOL); i = i + SAMPLE_PER_SYMBOL) {
+      overall_bit_idx = j*8*SAMPLE_PER_SYMBOL + i;
+     (*(int*)(&(tmp_phy_bit_over_sampling_int8[overall_bit_idx+(LEN_GAUSS_FILTER*SAMPLE_PER_SYMBOL-1)]))) = 0xff & (( (byte[j]>>sub_bit_idx & 0x01) ) * 2 - 1);
+     sub_bit_idx++;
+    }
+  }
+
+  int16_t tmp = 0;
+  sample[0] = cos_table_int8[tmp];
+  sample[1] = sin_table_int8[tmp];
+
+  int len_conv_result = num_sample - 1;
+  for (i=0; i<len_conv_result; i++) {
+    int16_t acc = 0;
+    for (j=3; j<(LEN_GAUSS_FILTER*SAMPLE_PER_SYMBOL-4); j++) {
+      acc = acc + gauss_coef_int8[(LEN_GAUSS_FILTER*SAMPLE_PER_SYMBOL)-j-1]*tmp_phy_bit_over_sampling_int8[i+j];
+    }
+
+    tmp = (tmp + acc)&1023;
+    sample[(i+1)*2 + 0] = cos_table_int8[tmp];
+    sample[(i+1)*2 + 1] = sin_table_int8[tmp];
+  }
+
+  return(num_sample);
+}
+//----------------------------------modulator----------------------------------
+
+//----------------------------------demodulator----------------------------------
+static void int_to_bit(int n, uint8_t *bit) {
+  bit[0] = 0x01&(n>>0);
+  bit[1] = 0x01&(n>>1);
+  bit[2] = 0x01&(n>>2);
+  bit[3] = 0x01&(n>>3);
+  bit[4] = 0x01&(n>>4);
+  bit[5] = 0x01&(n>>5);
+  bit[6] = 0x01&(n>>6);
+  bit[7] = 0x01&(n>>7);
+}
+
+void demod_byte(IQ_TYPE* rxp, int num_byte, uint8_t *out_byte) {
+  int i, j;
+  int I0, Q0, I1, Q1;
+  uint8_t bit_decision;
+  int sample_idx = 0;
+  
+  for (i=0; i<num_byte; i++) {
+    out_byte[i] = 0;
+    for (j=0; j<8; j++) {
+      I0 = rxp[sample_idx];
+      Q0 = rxp[sample_idx+1];
+      I1 = rxp[sample_idx+2];
+      Q1 = rxp[sample_idx+3];
+      bit_decision = (I0*Q1 - I1*Q0)>0? 1 : 0;
+      out_byte[i] = out_byte[i] | (bit_decision<<j);
+
+      sample_idx = sample_idx + SAMPLE_PER_SYMBOL*2;
+    }
+  }
+}
+
+int search_unique_bits(IQ_TYPE* rxp, int search_len, uint8_t *unique_bits, const int num_bits) {
+  int i, sp, j, i0, q0, i1, q1, k, p, phase_idx;
+  int unequal_flag;
+  const int demod_buf_len = num_bits;
+  int demod_buf_offset = 0;
+  uint8_t demod_buf_preamble_access[SAMPLE_PER_SYMBOL][LEN_DEMOD_BUF_PREAMBLE_ACCESS]; // on the stack, so that threads can search at the same time
+  
+  //demod_buf_preamble_access[SAMPLE_PER_SYMBOL][LEN_DEMOD_BUF_PREAMBLE_ACCESS]
+  memset(demod_buf_preamble_access, 0, SAMPLE_PER_SYMBOL*LEN_DEMOD_BUF_PREAMBLE_ACCESS);
+  for(i=0; i<search_len*SAMPLE_PER_SYMBOL*2; i=i+(SAMPLE_PER_SYMBOL*2)) {
+    sp = ( (demod_buf_offset-demod_buf_len+1)&(demod_buf_len-1) );
+    //sp = (demod_buf_offset-demod_buf_len+1);
+    //if (sp>=demod_buf_len)
+    //  sp = sp - demod_buf_len;
+    
+    for(j=0; j<(SAMPLE_PER_SYMBOL*2); j=j+2) {
+      i0 = rxp[i+j];
+      q0 = rxp[i+j+1];
+      i1 = rxp[i+j+2];
+      q1 = rxp[i+j+3];
+      
+      phase_idx = j/2;
+      demod_buf_preamble_access[phase_idx][demod_buf_offset] = (i0*q1 - i1*q0) > 0? 1: 0;
+      
+      k = sp;
+      unequal_flag = 0;
+      for (p=0; p<demod_buf_len; p++) {
+        if (demod_buf_preamble_access[phase_idx][k] != unique_bits[p]) {
+          unequal_flag = 1;
+          break;
+        }
+        k = ( (k + 1)&(demod_buf_len-1) );
+        //k = (k + 1);
+        //if (k>=demod_buf_len)
+        //  k = k - demod_buf_len;
+      }
+      
+      if(unequal_flag==0) {
+        return( i + j - (demod_buf_len-1)*SAMPLE_PER_SYMBOL*2 );
+      }
+      
+    }
+
+    demod_buf_offset  = ( (demod_buf_offset+1)&(demod_buf_len-1) );
+    //demod_buf_offset  = (demod_buf_offset+1);
+    //if (demod_buf_offset>=demod_buf_len)
+    //  demod_buf_offset = demod_buf_offset - demod_buf_len;
+  }
+
+  return(-1);
+}
+
+void parse_adv_pdu_header_byte(uint8_t *byte_in, int *pdu_type, int *tx_add, int *rx_add, int *payload_len) {
+//% pdy_type_str = {'ADV_IND', 'ADV_DIRECT_IND', 'ADV_NONCONN_IND', 'SCAN_REQ', 'SCAN_RSP', 'CONNECT_REQ', 'ADV_SCAN_IND', 'Reserved', 'Reserved', 'Reserved', 'Reserved', 'Reserved', 'Reserved', 'Reserved', 'Reserved'};
+//pdu_type = bi2de(bits(1:4), 'right-msb');
+(*pdu_type) = (byte_in[0]&0x0F);
+//% disp(['   PDU Type: ' pdy_type_str{pdu_type+1}]);
+
+//tx_add = bits(7);
+//% disp(['     Tx Add: ' num2str(tx_add)]);
+(*tx_add) = ( (byte_in[0]&0x40) != 0 );
+
+//rx_add = bits(8);
+//% disp(['     Rx Add: ' num2str(rx_add)]);
+(*rx_add) = ( (byte_in[0]&0x80) != 0 );
+
+//payload_len = bi2de(bits(9:14), 'right-msb');
+(*payload_len) = ( (*pdu_type) == ADV_EXT_PDU_TYPE? byte_in[1] : (byte_in[1]&0x3F) ); // 8 bits since BLE 5, legacy PDUs up to 37
+}
+
+void parse_data_pdu_header_byte(uint8_t *byte_in, int *llid, int *nesn, int *sn, int *md, int *payload_len) {
+  (*llid) = (byte_in[0]&0x03);
+  (*nesn) = ( (byte_in[0]&0x04) != 0 );
+  (*sn) = ( (byte_in[0]&0x08) != 0 );
+  (*md) = ( (byte_in[0]&0x10) != 0 );
+  (*payload_len) = byte_in[1]; // 5 bits before data length extension, RFU bits are 0
+}
+
+float calc_rssi(IQ_TYPE *rxp, int num_iq_sample) {
+  int64_t power = 0;
+  int i;
+
+  for (i=0; i<num_iq_sample*2; i++) {
+    power = power + rxp[i]*rxp[i];
+  }
+  if (power == 0) {
+    return(-127.0f);
+  }
+  return( 10.0f*log10f( (float)power/((float)num_iq_sample*IQ_MAX*IQ_MAX) ) );
+}
+//----------------------------------demodulator----------------------------------
+
+//----------------------------------link----------------------------------
+static void toa_ref_init(BTLE_LINK *link);
+
+void link_init(BTLE_LINK *link, uint32_t access_addr, uint32_t crc_init) {
+  int i;
+  link->access_addr = access_addr;
+  link->crc_init = (crc_init&0xFFFFFF);
+  link->data_pdu = (access_addr != ADV_ACCESS_ADDR);
+  link->iso = 0;
+  link->crc_init_byte = bit_reverse_octet(link->crc_init);
+  // the preamble alternates starting with the first access address bit
+  int_to_bit( ((access_addr&1)? 0x55 : 0xAA), link->unique_bit );
+  for (i=0; i<NUM_ACCESS_ADDR_BYTE; i++) {
+    int_to_bit( (access_addr>>(i*8))&0xFF, link->unique_bit+(NUM_PREAMBLE_BYTE+i)*8 );
+  }
+  toa_ref_init(link);
+}
+
+void link_init_sync(BTLE_LINK *link, uint32_t access_addr, uint32_t crc_init) {
+  link_init(link, access_addr, crc_init);
+  link->data_pdu = 0;
+}
+
+void link_init_bis(BTLE_LINK *link, uint32_t access_addr, uint32_t crc_init) {
+  link_init(link, access_addr, crc_init);
+  link->data_pdu = 1;
+  link->iso = 1;
+}
+
+int parse_link(char *str, BTLE_LINK *link) {
+  char *endp;
+  unsigned long access_addr, crc_init;
+
+  access_addr = strtoul(str, &endp, 16);
+  if ( (endp - str) != 8 || (*endp) != ':' ) {
+    printf("parse_link: %s is not AA:CRCInit, e.g. 60850A1B:A77B22!\n", str);
+    return(-1);
+  }
+  crc_init = strtoul(endp+1, &str, 16);
+  if ( (str - (endp+1)) != 6 || (*str) != 0 ) {
+    printf("parse_link: CRCInit must be 6 hex digits!\n");
+    return(-1);
+  }
+  link_init(link, (uint32_t)access_addr, (uint32_t)crc_init);
+  return(0);
+}
+
+int gen_phy_byte(BTLE_LINK *link, int channel_number, uint8_t *pdu, int pdu_len, uint8_t *phy_byte) {
+  uint8_t *pdu_out = phy_byte + NUM_PREAMBLE_ACCESS_BYTE;
+  uint_fast32_t crc;
+  int i;
+
+  phy_byte[0] = ( (link->access_addr&1)? 0x55 : 0xAA );
+  for (i=0; i<NUM_ACCESS_ADDR_BYTE; i++) {
+    phy_byte[NUM_PREAMBLE_BYTE+i] = (link->access_addr>>(i*8))&0xFF;
+  }
+
+  memcpy(pdu_out, pdu, pdu_len);
+  crc = crc24_byte(pdu, pdu_len, link->crc_init_byte);
+  pdu_out[pdu_len+0] = crc & 0xFF;
+  pdu_out[pdu_len+1] = (crc>>8) & 0xFF;
+  pdu_out[pdu_len+2] = (crc>>16) & 0xFF;
+  scramble_byte(pdu_out, pdu_len+3, scramble_table_ext[channel_number], pdu_out);
+
+  return(NUM_PREAMBLE_ACCESS_BYTE+pdu_len+3);
+}
+//----------------------------------link----------------------------------
+
+//----------------------------------fine timing----------------------------------
+// the reference is the modulator output from TOA_REF_SKIP on, dropping most of the filter head.
+// there the frequency pulse of bit n is centered between samples 8+4n and 9+4n (the phase step
+// of a tap lands on the next sample), so bit 0 starts 1.5 samples before the reference does
+#define TOA_REF_SKIP ((LEN_GAUSS_FILTER/2)*SAMPLE_PER_SYMBOL)
+#define TOA_REF_DELAY (-1.5f)
+
+static void toa_ref_init(BTLE_LINK *link) {
+  int8_t sample[2*(NUM_PREAMBLE_ACCESS_BYTE*8+LEN_GAUSS_FILTER)*SAMPLE_PER_SYMBOL];
+  uint8_t byte[NUM_PREAMBLE_ACCESS_BYTE];
+  int i, j;
+
+  for (i=0; i<NUM_PREAMBLE_ACCESS_BYTE; i++) {
+    byte[i] = 0;
+    for (j=0; j<8; j++) {
+      byte[i] = byte[i] | (link->unique_bit[i*8+j]<<j);
+    }
+  }
+  gen_sample_from_phy_byte(byte, sample, NUM_PREAMBLE_ACCESS_BYTE);
+  for (i=0; i<TOA_NUM_REF; i++) {
+    link->toa_ref[2*i+0] = sample[2*(TOA_REF_SKIP+i)+0];
+    link->toa_ref[2*i+1] = sample[2*(TOA_REF_SKIP+i)+1];
+    link->toa_ref_rot[2*i+0] = -sample[2*(TOA_REF_SKIP+i)+1];
+    link->toa_ref_rot[2*i+1] = sample[2*(TOA_REF_SKIP+i)+0];
+  }
+}
+
+static inline int32_t toa_dot(const IQ_TYPE *x, const int8_t *ref) {
+  int32_t acc = 0;
+  int i;
+
+  // int8 (int16 with bladeRF) times int8 into an int32 sum, no dependency between terms: vectorizes
+  for (i=0; i<2*TOA_NUM_REF; i++) {
+    acc += (int32_t)x[i]*ref[i];
+  }
+  return(acc);
+}
+
+float toa_estimate(IQ_TYPE *rxp, int hit_idx, BTLE_LINK *link) {
+  float mag[2*TOA_MAX_LAG+1], re, im, denom, frac = 0;
+  int lag, start, best = -1;
+
+  for (lag=-TOA_MAX_LAG; lag<=TOA_MAX_LAG; lag++) {
+    start = hit_idx/2 + lag;
+    mag[lag+TOA_MAX_LAG] = -1;
+    if (start < 0) {
+      continue;
+    }
+    re = (float)toa_dot(rxp+2*start, link->toa_ref);
+    im = (float)toa_dot(rxp+2*start, link->toa_ref_rot);
+    mag[lag+TOA_MAX_LAG] = sqrtf(re*re + im*im);
+    if ( best < 0 || mag[lag+TOA_MAX_LAG] > mag[best] ) {
+      best = lag+TOA_MAX_LAG;
+    }
+  }
+  if (best < 0) {
+    return(0);
+  }
+
+  // the peak on the edge of the lags or with a missing neighbour stays on its sample
+  if ( best > 0 && best < 2*TOA_MAX_LAG && mag[best-1] >= 0 ) {
+    denom = mag[best-1] - 2*mag[best] + mag[best+1];
+    if (denom < 0) {
+      frac = 0.5f*(mag[best-1] - mag[best+1])/denom;
+    }
+  }
+  return( (float)(best - TOA_MAX_LAG) + frac + TOA_REF_DELAY );
+}
+//----------------------------------fine timing----------------------------------
+
+//----------------------------------block receiver----------------------------------
+static BTLE_LINK adv_link;
+// scramble_table only covers legacy PDUs. x^7+x^4+1 seeded with 1 and the channel number
+uint8_t scramble_table_ext[40][2+MAX_NUM_EXT_PAYLOAD_BYTE+3];
+
+static void init_scramble_table_ext(void) {
+  int channel_number, i, j, lfsr, bit;
+
+  for (channel_number=0; channel_number<40; channel_number++) {
+    lfsr = 0x40|channel_number; // position 0 in bit 6 ... position 6 in bit 0
+    for (i=0; i<(2+MAX_NUM_EXT_PAYLOAD_BYTE+3); i++) {
+      scramble_table_ext[channel_number][i] = 0;
+      for (j=0; j<8; j++) {
+        bit = (lfsr&1);
+        scramble_table_ext[channel_number][i] |= (bit<<j);
+        lfsr = (lfsr>>1) | (bit<<6);
+        lfsr = lfsr ^ (bit<<2);
+      }
+    }
+  }
+}
+
+void receiver_init(void) {
+  int i;
+  for(i=0; i<NUM_PREAMBLE_ACCESS_BYTE; i++) {
+    int_to_bit(preamble_access_byte[i], preamble_access_bit+i*8);
+  }
+  link_init(&adv_link, ADV_ACCESS_ADDR, ADV_CRC_INIT);
+  init_scramble_table_ext();
+}
+
+int receiver_block(IQ_TYPE *rxp_in, int buf_len, int demod_buf_len, int channel_number, BTLE_LINK *link, BTLE_FILTER *filter, BTLE_RX_STAT *stat, BTLE_PKT_HANDLER handler, void *arg) {
+  uint8_t tmp_byte[2+MAX_NUM_EXT_PAYLOAD_BYTE+3]; // header length + maximum payload length + 3 octets CRC
+  const uint8_t *scramble_table_byte = scramble_table_ext[channel_number];
+  BTLE_PKT pkt;
+  IQ_TYPE *rxp = rxp_in;
+  int num_demod_byte, hit_idx, buf_len_eaten, pdu_type, tx_add, rx_add, payload_len, pkt_start, pkt_end;
+  int llid, nesn, sn, md, cp, cte_info, cte_len;
+  int num_addr_byte, filter_stage;
+  float rssi;
+  int num_symbol_left = buf_len/(SAMPLE_PER_SYMBOL*2); //2 for IQ
+
+  if ( filter != NULL && ((filter->chan_mask>>channel_number)&1) == 0 ) {
+    return(buf_len);
+  }
+  if (link == NULL) {
+    link = &adv_link;
+  }
+  pdu_type = tx_add = rx_add = llid = nesn = sn = md = 0;
+
+  buf_len_eaten = 0;
+  while( 1 ) 
+  {
+    hit_idx = search_unique_bits(rxp, num_symbol_left, link->unique_bit, LEN_DEMOD_BUF_PREAMBLE_ACCESS);
+    if ( hit_idx == -1 ) {
+      break;
+    }
+
+    buf_len_eaten = buf_len_eaten + hit_idx;
+    pkt_start = buf_len_eaten;
+    
+    buf_len_eaten = buf_len_eaten + 8*NUM_PREAMBLE_ACCESS_BYTE*2*SAMPLE_PER_SYMBOL;// move to beginning of PDU header
+    rxp = rxp_in + buf_len_eaten;
+    
+    num_demod_byte = 2; // PDU header has 2 octets
+    buf_len_eaten = buf_len_eaten + 8*num_demod_byte*2*SAMPLE_PER_SYMBOL;
+    if ( buf_len_eaten > demod_buf_len ) {
+      return(pkt_start);
+    }
+
+    demod_byte(rxp, num_demod_byte, tmp_byte);
+    scramble_byte(tmp_byte, num_demod_byte, scramble_table_byte, tmp_byte);
+    rxp = rxp_in + buf_len_eaten;
+    num_symbol_left = (buf_len-buf_len_eaten)/(SAMPLE_PER_SYMBOL*2);
+    
+    if (link->data_pdu) {
+      parse_data_pdu_header_byte(tmp_byte, &llid, &nesn, &sn, &md, &payload_len);
+    } else {
+      parse_adv_pdu_header_byte(tmp_byte, &pdu_type, &tx_add, &rx_add, &payload_len);
+    }
+    
+    if( ( link->data_pdu && !link->iso && (llid == 0 || payload_len>MAX_NUM_DATA_PAYLOAD_BYTE) ) || ( link->iso && llid == 3 ) || ( !link->data_pdu && pdu_type != ADV_EXT_PDU_TYPE && (payload_len<6 || payload_len>37) ) ||
+        ( !link->data_pdu && pdu_type == ADV_EXT_PDU_TYPE && payload_len<1 ) ) {
+      if (stat != NULL) {
+        stat->num_hit++;
+        stat->num_header_reject++;
+      }
+      continue;
+    }
+    
+    // CP: the CTEInfo octet of a Constant Tone Extension sits between header and payload
+    cp = ( link->data_pdu && !link->iso && (tmp_byte[0]&0x20) != 0 );
+    num_demod_byte = (cp+payload_len+3);
+    pkt_end = buf_len_eaten + 8*num_demod_byte*2*SAMPLE_PER_SYMBOL;
+    if ( pkt_end > demod_buf_len ) {
+      return(pkt_start);
+    }
+
+    rssi = calc_rssi(rxp_in+pkt_start, 8*NUM_PREAMBLE_ACCESS_BYTE*SAMPLE_PER_SYMBOL);
+
+    // early filter stages: a rejected packet is skipped without demodulating the rest of it
+    num_addr_byte = 0;
+    filter_stage = NUM_FILTER_STAGE;
+    if (filter != NULL) {
+      if ( !link->data_pdu && filter_pdu_type(filter, pdu_type) == 0 ) {
+        filter_stage = FILTER_STAGE_TYPE;
+      } else if ( rssi < filter->rssi_th ) {
+        filter_stage = FILTER_STAGE_RSSI;
+      } else if ( !link->data_pdu && (filter->num_adv_addr != 0 || filter->num_init_addr != 0) ) {
+        num_addr_byte = filter_num_addr_byte(filter, pdu_type);
+        if ( num_addr_byte > payload_len ) {
+          filter_stage = FILTER_STAGE_ADDR;
+        } else {
+          demod_byte(rxp, num_addr_byte, tmp_byte+2);
+          scramble_byte(tmp_byte+2, num_addr_byte, scramble_table_byte+2, tmp_byte+2);
+          if ( filter_addr(filter, tmp_byte+2, pdu_type) == 0 ) {
+            filter_stage = FILTER_STAGE_ADDR;
+          }
+        }
+      }
+    }
+
+    if (filter_stage == NUM_FILTER_STAGE) {
+      demod_byte(rxp+num_addr_byte*8*2*SAMPLE_PER_SYMBOL, num_demod_byte-num_addr_byte, tmp_byte+2+num_addr_byte);
+      scramble_byte(tmp_byte+2+num_addr_byte, num_demod_byte-num_addr_byte, scramble_table_byte+2+num_addr_byte, tmp_byte+2+num_addr_byte);
+      if ( filter != NULL && !link->data_pdu && filter_data(filter, tmp_byte+2, payload_len, pdu_type) == 0 ) {
+        filter_stage = FILTER_STAGE_DATA;
+      }
+    }
+
+    // rejected or not, the search goes on after the packet
+    buf_len_eaten = pkt_end;
+    rxp = rxp_in + buf_len_eaten;
+    num_symbol_left = (buf_len-buf_len_eaten)/(SAMPLE_PER_SYMBOL*2);
+
+    if (filter_stage != NUM_FILTER_STAGE) {
+      if (stat != NULL) {
+        stat->num_hit++;
+        stat->num_filter_reject[filter_stage]++;
+      }
+      continue;
+    }
+
+    pkt.pkt_start = pkt_start;
+    pkt.pkt_end = pkt_end;
+    pkt.toa = toa_estimate(rxp_in, pkt_start, link);
+    pkt.channel_number = channel_number;
+    pkt.access_addr = link->access_addr;
+    pkt.data_pdu = link->data_pdu;
+    pkt.pdu_type = pdu_type;
+    pkt.tx_add = tx_add;
+    pkt.rx_add = rx_add;
+    pkt.llid = llid;
+    pkt.nesn = nesn;
+    pkt.sn = sn;
+    pkt.md = md;
+    pkt.payload_len = payload_len;
+    pkt.crc_flag = crc_check(tmp_byte, cp+payload_len+2, link->crc_init_byte);
+    pkt.rssi = rssi;
+    pkt.byte = tmp_byte;
+
+    cte_info = -1;
+    if (cp) {
+      cte_info = tmp_byte[2];
+      memmove(tmp_byte+2, tmp_byte+3, payload_len+3);
+    } else if ( !link->data_pdu && pdu_type == ADV_EXT_PDU_TYPE ) {
+      cte_info = cte_info_ext_adv(tmp_byte+2, payload_len);
+    }
+    cte_len = ( (pkt.crc_flag == 0 && cte_info >= 0)? cte_time_us(cte_info)*2*SAMPLE_PER_SYMBOL : -1 );
+    pkt.cte_info = ( cte_len > 0? cte_info : -1 );
+    pkt.cte = NULL;
+    pkt.cte_len = 0;
+    if (cte_len > 0) {
+      if (pkt_end + cte_len > demod_buf_len) {
+        return(pkt_start);
+      }
+      pkt.cte = rxp_in + pkt_end;
+      pkt.cte_len = cte_len;
+      // a tone holds no access address: the search goes on after it
+      buf_len_eaten = pkt_end + cte_len;
+      rxp = rxp_in + buf_len_eaten;
+      num_symbol_left = (buf_len-buf_len_eaten)/(SAMPLE_PER_SYMBOL*2);
+    }
+
+    if (stat != NULL) {
+      stat->num_hit++;
+      if (pkt.crc_flag) {
+        stat->num_crc_err++;
+      } else {
+        stat->num_crc_ok++;
+      }
+    }
+
+    if (handler != NULL) {
+      (*handler)(&pkt, arg);
+    }
+  }
+  return(buf_len);
+}
+//----------------------------------block receiver----------------------------------
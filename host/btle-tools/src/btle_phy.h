@@ -0,0 +1,168 @@
+// BTLE physical layer shared by btle_tx, btle_rx and the benchmarks
+//
+// GFSK modulator, correlator/discriminator demodulator, CRC24 and whitening, plus the block
+// receiver that btle_rx runs on every half of its cyclic buffer. The receiver listens to one
+// link at a time: the advertising channel access address and CRC init, or those of a
+// connection, whose data channel PDUs it then demodulates instead.
+
+#ifndef BTLE_PHY_H
+#define BTLE_PHY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "common.h"
+#include "btle_filter.h"
+
+#define SAMPLE_PER_SYMBOL 4 // 4M sampling rate
+
+#ifdef USE_BLADERF
+typedef int16_t IQ_TYPE;
+#define IQ_MAX (2047) // SC16 Q11
+#else
+typedef int8_t IQ_TYPE;
+#define IQ_MAX (127)
+#endif
+
+#define LEN_GAUSS_FILTER (4) // pre 2, post 2
+#define MAX_NUM_INFO_BYTE (43)
+#define MAX_NUM_PHY_BYTE (47)
+#define MAX_NUM_EXT_PAYLOAD_BYTE (255) // BLE 5 extended advertising PDUs
+#define MAX_NUM_DATA_PAYLOAD_BYTE (251) // data channel PDUs with data length extension (BLE 4.2), 27 (+4 MIC) without
+#define MAX_NUM_EXT_PHY_BYTE (1+4+2+MAX_NUM_EXT_PAYLOAD_BYTE+3)
+
+#define NUM_PREAMBLE_BYTE (1)
+#define NUM_ACCESS_ADDR_BYTE (4)
+#define NUM_PREAMBLE_ACCESS_BYTE (NUM_PREAMBLE_BYTE+NUM_ACCESS_ADDR_BYTE)
+
+//#define LEN_DEMOD_BUF_PREAMBLE_ACCESS ( (NUM_PREAMBLE_ACCESS_BYTE*8)-8 ) // to get 2^x integer
+#define LEN_DEMOD_BUF_PREAMBLE_ACCESS 32
+//#define LEN_DEMOD_BUF_PREAMBLE_ACCESS (NUM_PREAMBLE_ACCESS_BYTE*8)
+
+extern const int8_t gauss_coef_int8[16];
+extern const int8_t cos_table_int8[1024];
+extern const int8_t sin_table_int8[1024];
+extern const uint8_t scramble_table[40][42];
+// whitening of PDUs up to MAX_NUM_EXT_PAYLOAD_BYTE octets, per channel. filled by receiver_init()
+extern uint8_t scramble_table_ext[40][2+MAX_NUM_EXT_PAYLOAD_BYTE+3];
+
+extern uint8_t preamble_access_byte[NUM_PREAMBLE_ACCESS_BYTE];
+extern uint8_t preamble_access_bit[NUM_PREAMBLE_ACCESS_BYTE*8];
+
+//----------------------------------CRC and whitening----------------------------------
+uint_fast32_t crc_update(uint_fast32_t crc, const void *data, size_t data_len);
+uint_fast32_t crc24_byte(uint8_t *byte_in, int num_byte, int init_hex);
+// 0: CRC of the body_len octets matches the 3 octets after them. 1: CRC error.
+// crc_init_byte: see BTLE_LINK
+int crc_check(uint8_t *tmp_byte, int body_len, uint32_t crc_init_byte);
+// runs the CRC register back from the 3 octets after the body to its start: the CRCInit (as
+// BTLE_LINK crc_init) that makes crc_check pass. a bit error gives some other value
+uint32_t crc_init_recover(uint8_t *tmp_byte, int body_len);
+void scramble_byte(uint8_t *byte_in, int num_byte, const uint8_t *scramble_table_byte, uint8_t *byte_out);
+
+//----------------------------------modulator----------------------------------
+// fixed point GFSK. sample gets 2*((num_byte*8+LEN_GAUSS_FILTER)*SAMPLE_PER_SYMBOL) int8 I/Q.
+// reentrant
+int gen_sample_from_phy_byte(uint8_t *byte, int8_t *sample, int num_byte);
+
+//----------------------------------demodulator----------------------------------
+void demod_byte(IQ_TYPE* rxp, int num_byte, uint8_t *out_byte);
+int search_unique_bits(IQ_TYPE* rxp, int search_len, uint8_t *unique_bits, const int num_bits);
+void parse_adv_pdu_header_byte(uint8_t *byte_in, int *pdu_type, int *tx_add, int *rx_add, int *payload_len);
+void parse_data_pdu_header_byte(uint8_t *byte_in, int *llid, int *nesn, int *sn, int *md, int *payload_len);
+// mean power of num_iq_sample I/Q samples in dB relative to an IQ_MAX amplitude tone
+float calc_rssi(IQ_TYPE *rxp, int num_iq_sample);
+
+//----------------------------------link----------------------------------
+#define ADV_ACCESS_ADDR (0x8E89BED6)
+#define ADV_CRC_INIT (0x555555)
+#define ADV_EXT_PDU_TYPE (7) // ADV_EXT_IND and the AUX_ PDUs: common extended advertising payload, up to 255 octets
+#define TOA_NUM_REF (NUM_PREAMBLE_ACCESS_BYTE*8*SAMPLE_PER_SYMBOL) // IQ samples of the preamble and access address waveform
+
+typedef struct {
+  uint32_t access_addr;     // sent LSB first
+  uint32_t crc_init;        // as btle_tx takes it and CONNECT_REQ prints it
+  int data_pdu;             // 1: data channel PDUs. 0: advertising channel PDUs
+  int iso;                  // with data_pdu: BIS PDUs, LLID 0~2, up to 255 octets
+  uint32_t crc_init_byte;   // crc_init loaded into the register of crc24_byte
+  uint8_t unique_bit[NUM_PREAMBLE_ACCESS_BYTE*8]; // preamble and access address, one bit per octet
+  // their GFSK waveform for toa_estimate, interleaved I/Q, and the same times -j. a dot
+  // product with each gives real and imaginary part of the correlation
+  int8_t toa_ref[2*TOA_NUM_REF];
+  int8_t toa_ref_rot[2*TOA_NUM_REF];
+} BTLE_LINK;
+
+// the advertising link when access_addr is ADV_ACCESS_ADDR, otherwise a connection
+void link_init(BTLE_LINK *link, uint32_t access_addr, uint32_t crc_init);
+// advertising channel PDUs on the access address of a periodic advertising train (AUX_SYNC_IND)
+void link_init_sync(BTLE_LINK *link, uint32_t access_addr, uint32_t crc_init);
+// BIS PDUs of a broadcast isochronous stream on access_addr
+void link_init_bis(BTLE_LINK *link, uint32_t access_addr, uint32_t crc_init);
+// "AA:CRCInit" in hex, e.g. 60850A1B:A77B22. returns -1 on a syntax error
+int parse_link(char *str, BTLE_LINK *link);
+// the packet of pdu (header and payload, pdu_len octets) on link as sent on channel_number:
+// preamble, access address, then PDU and CRC whitened. writes its 1+4+pdu_len+3 octets to
+// phy_byte, for gen_sample_from_phy_byte, and returns their number. receiver_init() first
+int gen_phy_byte(BTLE_LINK *link, int channel_number, uint8_t *pdu, int pdu_len, uint8_t *phy_byte);
+//----------------------------------link----------------------------------
+
+//----------------------------------fine timing----------------------------------
+#define TOA_MAX_LAG SAMPLE_PER_SYMBOL // correlation lags (IQ samples) tried each side of the correlator hit
+
+// sub-sample time of arrival: correlates the preamble and access address waveform of link
+// against rxp at the lags around hit_idx (IQ_TYPE elements, as search_unique_bits returns it)
+// and puts a parabola through the magnitude peak and its neighbours. returns where the first
+// preamble bit starts, in IQ samples from hit_idx/2. lags before rxp are left out
+float toa_estimate(IQ_TYPE *rxp, int hit_idx, BTLE_LINK *link);
+//----------------------------------fine timing----------------------------------
+
+//----------------------------------block receiver----------------------------------
+typedef struct {
+  int pkt_start;      // offset (IQ_TYPE elements) of the preamble from the start of the block
+  int pkt_end;        // offset right after the CRC
+  float toa;          // start of the preamble in IQ samples from pkt_start/2, sub-sample. see toa_estimate
+  int channel_number;
+  uint32_t access_addr;
+  int data_pdu;       // 1: llid, nesn, sn and md are set. 0: pdu_type, tx_add and rx_add
+  int pdu_type;
+  int tx_add;
+  int rx_add;
+  int llid;
+  int nesn;
+  int sn;
+  int md;
+  int payload_len;
+  int crc_flag;       // as crc_check: 0 OK
+  float rssi;         // dBFS over the preamble and access address
+  uint8_t *byte;      // de-whitened PDU header + payload + CRC, up to 2+255+3 octets. valid during the handler call only
+  // a data PDU with the CP bit set has its CTEInfo octet taken out of byte (the CRC is checked
+  // with it). the search goes on after the CTE
+  int cte_info;       // CTEInfo of a packet with a Constant Tone Extension and a good CRC, -1: none. see btle_cte.h
+  IQ_TYPE *cte;       // the CTE, right after the CRC in the caller's buffer
+  int cte_len;        // IQ_TYPE elements at cte
+} BTLE_PKT;
+
+// each counter is written by the thread running receiver_block only
+typedef struct {
+  volatile uint64_t num_hit;            // correlator hits, counted when the packet is resolved so a retried one counts once
+  volatile uint64_t num_header_reject;  // hits dropped because of an invalid PDU header or length
+  volatile uint64_t num_crc_ok;
+  volatile uint64_t num_crc_err;
+  volatile uint64_t num_filter_reject[NUM_FILTER_STAGE]; // packets dropped by the filter, per stage
+} BTLE_RX_STAT;
+
+typedef void (*BTLE_PKT_HANDLER)(BTLE_PKT *pkt, void *arg);
+
+// once, before receiver_block(). that keeps no state between calls, so several threads may then
+// run it at once, each with its own stat
+void receiver_init(void);
+// searches preambles starting in the first buf_len IQ_TYPE elements of rxp_in, demodulates
+// packets that end within demod_buf_len elements and hands each one the filter accepts to
+// handler. link NULL: the advertising link; on a data link the filter applies its channel and
+// RSSI stages only. filter and stat may be NULL. returns buf_len, or the offset (IQ_TYPE
+// elements) of the first packet that does not end within demod_buf_len, CTE included, to be run
+// again from there once more samples are in. room for MAX_NUM_EXT_PHY_BYTE octets and
+// MAX_NUM_CTE_SAMPLE (btle_cte.h) beyond buf_len is always enough
+int receiver_block(IQ_TYPE *rxp_in, int buf_len, int demod_buf_len, int channel_number, BTLE_LINK *link, BTLE_FILTER *filter, BTLE_RX_STAT *stat, BTLE_PKT_HANDLER handler, void *arg);
+
+#endif
@@ -0,0 +1,591 @@
+// Parallel offline replay of recorded IQ captures through the BTLE receiver
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+// The capture (cs8 as hackrf_transfer -r writes it, or cs16/cf32, at 4Msps, see btle_iqfile.h)
+// is memory mapped and cut into
+// chunks. A pool of worker threads demodulates the chunks with receiver_block(): a worker
+// searches preambles in its own chunk only, but the chunk is extended by one maximum packet
+// (the overlap), so a packet starting near the end is still demodulated completely.
+// The main thread takes the chunk results in file order and drops every packet that starts
+// before the end of the last accepted one, i.e. a sync inside a packet that the previous chunk
+// already delivered. What is left is printed in timestamp order.
+// Workers run at most LEN_WINDOW_PER_THREAD chunks per thread ahead of the output, so memory
+// stays bounded for captures of any size.
+
+#include "common.h"
+#include "btle_phy.h"
+#include "btle_pdu.h"
+#include "btle_filter.h"
+#include "btle_iqfile.h"
+#include "btle_aa.h"
+#include "btle_cte.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+//----------------------------------print_usage----------------------------------
+static void print_usage() {
+	printf("Usage: btle_replay [options] capture.cs8|cs16|cf32\n");
+  printf("    -h --help\n");
+  printf("      print this help screen\n");
+  printf("    -c --chan\n");
+  printf("      channel number the capture was taken on. default: from the file header, else 37. valid range 0~39\n");
+  printf("    -j --threads\n");
+  printf("      number of worker threads. default: number of online CPUs\n");
+  printf("    -b --chunk\n");
+  printf("      chunk length in M IQ samples per worker job. default 8 (2s of capture)\n");
+  printf("    -F --filter\n");
+  printf("      packet filter, same syntax as btle_rx -F. may be given more than once\n");
+  printf("    -D --link\n");
+  printf("      AA:CRCInit of a connection, e.g. 60850A1B:A77B22: demodulate its data channel PDUs\n");
+  printf("    -p --promisc\n");
+  printf("      discover the access addresses of connections instead of printing packets, as btle_rx -p\n");
+  printf("    -A --ad\n");
+  printf("      also print AdvData decoded into its AD structures (name, UUIDs, beacons, ...)\n");
+  printf("    -q --quiet\n");
+  printf("      do not print packets, only the summary\n");
+  printf("\nSee README for detailed information.\n");
+}
+//----------------------------------print_usage----------------------------------
+
+//----------------------------------chunking----------------------------------
+#define SAMPLE_RATE (SAMPLE_PER_SYMBOL*1000000.0)
+#define DEFAULT_CHANNEL 37
+#define DEFAULT_CHUNK_MSAMPLE 8
+#define MAX_NUM_THREAD 256
+#define LEN_WINDOW_PER_THREAD 2 // chunks in flight per worker
+
+// one maximum packet (preamble to the end of its CTE), in IQ_TYPE elements
+#define LEN_OVERLAP (2*(MAX_NUM_EXT_PHY_BYTE*8*SAMPLE_PER_SYMBOL+MAX_NUM_CTE_SAMPLE))
+// search_unique_bits() looks one sample past the searched range
+#define LEN_SEARCH_MARGIN (2*SAMPLE_PER_SYMBOL)
+
+typedef struct {
+  uint64_t sample_idx;  // absolute IQ_TYPE element index of the preamble
+  double toa;           // IQ samples from the start of the file to the preamble, sub-sample. see toa_estimate
+  int len;              // IQ_TYPE elements from the preamble to the end of the CRC
+  int channel_number;
+  uint32_t access_addr;
+  int data_pdu;
+  int empty_pdu;        // -p: a candidate access address followed by an empty PDU header
+  uint32_t crc_init;    // -p: see AA_HIT
+  int pdu_type;
+  int tx_add;
+  int rx_add;
+  int payload_len;
+  int crc_flag;
+  float rssi;
+  uint8_t byte[2+MAX_NUM_EXT_PAYLOAD_BYTE+3];
+} REPLAY_PKT;
+
+typedef struct {
+  volatile int done;    // set by the worker, cleared by the merger. under pool_lock
+  uint64_t chunk_start; // absolute IQ_TYPE element index of the chunk
+  int num_pkt;
+  int max_num_pkt;
+  REPLAY_PKT *pkt;
+  BTLE_RX_STAT stat;
+} CHUNK_RESULT;
+
+// read-only after setup
+IQ_FILE capture;        // mmap of the whole file
+uint64_t num_element;   // I and Q counted separately
+uint64_t len_chunk;     // IQ_TYPE elements per chunk
+int num_chunk;
+int num_slot;
+int channel_number;
+BTLE_FILTER replay_filter;
+BTLE_FILTER *filter_active;
+BTLE_LINK replay_link;
+int promisc;
+
+// worker pool state, under pool_lock
+CHUNK_RESULT *slot;
+int next_chunk = 0;     // next chunk a worker will take
+int num_merged = 0;     // chunks the merger has finished with
+pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t slot_free = PTHREAD_COND_INITIALIZER;
+pthread_cond_t chunk_done = PTHREAD_COND_INITIALIZER;
+
+static void collect_pkt(BTLE_PKT *pkt, void *arg) {
+  CHUNK_RESULT *r = (CHUNK_RESULT *)arg;
+  REPLAY_PKT *p;
+
+  if (r->num_pkt == r->max_num_pkt) {
+    p = (REPLAY_PKT *)realloc(r->pkt, 2*r->max_num_pkt*sizeof(REPLAY_PKT));
+    if (p == NULL) {
+      printf("collect_pkt: realloc failed! packet dropped\n");
+      return;
+    }
+    r->pkt = p;
+    r->max_num_pkt = 2*r->max_num_pkt;
+  }
+
+  p = r->pkt + r->num_pkt;
+  p->sample_idx = r->chunk_start + pkt->pkt_start;
+  p->toa = (double)(p->sample_idx/2) + pkt->toa;
+  p->len = pkt->pkt_end - pkt->pkt_start;
+  p->channel_number = pkt->channel_number;
+  p->access_addr = pkt->access_addr;
+  p->data_pdu = pkt->data_pdu;
+  p->pdu_type = pkt->pdu_type;
+  p->tx_add = pkt->tx_add;
+  p->rx_add = pkt->rx_add;
+  p->payload_len = pkt->payload_len;
+  p->crc_flag = pkt->crc_flag;
+  p->rssi = pkt->rssi;
+  memcpy(p->byte, pkt->byte, pkt->payload_len+2+3);
+  r->num_pkt++;
+}
+
+static void collect_hit(AA_HIT *hit, void *arg) {
+  CHUNK_RESULT *r = (CHUNK_RESULT *)arg;
+  BTLE_PKT pkt;
+  int num_pkt = r->num_pkt;
+
+  // the packet list carries the hit, see aa_hit_of
+  memset(&pkt, 0, sizeof(pkt));
+  pkt.cte_info = -1;
+  pkt.pkt_start = hit->pkt_start;
+  pkt.pkt_end = hit->pkt_end;
+  pkt.toa = 0;
+  pkt.channel_number = hit->channel_number;
+  pkt.access_addr = hit->access_addr;
+  pkt.data_pdu = 1;
+  pkt.llid = hit->llid;
+  pkt.payload_len = hit->payload_len;
+  pkt.rssi = hit->rssi;
+  pkt.byte = hit->byte;
+  collect_pkt(&pkt, arg);
+  if (r->num_pkt != num_pkt) {
+    r->pkt[num_pkt].empty_pdu = hit->empty_pdu;
+    r->pkt[num_pkt].crc_init = hit->crc_init;
+  }
+}
+
+static void aa_hit_of(REPLAY_PKT *p, AA_HIT *hit) {
+  int nesn, sn, md;
+  hit->channel_number = p->channel_number;
+  hit->access_addr = p->access_addr;
+  parse_data_pdu_header_byte(p->byte, &(hit->llid), &nesn, &sn, &md, &(hit->payload_len));
+  hit->empty_pdu = p->empty_pdu;
+  memcpy(hit->byte, p->byte, sizeof(hit->byte));
+  hit->crc_init = p->crc_init;
+  hit->rssi = p->rssi;
+}
+
+// conv_buf: len_chunk+LEN_OVERLAP IQ_TYPE elements, only needed when the file is not IQ_TYPE
+static void demod_chunk(int idx, CHUNK_RESULT *r, IQ_TYPE *conv_buf) {
+  uint64_t start = (uint64_t)idx*len_chunk;
+  uint64_t len = num_element - start;
+  int buf_len, demod_buf_len;
+  IQ_TYPE *rxp;
+
+  // the last chunk has no overlap and must not be read past the end of the file
+  if ( len > (len_chunk+LEN_OVERLAP) ) {
+    len = len_chunk+LEN_OVERLAP;
+    demod_buf_len = (int)len;
+    buf_len = (int)len_chunk + (LEN_DEMOD_BUF_PREAMBLE_ACCESS-1)*2*SAMPLE_PER_SYMBOL;
+  } else {
+    demod_buf_len = (int)len - LEN_SEARCH_MARGIN;
+    buf_len = demod_buf_len;
+  }
+
+  rxp = iq_file_ptr(&capture, start/2);
+  if (rxp == NULL) {
+    iq_file_read(&capture, start/2, (int)(len/2), conv_buf);
+    rxp = conv_buf;
+  }
+
+  r->chunk_start = start;
+  r->num_pkt = 0;
+  memset(&(r->stat), 0, sizeof(r->stat));
+  if (buf_len > 0 && promisc) {
+    aa_search_block(rxp, buf_len, demod_buf_len, channel_number, collect_hit, r);
+  } else if (buf_len > 0) {
+    receiver_block(rxp, buf_len, demod_buf_len, channel_number, &replay_link, filter_active, &(r->stat), collect_pkt, r);
+  }
+}
+
+void *worker_thread(void *arg) {
+  IQ_TYPE *conv_buf = (IQ_TYPE *)arg;
+  CHUNK_RESULT *r;
+  int idx;
+
+  while (1) {
+    pthread_mutex_lock(&pool_lock);
+    while ( next_chunk < num_chunk && (next_chunk - num_merged) >= num_slot ) {
+      pthread_cond_wait(&slot_free, &pool_lock);
+    }
+    if (next_chunk == num_chunk) {
+      pthread_mutex_unlock(&pool_lock);
+      break;
+    }
+    idx = next_chunk;
+    next_chunk++;
+    pthread_mutex_unlock(&pool_lock);
+
+    r = slot + (idx%num_slot);
+    demod_chunk(idx, r, conv_buf);
+
+    pthread_mutex_lock(&pool_lock);
+    r->done = 1;
+    pthread_cond_broadcast(&chunk_done);
+    pthread_mutex_unlock(&pool_lock);
+  }
+
+  return(NULL);
+}
+//----------------------------------chunking----------------------------------
+
+//----------------------------------command line parameters----------------------------------
+void parse_commandline(
+  // Inputs
+  int argc,
+  char * const argv[],
+  // Outputs
+  char** file_name,
+  int* chan,
+  int* num_thread,
+  int* chunk_msample,
+  int* quiet,
+  int* ad,
+  int* promisc,
+  BTLE_LINK* link,
+  BTLE_FILTER* filter
+) {
+  // Default values
+  (*chan) = -1; // from the file
+
+  (*num_thread) = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if ( (*num_thread)<1 ) {
+    (*num_thread) = 1;
+  }
+
+  (*chunk_msample) = DEFAULT_CHUNK_MSAMPLE;
+
+  (*quiet) = 0;
+
+  (*ad) = 0;
+
+  (*promisc) = 0;
+
+  link_init(link, ADV_ACCESS_ADDR, ADV_CRC_INIT);
+
+  filter_init(filter);
+
+  while (1) {
+    static struct option long_options[] = {
+      {"help",         no_argument,       0, 'h'},
+      {"chan",         required_argument, 0, 'c'},
+      {"threads",      required_argument, 0, 'j'},
+      {"chunk",        required_argument, 0, 'b'},
+      {"filter",       required_argument, 0, 'F'},
+      {"quiet",        no_argument,       0, 'q'},
+      {"ad",           no_argument,       0, 'A'},
+      {"link",         required_argument, 0, 'D'},
+      {"promisc",      no_argument,       0, 'p'},
+      {0, 0, 0, 0}
+    };
+    /* getopt_long stores the option index here. */
+    int option_index = 0;
+    int c = getopt_long (argc, argv, "hc:j:b:F:qAD:p",
+                     long_options, &option_index);
+
+    /* Detect the end of the options. */
+    if (c == -1)
+      break;
+
+    switch (c) {
+      char * endp;
+      case 'c':
+        (*chan) = strtol(optarg,&endp,10);
+        break;
+
+      case 'j':
+        (*num_thread) = strtol(optarg,&endp,10);
+        break;
+
+      case 'b':
+        (*chunk_msample) = strtol(optarg,&endp,10);
+        break;
+
+      case 'F':
+        if ( parse_filter(optarg, filter) != 0 ) {
+          goto abnormal_quit;
+        }
+        break;
+
+      case 'q':
+        (*quiet) = 1;
+        break;
+
+      case 'A':
+        (*ad) = 1;
+        break;
+
+      case 'D':
+        if ( parse_link(optarg, link) != 0 ) {
+          goto abnormal_quit;
+        }
+        break;
+
+      case 'p':
+        (*promisc) = 1;
+        break;
+
+      case 'h':
+      case '?':
+      default:
+        goto abnormal_quit;
+    }
+  }
+
+  if ( (*chan)<-1 || (*chan)>MAX_CHANNEL_NUMBER ) {
+    printf("channel number must be within 0~%d!\n", MAX_CHANNEL_NUMBER);
+    goto abnormal_quit;
+  }
+
+  if ( (*num_thread)<1 || (*num_thread)>MAX_NUM_THREAD ) {
+    printf("number of threads must be within 1~%d!\n", MAX_NUM_THREAD);
+    goto abnormal_quit;
+  }
+
+  if ( (*promisc) && link->data_pdu ) {
+    printf("-p and -D exclude each other!\n");
+    goto abnormal_quit;
+  }
+
+  if ( (*chunk_msample)<1 || (*chunk_msample)>256 ) {
+    printf("chunk length must be within 1~256 M samples!\n");
+    goto abnormal_quit;
+  }
+
+  if (optind != argc-1) {
+    printf("Error: one capture file expected\n");
+    goto abnormal_quit;
+  }
+  (*file_name) = argv[optind];
+
+  return;
+
+abnormal_quit:
+  print_usage();
+  exit(-1);
+}
+//----------------------------------command line parameters----------------------------------
+
+// channel of the center frequency in the file header, DEFAULT_CHANNEL if there is none
+static int channel_from_file(IQ_FILE *f) {
+  int i;
+  for (i=0; i<=MAX_CHANNEL_NUMBER; i++) {
+    if ( get_freq_by_channel_number(i) == f->info.freq_hz ) {
+      return(i);
+    }
+  }
+  return(DEFAULT_CHANNEL);
+}
+
+static double time_diff_s(struct timeval *t1, struct timeval *t0) {
+  return( (t1->tv_sec - t0->tv_sec) + (t1->tv_usec - t0->tv_usec)/1000000.0 );
+}
+
+int main(int argc, char** argv) {
+  char *file_name;
+  int chan, num_thread, chunk_msample, quiet, ad, i, j, pkt_count, llid, nesn, sn, md, payload_len;
+  uint64_t last_end, num_dup, num_hit, num_header_reject, num_crc_ok, num_crc_err, num_filter_reject;
+  pthread_t tid[MAX_NUM_THREAD];
+  IQ_TYPE *conv_buf[MAX_NUM_THREAD];
+  CHUNK_RESULT *r;
+  REPLAY_PKT *p;
+  ADV_PDU_PAYLOAD adv_pdu_payload;
+  AA_TABLE aa_table;
+  AA_ENTRY *e;
+  AA_HIT hit;
+  int event;
+  struct timeval time_start, time_end;
+  double run_s;
+
+  parse_commandline(argc, argv, &file_name, &chan, &num_thread, &chunk_msample, &quiet, &ad, &promisc, &replay_link, &replay_filter);
+  filter_active = ( filter_is_active(&replay_filter)? &replay_filter : NULL );
+
+  if ( iq_file_open(&capture, file_name) != 0 ) {
+    return(1);
+  }
+  if ( capture.info.sample_rate != (uint64_t)SAMPLE_RATE ) {
+    printf("main: %s is at %.3fMsps, btle_replay needs %.0fMsps!\n", file_name, capture.info.sample_rate/1e6, SAMPLE_RATE/1e6);
+    return(1);
+  }
+  num_element = 2*capture.num_iq;
+  if (num_element <= LEN_SEARCH_MARGIN) {
+    printf("main: %s is too short!\n", file_name);
+    return(1);
+  }
+  channel_number = ( chan < 0? channel_from_file(&capture) : chan );
+
+  len_chunk = (uint64_t)chunk_msample*1000000*2;
+  num_chunk = (int)( (num_element + len_chunk - 1)/len_chunk );
+  if (num_thread > num_chunk) {
+    num_thread = num_chunk;
+  }
+  num_slot = LEN_WINDOW_PER_THREAD*num_thread;
+
+  slot = (CHUNK_RESULT *)calloc(num_slot, sizeof(CHUNK_RESULT));
+  if (slot == NULL) {
+    printf("main: calloc failed!\n");
+    return(1);
+  }
+  for (i=0; i<num_slot; i++) {
+    slot[i].max_num_pkt = 1024;
+    slot[i].pkt = (REPLAY_PKT *)malloc(slot[i].max_num_pkt*sizeof(REPLAY_PKT));
+    if (slot[i].pkt == NULL) {
+      printf("main: malloc failed!\n");
+      return(1);
+    }
+  }
+
+  receiver_init();
+  aa_table_init(&aa_table);
+
+  printf("# btle_replay: %s, %s%s, %.1fs of capture, channel %d, %d chunks, %d threads\n",
+    file_name, IQ_FORMAT_STR[capture.info.format], (capture.has_header? " with header" : ""), (num_element/2)/SAMPLE_RATE,
+    channel_number, num_chunk, num_thread);
+  if (replay_link.data_pdu) {
+    printf("# link: AA %08X CRCInit %06X, data channel PDUs\n", replay_link.access_addr, replay_link.crc_init);
+  }
+
+  gettimeofday(&time_start, NULL);
+  for (i=0; i<num_thread; i++) {
+    conv_buf[i] = NULL;
+    if ( iq_file_ptr(&capture, 0) == NULL ) {
+      conv_buf[i] = (IQ_TYPE *)malloc((len_chunk+LEN_OVERLAP)*sizeof(IQ_TYPE));
+      if (conv_buf[i] == NULL) {
+        printf("main: malloc failed!\n");
+        return(1);
+      }
+    }
+    if ( pthread_create(tid+i, NULL, worker_thread, conv_buf[i]) != 0 ) {
+      printf("main: pthread_create failed!\n");
+      return(1);
+    }
+  }
+
+  // merge in chunk order
+  pkt_count = 0;
+  last_end = 0;
+  num_dup = num_hit = num_header_reject = num_crc_ok = num_crc_err = num_filter_reject = 0;
+  for (i=0; i<num_chunk; i++) {
+    r = slot + (i%num_slot);
+    pthread_mutex_lock(&pool_lock);
+    while (r->done == 0) {
+      pthread_cond_wait(&chunk_done, &pool_lock);
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    for (j=0; j<r->num_pkt; j++) {
+      p = r->pkt + j;
+      if (p->sample_idx < last_end) {
+        num_dup++;
+        continue;
+      }
+      last_end = p->sample_idx + p->len;
+      pkt_count++;
+      if (promisc) {
+        aa_hit_of(p, &hit);
+        e = aa_table_add(&aa_table, &hit, (int64_t)((p->sample_idx/2)*(1e9/SAMPLE_RATE)), &event);
+        if (event & AA_EVENT_PROMOTED) {
+          printf("%.2fus AA:%08X promoted on ch%d after %u hits, %u empty PDUs in %.3fs\n", (p->sample_idx/2)/(SAMPLE_RATE/1e6),
+            e->access_addr, p->channel_number, e->num_hit, e->num_empty, (e->last_ns - e->first_ns)/1e9);
+        }
+        if (event & AA_EVENT_CRC_INIT) {
+          printf("%.2fus AA:%08X CRCInit %06X confirmed on ch%d by %u PDUs\n", (p->sample_idx/2)/(SAMPLE_RATE/1e6),
+            e->access_addr, e->crc_init, p->channel_number, e->num_crc_agree);
+        }
+        // once the CRCInit is confirmed the hits are packets of the link, printed as -D does
+        if ( e == NULL || !e->crc_confirmed ) {
+          continue;
+        }
+        p->crc_flag = aa_crc_check(e, &hit);
+        if (p->crc_flag) {
+          num_crc_err++;
+        } else {
+          num_crc_ok++;
+        }
+      }
+      if (quiet) {
+        continue;
+      }
+      if (p->data_pdu) {
+        parse_data_pdu_header_byte(p->byte, &llid, &nesn, &sn, &md, &payload_len);
+        printf("%.3fus Pkt%d Ch%d AA:%08X LLID%d:%s NESN%d SN%d MD%d PloadL%d ", p->toa/(SAMPLE_RATE/1e6), pkt_count, p->channel_number, p->access_addr, llid, LLID_STR[llid], nesn, sn, md, payload_len);
+        print_data_pdu_payload(p->byte+2, llid, payload_len, p->crc_flag, 0);
+        continue;
+      }
+      printf("%.3fus Pkt%d Ch%d AA:%08X PDU_t%d:%s T%d R%d PloadL%d ", p->toa/(SAMPLE_RATE/1e6), pkt_count, p->channel_number, p->access_addr, p->pdu_type, PDU_TYPE_STR[p->pdu_type], p->tx_add, p->rx_add, p->payload_len);
+      if (p->pdu_type == ADV_EXT_PDU_TYPE) {
+        print_ext_adv(p->byte+2, p->payload_len, p->crc_flag, 0, ad);
+      } else if (parse_adv_pdu_payload_byte(p->byte+2, p->payload_len, p->pdu_type, (void *)(&adv_pdu_payload) ) == 0 ) {
+        print_pdu_payload((void *)(&adv_pdu_payload), p->pdu_type, p->payload_len, p->crc_flag, 0, ad);
+      }
+    }
+
+    num_hit = num_hit + r->stat.num_hit;
+    num_header_reject = num_header_reject + r->stat.num_header_reject;
+    num_crc_ok = num_crc_ok + r->stat.num_crc_ok;
+    num_crc_err = num_crc_err + r->stat.num_crc_err;
+    for (j=0; j<NUM_FILTER_STAGE; j++) {
+      num_filter_reject = num_filter_reject + r->stat.num_filter_reject[j];
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    r->done = 0;
+    num_merged++;
+    pthread_cond_broadcast(&slot_free);
+    pthread_mutex_unlock(&pool_lock);
+  }
+
+  for (i=0; i<num_thread; i++) {
+    pthread_join(tid[i], NULL);
+    free(conv_buf[i]);
+  }
+  gettimeofday(&time_end, NULL);
+  run_s = time_diff_s(&time_end, &time_start);
+
+  printf("# %d packets, %llu overlap duplicates dropped, hits %llu, header rejects %llu, CRC ok %llu, CRC err %llu, filter rejects %llu\n",
+    pkt_count, (unsigned long long)num_dup, (unsigned long long)num_hit, (unsigned long long)num_header_reject,
+    (unsigned long long)num_crc_ok, (unsigned long long)num_crc_err, (unsigned long long)num_filter_reject);
+  printf("# %.2fs, %.1f Msps, %.1fx real time\n", run_s,
+    run_s>0? (num_element/2)/run_s/1e6 : 0.0, run_s>0? (num_element/2)/SAMPLE_RATE/run_s : 0.0);
+  if (promisc) {
+    aa_table_print(&aa_table, 2);
+  }
+
+  for (i=0; i<num_slot; i++) {
+    free(slot[i].pkt);
+  }
+  free(slot);
+  iq_file_close(&capture);
+  return(0);
+}
@@ -0,0 +1,370 @@
+// Locked sample memory and real-time threads for the btle receiver
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _WIN32
+#define _GNU_SOURCE // MAP_HUGETLB, CPU_SET, pthread_setaffinity_np
+#endif
+
+#include "btle_rt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+#define LEN_HUGE_PAGE (2*1024*1024)
+#define MAX_LEN_RT_LINE 256
+
+char *RT_MEM_STR[NUM_RT_MEM] = {
+    "default",
+    "lock",
+    "huge"
+};
+
+char *RT_THREAD_STR[NUM_RT_THREAD] = {
+    "usb",
+    "demod",
+    "output"
+};
+
+void rt_init(RT_CONF *conf) {
+  memset(conf, 0, sizeof(RT_CONF));
+  conf->mem = RT_MEM_DEFAULT;
+}
+
+//----------------------------------parser----------------------------------
+// 2,4-5
+static int parse_cpu_list(char *str, RT_THREAD *t) {
+  char *p = str, *endp;
+  long first, last, i;
+
+  t->num_cpu = 0;
+  while (1) {
+    first = strtol(p, &endp, 10);
+    last = first;
+    if (endp == p) {
+      goto invalid;
+    }
+    if ( (*endp) == '-' ) {
+      p = endp + 1;
+      last = strtol(p, &endp, 10);
+      if (endp == p) {
+        goto invalid;
+      }
+    }
+    if ( first < 0 || last < first || last >= RT_MAX_CPU ) {
+      goto invalid;
+    }
+    for (i=first; i<=last && t->num_cpu<RT_MAX_CPU; i++) {
+      t->cpu[t->num_cpu] = (int)i;
+      t->num_cpu++;
+    }
+    if ( (*endp) == 0 ) {
+      return(0);
+    }
+    if ( (*endp) != ',' ) {
+      goto invalid;
+    }
+    p = endp + 1;
+  }
+
+invalid:
+  printf("rt_parse: invalid CPU list %s! e.g. 2,4-5, CPUs 0~%d\n", str, RT_MAX_CPU-1);
+  return(-1);
+}
+
+// prio[@cpus]
+static int parse_thread(char *str, RT_THREAD *t) {
+  char *endp;
+  long prio = strtol(str, &endp, 10);
+
+  if ( endp == str || prio < 0 || prio > 99 ) {
+    printf("rt_parse: invalid priority %s! 1~99 for SCHED_FIFO, 0 to leave scheduling alone\n", str);
+    return(-1);
+  }
+  t->prio = (int)prio;
+  if ( (*endp) == '@' ) {
+    return( parse_cpu_list(endp+1, t) );
+  }
+  if ( (*endp) != 0 ) {
+    printf("rt_parse: invalid priority %s! prio or prio@cpus\n", str);
+    return(-1);
+  }
+  t->num_cpu = 0;
+  return(0);
+}
+
+static int parse_file(const char *name, RT_CONF *conf) {
+  char line[MAX_LEN_RT_LINE], *p, *q;
+  int line_no = 0;
+  FILE *fp = fopen(name, "r");
+
+  if (fp == NULL) {
+    printf("rt_parse: can not open %s!\n", name);
+    return(-1);
+  }
+  while ( fgets(line, sizeof(line), fp) != NULL ) {
+    line_no++;
+    p = strchr(line, '#');
+    if (p != NULL) {
+      (*p) = 0;
+    }
+    for (p=line, q=line; (*p)!=0; p++) { // "demod = 50 @ 2" is fine too
+      if ( !isspace((unsigned char)(*p)) ) {
+        (*q) = (*p);
+        q++;
+      }
+    }
+    (*q) = 0;
+    if (line[0] == 0) {
+      continue;
+    }
+    if ( line[0] == '@' || rt_parse(line, conf) != 0 ) {
+      printf("rt_parse: %s line %d not accepted!\n", name, line_no);
+      fclose(fp);
+      return(-1);
+    }
+  }
+  fclose(fp);
+  return(0);
+}
+
+int rt_parse(char *item, RT_CONF *conf) {
+  int i, len;
+
+  if (item[0] == '@') {
+    return( parse_file(item+1, conf) );
+  }
+  if (strncmp(item, "mem=", 4) == 0) {
+    for (i=0; i<NUM_RT_MEM; i++) {
+      if (strcmp(item+4, RT_MEM_STR[i]) == 0) {
+        conf->mem = (RT_MEM_MODE)i;
+        return(0);
+      }
+    }
+    printf("rt_parse: mem must be default, lock or huge!\n");
+    return(-1);
+  }
+  for (i=0; i<NUM_RT_THREAD; i++) {
+    len = (int)strlen(RT_THREAD_STR[i]);
+    if ( strncmp(item, RT_THREAD_STR[i], len) == 0 && item[len] == '=' ) {
+      return( parse_thread(item+len+1, conf->thread+i) );
+    }
+  }
+  printf("rt_parse: %s unknown! mem=default|lock|huge, usb|demod|output=prio[@cpus] or @file\n", item);
+  return(-1);
+}
+//----------------------------------parser----------------------------------
+
+#ifndef _WIN32
+
+//----------------------------------startup check----------------------------------
+void rt_check(RT_CONF *conf, size_t mem_len) {
+  struct rlimit lim;
+  int i, prio_max = 0, num_cpu = (int)sysconf(_SC_NPROCESSORS_CONF);
+  FILE *fp;
+
+  if ( conf->mem != RT_MEM_DEFAULT && getrlimit(RLIMIT_MEMLOCK, &lim) == 0 &&
+       lim.rlim_cur != RLIM_INFINITY && lim.rlim_cur < mem_len && geteuid() != 0 ) {
+    printf("rt: RLIMIT_MEMLOCK is %llukB, %llukB needed. mlock fails without CAP_IPC_LOCK (ulimit -l)\n",
+      (unsigned long long)lim.rlim_cur/1024, (unsigned long long)mem_len/1024);
+  }
+  if (conf->mem == RT_MEM_HUGE) {
+    i = 0;
+    fp = fopen("/proc/sys/vm/nr_hugepages", "r");
+    if ( fp == NULL || fscanf(fp, "%d", &i) != 1 || i == 0 ) {
+      printf("rt: no huge pages reserved (vm.nr_hugepages), transparent huge pages only\n");
+    }
+    if (fp != NULL) {
+      fclose(fp);
+    }
+  }
+
+  for (i=0; i<NUM_RT_THREAD; i++) {
+    int j;
+    prio_max = ( conf->thread[i].prio > prio_max? conf->thread[i].prio : prio_max );
+    for (j=0; j<conf->thread[i].num_cpu; j++) {
+      if (conf->thread[i].cpu[j] >= num_cpu) {
+        printf("rt: %s CPU %d does not exist, this host has %d\n", RT_THREAD_STR[i], conf->thread[i].cpu[j], num_cpu);
+      }
+    }
+  }
+#ifdef RLIMIT_RTPRIO
+  if ( prio_max > 0 && getrlimit(RLIMIT_RTPRIO, &lim) == 0 &&
+       lim.rlim_cur != RLIM_INFINITY && lim.rlim_cur < (rlim_t)prio_max && geteuid() != 0 ) {
+    printf("rt: RLIMIT_RTPRIO is %llu, %d needed. SCHED_FIFO fails without CAP_SYS_NICE (ulimit -r)\n",
+      (unsigned long long)lim.rlim_cur, prio_max);
+  }
+#endif
+}
+//----------------------------------startup check----------------------------------
+
+//----------------------------------memory----------------------------------
+int rt_alloc(RT_MEM *m, size_t len, RT_MEM_MODE mode) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+  memset(m, 0, sizeof(RT_MEM));
+#ifdef MAP_HUGETLB
+  if (mode == RT_MEM_HUGE) {
+    m->len = (len + LEN_HUGE_PAGE - 1)&(~((size_t)LEN_HUGE_PAGE-1));
+    m->p = mmap(NULL, m->len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    if (m->p == MAP_FAILED) {
+      m->p = NULL;
+    } else {
+      m->huge = 1;
+    }
+  }
+#endif
+  if (m->p == NULL) {
+    m->len = (len + page - 1)&(~(page-1));
+    m->p = mmap(NULL, m->len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (m->p == MAP_FAILED) {
+      m->p = NULL;
+      printf("rt_alloc: out of memory!\n");
+      return(-1);
+    }
+#ifdef MADV_HUGEPAGE
+    if ( mode == RT_MEM_HUGE && madvise(m->p, m->len, MADV_HUGEPAGE) == 0 ) {
+      m->huge = 2;
+    }
+#endif
+  }
+  if (mode != RT_MEM_DEFAULT) {
+    if (mlock(m->p, m->len) == 0) {
+      m->locked = 1;
+    } else {
+      printf("rt_alloc: mlock of %llukB failed (%s)!\n", (unsigned long long)m->len/1024, strerror(errno));
+    }
+  }
+  memset(m->p, 0, m->len); // fault every page in now
+  return(0);
+}
+
+void rt_free(RT_MEM *m) {
+  if (m->p != NULL) {
+    munmap(m->p, m->len); // unlocks too
+  }
+  memset(m, 0, sizeof(RT_MEM));
+}
+//----------------------------------memory----------------------------------
+
+//----------------------------------threads----------------------------------
+int rt_thread_apply(RT_THREAD *t, pthread_t thread, int idx, const char *name, const char *tag) {
+  char sched_str[32] = "", cpu_str[32] = "";
+  int ret = 0, err;
+
+  if (t->prio > 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = t->prio;
+    err = pthread_setschedparam(thread, SCHED_FIFO, &param);
+    if (err != 0) {
+      printf("rt: %s%s SCHED_FIFO %d not granted (%s)! needs CAP_SYS_NICE or ulimit -r %d\n", name, tag, t->prio, strerror(err), t->prio);
+      ret = -1;
+    } else {
+      snprintf(sched_str, sizeof(sched_str), " SCHED_FIFO %d", t->prio);
+    }
+  }
+
+  if (t->num_cpu > 0) {
+#ifdef __linux__
+    cpu_set_t set;
+    int i;
+    CPU_ZERO(&set);
+    if (idx >= 0) {
+      CPU_SET(t->cpu[idx%t->num_cpu], &set);
+      snprintf(cpu_str, sizeof(cpu_str), " CPU %d", t->cpu[idx%t->num_cpu]);
+    } else {
+      for (i=0; i<t->num_cpu; i++) {
+        CPU_SET(t->cpu[i], &set);
+      }
+      snprintf(cpu_str, sizeof(cpu_str), " %d CPUs from %d", t->num_cpu, t->cpu[0]);
+    }
+    err = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (err != 0) {
+      printf("rt: %s%s CPU affinity not granted (%s)!\n", name, tag, strerror(err));
+      cpu_str[0] = 0;
+      ret = -1;
+    }
+#else
+    printf("rt: %s%s CPU affinity not supported on this OS!\n", name, tag);
+    ret = -1;
+#endif
+  }
+
+  if (sched_str[0] != 0 || cpu_str[0] != 0) {
+    printf("rt: %s%s%s%s\n", name, tag, sched_str, cpu_str);
+  }
+  return(ret);
+}
+
+int rt_lock_all(void) {
+  if (mlockall(MCL_CURRENT) != 0) {
+    printf("rt: mlockall failed (%s)! code and stacks stay pageable\n", strerror(errno));
+    return(-1);
+  }
+  return(0);
+}
+//----------------------------------threads----------------------------------
+
+#else
+
+void rt_check(RT_CONF *conf, size_t mem_len) {
+}
+
+int rt_alloc(RT_MEM *m, size_t len, RT_MEM_MODE mode) {
+  memset(m, 0, sizeof(RT_MEM));
+  if (mode != RT_MEM_DEFAULT) {
+    printf("rt_alloc: locked memory not supported on Windows!\n");
+  }
+  m->p = calloc(1, len);
+  if (m->p == NULL) {
+    printf("rt_alloc: out of memory!\n");
+    return(-1);
+  }
+  m->len = len;
+  return(0);
+}
+
+void rt_free(RT_MEM *m) {
+  free(m->p);
+  memset(m, 0, sizeof(RT_MEM));
+}
+
+int rt_thread_apply(RT_THREAD *t, pthread_t thread, int idx, const char *name, const char *tag) {
+  if (t->prio > 0 || t->num_cpu > 0) {
+    printf("rt: %s%s real-time scheduling not supported on Windows!\n", name, tag);
+    return(-1);
+  }
+  return(0);
+}
+
+int rt_lock_all(void) {
+  return(-1);
+}
+
+#endif
@@ -0,0 +1,74 @@
+// Locked sample memory and real-time threads for the btle receiver
+//
+// rt_alloc() hands out sample rings from anonymous mappings that are touched once, so the rx
+// callback and the demod thread never take a page fault on them. RT_MEM_LOCK also mlock()s
+// them; RT_MEM_HUGE first tries explicit huge pages (MAP_HUGETLB, needs vm.nr_hugepages),
+// then asks for transparent huge pages, and locks either way.
+// rt_thread_apply() gives a thread SCHED_FIFO priority and CPU affinity. Per-board threads
+// take the idx-th CPU of their list (round robin), so several boards spread over the list.
+// Nothing here is fatal: what the system refuses is reported, together with what is missing
+// (CAP_IPC_LOCK / RLIMIT_MEMLOCK, CAP_SYS_NICE / RLIMIT_RTPRIO), and the receiver runs on.
+
+#ifndef BTLE_RT_H
+#define BTLE_RT_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define RT_MAX_CPU 64   // CPU numbers 0~RT_MAX_CPU-1
+
+typedef enum {
+  RT_MEM_DEFAULT,       // pageable
+  RT_MEM_LOCK,
+  RT_MEM_HUGE,
+  NUM_RT_MEM
+} RT_MEM_MODE;
+
+extern char *RT_MEM_STR[NUM_RT_MEM];
+
+typedef struct {
+  void *p;
+  size_t len;           // mapped, rounded up to the page size used
+  int huge;             // 1: MAP_HUGETLB. 2: transparent huge pages asked for
+  int locked;
+} RT_MEM;
+
+typedef enum {
+  RT_THREAD_USB,        // board streaming thread, runs rx_callback
+  RT_THREAD_DEMOD,
+  RT_THREAD_OUTPUT,
+  NUM_RT_THREAD
+} RT_THREAD_TYPE;
+
+extern char *RT_THREAD_STR[NUM_RT_THREAD];
+
+typedef struct {
+  int prio;             // SCHED_FIFO 1~99. 0: scheduling left alone
+  int num_cpu;          // 0: affinity left alone
+  int cpu[RT_MAX_CPU];
+} RT_THREAD;
+
+typedef struct {
+  RT_MEM_MODE mem;
+  RT_THREAD thread[NUM_RT_THREAD];
+} RT_CONF;
+
+void rt_init(RT_CONF *conf);
+// mem=default|lock|huge or thread=prio[@cpus], thread usb, demod or output, cpus e.g. 2,4-5.
+// @file reads one such item per line, # starts a comment. returns -1 on failure
+int rt_parse(char *item, RT_CONF *conf);
+// prints the limits that will get in the way of conf, before anything is started.
+// mem_len: bytes rt_alloc() will be asked for in total
+void rt_check(RT_CONF *conf, size_t mem_len);
+
+// zeroed, page aligned. returns -1 only if no memory at all could be had
+int rt_alloc(RT_MEM *m, size_t len, RT_MEM_MODE mode);
+void rt_free(RT_MEM *m);
+
+// thread is the idx-th of its type and gets the idx-th CPU of the list; -1: the whole list.
+// name and tag for the report. returns -1 if anything asked for was refused
+int rt_thread_apply(RT_THREAD *t, pthread_t thread, int idx, const char *name, const char *tag);
+// mlockall(MCL_CURRENT) once everything is running: code, stacks and driver buffers too
+int rt_lock_all(void);
+
+#endif
@@ -23,26 +23,36 @@
  */
 
 #include "common.h"
-
-#ifdef USE_BLADERF
-#include <libbladeRF.h>
-#else
-#include <hackrf.h>
-#endif
+#include "btle_phy.h"
+#include "btle_pdu.h"
+#include "btle_board.h"
+#include "btle_agc.h"
+#include "btle_iqcorr.h"
+#include "btle_decim.h"
+#include "btle_iqrec.h"
+#include "btle_iqfile.h"
+#include "btle_rt.h"
+#include "btle_aa.h"
+#include "btle_follow.h"
+#include "btle_cte.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
 #include <math.h>
 #include <getopt.h>
+#include <pthread.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
 
+#include "metrics.h"
+
 //----------------------------------some sys stuff----------------------------------
 #ifndef bool
 typedef int bool;
@@ -93,6 +103,13 @@ int gettimeofday(struct timeval *tv, void* ignored)
 
 #if defined _WIN32
 	#define sleep(a) Sleep( (a*1000) )
+	#define usleep(a) Sleep( ((a)+999)/1000 )
+#endif
+
+#ifdef _MSC_VER
+	#define memory_barrier() MemoryBarrier()
+#else
+	#define memory_barrier() __sync_synchronize()
 #endif
 
 static inline int
@@ -101,6 +118,12 @@ TimevalDiff(const struct timeval *a, const struct timeval *b)
    return( (a->tv_sec - b->tv_sec)*1000000 + (a->tv_usec - b->tv_usec) );
 }
 
+static inline int64_t
+TimevalDiff64(const struct timeval *a, const struct timeval *b)
+{
+   return( ((int64_t)(a->tv_sec - b->tv_sec))*1000000 + (a->tv_usec - b->tv_usec) );
+}
+
 volatile bool do_exit = false;
 #ifdef _MSC_VER
 BOOL WINAPI
@@ -132,229 +155,454 @@ static void print_usage() {
   printf("      channel number. default 37. valid range 0~39\n");
   printf("    -g --gain\n");
   printf("      rx gain in dB. HACKRF rxvga default 10, valid 0~62, lna in max gain. bladeRF default is max rx gain 66dB (valid 0~66)\n");
+  printf("    -a --agc\n");
+  printf("      automatic gain control, starting from -g. gain follows clipping, noise floor and packet RSSI. default off\n");
+  printf("    -d --iq-corr\n");
+  printf("      remove DC offset and IQ imbalance from the samples before demodulation. default off\n");
+  printf("    -R --rate\n");
+  printf("      sample rate in Msps. 4 (default): the analog filter selects the channel. 8: a digital\n");
+  printf("      channel filter does, with much better adjacent channel rejection, and decimates to 4\n");
+  printf("    -w --record\n");
+  printf("      prefix[:seconds]. keep the last seconds (default 10) of the board's samples in prefix.ring and cut a\n");
+  printf("      capture around every -T trigger. prefix_last.cs8 holds the last seconds at exit. default off\n");
+  printf("    -T --trigger\n");
+  printf("      what cuts a -w capture: crc=n (n CRC failures in one ~4ms block), energy=dBFS (a 16us\n");
+  printf("      window above), or packets matching a -F style filter, e.g. -T type=CONNECT_REQ. may be repeated\n");
+  printf("    -W --window\n");
+  printf("      pre_ms:post_ms of samples around a trigger. default 50:50\n");
+  printf("    -m --metrics\n");
+  printf("      publish runtime metrics in Prometheus text format to a file, or to a Unix socket with unix:/path. default off\n");
+  printf("    -M --metrics-interval\n");
+  printf("      metrics publishing interval in ms. default 1000\n");
+  printf("    -F --filter\n");
+  printf("      only demodulate and print matching packets. terms key=value[,value...] separated by ;\n");
+  printf("      keys: chan, type (name or number), rssi (minimum dBFS), adva, inita, data (hex, ?? for any byte)\n");
+  printf("      e.g. -F \"type=ADV_IND,SCAN_RSP;adva=010203040506;rssi=-60\". may be given more than once\n");
+  printf("    -D --link\n");
+  printf("      AA:CRCInit of a connection, e.g. 60850A1B:A77B22 as in its CONNECT_REQ: demodulate its data\n");
+  printf("      channel PDUs (LL control, L2CAP fragments) instead of advertising. -F: chan and rssi only\n");
+  printf("    -p --promisc\n");
+  printf("      discover the access addresses of connections on a data channel, instead of receiving packets.\n");
+  printf("      an access address is promoted once it carried %d empty PDUs\n", AA_PROMOTE_NUM_EMPTY);
+  printf("    -H --hop\n");
+  printf("      recover connInterval and hop increment of the -D connection, or of the first one -p finds,\n");
+  printf("      then follow it over its channels. a single board is moved to the next channel once for that\n");
+  printf("      (CSA#1). default off\n");
+  printf("    -C --csa\n");
+  printf("      channel selection algorithm of the -H connection, 1 or 2 (BLE 5). default 1\n");
+  printf("    -S --sync\n");
+  printf("      follow the periodic advertising trains whose SyncInfo shows up on the board's data channel,\n");
+  printf("      up to %d per board, sharing the radio between them. default off\n", FOLLOW_MAX_SCHED);
+  printf("    -B --big\n");
+  printf("      with -S: capture the BISes of the first BIG (LE Audio broadcast, 1M PHY) whose BIGInfo a\n");
+  printf("      followed train carries, subevent by subevent. the board stays with the BIG. default off\n");
+  printf("    -A --ad\n");
+  printf("      also print AdvData decoded into its AD structures (name, UUIDs, beacons, ...). default off\n");
+  printf("    -E --cte\n");
+  printf("      file[:cfo]. write the Constant Tone Extension (BLE 5.1 direction finding) of packets that carry\n");
+  printf("      one to file: reference period and sample slots as IQ, AoA in %dus slots. cfo: derotate them\n", CTE_AOA_SLOT_US);
+  printf("      by the tone of the reference period. default off\n");
+  printf("    -t --toa\n");
+  printf("      also print the time of arrival of each packet, the start of its preamble in host time to the\n");
+  printf("      ns, from the preamble and access address correlated at sub-sample resolution. default off\n");
+  printf("    -l --low-latency\n");
+  printf("      demodulate the samples as they arrive instead of in ~4ms blocks, and print each packet as\n");
+  printf("      soon as its CRC is checked: well under 1ms from the air to stdout. costs more CPU. default off\n");
+  printf("    -s --serial\n");
+  printf("      serial[:chan] of a board to open, channel default -c. repeat for up to 8 boards, e.g.\n");
+  printf("      -s 0000000000000000457863c8234e4c1f:37 -s 000000000000000014d463dc2f4d5ae1:38. default: the first board\n");
+  printf("    -L --lock-mem\n");
+  printf("      lock or huge. sample rings in mlock'ed memory, huge: on huge pages where reserved. default off\n");
+  printf("    -P --rt\n");
+  printf("      usb|demod|output=prio[@cpus]: SCHED_FIFO priority and CPUs of a thread, e.g. -P demod=50@2,3.\n");
+  printf("      usb and demod threads take one CPU of the list each, per board. may be repeated.\n");
+  printf("      @file reads these (and mem=lock|huge) one per line. default: normal scheduling\n");
   printf("\nSee README for detailed information.\n");
 }
 //----------------------------------print_usage----------------------------------
 
 //----------------------------------some basic signal definition----------------------------------
-#define SAMPLE_PER_SYMBOL 4 // 4M sampling rate
-
-volatile int rx_buf_offset; // remember to initialize it!
-
 #define LEN_BUF_IN_SAMPLE (8*4096) //4096 samples = ~1ms for 4Msps; ATTENTION each rx callback get hackrf.c:lib_device->buffer_size samples!!!
 #define LEN_BUF (LEN_BUF_IN_SAMPLE*2)
 #define LEN_BUF_IN_SYMBOL (LEN_BUF_IN_SAMPLE/SAMPLE_PER_SYMBOL)
 //----------------------------------some basic signal definition----------------------------------
 
 //----------------------------------BTLE SPEC related--------------------------------
-#include "scramble_table.h"
 #define DEFAULT_CHANNEL 37
-#define MAX_CHANNEL_NUMBER 39
-#define MAX_NUM_INFO_BYTE (43)
-#define MAX_NUM_PHY_BYTE (47)
 //#define MAX_NUM_PHY_SAMPLE ((MAX_NUM_PHY_BYTE*8*SAMPLE_PER_SYMBOL)+(LEN_GAUSS_FILTER*SAMPLE_PER_SYMBOL))
-#define MAX_NUM_PHY_SAMPLE (MAX_NUM_PHY_BYTE*8*SAMPLE_PER_SYMBOL)
-#define LEN_BUF_MAX_NUM_PHY_SAMPLE (2*MAX_NUM_PHY_SAMPLE)
-
-#define NUM_PREAMBLE_BYTE (1)
-#define NUM_ACCESS_ADDR_BYTE (4)
-#define NUM_PREAMBLE_ACCESS_BYTE (NUM_PREAMBLE_BYTE+NUM_ACCESS_ADDR_BYTE)
+#define MAX_NUM_PHY_SAMPLE (MAX_NUM_EXT_PHY_BYTE*8*SAMPLE_PER_SYMBOL) // extended advertising PDUs are the longest
+#define LEN_BUF_MAX_NUM_PHY_SAMPLE (2*(MAX_NUM_PHY_SAMPLE+MAX_NUM_CTE_SAMPLE)) // and may carry a CTE
 //----------------------------------BTLE SPEC related--------------------------------
 
-//----------------------------------board specific operation----------------------------------
-
-#ifdef USE_BLADERF //--------------------------------------BladeRF-----------------------
-char *board_name = "BladeRF";
-#define MAX_GAIN 66
-#define DEFAULT_GAIN 66
-typedef struct bladerf_devinfo bladerf_devinfo;
-typedef struct bladerf bladerf_device;
-typedef int16_t IQ_TYPE;
-volatile IQ_TYPE rx_buf[LEN_BUF+LEN_BUF_MAX_NUM_PHY_SAMPLE];
-static inline const char *backend2str(bladerf_backend b)
-{
-    switch (b) {
-        case BLADERF_BACKEND_LIBUSB:
-            return "libusb";
-        case BLADERF_BACKEND_LINUX:
-            return "Linux kernel driver";
-        default:
-            return "Unknown";
-    }
+//----------------------------------sample accounting----------------------------------
+// rx_callback (producer) and the demod thread (consumer) both count IQ_TYPE elements since start.
+// With absolute counters a lap of the cyclic rx_buf (overrun) or a hole in the USB stream
+// can be measured, instead of silently demodulating torn data.
+#define LEN_GAP_WINDOW_TRANSFER (256) // rx callbacks per stream gap detection window (~128ms at 4Msps)
+#define LEN_T0_WINDOW_TRANSFER (2048) // rx callbacks the stream start time is estimated over (~1s)
+
+typedef struct {
+  volatile uint64_t produced;       // IQ_TYPE elements written to rx_buf by rx_callback
+  volatile uint64_t consumed;       // IQ_TYPE elements handed over to receiver()
+  volatile uint64_t num_transfer;   // rx callbacks
+  volatile uint64_t num_short_transfer; // callbacks with valid_length < buffer_length
+  volatile uint64_t num_gap;        // stream gaps inferred from sample count vs. host clock
+  volatile uint64_t gap_sample;     // IQ samples estimated lost in stream gaps
+  volatile uint64_t gap_position;   // produced (IQ_TYPE elements) when the last gap was detected
+  volatile uint64_t num_overrun;    // times the demod thread was lapped by rx_callback
+  volatile uint64_t overrun_sample; // IQ samples skipped because of overrun
+  volatile uint64_t num_torn_pkt;   // packets whose samples were overwritten while demodulating
+  volatile int64_t t0_us;           // host time (us since the epoch) of IQ sample 0
+  // account_transfer() state
+  struct timeval time_start;
+  uint64_t produced_start;
+  int64_t deficit_min, deficit_min_pre;
+  int num_transfer_in_window;
+} SAMPLE_ACCOUNT;
+
+// IQ_TYPE elements (I and Q counted separately) to milliseconds since start of streaming
+static inline double sample_idx_to_ms(uint64_t idx) {
+  return( (double)(idx/2)/(SAMPLE_PER_SYMBOL*1000.0) );
 }
 
-int init_board(bladerf_device *dev, bladerf_devinfo *dev_info) {
-  int n_devices = bladerf_get_device_list(&dev_info);
+// host time in ns of IQ_TYPE element idx
+static inline int64_t sample_idx_to_ns(SAMPLE_ACCOUNT *acc, uint64_t idx) {
+  return( acc->t0_us*1000 + (int64_t)( idx*1000/(2*SAMPLE_PER_SYMBOL) ) );
+}
 
-  if (n_devices < 0) {
-    if (n_devices == BLADERF_ERR_NODEV) {
-        printf("init_board: No bladeRF devices found.\n");
-    } else {
-        printf("init_board: Failed to probe for bladeRF devices: %s\n", bladerf_strerror(n_devices));
-    }
-		print_usage();
-		return(-1);
+// how many IQ_TYPE elements of [start, start+len) rx_callback has already overwritten
+static inline uint64_t num_overwritten(SAMPLE_ACCOUNT *acc, uint64_t start, uint64_t len) {
+  uint64_t produced = acc->produced;
+  if ( produced <= (start + LEN_BUF) ) {
+    return(0);
   }
+  return( (produced-start-LEN_BUF) < len? (produced-start-LEN_BUF) : len );
+}
 
-  printf("init_board: %d bladeRF devices found! The 1st one will be used:\n", n_devices);
-  printf("    Backend:        %s\n", backend2str(dev_info[0].backend));
-  printf("    Serial:         %s\n", dev_info[0].serial);
-  printf("    USB Bus:        %d\n", dev_info[0].usb_bus);
-  printf("    USB Address:    %d\n", dev_info[0].usb_addr);
-
-  int fpga_loaded;
-  int status = bladerf_open(&dev, NULL);
-  if (status != 0) {
-    printf("init_board: Failed to open bladeRF device: %s\n",
-            bladerf_strerror(status));
-    return(-1);
+// Called by rx_callback after the transfer has been copied into rx_buf.
+// libhackrf has no sequence numbers, so stream gaps are inferred: the deficit between samples
+// expected from the host clock and samples received is jittery (USB bursts), but its minimum
+// over a window is stable. A step of that minimum between two windows is a gap.
+// The same holds for the stream start: arrival time minus the air time of everything received
+// so far only gets later with USB latency, so its minimum is the host time of sample 0.
+void account_transfer(SAMPLE_ACCOUNT *acc, int valid_length, int buffer_length) {
+  struct timeval time_current;
+  int64_t deficit, time_us, t0_us;
+
+  acc->produced = acc->produced + valid_length;
+  acc->num_transfer++;
+  if (valid_length < buffer_length) {
+    acc->num_short_transfer++;
   }
 
-  fpga_loaded = bladerf_is_fpga_configured(dev);
-  if (fpga_loaded < 0) {
-      printf("init_board: Failed to check FPGA state: %s\n",
-                bladerf_strerror(fpga_loaded));
-      status = -1;
-      goto initialize_device_out_point;
-  } else if (fpga_loaded == 0) {
-      printf("init_board: The device's FPGA is not loaded.\n");
-      status = -1;
-      goto initialize_device_out_point;
+  gettimeofday(&time_current, NULL);
+  if (acc->num_transfer <= LEN_T0_WINDOW_TRANSFER) {
+    t0_us = (int64_t)time_current.tv_sec*1000000 + time_current.tv_usec - (int64_t)( (acc->produced/2)/SAMPLE_PER_SYMBOL );
+    if (acc->num_transfer == 1 || t0_us < acc->t0_us) {
+      acc->t0_us = t0_us;
+    }
   }
 
-  unsigned int actual_sample_rate;
-  status = bladerf_set_sample_rate(dev, BLADERF_MODULE_RX, SAMPLE_PER_SYMBOL*1000000ul, &actual_sample_rate);
-  if (status != 0) {
-      printf("init_board: Failed to set samplerate: %s\n",
-              bladerf_strerror(status));
-      goto initialize_device_out_point;
+  if (acc->num_transfer == 1) {
+    acc->time_start = time_current;
+    acc->produced_start = acc->produced;
+    acc->deficit_min_pre = INT64_MAX;
+    acc->deficit_min = INT64_MAX;
+    acc->num_transfer_in_window = 0;
+    return;
   }
 
-  status = bladerf_set_frequency(dev, BLADERF_MODULE_RX, 2402000000ul);
-  if (status != 0) {
-      printf("init_board: Failed to set frequency: %s\n",
-              bladerf_strerror(status));
-      goto initialize_device_out_point;
+  time_us = TimevalDiff64(&time_current, &(acc->time_start));
+  deficit = time_us*SAMPLE_PER_SYMBOL - (int64_t)((acc->produced - acc->produced_start)/2);
+  if (deficit < acc->deficit_min) {
+    acc->deficit_min = deficit;
   }
 
-  unsigned int actual_frequency;
-  status = bladerf_get_frequency(dev, BLADERF_MODULE_RX, &actual_frequency);
-  if (status != 0) {
-      printf("init_board: Failed to read back frequency: %s\n",
-              bladerf_strerror(status));
-      goto initialize_device_out_point;
+  acc->num_transfer_in_window++;
+  if (acc->num_transfer_in_window < LEN_GAP_WINDOW_TRANSFER) {
+    return;
   }
 
-initialize_device_out_point:
-  if (status != 0) {
-      bladerf_close(dev);
-      dev = NULL;
-      return(-1);
+  // threshold: half a transfer, i.e. a quarter of buffer_length in IQ samples
+  if ( acc->deficit_min_pre != INT64_MAX && (acc->deficit_min - acc->deficit_min_pre) > (buffer_length/4) ) {
+    acc->gap_sample = acc->gap_sample + (acc->deficit_min - acc->deficit_min_pre);
+    acc->gap_position = acc->produced;
+    acc->num_gap++;
   }
-
-  #ifdef _MSC_VER
-    SetConsoleCtrlHandler( (PHANDLER_ROUTINE) sighandler, TRUE );
-  #else
-    signal(SIGINT, &sigint_callback_handler);
-    signal(SIGILL, &sigint_callback_handler);
-    signal(SIGFPE, &sigint_callback_handler);
-    signal(SIGSEGV, &sigint_callback_handler);
-    signal(SIGTERM, &sigint_callback_handler);
-    signal(SIGABRT, &sigint_callback_handler);
-  #endif
-
-  printf("init_board: set bladeRF to %f MHz %u sps BLADERF_LB_NONE.\n", (float)actual_frequency/1000000.0f, actual_sample_rate);
-  return(0);
+  acc->deficit_min_pre = acc->deficit_min;
+  acc->deficit_min = INT64_MAX;
+  acc->num_transfer_in_window = 0;
 }
 
-inline int open_board(uint64_t freq_hz, int gain, bladerf_device *dev) {
-  int status;
+void print_sample_account(SAMPLE_ACCOUNT *acc, char *tag) {
+  printf("sample accounting%s: produced %llu consumed %llu IQ samples (%.3fs), %llu transfers (%llu short)\n", tag,
+    (unsigned long long)(acc->produced/2), (unsigned long long)(acc->consumed/2), sample_idx_to_ms(acc->produced)/1000.0,
+    (unsigned long long)acc->num_transfer, (unsigned long long)acc->num_short_transfer);
+  printf("sample accounting%s: overrun %llu times %llu IQ samples, stream gap %llu times ~%llu IQ samples, torn packets %llu\n", tag,
+    (unsigned long long)acc->num_overrun, (unsigned long long)acc->overrun_sample,
+    (unsigned long long)acc->num_gap, (unsigned long long)acc->gap_sample,
+    (unsigned long long)acc->num_torn_pkt);
+}
+//----------------------------------sample accounting----------------------------------
 
-  status = bladerf_set_frequency(dev, BLADERF_MODULE_RX, freq_hz);
-  if (status != 0) {
-    printf("open_board: Failed to set frequency: %s\n",
-            bladerf_strerror(status));
-    return(-1);
-  }
+//----------------------------------runtime statistics----------------------------------
+// each field has a single writer: the demod thread (demod) or output_thread (out). see metrics.h
+typedef struct {
+  volatile uint64_t num_block;          // blocks handed over to receiver(), LEN_BUF/2 or smaller with -l
+  BTLE_RX_STAT phy;                     // correlator hits, header rejects and CRC results
+  volatile uint64_t num_pkt_queued;     // packets put into the output ring
+  volatile uint64_t num_pkt_drop;       // packets lost because the output ring was full
+  volatile uint64_t num_pkt_out;        // packets printed by output_thread
+  volatile int ring_fill_percent;       // rx_buf occupancy when the last block was started
+  volatile uint64_t num_clip;           // IQ samples at full scale. counted with -a only
+  volatile uint64_t num_gain_change;    // board retuned by the AGC
+  volatile uint64_t num_retune;         // board moved to another channel, -H
+  volatile uint64_t num_retune_late;    // events of the followed connection there was no time to retune for
+  volatile uint64_t num_cte;            // -E: CTEs taken into the output ring
+  volatile uint64_t num_cte_cut;        // -E: CTEs a retune or the end of the buffer cut short
+  METRICS_HIST demod_us;                // time spent in receiver() per block
+  METRICS_HIST ring_fill;               // rx_buf occupancy (%) per block
+  METRICS_HIST retune_us;               // time set_board_rx_freq took. the retuning thread
+  METRICS_HIST retune_late_us;          // -B: how late a retune was issued against its plan. the retuning thread
+} RX_STAT;
+
+// derived gauges, computed by the metrics publisher thread in update_metrics()
+typedef struct {
+  volatile double pkt_rate, crc_ok_ratio, demod_load, ring_fill_ratio, output_backlog, clock_corr_us, gain_db;
+  uint64_t num_crc_ok_pre, num_crc_err_pre, consumed_pre, demod_us_pre;
+} RX_GAUGE;
+
+static const uint64_t demod_us_bound[] = {100, 200, 500, 1000, 2000, 3000, 4000, 6000, 8000, 16000};
+static const uint64_t ring_fill_bound[] = {55, 60, 70, 80, 90, 100};
+static const uint64_t retune_us_bound[] = {50, 100, 200, 300, 500, 1000, 2000, 5000};
+static const uint64_t retune_late_us_bound[] = {5, 10, 20, 50, 100, 200, 500, 1000};
+
+#define DEFAULT_METRICS_INTERVAL_MS 1000
+//----------------------------------runtime statistics----------------------------------
+
+//----------------------------------receiver context----------------------------------
+// One per board: rx_callback fills rx_buf from the board's streaming thread, demod_thread
+// demodulates it block by block into pkt_ring, and output_thread merges the pkt_rings of
+// all boards in time order.
+#define MAX_NUM_RX_DEV 8
+#define LEN_PKT_RING 1024 // must be 2^x
+#define MAX_LEN_RECORD_PREFIX 200
+#define LEN_CHAN_SWITCH 256 // must be 2^x. far more than the retunes over one rx_buf, -B subevents included
+#define MAX_NUM_SYNC FOLLOW_MAX_SCHED // periodic advertising trains per board
 
-  status = bladerf_set_gain(dev, BLADERF_MODULE_RX, gain);
-  if (status != 0) {
-    printf("open_board: Failed to set gain: %s\n",
-            bladerf_strerror(status));
-    return(-1);
-  }
+typedef struct {
+  uint64_t sample_idx;  // IQ_TYPE element index from which the samples are on chan
+  int chan;
+  FOLLOW_CONN *follow;  // received from then on, NULL: -D or advertising
+  int bis;              // -B: the BIS received from then on, 0: none
+} CHAN_SWITCH;
 
-  status = bladerf_sync_config(dev, BLADERF_MODULE_RX, BLADERF_FORMAT_SC16_Q11, 2, LEN_BUF_IN_SAMPLE, 1, 3500);
-  if (status != 0) {
-     printf("open_board: Failed to configure sync interface: %s\n",
-             bladerf_strerror(status));
-     return(-1);
-  }
+typedef struct {
+  FOLLOW_CONN f;        // first, so that a FOLLOW_CONN of a board's sync[] is its SYNC_TRAIN
+  uint8_t adv_a[6];     // of the AUX_ADV_IND with the SyncInfo, air order. 0 if it had none
+  int sid;              // -1: no ADI
+  uint32_t next_event;  // the first event not scheduled or skipped yet. sync_thread
+  uint64_t num_skip;    // events given to another train
+  uint64_t num_late;    // events sync_thread woke up too late for
+  volatile uint64_t num_crc_err; // demod thread
+} SYNC_TRAIN;
 
-  status = bladerf_enable_module(dev, BLADERF_MODULE_RX, true);
-  if (status != 0) {
-     printf("open_board: Failed to enable module: %s\n",
-             bladerf_strerror(status));
-     return(-1);
-  }
+typedef struct {
+  uint64_t sample_idx;  // absolute IQ_TYPE element index of the preamble
+  int64_t time_ns;      // host time of the preamble from the board's sample clock, see account_transfer
+  int64_t end_ns;       // the same for the end of the CRC, for the output latency
+  int channel_number;
+  uint32_t access_addr;
+  bool data_pdu;        // byte[0] holds LLID, NESN, SN and MD instead of pdu_type, tx_add and rx_add
+  int pdu_type;
+  int tx_add;
+  int rx_add;
+  int payload_len;
+  bool crc_flag;
+  bool torn_flag;
+  int sync_idx;         // -S: its train in the board's sync[], -1: none
+  uint16_t pa_event;    // -S: paEventCounter
+  int bis;              // -B: BIS number, 0: none
+  uint64_t payload;     // -B: bisPayloadCount, BIS_PAYLOAD_UNKNOWN for a PDU that fits no subevent
+  uint8_t byte[2+MAX_NUM_EXT_PAYLOAD_BYTE+3];
+  int cte_info;         // -E: CTEInfo of the CTE in cte_iq, -1: none
+  float cte_cfo_hz;     // -E: carrier offset the reference period showed
+  IQ_TYPE cte_iq[2*MAX_NUM_CTE_IQ]; // -E: as cte_extract() leaves it
+} PKT_RECORD;
+
+#define BIS_PAYLOAD_UNKNOWN (~(uint64_t)0)
+#define BIS_SEEN_WINDOW 64      // payloads below the newest one a copy is still recognized for
 
-  return(0);
-}
+typedef struct {
+  uint64_t first_payload;       // lowest and newest bisPayloadCount received
+  uint64_t last_payload;
+  uint64_t seen;                // bit k: payload last_payload-k received
+  uint64_t num_payload;         // distinct payloads received
+  uint64_t num_repeat;          // copies of a payload already received, dropped
+  uint64_t num_crc_err;
+} BIS_STREAM;
 
-inline int close_board(bladerf_device *dev) {
-  // Disable TX module, shutting down our underlying TX stream
-  int status = bladerf_enable_module(dev, BLADERF_MODULE_RX, false);
-  if (status != 0) {
-    printf("close_board: Failed to disable module: %s\n",
-             bladerf_strerror(status));
-    return(-1);
-  }
+typedef struct {
+  uint64_t start;               // IQ_TYPE element index of the subevent
+  int bis;
+  int chan;
+  uint64_t payload;
+  bool chosen;                  // listened to
+} BIG_SUBEVENT;
 
-  return(0);
-}
+typedef struct {
+  FOLLOW_BIG g;                 // follow_lock
+  int sync_idx;                 // the train whose BIGInfo announced it
+  int encrypted;
+  BIS_STREAM bis[BIG_MAX_BIS];  // follow_lock
+  BIG_SUBEVENT plan[BIG_MAX_BIS*BIG_MAX_SE]; // subevents of one BIG event in time order. big_thread
+  uint64_t num_event;           // BIG events planned. big_thread
+  uint64_t num_subevent;        // subevents listened to
+  uint64_t num_skip;            // subevents of a payload not in yet that were not listened to
+  uint64_t num_late;            // chosen subevents missed because the retune came too late
+  int64_t late_max_us;
+  int64_t wake_lead_us;         // median of how much later than asked usleep returns. big_thread
+  uint64_t num_stray;           // CRC-OK BIS PDUs that fit no subevent. demod thread
+} BIG_RX;
 
-void exit_board(bladerf_device *dev) {
-  bladerf_close(dev);
-  dev = NULL;
-}
+typedef struct {
+  int idx;
+  char *serial;                   // NULL: the first board found
+  int chan;
+  uint64_t freq_hz;
+  void *rf_dev;
+  pthread_t demod_thread_id;
+  char tag[64];                   // appended to messages about this board. empty with one board
+
+  volatile IQ_TYPE *rx_buf;       // LEN_BUF + LEN_BUF_MAX_NUM_PHY_SAMPLE elements in rx_mem
+  RT_MEM rx_mem;
+  volatile int rx_buf_offset;     // written by rx_callback only
+  bool rt_applied;                // rx_callback ran -P usb on its thread
+  IQ_CORR iq_corr;                // rx_callback
+  DECIMATOR decim;                // rx_callback
+  IQ_TYPE decim_buf[LEN_DECIM_CHUNK*2];
+  IQ_REC rec;                     // -w. written by rx_callback, triggered by the demod thread
+  uint64_t num_crc_err_pre;       // demod thread, for the CRC burst trigger
+  SAMPLE_ACCOUNT account;
+  RX_STAT stat;
+  RX_GAUGE gauge;
+  uint64_t block_base;            // consumed when the current block was started. demod thread
+  AGC_STATE agc;                  // demod thread
+  int agc_gain_pending;           // gain the AGC asked for, applied once the air is quiet
+  AGC_REASON agc_reason_pending;
+  CHAN_SWITCH chan_switch[LEN_CHAN_SWITCH]; // retunes in sample order, applied by the demod thread
+  volatile uint64_t chan_switch_head; // written by the one thread that retunes
+  uint64_t chan_switch_tail;      // demod thread
+  FOLLOW_CONN *follow;            // -H: the connection this board follows, -S: the train it is on. demod thread
+  pthread_t follow_thread_id;     // follow_thread or sync_thread
+  SYNC_TRAIN sync[MAX_NUM_SYNC];  // -S: added by the demod thread, scheduled by sync_thread
+  volatile int num_sync;
+  int home_chan;                  // -S: where SyncInfo is looked for between events
+  int tuned_chan;                 // the channel the board was set to last. the retuning thread
+  double retune_avg_us;           // set_board_rx_freq time, averaged. the retuning thread
+  int64_t retune_max_us;
+  BIG_RX big;                     // -B: set up by the demod thread, then run by sync_thread
+  volatile int big_started;
+  bool big_phy_shown;             // demod thread
+  int bis;                        // -B: the BIS on the air of dev->chan. demod thread
+
+  PKT_RECORD pkt_ring[LEN_PKT_RING];
+  volatile uint64_t pkt_ring_head; // written by the demod thread only
+  volatile uint64_t pkt_ring_tail; // written by output_thread only
+  volatile int64_t watermark_ns;  // every packet starting before this time is in pkt_ring. demod thread
+  volatile int64_t clock_corr_ns; // subtracted from packet times. output_thread
+
+  char label[64];                 // metrics labels. empty with one board
+  char label_stage[NUM_FILTER_STAGE][96];
+  char label_crc[2][96];
+} RX_DEV;
+
+RX_DEV rx_dev[MAX_NUM_RX_DEV];
+int num_rx_dev;
+
+void init_rx_dev(RX_DEV *dev, int idx, char *serial, int chan, int gain) {
+  int i;
 
-bladerf_device* config_run_board(uint64_t freq_hz, int gain, void **rf_dev) {
-  bladerf_device *dev = NULL;
-  return(dev);
+  memset((void *)dev, 0, sizeof(RX_DEV));
+  dev->idx = idx;
+  dev->serial = serial;
+  dev->chan = chan;
+  dev->home_chan = chan;
+  dev->tuned_chan = chan;
+  dev->freq_hz = get_freq_by_channel_number(chan);
+  dev->rx_buf_offset = 0; // before streaming starts, so that it stays in step with account.produced
+  iq_corr_init(&(dev->iq_corr));
+  decim_init(&(dev->decim));
+  agc_init(&(dev->agc), gain, 0, MAX_RX_GAIN);
+  dev->agc_gain_pending = gain;
+
+  if (num_rx_dev > 1) {
+    snprintf(dev->tag, sizeof(dev->tag), " [board %d ch%d]", idx, chan);
+    if (serial != NULL) {
+      snprintf(dev->label, sizeof(dev->label), "board=\"%s\",chan=\"%d\"", serial, chan);
+    } else {
+      snprintf(dev->label, sizeof(dev->label), "board=\"%d\",chan=\"%d\"", idx, chan);
+    }
+  }
+  for (i=0; i<NUM_FILTER_STAGE; i++) {
+    snprintf(dev->label_stage[i], sizeof(dev->label_stage[i]), "%s%sstage=\"%s\"", dev->label, (dev->label[0]? "," : ""), FILTER_STAGE_STR[i]);
+  }
+  snprintf(dev->label_crc[0], sizeof(dev->label_crc[0]), "%s%scrc=\"ok\"", dev->label, (dev->label[0]? "," : ""));
+  snprintf(dev->label_crc[1], sizeof(dev->label_crc[1]), "%s%scrc=\"fail\"", dev->label, (dev->label[0]? "," : ""));
 }
-
-void stop_close_board(bladerf_device* rf_dev){
-  
+//----------------------------------receiver context----------------------------------
+
+//----------------------------------rx stream----------------------------------
+bool iq_corr_enable; // -d
+int oversample = 1;  // -R: board sample rate / SAMPLE_PER_SYMBOL Msps. 1 or 2
+bool record_enable;  // -w
+RT_CONF rt_conf;     // -L, -P
+
+static void rx_buf_write(RX_DEV *dev, IQ_TYPE *buf, int len) {
+  int i, offset = dev->rx_buf_offset;
+  // corrected before rx_buf, so the demod thread only ever sees clean samples
+  if (iq_corr_enable) {
+    iq_corr_estimate(&(dev->iq_corr), buf, len/2);
+    iq_corr_apply(&(dev->iq_corr), buf, len/2);
+  }
+  for( i=0; i<len; i++) {
+    dev->rx_buf[offset] = buf[i];
+    offset = (offset+1)&( LEN_BUF-1 ); //cyclic buffer
+  }
+  dev->rx_buf_offset = offset;
 }
 
-#else //-----------------------------the board is HACKRF-----------------------------
-char *board_name = "HACKRF";
-#define MAX_GAIN 62
-#define DEFAULT_GAIN 10
-#define MAX_LNA_GAIN 40
+// called by the board streaming thread for every transfer. arg is the RX_DEV
+int rx_callback(IQ_TYPE *buf, int valid_length, int buffer_length, void *arg) {
+  RX_DEV *dev = (RX_DEV *)arg;
+  int i, len;
 
-typedef int8_t IQ_TYPE;
-volatile IQ_TYPE rx_buf[LEN_BUF + LEN_BUF_MAX_NUM_PHY_SAMPLE];
+  // the board library owns this thread, so it is set up from inside, on the first transfer
+  if (!dev->rt_applied) {
+    dev->rt_applied = true;
+    rt_thread_apply(rt_conf.thread+RT_THREAD_USB, pthread_self(), dev->idx, RT_THREAD_STR[RT_THREAD_USB], dev->tag);
+  }
 
-int rx_callback(hackrf_transfer* transfer) {
-  int i;
-  int8_t *p = (int8_t *)transfer->buffer;
-  for( i=0; i<transfer->valid_length; i++) {
-    rx_buf[rx_buf_offset] = p[i];
-    rx_buf_offset = (rx_buf_offset+1)&( LEN_BUF-1 ); //cyclic buffer
+  // as the board delivered it: -d corrects buf in place and -R replaces it
+  if (record_enable) {
+    iq_rec_write(&(dev->rec), buf, valid_length);
+  }
+  if (oversample == 1) {
+    rx_buf_write(dev, buf, valid_length);
+  } else {
+    // channel filter and decimation, LEN_DECIM_CHUNK output samples at a time
+    for (i=0; i<valid_length; i=i+len) {
+      len = valid_length - i;
+      len = (len > LEN_DECIM_CHUNK*4? LEN_DECIM_CHUNK*4 : len);
+      rx_buf_write(dev, dev->decim_buf, 2*decim_block(&(dev->decim), buf+i, len/2, dev->decim_buf));
+    }
   }
-  //printf("%d\n", transfer->valid_length); // !!!!it is 262144 always!!!! Now it is 4096. Defined in hackrf.c lib_device->buffer_size
+  // everything from here on counts samples at SAMPLE_PER_SYMBOL Msps
+  account_transfer(&(dev->account), valid_length/oversample, buffer_length/oversample);
   return(0);
 }
 
-int init_board() {
-	int result = hackrf_init();
-	if( result != HACKRF_SUCCESS ) {
-		printf("open_board: hackrf_init() failed: %s (%d)\n", hackrf_error_name(result), result);
-		print_usage();
-		return(-1);
-	}
-
+void set_signal_handler(void) {
   #ifdef _MSC_VER
     SetConsoleCtrlHandler( (PHANDLER_ROUTINE) sighandler, TRUE );
   #else
@@ -365,527 +613,217 @@ int init_board() {
     signal(SIGTERM, &sigint_callback_handler);
     signal(SIGABRT, &sigint_callback_handler);
   #endif
-
-  return(0);
 }
+//----------------------------------rx stream----------------------------------
 
-inline int open_board(uint64_t freq_hz, int gain, hackrf_device** device) {
-  int result;
-
-	result = hackrf_open(device);
-	if( result != HACKRF_SUCCESS ) {
-		printf("open_board: hackrf_open() failed: %s (%d)\n", hackrf_error_name(result), result);
-    print_usage();
-		return(-1);
-	}
-
-  result = hackrf_set_freq(*device, freq_hz);
-  if( result != HACKRF_SUCCESS ) {
-    printf("open_board: hackrf_set_freq() failed: %s (%d)\n", hackrf_error_name(result), result);
-    print_usage();
-    return(-1);
-  }
-
-  result = hackrf_set_sample_rate(*device, SAMPLE_PER_SYMBOL*1000000ul);
-  if( result != HACKRF_SUCCESS ) {
-    printf("open_board: hackrf_set_sample_rate() failed: %s (%d)\n", hackrf_error_name(result), result);
-    print_usage();
-    return(-1);
-  }
-  
-  result = hackrf_set_baseband_filter_bandwidth(*device, SAMPLE_PER_SYMBOL*1000000ul/2);
-  if( result != HACKRF_SUCCESS ) {
-    printf("open_board: hackrf_set_baseband_filter_bandwidth() failed: %s (%d)\n", hackrf_error_name(result), result);
-    print_usage();
-    return(-1);
-  }
-  
-  result = hackrf_set_vga_gain(*device, gain);
-	result |= hackrf_set_lna_gain(*device, MAX_LNA_GAIN);
-  if( result != HACKRF_SUCCESS ) {
-    printf("open_board: hackrf_set_txvga_gain() failed: %s (%d)\n", hackrf_error_name(result), result);
-    print_usage();
-    return(-1);
-  }
+//----------------------------------recording triggers----------------------------------
+#define DEFAULT_RECORD_SECONDS 10
+#define DEFAULT_TRIGGER_WINDOW_MS 50
+#define TRIGGER_OFF (-1000)
 
-  return(0);
+typedef struct {
+  BTLE_FILTER pkt;              // packets that trigger. accept everything: off
+  int num_crc_err;              // CRC failures in one block. 0: off
+  int energy_dbfs;              // TRIGGER_OFF: off
+  int pre_ms, post_ms;
+} RECORD_TRIGGER;
+
+RECORD_TRIGGER rec_trigger; // set up by parse_commandline
+bool pkt_trigger_enable;
+
+void trigger_init(RECORD_TRIGGER *trigger) {
+  filter_init(&(trigger->pkt));
+  trigger->num_crc_err = 0;
+  trigger->energy_dbfs = TRIGGER_OFF;
+  trigger->pre_ms = DEFAULT_TRIGGER_WINDOW_MS;
+  trigger->post_ms = DEFAULT_TRIGGER_WINDOW_MS;
 }
 
-void exit_board(hackrf_device *device) {
-	if(device != NULL)
-	{
-		hackrf_exit();
-		printf("hackrf_exit() done\n");
-	}
+bool trigger_is_active(RECORD_TRIGGER *trigger) {
+  return( filter_is_active(&(trigger->pkt)) || trigger->num_crc_err != 0 || trigger->energy_dbfs != TRIGGER_OFF );
 }
 
-inline int close_board(hackrf_device *device) {
-  int result;
+// crc=n, energy=dBFS, or a packet filter expression
+int parse_trigger(char *expr, RECORD_TRIGGER *trigger) {
+  char *endp;
 
-	if(device != NULL)
-	{
-    result = hackrf_stop_rx(device);
-    if( result != HACKRF_SUCCESS ) {
-      printf("close_board: hackrf_stop_rx() failed: %s (%d)\n", hackrf_error_name(result), result);
+  if (strncmp(expr, "crc=", 4) == 0) {
+    trigger->num_crc_err = strtol(expr+4, &endp, 10);
+    if ( (*endp) != 0 || expr[4] == 0 || trigger->num_crc_err < 1 ) {
+      printf("parse_trigger: invalid CRC failure count %s!\n", expr+4);
       return(-1);
     }
-
-		result = hackrf_close(device);
-		if( result != HACKRF_SUCCESS )
-		{
-			printf("close_board: hackrf_close() failed: %s (%d)\n", hackrf_error_name(result), result);
-			return(-1);
-		}
-
     return(0);
-	} else {
-	  return(-1);
-	}
-}
-
-inline int run_board(hackrf_device* device) {
-  int result;
-
-	result = hackrf_stop_rx(device);
-	if( result != HACKRF_SUCCESS ) {
-		printf("run_board: hackrf_stop_rx() failed: %s (%d)\n", hackrf_error_name(result), result);
-		return(-1);
-	}
-  
-  result = hackrf_start_rx(device, rx_callback, NULL);
-  if( result != HACKRF_SUCCESS ) {
-    printf("run_board: hackrf_start_rx() failed: %s (%d)\n", hackrf_error_name(result), result);
-    return(-1);
-  }
-
-  return(0);
-}
-
-inline int config_run_board(uint64_t freq_hz, int gain, void **rf_dev) {
-  hackrf_device *dev = NULL;
-  
-  (*rf_dev) = dev;
-  
-  if (init_board() != 0) {
-    return(-1);
-  }
-  
-  if ( open_board(freq_hz, gain, &dev) != 0 ) {
-    (*rf_dev) = dev;
-    return(-1);
-  }
-
-  (*rf_dev) = dev;
-  if ( run_board(dev) != 0 ) {
-    return(-1);
-  }
-  
-  return(0);
-}
-
-void stop_close_board(hackrf_device* device){
-  if (close_board(device)!=0){
-    return;
-  }
-  exit_board(device);
-}
-
-#endif  //#ifdef USE_BLADERF
-//----------------------------------board specific operation----------------------------------
-
-//----------------------------------MISC MISC MISC----------------------------------
-char* toupper_str(char *input_str, char *output_str) {
-  int len_str = strlen(input_str);
-  int i;
-
-  for (i=0; i<=len_str; i++) {
-    output_str[i] = toupper( input_str[i] );
-  }
-
-  return(output_str);
-}
-
-void octet_hex_to_bit(char *hex, char *bit) {
-  char tmp_hex[3];
-
-  tmp_hex[0] = hex[0];
-  tmp_hex[1] = hex[1];
-  tmp_hex[2] = 0;
-
-  int n = strtol(tmp_hex, NULL, 16);
-
-  bit[0] = 0x01&(n>>0);
-  bit[1] = 0x01&(n>>1);
-  bit[2] = 0x01&(n>>2);
-  bit[3] = 0x01&(n>>3);
-  bit[4] = 0x01&(n>>4);
-  bit[5] = 0x01&(n>>5);
-  bit[6] = 0x01&(n>>6);
-  bit[7] = 0x01&(n>>7);
-}
-
-void int_to_bit(int n, uint8_t *bit) {
-  bit[0] = 0x01&(n>>0);
-  bit[1] = 0x01&(n>>1);
-  bit[2] = 0x01&(n>>2);
-  bit[3] = 0x01&(n>>3);
-  bit[4] = 0x01&(n>>4);
-  bit[5] = 0x01&(n>>5);
-  bit[6] = 0x01&(n>>6);
-  bit[7] = 0x01&(n>>7);
-}
-
-void byte_array_to_bit_array(uint8_t *byte_in, int num_byte, uint8_t *bit) {
-  int i, j;
-  j=0;
-  for(i=0; i<num_byte*8; i=i+8) {
-    int_to_bit(byte_in[j], bit+i);
-    j++;
-  }
-}
-
-int convert_hex_to_bit(char *hex, char *bit){
-  int num_hex = strlen(hex);
-  while(hex[num_hex-1]<=32 || hex[num_hex-1]>=127) {
-    num_hex--;
   }
-
-  if (num_hex%2 != 0) {
-    printf("convert_hex_to_bit: Half octet is encountered! num_hex %d\n", num_hex);
-    printf("%s\n", hex);
-    return(-1);
-  }
-
-  int num_bit = num_hex*4;
-
-  int i, j;
-  for (i=0; i<num_hex; i=i+2) {
-    j = i*4;
-    octet_hex_to_bit(hex+i, bit+j);
-  }
-
-  return(num_bit);
-}
-
-void disp_bit(char *bit, int num_bit)
-{
-  int i, bit_val;
-  for(i=0; i<num_bit; i++) {
-    bit_val = bit[i];
-    if (i%8 == 0 && i != 0) {
-      printf(" ");
-    } else if (i%4 == 0 && i != 0) {
-      printf("-");
+  if (strncmp(expr, "energy=", 7) == 0) {
+    trigger->energy_dbfs = strtol(expr+7, &endp, 10);
+    if ( (*endp) != 0 || expr[7] == 0 || trigger->energy_dbfs > 0 ) {
+      printf("parse_trigger: invalid energy threshold %s! dBFS, at most 0\n", expr+7);
+      return(-1);
     }
-    printf("%d", bit_val);
-  }
-  printf("\n");
-}
-
-void disp_bit_in_hex(char *bit, int num_bit)
-{
-  int i, a;
-  for(i=0; i<num_bit; i=i+8) {
-    a = bit[i] + bit[i+1]*2 + bit[i+2]*4 + bit[i+3]*8 + bit[i+4]*16 + bit[i+5]*32 + bit[i+6]*64 + bit[i+7]*128;
-    //a = bit[i+7] + bit[i+6]*2 + bit[i+5]*4 + bit[i+4]*8 + bit[i+3]*16 + bit[i+2]*32 + bit[i+1]*64 + bit[i]*128;
-    printf("%02x", a);
+    return(0);
   }
-  printf("\n");
+  return( parse_filter(expr, &(trigger->pkt)) );
 }
+//----------------------------------recording triggers----------------------------------
 
-void disp_hex(uint8_t *hex, int num_hex)
+//----------------------------------MISC MISC MISC----------------------------------
+// binary, with the btle_iqfile header. btle_iqconv -m turns it into MATLAB text
+void save_phy_sample(IQ_TYPE *IQ_sample, int num_IQ_sample, char *filename)
 {
-  int i;
-  for(i=0; i<num_hex; i++)
-  {
-     printf("%02x", hex[i]);
+  IQ_FILE f;
+  IQ_FILE_INFO info;
+
+  info.format = IQ_FORMAT_NATIVE;
+  info.sample_rate = SAMPLE_PER_SYMBOL*1000000ull;
+  info.freq_hz = 0;
+  info.start_ns = 0;
+  if ( iq_file_create(&f, filename, &info, 1) != 0 ) {
+    return;
   }
-  printf("\n");
+  iq_file_write(&f, IQ_sample, num_IQ_sample/2);
+  iq_file_close(&f);
 }
 
-void disp_hex_in_bit(uint8_t *hex, int num_hex)
+// cs8, cs16 or cf32, with or without header. returns the IQ_TYPE elements read
+int load_phy_sample(IQ_TYPE *IQ_sample, int num_IQ_sample, char *filename)
 {
-  int i, j, bit_val;
-
-  for(j=0; j<num_hex; j++) {
-
-    for(i=0; i<8; i++) {
-      bit_val = (hex[j]>>i)&0x01;
-      if (i==4) {
-        printf("-");
-      }
-      printf("%d", bit_val);
-    }
-
-    printf(" ");
+  IQ_FILE f;
+  int num_iq;
 
+  if ( iq_file_open(&f, filename) != 0 ) {
+    return(0);
   }
-
-  printf("\n");
+  num_iq = ( f.num_iq < (uint64_t)(num_IQ_sample/2)? (int)f.num_iq : num_IQ_sample/2 );
+  iq_file_read(&f, 0, num_iq, IQ_sample);
+  printf("%d I/Q are read.\n", 2*num_iq);
+  iq_file_close(&f);
+  return(2*num_iq);
 }
+//----------------------------------MISC MISC MISC----------------------------------
 
-void save_phy_sample(IQ_TYPE *IQ_sample, int num_IQ_sample, char *filename)
-{
+//----------------------------------command line parameters----------------------------------
+// Parse the command line arguments and return optional parameters as
+// variables.
+// Also performs some basic sanity checks on the parameters.
+void parse_commandline(
+  // Inputs
+  int argc,
+  char * const argv[],
+  // Outputs
+  int* chan,
+  int* gain,
+  bool* agc,
+  bool* iq_corr,
+  int* rate,
+  char** record_prefix,
+  int* record_seconds,
+  RECORD_TRIGGER* trigger,
+  char** metrics_target,
+  int* metrics_interval_ms,
+  BTLE_FILTER* filter,
+  BTLE_LINK* link,
+  bool* promisc,
+  bool* hop,
+  int* csa,
+  bool* sync,
+  bool* big,
+  bool* ad,
+  char** cte_name,
+  bool* cte_cfo,
+  bool* toa,
+  bool* low_lat,
+  RT_CONF* rt,
+  int* num_dev,
+  char** serial,        // MAX_NUM_RX_DEV entries
+  int* dev_chan         // MAX_NUM_RX_DEV entries
+) {
+  char *p;
   int i;
 
-  FILE *fp = fopen(filename, "w");
-  if (fp == NULL) {
-    printf("save_phy_sample: fopen failed!\n");
-    return;
-  }
-
-  for(i=0; i<num_IQ_sample; i++) {
-    if (i%64 == 0) {
-      fprintf(fp, "\n");
-    }
-    fprintf(fp, "%d, ", IQ_sample[i]);
-  }
-  fprintf(fp, "\n");
+  printf("BTLE/BT4.0 Scanner. Xianjun Jiao. putaoshu@gmail.com\n\n");
+  
+  // Default values
+  (*chan) = DEFAULT_CHANNEL;
 
-  fclose(fp);
-}
+  (*gain) = DEFAULT_RX_GAIN;
 
-void load_phy_sample(IQ_TYPE *IQ_sample, int num_IQ_sample, char *filename)
-{
-  int i, tmp_val;
+  (*agc) = false;
 
-  FILE *fp = fopen(filename, "r");
-  if (fp == NULL) {
-    printf("load_phy_sample: fopen failed!\n");
-    return;
-  }
+  (*iq_corr) = false;
 
-  i = 0;
-  while( ~feof(fp) ) {
-    if ( fscanf(fp, "%d,", &tmp_val) ) {
-      IQ_sample[i] = tmp_val;
-      i++;
-    }
-    if (num_IQ_sample != -1) {
-      if (i==num_IQ_sample) {
-        break;
-      }
-    }
-    //printf("%d\n", i);
-  }
-  printf("%d I/Q are read.\n", i);
+  (*rate) = SAMPLE_PER_SYMBOL;
 
-  fclose(fp);
-}
+  (*record_prefix) = NULL;
 
-void save_phy_sample_for_matlab(IQ_TYPE *IQ_sample, int num_IQ_sample, char *filename)
-{
-  int i;
+  (*record_seconds) = DEFAULT_RECORD_SECONDS;
 
-  FILE *fp = fopen(filename, "w");
-  if (fp == NULL) {
-    printf("save_phy_sample_for_matlab: fopen failed!\n");
-    return;
-  }
+  trigger_init(trigger);
 
-  for(i=0; i<num_IQ_sample; i++) {
-    if (i%64 == 0) {
-      fprintf(fp, "...\n");
-    }
-    fprintf(fp, "%d ", IQ_sample[i]);
-  }
-  fprintf(fp, "\n");
+  (*metrics_target) = NULL;
 
-  fclose(fp);
-}
-//----------------------------------MISC MISC MISC----------------------------------
+  (*metrics_interval_ms) = DEFAULT_METRICS_INTERVAL_MS;
 
-//----------------------------------BTLE SPEC related--------------------------------
-/**
- * Static table used for the table_driven implementation.
- *****************************************************************************/
-static const uint_fast32_t crc_table[256] = {
-    0x000000, 0x01b4c0, 0x036980, 0x02dd40, 0x06d300, 0x0767c0, 0x05ba80, 0x040e40,
-    0x0da600, 0x0c12c0, 0x0ecf80, 0x0f7b40, 0x0b7500, 0x0ac1c0, 0x081c80, 0x09a840,
-    0x1b4c00, 0x1af8c0, 0x182580, 0x199140, 0x1d9f00, 0x1c2bc0, 0x1ef680, 0x1f4240,
-    0x16ea00, 0x175ec0, 0x158380, 0x143740, 0x103900, 0x118dc0, 0x135080, 0x12e440,
-    0x369800, 0x372cc0, 0x35f180, 0x344540, 0x304b00, 0x31ffc0, 0x332280, 0x329640,
-    0x3b3e00, 0x3a8ac0, 0x385780, 0x39e340, 0x3ded00, 0x3c59c0, 0x3e8480, 0x3f3040,
-    0x2dd400, 0x2c60c0, 0x2ebd80, 0x2f0940, 0x2b0700, 0x2ab3c0, 0x286e80, 0x29da40,
-    0x207200, 0x21c6c0, 0x231b80, 0x22af40, 0x26a100, 0x2715c0, 0x25c880, 0x247c40,
-    0x6d3000, 0x6c84c0, 0x6e5980, 0x6fed40, 0x6be300, 0x6a57c0, 0x688a80, 0x693e40,
-    0x609600, 0x6122c0, 0x63ff80, 0x624b40, 0x664500, 0x67f1c0, 0x652c80, 0x649840,
-    0x767c00, 0x77c8c0, 0x751580, 0x74a140, 0x70af00, 0x711bc0, 0x73c680, 0x727240,
-    0x7bda00, 0x7a6ec0, 0x78b380, 0x790740, 0x7d0900, 0x7cbdc0, 0x7e6080, 0x7fd440,
-    0x5ba800, 0x5a1cc0, 0x58c180, 0x597540, 0x5d7b00, 0x5ccfc0, 0x5e1280, 0x5fa640,
-    0x560e00, 0x57bac0, 0x556780, 0x54d340, 0x50dd00, 0x5169c0, 0x53b480, 0x520040,
-    0x40e400, 0x4150c0, 0x438d80, 0x423940, 0x463700, 0x4783c0, 0x455e80, 0x44ea40,
-    0x4d4200, 0x4cf6c0, 0x4e2b80, 0x4f9f40, 0x4b9100, 0x4a25c0, 0x48f880, 0x494c40,
-    0xda6000, 0xdbd4c0, 0xd90980, 0xd8bd40, 0xdcb300, 0xdd07c0, 0xdfda80, 0xde6e40,
-    0xd7c600, 0xd672c0, 0xd4af80, 0xd51b40, 0xd11500, 0xd0a1c0, 0xd27c80, 0xd3c840,
-    0xc12c00, 0xc098c0, 0xc24580, 0xc3f140, 0xc7ff00, 0xc64bc0, 0xc49680, 0xc52240,
-    0xcc8a00, 0xcd3ec0, 0xcfe380, 0xce5740, 0xca5900, 0xcbedc0, 0xc93080, 0xc88440,
-    0xecf800, 0xed4cc0, 0xef9180, 0xee2540, 0xea2b00, 0xeb9fc0, 0xe94280, 0xe8f640,
-    0xe15e00, 0xe0eac0, 0xe23780, 0xe38340, 0xe78d00, 0xe639c0, 0xe4e480, 0xe55040,
-    0xf7b400, 0xf600c0, 0xf4dd80, 0xf56940, 0xf16700, 0xf0d3c0, 0xf20e80, 0xf3ba40,
-    0xfa1200, 0xfba6c0, 0xf97b80, 0xf8cf40, 0xfcc100, 0xfd75c0, 0xffa880, 0xfe1c40,
-    0xb75000, 0xb6e4c0, 0xb43980, 0xb58d40, 0xb18300, 0xb037c0, 0xb2ea80, 0xb35e40,
-    0xbaf600, 0xbb42c0, 0xb99f80, 0xb82b40, 0xbc2500, 0xbd91c0, 0xbf4c80, 0xbef840,
-    0xac1c00, 0xada8c0, 0xaf7580, 0xaec140, 0xaacf00, 0xab7bc0, 0xa9a680, 0xa81240,
-    0xa1ba00, 0xa00ec0, 0xa2d380, 0xa36740, 0xa76900, 0xa6ddc0, 0xa40080, 0xa5b440,
-    0x81c800, 0x807cc0, 0x82a180, 0x831540, 0x871b00, 0x86afc0, 0x847280, 0x85c640,
-    0x8c6e00, 0x8ddac0, 0x8f0780, 0x8eb340, 0x8abd00, 0x8b09c0, 0x89d480, 0x886040,
-    0x9a8400, 0x9b30c0, 0x99ed80, 0x985940, 0x9c5700, 0x9de3c0, 0x9f3e80, 0x9e8a40,
-    0x972200, 0x9696c0, 0x944b80, 0x95ff40, 0x91f100, 0x9045c0, 0x929880, 0x932c40
-};
-
-uint64_t get_freq_by_channel_number(int channel_number) {
-  uint64_t freq_hz;
-  if ( channel_number == 37 ) {
-    freq_hz = 2402000000ull;
-  } else if (channel_number == 38) {
-    freq_hz = 2426000000ull;
-  } else if (channel_number == 39) {
-    freq_hz = 2480000000ull;
-  } else if (channel_number >=0 && channel_number <= 10 ) {
-    freq_hz = 2404000000ull + channel_number*2000000ull;
-  } else if (channel_number >=11 && channel_number <= 36 ) {
-    freq_hz = 2428000000ull + (channel_number-11)*2000000ull;
-  } else {
-    freq_hz = 0xffffffffffffffff;
-  }
-  return(freq_hz);
-}
+  filter_init(filter);
 
-typedef enum
-{
-    ADV_IND,
-    ADV_DIRECT_IND,
-    ADV_NONCONN_IND,
-    SCAN_REQ,
-    SCAN_RSP,
-    CONNECT_REQ,
-    ADV_SCAN_IND,
-    RESERVED0,
-    RESERVED1,
-    RESERVED2,
-    RESERVED3,
-    RESERVED4,
-    RESERVED5,
-    RESERVED6,
-    RESERVED7,
-    RESERVED8
-} PDU_TYPE;
+  link_init(link, ADV_ACCESS_ADDR, ADV_CRC_INIT);
 
-typedef struct {
-  uint8_t AdvA[6];
-  uint8_t Data[31];
-} ADV_PDU_PAYLOAD_TYPE_0_2_4_6;
+  (*promisc) = false;
 
-typedef struct {
-  uint8_t A0[6];
-  uint8_t A1[6];
-} ADV_PDU_PAYLOAD_TYPE_1_3;
+  (*hop) = false;
 
-typedef struct {
-  uint8_t InitA[6];
-  uint8_t AdvA[6];
-  uint8_t AA[4];
-  uint32_t CRCInit;
-  uint8_t WinSize;
-  uint16_t WinOffset;
-  uint16_t Interval;
-  uint16_t Latency;
-  uint16_t Timeout;
-  uint8_t ChM[5];
-  uint8_t Hop;
-  uint8_t SCA;
-} ADV_PDU_PAYLOAD_TYPE_5;
+  (*csa) = 1;
 
-typedef struct {
-  uint8_t payload_byte[37];
-} ADV_PDU_PAYLOAD_TYPE_R;
-
-char *PDU_TYPE_STR[] = {
-    "ADV_IND",
-    "ADV_DIRECT_IND",
-    "ADV_NONCONN_IND",
-    "SCAN_REQ",
-    "SCAN_RSP",
-    "CONNECT_REQ",
-    "ADV_SCAN_IND",
-    "RESERVED0",
-    "RESERVED1",
-    "RESERVED2",
-    "RESERVED3",
-    "RESERVED4",
-    "RESERVED5",
-    "RESERVED6",
-    "RESERVED7",
-    "RESERVED8"
-};
-
-/**
- * Update the crc value with new data.
- *
- * \param crc      The current crc value.
- * \param data     Pointer to a buffer of \a data_len bytes.
- * \param data_len Number of bytes in the \a data buffer.
- * \return         The updated crc value.
- *****************************************************************************/
-uint_fast32_t crc_update(uint_fast32_t crc, const void *data, size_t data_len) {
-    const unsigned char *d = (const unsigned char *)data;
-    unsigned int tbl_idx;
+  (*sync) = false;
 
-    while (data_len--) {
-            tbl_idx = (crc ^ *d) & 0xff;
-            crc = (crc_table[tbl_idx] ^ (crc >> 8)) & 0xffffff;
+  (*big) = false;
 
-        d++;
-    }
-    return crc & 0xffffff;
-}
+  (*ad) = false;
 
-uint_fast32_t crc24_byte(uint8_t *byte_in, int num_byte, int init_hex) {
-  uint_fast32_t crc = init_hex;
+  (*cte_name) = NULL;
 
-  crc = crc_update(crc, byte_in, num_byte);
+  (*cte_cfo) = false;
 
-  return(crc);
-}
+  (*toa) = false;
 
-void scramble_byte(uint8_t *byte_in, int num_byte, const uint8_t *scramble_table_byte, uint8_t *byte_out) {
-  int i;
-  for(i=0; i<num_byte; i++){
-    byte_out[i] = byte_in[i]^scramble_table_byte[i];
-  }
-}
-//----------------------------------BTLE SPEC related----------------------------------
+  (*low_lat) = false;
 
-//----------------------------------command line parameters----------------------------------
-// Parse the command line arguments and return optional parameters as
-// variables.
-// Also performs some basic sanity checks on the parameters.
-void parse_commandline(
-  // Inputs
-  int argc,
-  char * const argv[],
-  // Outputs
-  int* chan,
-  int* gain
-) {
-  printf("BTLE/BT4.0 Scanner(NO bladeRF support so far). Xianjun Jiao. putaoshu@gmail.com\n\n");
-  
-  // Default values
-  (*chan) = DEFAULT_CHANNEL;
+  rt_init(rt);
 
-  (*gain) = DEFAULT_GAIN;
+  (*num_dev) = 0;
 
   while (1) {
     static struct option long_options[] = {
       {"help",         no_argument,       0, 'h'},
       {"chan",   required_argument, 0, 'c'},
       {"gain",         required_argument, 0, 'g'},
+      {"agc",          no_argument,       0, 'a'},
+      {"iq-corr",      no_argument,       0, 'd'},
+      {"rate",         required_argument, 0, 'R'},
+      {"record",       required_argument, 0, 'w'},
+      {"trigger",      required_argument, 0, 'T'},
+      {"window",       required_argument, 0, 'W'},
+      {"metrics",      required_argument, 0, 'm'},
+      {"metrics-interval", required_argument, 0, 'M'},
+      {"filter",       required_argument, 0, 'F'},
+      {"link",         required_argument, 0, 'D'},
+      {"promisc",      no_argument,       0, 'p'},
+      {"hop",          no_argument,       0, 'H'},
+      {"csa",          required_argument, 0, 'C'},
+      {"sync",         no_argument,       0, 'S'},
+      {"big",          no_argument,       0, 'B'},
+      {"ad",           no_argument,       0, 'A'},
+      {"cte",          required_argument, 0, 'E'},
+      {"toa",          no_argument,       0, 't'},
+      {"low-latency",  no_argument,       0, 'l'},
+      {"serial",       required_argument, 0, 's'},
+      {"lock-mem",     required_argument, 0, 'L'},
+      {"rt",           required_argument, 0, 'P'},
       {0, 0, 0, 0}
     };
     /* getopt_long stores the option index here. */
     int option_index = 0;
-    int c = getopt_long (argc, argv, "hc:g:",
+    int c = getopt_long (argc, argv, "hc:g:adR:w:T:W:m:M:F:D:pHC:SBAE:tls:L:P:",
                      long_options, &option_index);
 
     /* Detect the end of the options. */
@@ -912,12 +850,151 @@ void parse_commandline(
       case 'g':
         (*gain) = strtol(optarg,&endp,10);
         break;
-        
-      case '?':
-        /* getopt_long already printed an error message. */
-        goto abnormal_quit;
-        
-      default:
+
+      case 'a':
+        (*agc) = true;
+        break;
+
+      case 'd':
+        (*iq_corr) = true;
+        break;
+
+      case 'R':
+        (*rate) = strtol(optarg,&endp,10);
+        break;
+
+      case 'w':
+        (*record_prefix) = optarg;
+        p = strrchr(optarg, ':');
+        if (p != NULL) {
+          (*p) = 0;
+          (*record_seconds) = strtol(p+1,&endp,10);
+          if ( (*endp) != 0 || p[1] == 0 ) {
+            printf("record length must be in seconds!\n");
+            goto abnormal_quit;
+          }
+        }
+        break;
+
+      case 'T':
+        if ( parse_trigger(optarg, trigger) != 0 ) {
+          goto abnormal_quit;
+        }
+        break;
+
+      case 'W':
+        trigger->pre_ms = strtol(optarg,&endp,10);
+        if ( (*endp) != ':' || endp == optarg ) {
+          printf("window must be pre_ms:post_ms!\n");
+          goto abnormal_quit;
+        }
+        p = endp+1;
+        trigger->post_ms = strtol(p,&endp,10);
+        if ( (*endp) != 0 || (*p) == 0 || trigger->pre_ms < 0 || trigger->post_ms < 0 ) {
+          printf("window must be pre_ms:post_ms!\n");
+          goto abnormal_quit;
+        }
+        break;
+
+      case 'm':
+        (*metrics_target) = optarg;
+        break;
+
+      case 'M':
+        (*metrics_interval_ms) = strtol(optarg,&endp,10);
+        break;
+
+      case 'F':
+        if ( parse_filter(optarg, filter) != 0 ) {
+          goto abnormal_quit;
+        }
+        break;
+
+      case 'D':
+        if ( parse_link(optarg, link) != 0 ) {
+          goto abnormal_quit;
+        }
+        break;
+
+      case 'p':
+        (*promisc) = true;
+        break;
+
+      case 'H':
+        (*hop) = true;
+        break;
+
+      case 'C':
+        (*csa) = strtol(optarg,&endp,10);
+        break;
+
+      case 'S':
+        (*sync) = true;
+        break;
+
+      case 'B':
+        (*big) = true;
+        break;
+
+      case 'A':
+        (*ad) = true;
+        break;
+
+      case 'E':
+        (*cte_name) = optarg;
+        p = strrchr(optarg, ':');
+        if ( p != NULL && strcmp(p+1, "cfo") == 0 ) {
+          (*p) = 0;
+          (*cte_cfo) = true;
+        }
+        break;
+
+      case 't':
+        (*toa) = true;
+        break;
+
+      case 'l':
+        (*low_lat) = true;
+        break;
+
+      case 's':
+        if ( (*num_dev) == MAX_NUM_RX_DEV ) {
+          printf("at most %d boards!\n", MAX_NUM_RX_DEV);
+          goto abnormal_quit;
+        }
+        serial[*num_dev] = optarg;
+        dev_chan[*num_dev] = -1; // -c
+        p = strchr(optarg, ':');
+        if (p != NULL) {
+          (*p) = 0;
+          dev_chan[*num_dev] = strtol(p+1,&endp,10);
+          if ( (*endp) != 0 || p[1] == 0 || dev_chan[*num_dev]<0 || dev_chan[*num_dev]>MAX_CHANNEL_NUMBER ) {
+            printf("channel number must be within 0~%d!\n", MAX_CHANNEL_NUMBER);
+            goto abnormal_quit;
+          }
+        }
+        (*num_dev)++;
+        break;
+
+      case 'L':
+        if ( strcmp(optarg, "lock") != 0 && strcmp(optarg, "huge") != 0 ) {
+          printf("lock-mem must be lock or huge!\n");
+          goto abnormal_quit;
+        }
+        rt->mem = ( optarg[0] == 'h'? RT_MEM_HUGE : RT_MEM_LOCK );
+        break;
+
+      case 'P':
+        if ( rt_parse(optarg, rt) != 0 ) {
+          goto abnormal_quit;
+        }
+        break;
+        
+      case '?':
+        /* getopt_long already printed an error message. */
+        goto abnormal_quit;
+        
+      default:
         goto abnormal_quit;
     }
     
@@ -927,9 +1004,77 @@ void parse_commandline(
     printf("channel number must be within 0~%d!\n", MAX_CHANNEL_NUMBER);
     goto abnormal_quit;
   }
+
+  // without -s: the first board found, on -c
+  if ( (*num_dev) == 0 ) {
+    serial[0] = NULL;
+    dev_chan[0] = (*chan);
+    (*num_dev) = 1;
+  }
+  for (i=0; i<(*num_dev); i++) {
+    if (dev_chan[i] < 0) {
+      dev_chan[i] = (*chan);
+    }
+  }
   
-  if ( (*gain)<0 || (*gain)>MAX_GAIN ) {
-    printf("rx gain must be within 0~%d!\n", MAX_GAIN);
+  if ( (*rate) != SAMPLE_PER_SYMBOL && (*rate) != 2*SAMPLE_PER_SYMBOL ) {
+    printf("sample rate must be %d or %d Msps!\n", SAMPLE_PER_SYMBOL, 2*SAMPLE_PER_SYMBOL);
+    goto abnormal_quit;
+  }
+
+  if ( (*record_prefix) != NULL && ( (*record_seconds)<1 || strlen(*record_prefix) > MAX_LEN_RECORD_PREFIX ) ) {
+    printf("record length must be at least 1s, prefix at most %d characters!\n", MAX_LEN_RECORD_PREFIX);
+    goto abnormal_quit;
+  }
+
+  if ( (*promisc) && link->data_pdu ) {
+    printf("-p and -D exclude each other!\n");
+    goto abnormal_quit;
+  }
+
+  if ( (*hop) && !(*promisc) && !link->data_pdu ) {
+    printf("-H needs -D or -p!\n");
+    goto abnormal_quit;
+  }
+  if ( (*csa) != 1 && (*csa) != 2 ) {
+    printf("-C must be 1 or 2!\n");
+    goto abnormal_quit;
+  }
+  for (i=0; (*hop) && i<(*num_dev); i++) {
+    if (dev_chan[i] >= NUM_DATA_CHANNEL) {
+      printf("-H: every board must be on a data channel, 0~%d!\n", NUM_DATA_CHANNEL-1);
+      goto abnormal_quit;
+    }
+  }
+
+  if ( (*sync) && ((*hop) || (*promisc) || link->data_pdu) ) {
+    printf("-S excludes -D, -p and -H!\n");
+    goto abnormal_quit;
+  }
+  for (i=0; (*sync) && i<(*num_dev); i++) {
+    if (dev_chan[i] >= NUM_DATA_CHANNEL) {
+      printf("-S: every board must be on a data channel (secondary advertising channel), 0~%d!\n", NUM_DATA_CHANNEL-1);
+      goto abnormal_quit;
+    }
+  }
+
+  if ( (*big) && !(*sync) ) {
+    printf("-B needs -S!\n");
+    goto abnormal_quit;
+  }
+
+  if ( (*record_prefix) == NULL && trigger_is_active(trigger) ) {
+    printf("-T needs -w!\n");
+    goto abnormal_quit;
+  }
+
+  if ( (*gain)<0 || (*gain)>MAX_RX_GAIN ) {
+    printf("rx gain must be within 0~%d!\n", MAX_RX_GAIN);
+    goto abnormal_quit;
+  }
+
+  if ( (*metrics_interval_ms)<100 ) {
+    printf("metrics interval must be at least 100ms!\n");
     goto abnormal_quit;
   }
   
@@ -949,17 +1094,10 @@ abnormal_quit:
 
 //----------------------------------receiver----------------------------------
 
-//#define LEN_DEMOD_BUF_PREAMBLE_ACCESS ( (NUM_PREAMBLE_ACCESS_BYTE*8)-8 ) // to get 2^x integer
-#define LEN_DEMOD_BUF_PREAMBLE_ACCESS 32
-//#define LEN_DEMOD_BUF_PREAMBLE_ACCESS (NUM_PREAMBLE_ACCESS_BYTE*8)
 typedef enum {
   RISE_EDGE,
   FALL_EDGE
 } EDGE_TYPE;
-static uint8_t demod_buf_preamble_access[SAMPLE_PER_SYMBOL][LEN_DEMOD_BUF_PREAMBLE_ACCESS];
-uint8_t preamble_access_byte[NUM_PREAMBLE_ACCESS_BYTE] = {0xAA, 0xD6, 0xBE, 0x89, 0x8E};
-uint8_t preamble_access_bit[NUM_PREAMBLE_ACCESS_BYTE*8];
-uint8_t tmp_byte[2+37+3]; // header length + maximum payload length 37 + 3 octets CRC
 
 bool edge_detect(IQ_TYPE *rxp, EDGE_TYPE edge_target, int avg_len, int th) {
   int fake_power[2] = {0, 0};
@@ -990,468 +1128,1685 @@ bool edge_detect(IQ_TYPE *rxp, EDGE_TYPE edge_target, int avg_len, int th) {
   return(false);
 }
 
-void demod_byte(IQ_TYPE* rxp, int num_byte, uint8_t *out_byte) {
-  int i, j;
-  int I0, Q0, I1, Q1;
-  uint8_t bit_decision;
-  int sample_idx = 0;
-  
-  for (i=0; i<num_byte; i++) {
-    out_byte[i] = 0;
-    for (j=0; j<8; j++) {
-      I0 = rxp[sample_idx];
-      Q0 = rxp[sample_idx+1];
-      I1 = rxp[sample_idx+2];
-      Q1 = rxp[sample_idx+3];
-      bit_decision = (I0*Q1 - I1*Q0)>0? 1 : 0;
-      out_byte[i] = out_byte[i] | (bit_decision<<j);
+//----------------------------------packet ring----------------------------------
+// receiver() only demodulates and queues; printing happens in output_thread, so a slow
+// terminal or pipe shows up as output backlog and drops instead of stalling demodulation.
 
-      sample_idx = sample_idx + SAMPLE_PER_SYMBOL*2;
+// returns NULL when the ring is full
+static inline PKT_RECORD* pkt_ring_claim(RX_DEV *dev) {
+  if ( (dev->pkt_ring_head - dev->pkt_ring_tail) >= LEN_PKT_RING ) {
+    return(NULL);
+  }
+  return( dev->pkt_ring + (dev->pkt_ring_head&(LEN_PKT_RING-1)) );
+}
+
+static inline void pkt_ring_publish(RX_DEV *dev) {
+  memory_barrier(); // record content before head
+  dev->pkt_ring_head = dev->pkt_ring_head + 1;
+}
+//----------------------------------packet ring----------------------------------
+
+bool cte_enable;     // -E
+bool cte_cfo_remove; // -E file:cfo
+CTE_FILE cte_file;   // written by output_thread only
+
+// called by receiver_block for every demodulated packet. arg is the RX_DEV
+// sync_idx, pa_event, bis, payload: see PKT_RECORD
+static void queue_pkt_tag(BTLE_PKT *pkt, RX_DEV *dev, int sync_idx, uint16_t pa_event, int bis, uint64_t payload) {
+  uint64_t sample_idx = dev->block_base + pkt->pkt_start;
+  bool torn_flag;
+  PKT_RECORD *r;
+  CTE_LAYOUT l;
+
+  // demod is done, so if rx_callback has not lapped the packet start by now, the samples were intact
+  torn_flag = ( num_overwritten(&(dev->account), sample_idx, pkt->pkt_end+pkt->cte_len-pkt->pkt_start) != 0 );
+  if (torn_flag) {
+    dev->account.num_torn_pkt++;
+  }
+
+  agc_pkt(&(dev->agc), pkt->rssi, pkt->crc_flag);
+
+  if ( pkt_trigger_enable && !pkt->data_pdu && filter_pkt(&(rec_trigger.pkt), pkt->channel_number, pkt->pdu_type, pkt->rssi, pkt->byte+2, pkt->payload_len) ) {
+    iq_rec_trigger(&(dev->rec), sample_idx, pkt->pkt_end-pkt->pkt_start, IQREC_TRIG_PKT);
+  }
+
+  r = pkt_ring_claim(dev);
+  if (r == NULL) {
+    METRICS_INC(dev->stat.num_pkt_drop);
+    return;
+  }
+  r->sample_idx = sample_idx;
+  // sub-sample: toa_estimate moves the preamble off the sample pkt_start found it at
+  r->time_ns = sample_idx_to_ns(&(dev->account), sample_idx) + (int64_t)lrintf( pkt->toa*(1000.0f/SAMPLE_PER_SYMBOL) );
+  r->end_ns = sample_idx_to_ns(&(dev->account), dev->block_base + pkt->pkt_end);
+  r->channel_number = pkt->channel_number;
+  r->access_addr = pkt->access_addr;
+  r->data_pdu = pkt->data_pdu;
+  r->pdu_type = pkt->pdu_type;
+  r->tx_add = pkt->tx_add;
+  r->rx_add = pkt->rx_add;
+  r->payload_len = pkt->payload_len;
+  r->crc_flag = pkt->crc_flag;
+  r->torn_flag = torn_flag;
+  r->sync_idx = sync_idx;
+  r->pa_event = pa_event;
+  r->bis = bis;
+  r->payload = payload;
+  memcpy(r->byte, pkt->byte, pkt->payload_len+2+3);
+  r->cte_info = -1;
+  if ( cte_enable && pkt->cte_info >= 0 ) {
+    if (pkt->cte == NULL) {
+      METRICS_INC(dev->stat.num_cte_cut);
+    } else if ( cte_layout(pkt->cte_info, CTE_AOA_SLOT_US, &l) == 0 ) {
+      // from rx_buf straight into the record, which output_thread hands to fwrite as it is
+      r->cte_cfo_hz = cte_extract(pkt->cte, &l, cte_cfo_remove, r->cte_iq);
+      r->cte_info = pkt->cte_info;
+      METRICS_INC(dev->stat.num_cte);
     }
   }
+  pkt_ring_publish(dev);
+  METRICS_INC(dev->stat.num_pkt_queued);
 }
 
-inline int search_unique_bits(IQ_TYPE* rxp, int search_len, uint8_t *unique_bits, const int num_bits) {
-  int i, sp, j, i0, q0, i1, q1, k, p, phase_idx;
-  bool unequal_flag;
-  const int demod_buf_len = num_bits;
-  int demod_buf_offset = 0;
-  
-  //demod_buf_preamble_access[SAMPLE_PER_SYMBOL][LEN_DEMOD_BUF_PREAMBLE_ACCESS]
-  memset(demod_buf_preamble_access, 0, SAMPLE_PER_SYMBOL*LEN_DEMOD_BUF_PREAMBLE_ACCESS);
-  for(i=0; i<search_len*SAMPLE_PER_SYMBOL*2; i=i+(SAMPLE_PER_SYMBOL*2)) {
-    sp = ( (demod_buf_offset-demod_buf_len+1)&(demod_buf_len-1) );
-    //sp = (demod_buf_offset-demod_buf_len+1);
-    //if (sp>=demod_buf_len)
-    //  sp = sp - demod_buf_len;
-    
-    for(j=0; j<(SAMPLE_PER_SYMBOL*2); j=j+2) {
-      i0 = rxp[i+j];
-      q0 = rxp[i+j+1];
-      i1 = rxp[i+j+2];
-      q1 = rxp[i+j+3];
-      
-      phase_idx = j/2;
-      demod_buf_preamble_access[phase_idx][demod_buf_offset] = (i0*q1 - i1*q0) > 0? 1: 0;
-      
-      k = sp;
-      unequal_flag = false;
-      for (p=0; p<demod_buf_len; p++) {
-        if (demod_buf_preamble_access[phase_idx][k] != unique_bits[p]) {
-          unequal_flag = true;
-          break;
-        }
-        k = ( (k + 1)&(demod_buf_len-1) );
-        //k = (k + 1);
-        //if (k>=demod_buf_len)
-        //  k = k - demod_buf_len;
-      }
-      
-      if(unequal_flag==false) {
-        return( i + j - (demod_buf_len-1)*SAMPLE_PER_SYMBOL*2 );
+void queue_pkt(BTLE_PKT *pkt, void *arg) {
+  queue_pkt_tag(pkt, (RX_DEV *)arg, -1, 0, 0, 0);
+}
+
+BTLE_FILTER rx_filter; // set up by parse_commandline
+BTLE_FILTER *rx_filter_active; // NULL if rx_filter accepts everything
+BTLE_LINK rx_link; // -D, else advertising
+
+//----------------------------------connection following----------------------------------
+#define FOLLOW_RETUNE_US 300  // a retune must be done this long before the anchor
+#define FOLLOW_SLEEP_US 100000 // longest sleep of follow_thread, so that it sees do_exit
+
+bool hop_enable;           // -H
+int hop_csa;               // -C
+HOP_EST hop_est;           // packets of all boards
+FOLLOW_CONN follow_conn;   // set up once by the board that completes hop_est
+bool follow_started;
+pthread_mutex_t follow_lock = PTHREAD_MUTEX_INITIALIZER; // hop_est, and follow_conn between its demod and follow thread
+
+static inline int64_t host_time_us(void) {
+  struct timeval time_current;
+  gettimeofday(&time_current, NULL);
+  return( (int64_t)time_current.tv_sec*1000000 + time_current.tv_usec );
+}
+
+// by the only thread retuning dev at the time: its demod thread while estimating, then its follow_thread
+// or sync_thread. follow, bis: the link received from sample_idx on, see receiver(). the board is
+// left alone if it is on chan already: only the link changes then
+static int retune(RX_DEV *dev, uint64_t sample_idx, int chan, FOLLOW_CONN *follow, int bis) {
+  CHAN_SWITCH *sw;
+  int64_t t0;
+
+  if (chan != dev->tuned_chan) {
+    t0 = host_time_us();
+    if ( set_board_rx_freq(dev->rf_dev, get_freq_by_channel_number(chan)) != 0 ) {
+      return(-1);
+    }
+    t0 = host_time_us() - t0;
+    metrics_hist_observe(&(dev->stat.retune_us), t0);
+    dev->retune_avg_us = ( dev->stat.num_retune == 0? t0 : dev->retune_avg_us + (t0 - dev->retune_avg_us)/8 );
+    if (t0 > dev->retune_max_us) {
+      dev->retune_max_us = t0;
+    }
+    dev->tuned_chan = chan;
+    METRICS_INC(dev->stat.num_retune);
+  }
+  sw = dev->chan_switch + (dev->chan_switch_head&(LEN_CHAN_SWITCH-1));
+  sw->sample_idx = sample_idx&(~((uint64_t)1));
+  sw->chan = chan;
+  sw->follow = follow;
+  sw->bis = bis;
+  memory_barrier(); // entry before head
+  dev->chan_switch_head = dev->chan_switch_head + 1;
+  return(0);
+}
+
+// Sleeps until the midpoint between two events and retunes to the channel of the next one.
+// The midpoint is converted to host time by the sample accounting, which is good to a
+// fraction of a transfer: half an interval of margin either way.
+void *follow_thread(void *arg) {
+  RX_DEV *dev = (RX_DEV *)arg;
+  FOLLOW_CONN *f = &follow_conn;
+  struct timeval time_current;
+  uint64_t anchor_idx, boundary;
+  uint32_t event;
+  int64_t wait_us;
+  int chan;
+
+  pthread_mutex_lock(&follow_lock);
+  event = f->anchor_event + 1;
+  pthread_mutex_unlock(&follow_lock);
+  while (do_exit == false) {
+    pthread_mutex_lock(&follow_lock);
+    if (event <= f->anchor_event) { // the anchor moved on meanwhile
+      event = f->anchor_event + 1;
+    }
+    anchor_idx = follow_anchor_idx(f, event);
+    boundary = anchor_idx - (uint64_t)(f->interval_sample/2);
+    chan = follow_channel(f, event);
+    pthread_mutex_unlock(&follow_lock);
+
+    gettimeofday(&time_current, NULL);
+    wait_us = sample_idx_to_ns(&(dev->account), anchor_idx)/1000 - FOLLOW_RETUNE_US - ( (int64_t)time_current.tv_sec*1000000 + time_current.tv_usec );
+    if (wait_us < 0) {
+      METRICS_INC(dev->stat.num_retune_late);
+      event++;
+      continue;
+    }
+    wait_us = sample_idx_to_ns(&(dev->account), boundary)/1000 - ( (int64_t)time_current.tv_sec*1000000 + time_current.tv_usec );
+    if (wait_us > 0) {
+      usleep( wait_us > FOLLOW_SLEEP_US? FOLLOW_SLEEP_US : wait_us );
+      if (wait_us > FOLLOW_SLEEP_US) {
+        continue;
       }
-      
     }
+    if ( retune(dev, boundary, chan, f, 0) != 0 ) {
+      usleep(FOLLOW_SLEEP_US);
+      continue;
+    }
+    event++;
+    // the channel of the event after next, well before it is needed
+    pthread_mutex_lock(&follow_lock);
+    follow_table_fill(f, event);
+    pthread_mutex_unlock(&follow_lock);
+  }
+  return(NULL);
+}
 
-    demod_buf_offset  = ( (demod_buf_offset+1)&(demod_buf_len-1) );
-    //demod_buf_offset  = (demod_buf_offset+1);
-    //if (demod_buf_offset>=demod_buf_len)
-    //  demod_buf_offset = demod_buf_offset - demod_buf_len;
+// every CRC-OK data channel PDU, from the demod thread of dev
+static void follow_observe(RX_DEV *dev, uint32_t access_addr, uint32_t crc_init, int channel_number, uint64_t sample_idx) {
+  int event;
+
+  pthread_mutex_lock(&follow_lock);
+  if (dev->follow != NULL) {
+    if (access_addr == dev->follow->link.access_addr) {
+      follow_pkt(dev->follow, sample_idx);
+    }
+    pthread_mutex_unlock(&follow_lock);
+    return;
+  }
+  if (follow_started) {
+    pthread_mutex_unlock(&follow_lock);
+    return;
   }
 
-  return(-1);
+  event = hop_est_add(&hop_est, access_addr, channel_number, sample_idx);
+  if (event & HOP_EVENT_INTERVAL) {
+    printf("hop: AA %08X connInterval %.2fms (%d x 1.25ms) from %d revisits in %.3fs%s\n", hop_est.access_addr, hop_est.interval*1.25, hop_est.interval,
+      hop_est.num_revisit, sample_idx_to_ms(sample_idx - hop_est.first_idx)/1000.0, dev->tag);
+    // one channel only sees CSA#1 revisits. the next one is met within 37 events
+    if (hop_est.csa == 1 && num_rx_dev == 1 && retune(dev, dev->account.produced, hop_est_probe_channel(&hop_est), NULL, 0) == 0) {
+      printf("hop: moving to ch%d for the hop increment%s\n", hop_est_probe_channel(&hop_est), dev->tag);
+    }
+  }
+  if (event & HOP_EVENT_INCREMENT) {
+    printf("hop: AA %08X hop increment %d (ch%d to ch%d in %d events) after %.3fs%s\n", hop_est.access_addr, hop_est.hop, hop_est.hop_chan_a, hop_est.hop_chan_b,
+      hop_est.hop_num_event, sample_idx_to_ms(sample_idx - hop_est.first_idx)/1000.0, dev->tag);
+  }
+  if (event & HOP_EVENT_COUNTER) {
+    printf("hop: AA %08X CSA#2 connEventCounter %u, the only one of %d that fits %d events, after %.3fs%s\n", hop_est.access_addr, hop_est.counter, NUM_CSA2_COUNTER,
+      (hop_est.num_hist < HOP_CSA2_HIST_LEN? hop_est.num_hist : HOP_CSA2_HIST_LEN), sample_idx_to_ms(sample_idx - hop_est.first_idx)/1000.0, dev->tag);
+  }
+  if (event & (HOP_EVENT_INCREMENT|HOP_EVENT_COUNTER)) {
+    follow_init_from_est(&follow_conn, &hop_est, crc_init);
+    follow_started = true;
+    dev->follow = &follow_conn;
+    if ( pthread_create(&(dev->follow_thread_id), NULL, follow_thread, (void *)dev) != 0 ) {
+      printf("follow_observe: pthread_create failed!\n");
+      dev->follow = NULL;
+    } else {
+      printf("follow: AA %08X CRCInit %06X from ch%d, connInterval %.4fms measured%s\n", follow_conn.link.access_addr, follow_conn.link.crc_init,
+        hop_est.last_chan, sample_idx_to_ms((uint64_t)follow_conn.interval_sample), dev->tag);
+    }
+  }
+  pthread_mutex_unlock(&follow_lock);
 }
 
-int parse_adv_pdu_payload_byte(uint8_t *payload_byte, int num_payload_byte, int pdu_type, void *adv_pdu_payload) {
-  int i;
-  ADV_PDU_PAYLOAD_TYPE_0_2_4_6 *payload_type_0_2_4_6 = NULL;
-  ADV_PDU_PAYLOAD_TYPE_1_3 *payload_type_1_3 = NULL;
-  ADV_PDU_PAYLOAD_TYPE_5 *payload_type_5 = NULL;
-  ADV_PDU_PAYLOAD_TYPE_R *payload_type_R = NULL;
-  if (num_payload_byte<6) {
-      //payload_parse_result_str = ['Payload Too Short (only ' num2str(length(payload_bits)) ' bits)'];
-      printf("Error: Payload Too Short (only %d bytes)\n", num_payload_byte);
-      return(-1);
+// receiver_block handler while receiving a connection (-D, or following)
+void queue_link_pkt(BTLE_PKT *pkt, void *arg) {
+  RX_DEV *dev = (RX_DEV *)arg;
+
+  queue_pkt(pkt, arg);
+  if (pkt->crc_flag == 0) {
+    follow_observe(dev, pkt->access_addr, (dev->follow != NULL? dev->follow->link.crc_init : rx_link.crc_init), pkt->channel_number, dev->block_base + pkt->pkt_start);
   }
+}
 
-  if (pdu_type == 0 || pdu_type == 2 || pdu_type == 4 || pdu_type == 6) {
-      payload_type_0_2_4_6 = (ADV_PDU_PAYLOAD_TYPE_0_2_4_6 *)adv_pdu_payload;
-      
-      //AdvA = reorder_bytes_str( payload_bytes(1 : (2*6)) );
-      payload_type_0_2_4_6->AdvA[0] = payload_byte[5];
-      payload_type_0_2_4_6->AdvA[1] = payload_byte[4];
-      payload_type_0_2_4_6->AdvA[2] = payload_byte[3];
-      payload_type_0_2_4_6->AdvA[3] = payload_byte[2];
-      payload_type_0_2_4_6->AdvA[4] = payload_byte[1];
-      payload_type_0_2_4_6->AdvA[5] = payload_byte[0];
-      
-      //AdvData = payload_bytes((2*6+1):end);
-      for(i=0; i<(num_payload_byte-6); i++) {
-        payload_type_0_2_4_6->Data[i] = payload_byte[6+i];
-      }
-      
-      //payload_parse_result_str = ['AdvA:' AdvA ' AdvData:' AdvData];
-  } else if (pdu_type == 1 || pdu_type == 3) {
-      if (num_payload_byte!=12) {
-          printf("Error: Payload length %d bytes. Need to be 12 for PDU Type %d\n", num_payload_byte, pdu_type);
-          return(-1);
-      }
-      payload_type_1_3 = (ADV_PDU_PAYLOAD_TYPE_1_3 *)adv_pdu_payload;
-      
-      //AdvA = reorder_bytes_str( payload_bytes(1 : (2*6)) );
-      payload_type_1_3->A0[0] = payload_byte[5];
-      payload_type_1_3->A0[1] = payload_byte[4];
-      payload_type_1_3->A0[2] = payload_byte[3];
-      payload_type_1_3->A0[3] = payload_byte[2];
-      payload_type_1_3->A0[4] = payload_byte[1];
-      payload_type_1_3->A0[5] = payload_byte[0];
-      
-      //InitA = reorder_bytes_str( payload_bytes((2*6+1):end) );
-      payload_type_1_3->A1[0] = payload_byte[11];
-      payload_type_1_3->A1[1] = payload_byte[10];
-      payload_type_1_3->A1[2] = payload_byte[9];
-      payload_type_1_3->A1[3] = payload_byte[8];
-      payload_type_1_3->A1[4] = payload_byte[7];
-      payload_type_1_3->A1[5] = payload_byte[6];
-      
-      //payload_parse_result_str = ['AdvA:' AdvA ' InitA:' InitA];
-  } else if (pdu_type == 5) {
-      if (num_payload_byte!=34) {
-          printf("Error: Payload length %d bytes. Need to be 34 for PDU Type %d\n", num_payload_byte, pdu_type);
-          return(-1);
-      }
-      payload_type_5 = (ADV_PDU_PAYLOAD_TYPE_5 *)adv_pdu_payload;
-      
-      //InitA = reorder_bytes_str( payload_bytes(1 : (2*6)) );
-      payload_type_5->InitA[0] = payload_byte[5];
-      payload_type_5->InitA[1] = payload_byte[4];
-      payload_type_5->InitA[2] = payload_byte[3];
-      payload_type_5->InitA[3] = payload_byte[2];
-      payload_type_5->InitA[4] = payload_byte[1];
-      payload_type_5->InitA[5] = payload_byte[0];
-      
-      //AdvA = reorder_bytes_str( payload_bytes((2*6+1):(2*6+2*6)) );
-      payload_type_5->AdvA[0] = payload_byte[11];
-      payload_type_5->AdvA[1] = payload_byte[10];
-      payload_type_5->AdvA[2] = payload_byte[9];
-      payload_type_5->AdvA[3] = payload_byte[8];
-      payload_type_5->AdvA[4] = payload_byte[7];
-      payload_type_5->AdvA[5] = payload_byte[6];
-      
-      //AA = reorder_bytes_str( payload_bytes((2*6+2*6+1):(2*6+2*6+2*4)) );
-      payload_type_5->AA[0] = payload_byte[15];
-      payload_type_5->AA[1] = payload_byte[14];
-      payload_type_5->AA[2] = payload_byte[13];
-      payload_type_5->AA[3] = payload_byte[12];
-      
-      //CRCInit = payload_bytes((2*6+2*6+2*4+1):(2*6+2*6+2*4+2*3));
-      payload_type_5->CRCInit = 0;
-      payload_type_5->CRCInit = ( (payload_type_5->CRCInit << 8) | payload_byte[16] );
-      payload_type_5->CRCInit = ( (payload_type_5->CRCInit << 8) | payload_byte[17] );
-      payload_type_5->CRCInit = ( (payload_type_5->CRCInit << 8) | payload_byte[18] );
-      
-      //WinSize = payload_bytes((2*6+2*6+2*4+2*3+1):(2*6+2*6+2*4+2*3+2*1));
-      payload_type_5->WinSize = payload_byte[19];
-      
-      //WinOffset = reorder_bytes_str( payload_bytes((2*6+2*6+2*4+2*3+2*1+1):(2*6+2*6+2*4+2*3+2*1+2*2)) );
-      payload_type_5->WinOffset = 0;
-      payload_type_5->WinOffset = ( (payload_type_5->WinOffset << 8) | payload_byte[21] );
-      payload_type_5->WinOffset = ( (payload_type_5->WinOffset << 8) | payload_byte[20] );
-      
-      //Interval = reorder_bytes_str( payload_bytes((2*6+2*6+2*4+2*3+2*1+2*2+1):(2*6+2*6+2*4+2*3+2*1+2*2+2*2)) );
-      payload_type_5->Interval = 0;
-      payload_type_5->Interval = ( (payload_type_5->Interval << 8) | payload_byte[23] );
-      payload_type_5->Interval = ( (payload_type_5->Interval << 8) | payload_byte[22] );
-      
-      //Latency = reorder_bytes_str( payload_bytes((2*6+2*6+2*4+2*3+2*1+2*2+2*2+1):(2*6+2*6+2*4+2*3+2*1+2*2+2*2+2*2)) );
-      payload_type_5->Latency = 0;
-      payload_type_5->Latency = ( (payload_type_5->Latency << 8) | payload_byte[25] );
-      payload_type_5->Latency = ( (payload_type_5->Latency << 8) | payload_byte[24] );
-      
-      //Timeout = reorder_bytes_str( payload_bytes((2*6+2*6+2*4+2*3+2*1+2*2+2*2+2*2+1):(2*6+2*6+2*4+2*3+2*1+2*2+2*2+2*2+2*2)) );
-      payload_type_5->Timeout = 0;
-      payload_type_5->Timeout = ( (payload_type_5->Timeout << 8) | payload_byte[27] );
-      payload_type_5->Timeout = ( (payload_type_5->Timeout << 8) | payload_byte[26] );
-      
-      //ChM = reorder_bytes_str( payload_bytes((2*6+2*6+2*4+2*3+2*1+2*2+2*2+2*2+2*2+1):(2*6+2*6+2*4+2*3+2*1+2*2+2*2+2*2+2*2+2*5)) );
-      payload_type_5->ChM[0] = payload_byte[32];
-      payload_type_5->ChM[1] = payload_byte[31];
-      payload_type_5->ChM[2] = payload_byte[30];
-      payload_type_5->ChM[3] = payload_byte[29];
-      payload_type_5->ChM[4] = payload_byte[28];
-      
-      //tmp_bits = payload_bits((end-7) : end);
-      //Hop = num2str( bi2de(tmp_bits(1:5), 'right-msb') );
-      //SCA = num2str( bi2de(tmp_bits(6:end), 'right-msb') );
-      payload_type_5->Hop = (payload_byte[33]&0x1F);
-      payload_type_5->SCA = ((payload_byte[33]>>5)&0x07);
-  } else {
-      payload_type_R = (ADV_PDU_PAYLOAD_TYPE_R *)adv_pdu_payload;
+void print_follow(RX_DEV *dev) {
+  FOLLOW_CONN *f = dev->follow;
+  printf("follow%s: AA %08X %llu packets in %llu events, %llu retunes, %llu events too late to retune for, connInterval %.4fms\n", dev->tag,
+    f->link.access_addr, (unsigned long long)f->num_pkt, (unsigned long long)f->num_anchor, (unsigned long long)dev->stat.num_retune,
+    (unsigned long long)dev->stat.num_retune_late, sample_idx_to_ms((uint64_t)f->interval_sample));
+}
+//----------------------------------connection following----------------------------------
 
-      for(i=0; i<(num_payload_byte); i++) {
-        payload_type_R->payload_byte[i] = payload_byte[i];
-      }
-      //printf("Warning: Reserved PDU type %d\n", pdu_type);
-      //return(-1);
+//----------------------------------BIG----------------------------------
+#define BIG_LEAD_US 2000        // the first BIG event planned starts at least this long after the newest samples
+#define BIG_MAX_WAKE_LEAD_US 200 // how much earlier than a retune usleep is aimed, at most
+#define BIG_RETUNE_MARGIN_US 50 // between subevents on different channels, on top of the average retune time
+
+bool big_enable; // -B
+
+// payload went through queue_bis_pkt already. follow_lock
+static bool bis_seen(BIS_STREAM *st, uint64_t payload) {
+  if (st->num_payload == 0 || payload > st->last_payload) {
+    return(false);
   }
-  
-  return(0);
+  if (st->last_payload - payload >= BIS_SEEN_WINDOW) {
+    return(true); // long gone, whether received or not
+  }
+  return( (st->seen>>(st->last_payload - payload))&1 );
+}
+
+static int big_subevent_cmp(const void *a, const void *b) {
+  const BIG_SUBEVENT *x = (const BIG_SUBEVENT *)a, *y = (const BIG_SUBEVENT *)b;
+  if (x->start != y->start) {
+    return( x->start < y->start? -1 : 1 );
+  }
+  return(x->bis - y->bis);
 }
-void parse_adv_pdu_header_byte(uint8_t *byte_in, int *pdu_type, int *tx_add, int *rx_add, int *payload_len) {
-//% pdy_type_str = {'ADV_IND', 'ADV_DIRECT_IND', 'ADV_NONCONN_IND', 'SCAN_REQ', 'SCAN_RSP', 'CONNECT_REQ', 'ADV_SCAN_IND', 'Reserved', 'Reserved', 'Reserved', 'Reserved', 'Reserved', 'Reserved', 'Reserved', 'Reserved'};
-//pdu_type = bi2de(bits(1:4), 'right-msb');
-(*pdu_type) = (byte_in[0]&0x0F);
-//% disp(['   PDU Type: ' pdy_type_str{pdu_type+1}]);
-
-//tx_add = bits(7);
-//% disp(['     Tx Add: ' num2str(tx_add)]);
-(*tx_add) = ( (byte_in[0]&0x40) != 0 );
-
-//rx_add = bits(8);
-//% disp(['     Rx Add: ' num2str(rx_add)]);
-(*rx_add) = ( (byte_in[0]&0x80) != 0 );
-
-//payload_len = bi2de(bits(9:14), 'right-msb');
-(*payload_len) = (byte_in[1]&0x3F);
-}
-
-inline void receiver_init(void) {
-  byte_array_to_bit_array(preamble_access_byte, 5, preamble_access_bit);
-}
-
-bool crc_check(uint8_t *tmp_byte, int body_len) {
-    int crc24_checksum, crc24_received;
-    crc24_checksum = crc24_byte(tmp_byte, body_len, 0xAAAAAA); // 0x555555 --> 0xaaaaaa. maybe because byte order
-    crc24_received = 0;
-    crc24_received = ( (crc24_received << 8) | tmp_byte[body_len+2] );
-    crc24_received = ( (crc24_received << 8) | tmp_byte[body_len+1] );
-    crc24_received = ( (crc24_received << 8) | tmp_byte[body_len+0] );
-    return(crc24_checksum!=crc24_received);
-}
-
-void print_pdu_payload(void *adv_pdu_payload, int pdu_type, int payload_len, bool crc_flag) {
-    int i;
-    ADV_PDU_PAYLOAD_TYPE_5 *adv_pdu_payload_5;
-    ADV_PDU_PAYLOAD_TYPE_1_3 *adv_pdu_payload_1_3;
-    ADV_PDU_PAYLOAD_TYPE_0_2_4_6 *adv_pdu_payload_0_2_4_6;
-    ADV_PDU_PAYLOAD_TYPE_R *adv_pdu_payload_R;
-    // print payload out
-    if (pdu_type==0 || pdu_type==2 || pdu_type==4 || pdu_type==6) {
-      adv_pdu_payload_0_2_4_6 = (ADV_PDU_PAYLOAD_TYPE_0_2_4_6 *)(adv_pdu_payload);
-      printf("AdvA:");
-      for(i=0; i<6; i++) {
-        printf("%02x", adv_pdu_payload_0_2_4_6->AdvA[i]);
+
+// sleeps until the host time of sample_idx. usleep returns late by tens of us, so it is aimed that
+// much early, but not before not_before: the lead follows the median oversleep 1us at a time, as a
+// mean would chase the odd scheduling delay of milliseconds. Spinning the rest would not help: a
+// thread that spins loses the wakeup preference of the scheduler to the demod thread when they
+// share a CPU. returns how late (<0: early) it woke up in us, INT64_MIN on do_exit
+static int64_t big_wait(RX_DEV *dev, uint64_t sample_idx, uint64_t not_before) {
+  BIG_RX *b = &(dev->big);
+  int64_t target_us, wake_us, wait_us;
+
+  while (1) {
+    target_us = sample_idx_to_ns(&(dev->account), sample_idx)/1000;
+    wake_us = sample_idx_to_ns(&(dev->account), not_before)/1000;
+    wake_us = ( target_us - b->wake_lead_us > wake_us? target_us - b->wake_lead_us : wake_us );
+    wait_us = wake_us - host_time_us();
+    if (wait_us <= 0) {
+      return( host_time_us() - target_us );
+    }
+    usleep( wait_us > FOLLOW_SLEEP_US? FOLLOW_SLEEP_US : wait_us );
+    if (do_exit) {
+      return(INT64_MIN);
+    }
+    if (wait_us <= FOLLOW_SLEEP_US) {
+      break;
+    }
+  }
+  if (host_time_us() - wake_us > b->wake_lead_us) {
+    b->wake_lead_us = ( b->wake_lead_us < BIG_MAX_WAKE_LEAD_US? b->wake_lead_us+1 : b->wake_lead_us );
+  } else if (b->wake_lead_us > 0) {
+    b->wake_lead_us--;
+  }
+  return( host_time_us() - target_us );
+}
+
+// Plans one BIG event at a time out of the subevents of all its BISes whose payload is not in
+// yet. The first pass takes each payload at its first subevent that can be reached after the
+// one taken before: a retune needs its measured time plus BIG_RETUNE_MARGIN_US, staying on a
+// channel only a new link. The second pass adds repeats that fit between the chosen ones, for
+// a CRC error on the first copy. Each retune is issued halfway through the slack before its
+// subevent (see big_wait), and dropped if it would still be running when the window opens.
+// Runs on the thread of sync_thread, which hands the board over.
+static void big_thread(RX_DEV *dev) {
+  BIG_RX *b = &(dev->big);
+  FOLLOW_BIG *g = &(b->g);
+  BIG_SUBEVENT *s = b->plan;
+  uint8_t chan[BIG_MAX_SE];
+  uint64_t anchor_idx, window, gap, pkt_sample, boundary, end, prev_end;
+  uint32_t event;
+  int64_t late_us;
+  int i, k, n, bis, se, c, prev_chan = dev->tuned_chan;
+
+  // Max_PDU octets on 1M with the preamble, access address, header and CRC
+  pkt_sample = (uint64_t)(NUM_PREAMBLE_ACCESS_BYTE + 2 + g->max_pdu + 3)*8*US_SAMPLE;
+  prev_end = dev->account.produced;
+  pthread_mutex_lock(&follow_lock);
+  event = big_event_after(g, prev_end + BIG_LEAD_US*US_SAMPLE);
+  pthread_mutex_unlock(&follow_lock);
+  while (do_exit == false) {
+    gap = (uint64_t)( (dev->stat.num_retune == 0? FOLLOW_RETUNE_US : dev->retune_avg_us) + BIG_RETUNE_MARGIN_US )*US_SAMPLE;
+
+    pthread_mutex_lock(&follow_lock);
+    anchor_idx = big_anchor_idx(g, event);
+    window = ( g->num_anchor == 0? g->window_sample : HOP_JITTER_SAMPLE );
+    n = 0;
+    for (bis=1; bis<=g->num_bis; bis++) {
+      big_channels(g, bis, event, chan);
+      for (se=0; se<g->nse; se++) {
+        s[n].payload = big_payload(g, event, se);
+        if ( bis_seen(b->bis+bis-1, s[n].payload) ) {
+          continue;
+        }
+        s[n].start = anchor_idx + big_subevent_offset(g, bis, se);
+        s[n].bis = bis;
+        s[n].chan = chan[se];
+        s[n].chosen = false;
+        n++;
       }
-      printf(" Data:");
-      for(i=0; i<(payload_len-6); i++) {
-        printf("%02x", adv_pdu_payload_0_2_4_6->Data[i]);
+    }
+    pthread_mutex_unlock(&follow_lock);
+    qsort(s, n, sizeof(BIG_SUBEVENT), big_subevent_cmp);
+
+    end = prev_end;
+    c = prev_chan;
+    for (i=0; i<n; i++) {
+      for (k=0; k<i && !( s[k].chosen && s[k].bis == s[i].bis && s[k].payload == s[i].payload ); k++);
+      if ( k < i || s[i].start < end + window + (s[i].chan == c? 0 : gap) ) {
+        continue;
       }
-    } else if (pdu_type==1 || pdu_type==3) {
-      adv_pdu_payload_1_3 = (ADV_PDU_PAYLOAD_TYPE_1_3 *)(adv_pdu_payload);
-      printf("A0:");
-      for(i=0; i<6; i++) {
-        printf("%02x", adv_pdu_payload_1_3->A0[i]);
+      s[i].chosen = true;
+      end = s[i].start + window + pkt_sample;
+      c = s[i].chan;
+    }
+    end = prev_end;
+    c = prev_chan;
+    for (i=0; i<n; i++) {
+      if (!s[i].chosen) {
+        for (k=i+1; k<n && !s[k].chosen; k++);
+        if ( k == n || s[i].start < end + window + (s[i].chan == c? 0 : gap) ||
+             s[i].start + window + pkt_sample + (s[i].chan == s[k].chan? 0 : gap) + window > s[k].start ) {
+          continue;
+        }
+        s[i].chosen = true;
       }
-      printf(" A1:");
-      for(i=0; i<6; i++) {
-        printf("%02x", adv_pdu_payload_1_3->A1[i]);
+      end = s[i].start + window + pkt_sample;
+      c = s[i].chan;
+    }
+
+    for (i=0; i<n && do_exit == false; i++) {
+      if (!s[i].chosen) {
+        b->num_skip++;
+        continue;
       }
-    } else if (pdu_type==5) {
-      adv_pdu_payload_5 = (ADV_PDU_PAYLOAD_TYPE_5 *)(adv_pdu_payload);
-      printf("InitA:");
-      for(i=0; i<6; i++) {
-        printf("%02x", adv_pdu_payload_5->InitA[i]);
+      boundary = s[i].start - window - (s[i].chan == prev_chan? 0 : gap);
+      if (boundary > prev_end) {
+        boundary = prev_end + (boundary - prev_end)/2;
       }
-      printf(" AdvA:");
-      for(i=0; i<6; i++) {
-        printf("%02x", adv_pdu_payload_5->AdvA[i]);
+      late_us = big_wait(dev, boundary, prev_end);
+      if (late_us == INT64_MIN) {
+        break;
       }
-      printf(" AA:");
-      for(i=0; i<4; i++) {
-        printf("%02x", adv_pdu_payload_5->AA[i]);
+      metrics_hist_observe(&(dev->stat.retune_late_us), (late_us < 0? 0 : late_us));
+      if (late_us > b->late_max_us) {
+        b->late_max_us = late_us;
       }
-      printf(" CRCInit:%06x WSize:%d WOffset:%d Interval:%d Latency:%d Timeout:%d", adv_pdu_payload_5->CRCInit, adv_pdu_payload_5->WinSize, adv_pdu_payload_5->WinOffset, adv_pdu_payload_5->Interval, adv_pdu_payload_5->Latency, adv_pdu_payload_5->Timeout);
-      printf(" ChM:");
-      for(i=0; i<5; i++) {
-        printf("%02x", adv_pdu_payload_5->ChM[i]);
+      if ( host_time_us() + (s[i].chan == prev_chan? 0 : (int64_t)dev->retune_avg_us) > sample_idx_to_ns(&(dev->account), s[i].start - window)/1000 ) {
+        b->num_late++;
+        METRICS_INC(dev->stat.num_retune_late);
+        continue;
       }
-      printf(" Hop:%d SCA:%d", adv_pdu_payload_5->Hop, adv_pdu_payload_5->SCA);
-    } else {
-      adv_pdu_payload_R = (ADV_PDU_PAYLOAD_TYPE_R *)(adv_pdu_payload);
-      printf("Byte:");
-      for(i=0; i<(payload_len); i++) {
-        printf("%02x", adv_pdu_payload_R->payload_byte[i]);
+      if ( retune(dev, boundary, s[i].chan, NULL, s[i].bis) != 0 ) {
+        usleep(FOLLOW_SLEEP_US);
+        continue;
       }
+      b->num_subevent++;
+      prev_end = s[i].start + window + pkt_sample;
+      prev_chan = s[i].chan;
     }
-    printf(" CRC%d\n", crc_flag);
-}
-
-void receiver(IQ_TYPE *rxp_in, int buf_len, int channel_number) {
-  static int pkt_count = 0;
-  static ADV_PDU_PAYLOAD_TYPE_5 adv_pdu_payload;
-  static struct timeval time_current_pkt, time_pre_pkt;
-  const int demod_buf_len = LEN_BUF_MAX_NUM_PHY_SAMPLE+(LEN_BUF/2);
-  IQ_TYPE *rxp = rxp_in;
-  int num_demod_byte, hit_idx, buf_len_eaten, pdu_type, tx_add, rx_add, payload_len, time_diff;
-  int num_symbol_left = buf_len/(SAMPLE_PER_SYMBOL*2); //2 for IQ
-  bool crc_flag;
-  
-  if (pkt_count == 0) { // the 1st time run
-    gettimeofday(&time_current_pkt, NULL);
-    time_pre_pkt = time_current_pkt;
+    b->num_event++;
+    event++;
   }
+}
 
-  buf_len_eaten = 0;
-  while( 1 ) 
-  {
-    hit_idx = search_unique_bits(rxp, num_symbol_left, preamble_access_bit, LEN_DEMOD_BUF_PREAMBLE_ACCESS);
-    if ( hit_idx == -1 ) {
-      break;
-    }
-    //pkt_count++;
-    //printf("hit %d\n", hit_idx);
-    
-    //printf("%d %d %d %d %d %d %d %d\n", rxp[hit_idx+0], rxp[hit_idx+1], rxp[hit_idx+2], rxp[hit_idx+3], rxp[hit_idx+4], rxp[hit_idx+5], rxp[hit_idx+6], rxp[hit_idx+7]);
+// a CRC-OK AUX_SYNC_IND of train t. the first BIGInfo starts the BIG. demod thread
+static void big_observe(RX_DEV *dev, SYNC_TRAIN *t, BTLE_PKT *pkt, uint64_t sample_idx) {
+  BIG_RX *b = &(dev->big);
+  EXT_ADV x;
+  BIG_INFO bi;
 
-    buf_len_eaten = buf_len_eaten + hit_idx;
-    //printf("%d\n", buf_len_eaten);
-    
-    buf_len_eaten = buf_len_eaten + 8*NUM_PREAMBLE_ACCESS_BYTE*2*SAMPLE_PER_SYMBOL;// move to beginning of PDU header
-    rxp = rxp_in + buf_len_eaten;
-    
-    num_demod_byte = 2; // PDU header has 2 octets
-    buf_len_eaten = buf_len_eaten + 8*num_demod_byte*2*SAMPLE_PER_SYMBOL;
-    //if ( buf_len_eaten > buf_len ) {
-    if ( buf_len_eaten > demod_buf_len ) {
-      break;
+  if ( parse_ext_adv(pkt->byte+2, pkt->payload_len, &x) != 0 || parse_big_info(x.acad, x.acad_len, &bi) != 0 ) {
+    return;
+  }
+  if ( bi.phy != 0 || bi.num_bis < 1 ) {
+    if (!dev->big_phy_shown) {
+      printf("big: Sync%d BIG on %s PHY not received, 1M only%s\n", (int)(t - dev->sync), PHY_STR[bi.phy&3], dev->tag);
+      dev->big_phy_shown = true;
     }
+    return;
+  }
+  // the BIG anchor is within one offset unit after the offset, as the AUX_SYNC_IND of a SyncInfo
+  pthread_mutex_lock(&follow_lock);
+  follow_big(&(b->g), &bi, sample_idx + (uint64_t)bi.offset_us*US_SAMPLE + (uint64_t)bi.offset_unit_us*US_SAMPLE/2, ((uint64_t)bi.offset_unit_us/2)*US_SAMPLE + HOP_JITTER_SAMPLE);
+  pthread_mutex_unlock(&follow_lock);
+  if (b->g.num_used < 2) {
+    return;
+  }
+  b->sync_idx = (int)(t - dev->sync);
+  b->encrypted = bi.encrypted;
+  memory_barrier(); // BIG before the flag
+  dev->big_started = 1;
+
+  printf("big: Sync%d BIG of %d BIS, ISO_Interval %.2fms, NSE %d BN %d IRC %d PTO %d, Sub_Interval %uus BIS_Spacing %uus, Max_PDU %d, %d channels, bisPayloadCount %llu in %.3fms%s%s\n",
+    b->sync_idx, b->g.num_bis, bi.iso_interval*1.25, bi.nse, bi.bn, bi.irc, bi.pto, bi.sub_interval_us, bi.bis_spacing_us, bi.max_pdu, b->g.num_used,
+    (unsigned long long)bi.payload_count, bi.offset_us/1000.0, (bi.encrypted? ", encrypted" : ""), dev->tag);
+}
 
-    demod_byte(rxp, num_demod_byte, tmp_byte);
-    //printf("%d %d %d %d %d %d %d %d\n", rxp[0], rxp[1], rxp[2], rxp[3], rxp[4], rxp[5], rxp[6], rxp[7]);
-    //printf("%d %d %d %d %d %d %d %d\n", rxp[8+0], rxp[8+1], rxp[8+2], rxp[8+3], rxp[8+4], rxp[8+5], rxp[8+6], rxp[8+7]);
-    scramble_byte(tmp_byte, num_demod_byte, scramble_table[channel_number], tmp_byte);
-    rxp = rxp_in + buf_len_eaten;
-    num_symbol_left = (buf_len-buf_len_eaten)/(SAMPLE_PER_SYMBOL*2);
-    
-    parse_adv_pdu_header_byte(tmp_byte, &pdu_type, &tx_add, &rx_add, &payload_len);
-    
-    if( payload_len<6 || payload_len>37 ) {
-      //printf(" (should be 6~37, quit!)\n");
-      continue;
+// receiver_block handler on a BIS. copies of a payload already received are dropped
+void queue_bis_pkt(BTLE_PKT *pkt, void *arg) {
+  RX_DEV *dev = (RX_DEV *)arg;
+  BIG_RX *b = &(dev->big);
+  BIS_STREAM *st = b->bis + dev->bis-1;
+  uint64_t payload = BIS_PAYLOAD_UNKNOWN, d;
+  int64_t event = -1;
+  int se;
+
+  pthread_mutex_lock(&follow_lock);
+  if (pkt->crc_flag) {
+    st->num_crc_err++;
+  } else {
+    event = big_pkt(&(b->g), dev->bis, dev->block_base + pkt->pkt_start, &se);
+  }
+  if (event >= 0) {
+    payload = big_payload(&(b->g), (uint32_t)event, se);
+    if ( bis_seen(st, payload) ) {
+      st->num_repeat++;
+      pthread_mutex_unlock(&follow_lock);
+      return;
     }
-    
-    //num_pdu_payload_crc_bits = (payload_len+3)*8;
-    num_demod_byte = (payload_len+3);
-    buf_len_eaten = buf_len_eaten + 8*num_demod_byte*2*SAMPLE_PER_SYMBOL;
-    //if ( buf_len_eaten > buf_len ) {
-    if ( buf_len_eaten > demod_buf_len ) {
-      //printf("\n");
-      break;
+    if (st->num_payload == 0) {
+      st->first_payload = st->last_payload = payload;
+      st->seen = 1;
+    } else if (payload > st->last_payload) {
+      d = payload - st->last_payload;
+      st->seen = ( d >= BIS_SEEN_WINDOW? 0 : st->seen<<d )|1;
+      st->last_payload = payload;
+    } else {
+      st->seen = st->seen|((uint64_t)1<<(st->last_payload - payload));
     }
-    
-    demod_byte(rxp, num_demod_byte, tmp_byte+2);
-    scramble_byte(tmp_byte+2, num_demod_byte, scramble_table[channel_number]+2, tmp_byte+2);
-    rxp = rxp_in + buf_len_eaten;
-    num_symbol_left = (buf_len-buf_len_eaten)/(SAMPLE_PER_SYMBOL*2);
-    
-    crc_flag = crc_check(tmp_byte, payload_len+2);
-    pkt_count++;
-    
-    gettimeofday(&time_current_pkt, NULL);
-    time_diff = TimevalDiff(&time_current_pkt, &time_pre_pkt);
-    time_pre_pkt = time_current_pkt;
-    
-    printf("%dus Pkt%d Ch%d AA:8E89BED6 PDU_t%d:%s T%d R%d PloadL%d ", time_diff, pkt_count, channel_number, pdu_type, PDU_TYPE_STR[pdu_type], tx_add, rx_add, payload_len);
-    
-    if (parse_adv_pdu_payload_byte(tmp_byte+2, payload_len, pdu_type, (void *)(&adv_pdu_payload) ) != 0 ) {
-      continue;
+    if (payload < st->first_payload) {
+      st->first_payload = payload;
     }
-    print_pdu_payload((void *)(&adv_pdu_payload), pdu_type, payload_len, crc_flag);
+    st->num_payload++;
+  } else if (pkt->crc_flag == 0) {
+    b->num_stray++;
   }
+  pthread_mutex_unlock(&follow_lock);
+  queue_pkt_tag(pkt, dev, -1, 0, dev->bis, payload);
 }
-//----------------------------------receiver----------------------------------
 
-//---------------------------for offline test--------------------------------------
-IQ_TYPE tmp_buf[2097152];
-//---------------------------for offline test--------------------------------------
-int main(int argc, char** argv) {
-  uint64_t freq_hz;
-  int gain, chan, phase, rx_buf_offset_tmp;
-  bool run_flag = false;
-  void* rf_dev;
-  IQ_TYPE *rxp;
+// lost: payloads between the first and the newest one received that never came
+void print_big(RX_DEV *dev) {
+  BIG_RX *b = &(dev->big);
+  BIS_STREAM *st;
+  int i;
 
-  parse_commandline(argc, argv, &chan, &gain);
-  freq_hz = get_freq_by_channel_number(chan);
-  printf("cmd line input: chan %d, freq %ldMHz, rx %ddB (%s)\n", chan, freq_hz/1000000, gain, board_name);
-  
-  // run cyclic recv in background
-  do_exit = false;
-  if ( config_run_board(freq_hz, gain, &rf_dev) != 0 ){
-    if (rf_dev != NULL) {
-      goto program_quit;
-    }
-    else {
-      return(1);
+  printf("big%s: Sync%d %d BIS, %llu events, %llu subevents listened to, %llu not reachable, %llu too late, %llu stray PDUs, ISO_Interval %.4fms\n", dev->tag,
+    b->sync_idx, b->g.num_bis, (unsigned long long)b->num_event, (unsigned long long)b->num_subevent, (unsigned long long)b->num_skip,
+    (unsigned long long)b->num_late, (unsigned long long)b->num_stray, sample_idx_to_ms((uint64_t)b->g.interval_sample));
+  printf("big%s: retune %.0fus average, %lldus max, issued up to %lldus late\n", dev->tag, dev->retune_avg_us, (long long)dev->retune_max_us, (long long)b->late_max_us);
+  for (i=0; i<b->g.num_bis; i++) {
+    st = b->bis + i;
+    printf("big%s: BIS%d AA:%08X %llu payloads", dev->tag, i+1, b->g.link[i].access_addr, (unsigned long long)st->num_payload);
+    if (st->num_payload != 0) {
+      printf(" %llu~%llu, %llu lost", (unsigned long long)st->first_payload, (unsigned long long)st->last_payload,
+        (unsigned long long)(st->last_payload - st->first_payload + 1 - st->num_payload));
     }
+    printf(", %llu repeats dropped, %llu CRC errors\n", (unsigned long long)st->num_repeat, (unsigned long long)st->num_crc_err);
   }
-  // init receiver
-  receiver_init();
-  
-  // scan
-  do_exit = false;
-  phase = 0;
-  rx_buf_offset = 0;
-  while(do_exit == false) { //hackrf_is_streaming(hackrf_dev) == HACKRF_TRUE?
-    /*
-    if ( (rx_buf_offset-rx_buf_offset_old) > 65536 || (rx_buf_offset-rx_buf_offset_old) < -65536 ) {
-      printf("%d\n", rx_buf_offset);
-      rx_buf_offset_old = rx_buf_offset;
-    }
-     * */
-    // total buf len LEN_BUF = (8*4096)*2 =  (~ 8ms); tail length MAX_NUM_PHY_SAMPLE*2=LEN_BUF_MAX_NUM_PHY_SAMPLE
-    
-    rx_buf_offset_tmp = rx_buf_offset - LEN_BUF_MAX_NUM_PHY_SAMPLE;
-    // cross point 0
-    if (rx_buf_offset_tmp>=0 && rx_buf_offset_tmp<(LEN_BUF/2) && phase==1) {
-      //printf("rx_buf_offset cross 0: %d %d %d\n", rx_buf_offset, (LEN_BUF/2), LEN_BUF_MAX_NUM_PHY_SAMPLE);
-      phase = 0;
-      
-      memcpy((void *)(rx_buf+LEN_BUF), (void *)rx_buf, LEN_BUF_MAX_NUM_PHY_SAMPLE*sizeof(IQ_TYPE));
-      rxp = (IQ_TYPE*)(rx_buf + (LEN_BUF/2));
-      run_flag = true;
+}
+//----------------------------------BIG----------------------------------
+
+//----------------------------------periodic advertising----------------------------------
+#define SYNC_LEAD_US 1000                // retune at the latest this long before the window of an event opens
+#define SYNC_HOME_MIN_US 20000           // a gap this long between two events is spent on the home channel
+#define SYNC_PKT_SAMPLE (MAX_NUM_EXT_PHY_BYTE*8*US_SAMPLE) // the longest AUX_SYNC_IND
+
+bool sync_enable; // -S
+
+// Takes the next event of the board's trains from follow_sched, drops it if the previous one
+// is still on air then, spends long gaps on the home channel and retunes one window plus
+// SYNC_LEAD_US ahead of the anchor. Sample indices are converted to host time by the sample
+// accounting as in follow_thread.
+void *sync_thread(void *arg) {
+  RX_DEV *dev = (RX_DEV *)arg;
+  FOLLOW_CONN *f[MAX_NUM_SYNC];
+  SYNC_TRAIN *t;
+  uint64_t sched_idx = 0, prev_end = 0, anchor_idx, window, boundary;
+  uint32_t event;
+  int64_t wait_us;
+  bool at_home = true;
+  int i, m = -1, num_sync, sched_num_sync = 0, chan;
+
+  while (do_exit == false) {
+    if (dev->big_started) {
+      memory_barrier(); // flag before BIG
+      big_thread(dev);
+      break;
+    }
+    num_sync = dev->num_sync;
+    memory_barrier(); // count before trains
+    pthread_mutex_lock(&follow_lock);
+    for (i=0; i<num_sync; i++) {
+      f[i] = &(dev->sync[i].f);
+    }
+    // the choice holds until its event is taken or dropped: the packet of the other train would
+    // turn it around otherwise, too late. only a train added meanwhile is looked at again
+    if (m < 0 || num_sync != sched_num_sync) {
+      m = follow_sched(f, num_sync, sched_idx, SYNC_PKT_SAMPLE + SYNC_LEAD_US*US_SAMPLE, &event);
+      sched_num_sync = num_sync;
+    }
+    anchor_idx = follow_anchor_idx(f[m], event);
+    window = ( f[m]->num_anchor == 0? f[m]->window_sample : HOP_JITTER_SAMPLE );
+    chan = follow_channel(f[m], event);
+    pthread_mutex_unlock(&follow_lock);
+    t = dev->sync + m;
+
+    // a late packet moved the anchor of an event already taken past sched_idx
+    if (event < t->next_event) {
+      sched_idx = anchor_idx + 1;
+      m = -1;
+      continue;
+    }
+    if ( prev_end > anchor_idx - window || host_time_us() > sample_idx_to_ns(&(dev->account), anchor_idx)/1000 - FOLLOW_RETUNE_US ) {
+      if (prev_end > anchor_idx - window) {
+        t->num_skip++;
+      } else {
+        t->num_late++;
+        METRICS_INC(dev->stat.num_retune_late);
+      }
+      t->next_event = event + 1;
+      sched_idx = anchor_idx + 1;
+      m = -1;
+      continue;
+    }
+    boundary = anchor_idx - window - SYNC_LEAD_US*US_SAMPLE;
+    if (boundary < prev_end) {
+      boundary = prev_end;
     }
 
-    // cross point 1
-    if (rx_buf_offset_tmp>=(LEN_BUF/2) && phase==0) {
-      //printf("rx_buf_offset cross 1: %d %d %d\n", rx_buf_offset, (LEN_BUF/2), LEN_BUF_MAX_NUM_PHY_SAMPLE);
-      phase = 1;
+    // back to the home channel for SyncInfo of more trains, once the previous event is over
+    if ( !at_home && boundary > prev_end + SYNC_HOME_MIN_US*US_SAMPLE ) {
+      wait_us = sample_idx_to_ns(&(dev->account), prev_end)/1000 - host_time_us();
+      if (wait_us > 0) {
+        usleep( wait_us > FOLLOW_SLEEP_US? FOLLOW_SLEEP_US : wait_us );
+        continue;
+      }
+      if ( retune(dev, prev_end, dev->home_chan, NULL, 0) != 0 ) {
+        usleep(FOLLOW_SLEEP_US);
+        continue;
+      }
+      at_home = true;
+      continue;
+    }
 
-      rxp = (IQ_TYPE*)rx_buf;
-      run_flag = true;
+    // in steps: a train added meanwhile may have an earlier event
+    wait_us = sample_idx_to_ns(&(dev->account), boundary)/1000 - host_time_us();
+    if (wait_us > 0) {
+      usleep( wait_us > FOLLOW_SLEEP_US? FOLLOW_SLEEP_US : wait_us );
+      continue;
     }
-    
-    if (run_flag) {
-      #if 0
-      // ------------------------for offline test -------------------------------------
-      //save_phy_sample(rx_buf+buf_sp, LEN_BUF/2, "/home/jxj/git/BTLE/matlab/sample_iq_4msps.txt");
-      load_phy_sample(tmp_buf, 2097152, "/home/jxj/git/BTLE/matlab/sample_iq_4msps.txt");
-      receiver(tmp_buf, 2097152, 37);
-      break;
-      // ------------------------for offline test -------------------------------------
-      #endif
-      
-      // -----------------------------real online run--------------------------------
-      //receiver(rxp, LEN_BUF_MAX_NUM_PHY_SAMPLE+(LEN_BUF/2), chan);
-      receiver(rxp, (LEN_DEMOD_BUF_PREAMBLE_ACCESS-1)*2*SAMPLE_PER_SYMBOL+(LEN_BUF)/2, chan);
-      // -----------------------------real online run--------------------------------
-      
-      run_flag = false;
+    if ( retune(dev, boundary, chan, f[m], 0) != 0 ) {
+      usleep(FOLLOW_SLEEP_US);
+      continue;
+    }
+    at_home = false;
+    if (event > t->next_event) {
+      t->num_skip = t->num_skip + (event - t->next_event);
     }
+    t->next_event = event + 1;
+    sched_idx = anchor_idx + 1;
+    prev_end = anchor_idx + window + SYNC_PKT_SAMPLE;
+    // the channel of a later event, well before it is needed
+    pthread_mutex_lock(&follow_lock);
+    follow_table_fill(f[m], event + 1);
+    pthread_mutex_unlock(&follow_lock);
+    m = -1;
   }
+  return(NULL);
+}
+
+// a CRC-OK extended advertising PDU on the home channel of dev. demod thread
+static void sync_observe(RX_DEV *dev, BTLE_PKT *pkt, uint64_t sample_idx) {
+  EXT_ADV x;
+  EXT_SYNC_INFO *si = &(x.sync_info);
+  SYNC_TRAIN *t;
+  char addr[13];
+  int i;
 
-program_quit:
-  stop_close_board(rf_dev);
+  if ( parse_ext_adv(pkt->byte+2, pkt->payload_len, &x) != 0 || !(x.flags&EXT_HDR_SYNCINFO) ) {
+    return;
+  }
+  for (i=0; i<dev->num_sync; i++) {
+    if (dev->sync[i].f.link.access_addr == si->access_addr) {
+      return;
+    }
+  }
+  if ( dev->num_sync == MAX_NUM_SYNC || si->interval < MIN_CONN_INTERVAL ) {
+    return;
+  }
+
+  t = dev->sync + dev->num_sync;
+  memset(t, 0, sizeof(SYNC_TRAIN));
+  // the AUX_SYNC_IND starts within one offset unit after the offset: aim at the middle
+  follow_sync(&(t->f), si->access_addr, si->crc_init, si->interval, si->chan_map, si->pa_event_counter,
+    sample_idx + (uint64_t)si->offset_us*US_SAMPLE + (uint64_t)si->offset_unit_us*US_SAMPLE/2, ((uint64_t)si->offset_unit_us/2)*US_SAMPLE + HOP_JITTER_SAMPLE);
+  if (t->f.num_used < 2) {
+    return;
+  }
+  if (x.adv_a != NULL) {
+    memcpy(t->adv_a, x.adv_a, 6);
+  }
+  t->sid = x.sid;
+  memory_barrier(); // train before count
+  dev->num_sync = dev->num_sync + 1;
+
+  addr_str(t->adv_a, addr);
+  printf("sync: Sync%d AdvA:%s SID:%d AA:%08X CRCInit:%06X interval %.2fms on %d channels, paEventCounter %u in %.3fms%s\n", dev->num_sync-1, addr, t->sid,
+    si->access_addr, si->crc_init, si->interval*1.25, t->f.num_used, si->pa_event_counter, si->offset_us/1000.0, dev->tag);
+  if ( dev->num_sync == 1 && pthread_create(&(dev->follow_thread_id), NULL, sync_thread, (void *)dev) != 0 ) {
+    printf("sync_observe: pthread_create failed!\n");
+    dev->num_sync = 0;
+  }
+}
+
+// receiver_block handler with -S
+void queue_sync_pkt(BTLE_PKT *pkt, void *arg) {
+  RX_DEV *dev = (RX_DEV *)arg;
+  SYNC_TRAIN *t = (SYNC_TRAIN *)(dev->follow);
+  uint64_t sample_idx = dev->block_base + pkt->pkt_start;
+  int64_t event;
+
+  if (t == NULL) {
+    queue_pkt(pkt, arg);
+    if (pkt->crc_flag == 0 && pkt->pdu_type == ADV_EXT_PDU_TYPE) {
+      sync_observe(dev, pkt, sample_idx);
+    }
+    return;
+  }
+  if (pkt->crc_flag) {
+    t->num_crc_err++;
+    queue_pkt(pkt, arg);
+    return;
+  }
+  pthread_mutex_lock(&follow_lock);
+  event = follow_pkt(&(t->f), sample_idx);
+  pthread_mutex_unlock(&follow_lock);
+  if (big_enable && !dev->big_started) {
+    big_observe(dev, t, pkt, sample_idx);
+  }
+  queue_pkt_tag(pkt, dev, (int)(t - dev->sync), (uint16_t)(t->f.counter_base + (event < 0? 0 : event)), 0, 0);
+}
+
+void print_sync(RX_DEV *dev) {
+  SYNC_TRAIN *t;
+  char addr[13];
+  int i;
+
+  for (i=0; i<dev->num_sync; i++) {
+    t = dev->sync + i;
+    addr_str(t->adv_a, addr);
+    printf("sync%s: Sync%d AdvA:%s AA:%08X %llu packets in %llu events, %llu events given to other trains, %llu too late, %llu CRC errors, interval %.4fms\n", dev->tag, i, addr,
+      t->f.link.access_addr, (unsigned long long)t->f.num_pkt, (unsigned long long)t->f.num_anchor, (unsigned long long)t->num_skip, (unsigned long long)t->num_late,
+      (unsigned long long)t->num_crc_err, sample_idx_to_ms((uint64_t)t->f.interval_sample));
+  }
+}
+//----------------------------------periodic advertising----------------------------------
+
+//----------------------------------access address discovery----------------------------------
+bool promisc_enable; // -p
+AA_TABLE aa_table; // hits of all boards
+pthread_mutex_t aa_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// called by aa_search_block for every candidate. arg is the RX_DEV
+void aa_hit(AA_HIT *hit, void *arg) {
+  RX_DEV *dev = (RX_DEV *)arg;
+  uint64_t sample_idx = dev->block_base + hit->pkt_start;
+  AA_ENTRY *e;
+  BTLE_PKT pkt;
+  int event, crc_confirmed = 0;
+  uint32_t crc_init = 0;
+
+  pthread_mutex_lock(&aa_lock);
+  e = aa_table_add(&aa_table, hit, sample_idx_to_ns(&(dev->account), sample_idx), &event);
+  if (event & AA_EVENT_PROMOTED) {
+    printf("AA: %08X promoted on ch%d%s after %u hits, %u empty PDUs in %.3fs\n", e->access_addr, hit->channel_number, dev->tag,
+      e->num_hit, e->num_empty, (e->last_ns - e->first_ns)/1e9);
+  }
+  if (event & AA_EVENT_CRC_INIT) {
+    printf("AA: %08X CRCInit %06X confirmed on ch%d%s by %u PDUs, receiving its packets\n", e->access_addr, e->crc_init, hit->channel_number, dev->tag,
+      e->num_crc_agree);
+  }
+  if (e != NULL && e->crc_confirmed) {
+    crc_confirmed = 1;
+    pkt.crc_flag = aa_crc_check(e, hit);
+    crc_init = e->crc_init;
+  }
+  pthread_mutex_unlock(&aa_lock);
+
+  // the access address has its link now: the hit is one of its packets
+  if (!crc_confirmed) {
+    return;
+  }
+  pkt.pkt_start = hit->pkt_start;
+  pkt.pkt_end = hit->pkt_end;
+  pkt.channel_number = hit->channel_number;
+  pkt.access_addr = hit->access_addr;
+  pkt.data_pdu = 1;
+  pkt.pdu_type = pkt.tx_add = pkt.rx_add = 0;
+  parse_data_pdu_header_byte(hit->byte, &(pkt.llid), &(pkt.nesn), &(pkt.sn), &(pkt.md), &(pkt.payload_len));
+  pkt.toa = 0;
+  pkt.rssi = hit->rssi;
+  pkt.byte = hit->byte;
+  pkt.cte_info = -1;
+  pkt.cte = NULL;
+  pkt.cte_len = 0;
+  if (pkt.crc_flag) {
+    dev->stat.phy.num_crc_err++;
+  } else {
+    dev->stat.phy.num_crc_ok++;
+  }
+  queue_pkt(&pkt, arg);
+  if (hop_enable && pkt.crc_flag == 0) {
+    follow_observe(dev, pkt.access_addr, crc_init, pkt.channel_number, sample_idx);
+  }
+}
+//----------------------------------access address discovery----------------------------------
+
+// one stretch of a block on dev->chan. returns as receiver_block
+static int receiver_part(RX_DEV *dev, IQ_TYPE *rxp, int buf_len, int demod_buf_len) {
+  if (dev->bis > 0) {
+    return( receiver_block(rxp, buf_len, demod_buf_len, dev->chan, dev->big.g.link+dev->bis-1, rx_filter_active, &(dev->stat.phy), queue_bis_pkt, (void *)dev) );
+  } else if (dev->follow != NULL) {
+    return( receiver_block(rxp, buf_len, demod_buf_len, dev->chan, &(dev->follow->link), rx_filter_active, &(dev->stat.phy), (sync_enable? queue_sync_pkt : queue_link_pkt), (void *)dev) );
+  } else if (promisc_enable) {
+    return( aa_search_block(rxp, buf_len, demod_buf_len, dev->chan, aa_hit, (void *)dev) );
+  }
+  return( receiver_block(rxp, buf_len, demod_buf_len, dev->chan, &rx_link, rx_filter_active, &(dev->stat.phy), (hop_enable? queue_link_pkt : (sync_enable? queue_sync_pkt : queue_pkt)), (void *)dev) );
+}
+
+#define LEN_CORR_TAIL ((LEN_DEMOD_BUF_PREAMBLE_ACCESS-1)*2*SAMPLE_PER_SYMBOL) // after a block, for the correlator
+
+// sample_base: absolute index (IQ_TYPE elements since start) of rxp_in[0]. preambles starting in
+// the first block_len elements are searched, packets are demodulated within demod_buf_len, at
+// least block_len+LEN_CORR_TAIL. a retune within the block splits it, each part on its channel.
+// returns block_len, or where a packet running past demod_buf_len stopped the search
+int receiver(RX_DEV *dev, IQ_TYPE *rxp_in, int block_len, int demod_buf_len, uint64_t sample_base) {
+  int start = 0, end, done;
+  CHAN_SWITCH *sw;
+
+  while (1) {
+    end = block_len;
+    while (dev->chan_switch_tail != dev->chan_switch_head) {
+      memory_barrier(); // head before entry
+      sw = dev->chan_switch + (dev->chan_switch_tail&(LEN_CHAN_SWITCH-1));
+      if ( sw->sample_idx > sample_base + start ) {
+        if ( sw->sample_idx < sample_base + block_len ) {
+          end = (int)(sw->sample_idx - sample_base);
+        }
+        break;
+      }
+      dev->chan = sw->chan;
+      dev->follow = sw->follow;
+      dev->bis = sw->bis;
+      dev->chan_switch_tail++;
+    }
+    dev->block_base = sample_base + start;
+    done = receiver_part(dev, rxp_in+start, end-start+LEN_CORR_TAIL, demod_buf_len-start);
+    if (done < end-start) {
+      end = start + done;
+      break;
+    }
+    if (end == block_len) {
+      break;
+    }
+    start = end;
+  }
+  dev->block_base = sample_base;
+  return(end);
+}
+
+//----------------------------------AGC----------------------------------
+#define LEN_AGC_QUIET_SAMPLE (256)  // newest IQ samples (64us) that must be quiet before a retune
+#define AGC_QUIET_MARGIN (6.0f)     // dB above the noise floor of the block
+
+bool agc_enable; // -a
+
+// power of the LEN_AGC_QUIET_SAMPLE IQ samples rx_callback wrote last
+static float newest_power_dbfs(RX_DEV *dev) {
+  int64_t power = 0;
+  int i, v0, v1, offset = (int)( (dev->account.produced - LEN_AGC_QUIET_SAMPLE*2)&(LEN_BUF-1) );
+
+  for (i=0; i<LEN_AGC_QUIET_SAMPLE; i++) {
+    v0 = dev->rx_buf[offset];
+    v1 = dev->rx_buf[offset+1];
+    power = power + v0*v0 + v1*v1;
+    offset = (offset+2)&(LEN_BUF-1);
+  }
+  if (power == 0) {
+    return(-127.0f);
+  }
+  return( 10.0f*log10f( (float)power/((float)LEN_AGC_QUIET_SAMPLE*IQ_MAX*IQ_MAX) ) );
+}
+
+static char *AGC_REASON_STR[] = {"keep", "clipping", "noise", "strong packets", "weak signal"};
+
+// once per half of rx_buf, after receiver(). rxp holds its LEN_BUF/2 IQ_TYPE elements.
+// A gain change disturbs the samples for a moment, so the board is only retuned while the
+// newest samples carry no burst; until then the change stays pending.
+static void agc_update(RX_DEV *dev, IQ_TYPE *rxp) {
+  AGC_REASON reason;
+  float noise_dbfs;
+  int num_clip, gain;
+
+  iq_block_stat(rxp, LEN_BUF/4, &num_clip, &noise_dbfs);
+  dev->stat.num_clip = dev->stat.num_clip + num_clip;
+
+  gain = agc_block(&(dev->agc), num_clip, LEN_BUF/4, noise_dbfs, &reason);
+  if (reason != AGC_KEEP) {
+    dev->agc_gain_pending = gain;
+    dev->agc_reason_pending = reason;
+  }
+  if ( dev->agc_gain_pending == dev->agc.gain ) {
+    return;
+  }
+  if ( newest_power_dbfs(dev) > (noise_dbfs + AGC_QUIET_MARGIN) ) {
+    return;
+  }
+
+  if ( set_board_rx_gain(dev->rf_dev, dev->agc_gain_pending) != 0 ) {
+    dev->agc_gain_pending = dev->agc.gain;
+    return;
+  }
+  printf("AGC: %ddB -> %ddB, %s. noise floor %.1fdBFS%s\n", dev->agc.gain, dev->agc_gain_pending, AGC_REASON_STR[dev->agc_reason_pending], noise_dbfs, dev->tag);
+  agc_set(&(dev->agc), dev->agc_gain_pending);
+  METRICS_INC(dev->stat.num_gain_change);
+}
+//----------------------------------AGC----------------------------------
+
+// once per half of rx_buf, after receiver(): the block level recording triggers. sample_base
+// is the absolute index of rxp[0]
+static void record_trigger_block(RX_DEV *dev, IQ_TYPE *rxp, uint64_t sample_base) {
+  int peak_offset;
+
+  if (rec_trigger.num_crc_err != 0) {
+    if ( (dev->stat.phy.num_crc_err - dev->num_crc_err_pre) >= (uint64_t)rec_trigger.num_crc_err ) {
+      iq_rec_trigger(&(dev->rec), sample_base, LEN_BUF/2, IQREC_TRIG_CRC);
+    }
+    dev->num_crc_err_pre = dev->stat.phy.num_crc_err;
+  }
+  if (rec_trigger.energy_dbfs != TRIGGER_OFF) {
+    if ( iq_block_peak_dbfs(rxp, LEN_BUF/4, &peak_offset) >= rec_trigger.energy_dbfs ) {
+      iq_rec_trigger(&(dev->rec), sample_base + peak_offset, 128, IQREC_TRIG_ENERGY);
+    }
+  }
+}
+
+//---------------------------for offline test--------------------------------------
+IQ_TYPE tmp_buf[2097152];
+//---------------------------for offline test--------------------------------------
+
+#define DEMOD_RT_WAIT_US 200 // -P demod: poll interval while waiting for a block, ~1/20 of one
+#define DEMOD_LL_WAIT_US 20  // -l: poll interval, a fraction of a transfer
+#define LL_MIN_BLOCK (256*2) // -l: IQ_TYPE elements a block has at least, 64us at 4Msps
+
+bool low_latency; // -l
+
+// demodulates the rx_buf of one board until do_exit. a block is a half of rx_buf, taken once
+// every packet starting in it has arrived. -l: whatever has arrived, as soon as the correlator
+// has its tail; a packet that has not arrived in full stops the block at its preamble and the
+// next one starts there. either way blocks never cross the middle or the end of rx_buf, so the
+// AGC and the recording triggers still see each half as a whole
+void *demod_thread(void *arg) {
+  RX_DEV *dev = (RX_DEV *)arg;
+  uint64_t produced, produced_stall = ~(uint64_t)0, num_gap_reported = 0, num_avail;
+  int buf_sp, demod_us, block_len, demod_buf_len, half_left, done;
+  bool ready;
+  IQ_TYPE *rxp;
+  struct timeval time_demod_start, time_demod_end;
+
+  while(do_exit == false) {
+    // total buf len LEN_BUF = (8*4096)*2 =  (~ 8ms); tail length MAX_NUM_PHY_SAMPLE*2=LEN_BUF_MAX_NUM_PHY_SAMPLE
+    // a half of rx_buf is processed once rx_callback is LEN_BUF_MAX_NUM_PHY_SAMPLE beyond its end
+    produced = dev->account.produced;
+
+    if (dev->account.num_gap != num_gap_reported) {
+      num_gap_reported = dev->account.num_gap;
+      printf("Drop: stream gap, ~%llu IQ samples lost in total, detected at %.3fms%s\n", (unsigned long long)dev->account.gap_sample, sample_idx_to_ms(dev->account.gap_position), dev->tag);
+    }
+
+    num_avail = produced - dev->account.consumed;
+    half_left = (LEN_BUF/2) - (int)( dev->account.consumed&((LEN_BUF/2)-1) );
+    if (low_latency) {
+      demod_buf_len = (int)( num_avail < (uint64_t)(half_left + LEN_BUF_MAX_NUM_PHY_SAMPLE)? num_avail : (uint64_t)(half_left + LEN_BUF_MAX_NUM_PHY_SAMPLE) );
+      // the correlator's last phase compares with one IQ sample beyond its tail
+      block_len = ( (demod_buf_len - LEN_CORR_TAIL - 2) < half_left? (demod_buf_len - LEN_CORR_TAIL - 2) : half_left );
+      block_len = block_len&(~(2*SAMPLE_PER_SYMBOL-1)); // whole symbols, for the correlator
+      // the last one of a half may be short. nothing new since a stopped block: nothing to do
+      ready = ( block_len >= (half_left < LL_MIN_BLOCK? half_left : LL_MIN_BLOCK) && produced != produced_stall );
+    } else {
+      block_len = half_left;
+      demod_buf_len = half_left + LEN_BUF_MAX_NUM_PHY_SAMPLE;
+      ready = ( num_avail >= (uint64_t)demod_buf_len );
+    }
+    if (!ready) {
+      // spinning under SCHED_FIFO would starve every lower priority thread on this CPU,
+      // the board's streaming thread included. -l waits for a transfer at a time: spinning
+      // through that would take a CPU from the streaming and output threads as well
+      if (low_latency) {
+        usleep(DEMOD_LL_WAIT_US);
+      } else if (rt_conf.thread[RT_THREAD_DEMOD].prio > 0) {
+        usleep(DEMOD_RT_WAIT_US);
+      }
+      continue;
+    }
+
+    // lapped by rx_callback: the block has been (partially) overwritten. skip to the latest complete half
+    if ( num_avail > LEN_BUF ) {
+      uint64_t consumed_new = ( produced&(~((uint64_t)(LEN_BUF/2)-1)) ) - (LEN_BUF/2);
+      dev->account.num_overrun++;
+      dev->account.overrun_sample = dev->account.overrun_sample + (consumed_new - dev->account.consumed)/2;
+      printf("Drop: overrun, %llu IQ samples lost %.3fms~%.3fms%s\n", (unsigned long long)((consumed_new - dev->account.consumed)/2), sample_idx_to_ms(dev->account.consumed), sample_idx_to_ms(consumed_new), dev->tag);
+      dev->account.consumed = consumed_new;
+      dev->watermark_ns = sample_idx_to_ns(&(dev->account), consumed_new);
+      continue;
+    }
+
+    buf_sp = (int)( dev->account.consumed&(LEN_BUF-1) );
+    // the tail beyond the end of rx_buf is mirrored from its beginning
+    if ( (buf_sp + demod_buf_len) > LEN_BUF ) {
+      memcpy((void *)(dev->rx_buf+LEN_BUF), (void *)dev->rx_buf, (buf_sp + demod_buf_len - LEN_BUF)*sizeof(IQ_TYPE));
+    }
+    rxp = (IQ_TYPE*)(dev->rx_buf + buf_sp);
+
+    dev->stat.ring_fill_percent = (int)( num_avail*100/LEN_BUF );
+    metrics_hist_observe(&(dev->stat.ring_fill), dev->stat.ring_fill_percent);
+    gettimeofday(&time_demod_start, NULL);
+
+    #if 0
+    // ------------------------for offline test -------------------------------------
+    //save_phy_sample((IQ_TYPE *)(dev->rx_buf+buf_sp), LEN_BUF/2, "/home/jxj/git/BTLE/matlab/sample_iq_4msps.cs8");
+    demod_buf_len = load_phy_sample(tmp_buf, 2097152, "/home/jxj/git/BTLE/matlab/sample_iq_4msps.cs8");
+    receiver(dev, tmp_buf, demod_buf_len-LEN_CORR_TAIL, demod_buf_len, 0);
+    break;
+    // ------------------------for offline test -------------------------------------
+    #endif
+
+    // -----------------------------real online run--------------------------------
+    done = receiver(dev, rxp, block_len, demod_buf_len, dev->account.consumed);
+    // -----------------------------real online run--------------------------------
+
+    if (done < block_len) {
+      // stopped at a preamble: on from the symbol it is in, once more samples are there
+      done = done&(~(2*SAMPLE_PER_SYMBOL-1));
+      produced_stall = produced;
+      // the tail is as long as it gets: no more samples will make the packet fit, skip its symbol
+      if ( demod_buf_len == half_left + LEN_BUF_MAX_NUM_PHY_SAMPLE ) {
+        done = done + 2*SAMPLE_PER_SYMBOL;
+        produced_stall = ~(uint64_t)0;
+      }
+    }
+    if (done == half_left) {
+      rxp = (IQ_TYPE*)(dev->rx_buf + ( (dev->account.consumed + done - (LEN_BUF/2))&(LEN_BUF-1) ));
+      if (record_enable) {
+        record_trigger_block(dev, rxp, dev->account.consumed + done - (LEN_BUF/2));
+      }
+      if (agc_enable) {
+        agc_update(dev, rxp);
+      }
+    }
+
+    gettimeofday(&time_demod_end, NULL);
+    demod_us = TimevalDiff(&time_demod_end, &time_demod_start);
+    metrics_hist_observe(&(dev->stat.demod_us), demod_us<0? 0 : demod_us);
+    METRICS_INC(dev->stat.num_block);
+
+    dev->account.consumed = dev->account.consumed + done;
+    memory_barrier(); // packets of the block before the watermark that covers them
+    dev->watermark_ns = sample_idx_to_ns(&(dev->account), dev->account.consumed);
+  }
+
+  return(NULL);
+}
+//----------------------------------receiver----------------------------------
+
+//----------------------------------clock offset estimation----------------------------------
+// Every board is aligned to the host clock at stream start (account_transfer), good to a
+// fraction of a USB transfer. After that the sample clocks drift apart by their crystal
+// tolerance. Boards on different channels never receive the same transmission, but an
+// advertiser sends the same PDU on 37, 38 and 39 within one advertising event. The time from
+// the copy on board 0 to the copy on board k is the advertiser's channel spacing, which does
+// not change, plus the offset between the two boards. So the first difference seen per
+// advertiser is kept as its baseline, and how later differences move away from it is the
+// drift of board k against board 0. That is tracked in clock_corr_ns of board k.
+#define ADV_EVENT_NS (10000000)     // copies of an advertising event are at most 10ms apart
+#define LEN_CLOCK_HIST 64           // recent CRC-OK packets searched for copies
+#define NUM_CLOCK_ADV 256           // advertisers with a baseline, direct mapped by CRC
+#define CLOCK_OUTLIER_NS (500000)   // larger steps are a different event or a changed spacing
+
+typedef struct {
+  int dev_idx;                      // -1: empty
+  int64_t time_ns;                  // uncorrected
+  int num_byte;
+  uint8_t byte[2+37+3];
+} CLOCK_HIST;
+
+typedef struct {
+  int num_byte;
+  uint8_t byte[2+37+3];             // the PDU identifies the advertiser
+  uint32_t baseline_mask;           // bit k: baseline_ns[k] is set
+  int64_t baseline_ns[MAX_NUM_RX_DEV];
+} CLOCK_ADV;
+
+CLOCK_HIST clock_hist[LEN_CLOCK_HIST];
+int clock_hist_idx;
+CLOCK_ADV clock_adv[NUM_CLOCK_ADV];
+uint64_t num_clock_match[MAX_NUM_RX_DEV];
+
+void clock_init(void) {
+  int i;
+  for (i=0; i<LEN_CLOCK_HIST; i++) {
+    clock_hist[i].dev_idx = -1;
+  }
+  memset(clock_adv, 0, sizeof(clock_adv));
+  memset(num_clock_match, 0, sizeof(num_clock_match));
+  clock_hist_idx = 0;
+}
+
+// diff_ns: uncorrected time of the copy on board k minus that of the copy on board 0
+static void clock_update(int k, uint8_t *byte, int num_byte, int64_t diff_ns) {
+  int crc = byte[num_byte-3] | (byte[num_byte-2]<<8) | (byte[num_byte-1]<<16);
+  CLOCK_ADV *adv = clock_adv + (crc%NUM_CLOCK_ADV);
+  int64_t err_ns;
+
+  if ( adv->num_byte != num_byte || memcmp(adv->byte, byte, num_byte) != 0 ) {
+    adv->num_byte = num_byte;
+    memcpy(adv->byte, byte, num_byte);
+    adv->baseline_mask = 0;
+  }
+  if ( (adv->baseline_mask&(1<<k)) == 0 ) {
+    adv->baseline_mask = adv->baseline_mask | (1<<k);
+    adv->baseline_ns[k] = diff_ns - rx_dev[k].clock_corr_ns;
+    return;
+  }
+
+  err_ns = (diff_ns - adv->baseline_ns[k]) - rx_dev[k].clock_corr_ns;
+  if (err_ns > CLOCK_OUTLIER_NS || err_ns < -CLOCK_OUTLIER_NS) {
+    return;
+  }
+  rx_dev[k].clock_corr_ns = rx_dev[k].clock_corr_ns + err_ns/8;
+  num_clock_match[k]++;
+}
+
+// called by output_thread for every packet of a CRC-OK packet, in output order
+void clock_observe(RX_DEV *dev, PKT_RECORD *r) {
+  int num_byte = r->payload_len+2+3, i;
+  CLOCK_HIST *h;
+
+  for (i=0; i<LEN_CLOCK_HIST; i++) {
+    h = clock_hist + i;
+    if ( h->dev_idx < 0 || h->dev_idx == dev->idx || (h->dev_idx != 0 && dev->idx != 0) ) {
+      continue;
+    }
+    if ( (r->time_ns - h->time_ns) > ADV_EVENT_NS || (h->time_ns - r->time_ns) > ADV_EVENT_NS ) {
+      continue;
+    }
+    if ( h->num_byte != num_byte || memcmp(h->byte, r->byte, num_byte) != 0 ) {
+      continue;
+    }
+    if (dev->idx == 0) {
+      clock_update(h->dev_idx, r->byte, num_byte, h->time_ns - r->time_ns);
+    } else {
+      clock_update(dev->idx, r->byte, num_byte, r->time_ns - h->time_ns);
+    }
+  }
+
+  h = clock_hist + clock_hist_idx;
+  clock_hist_idx = (clock_hist_idx+1)%LEN_CLOCK_HIST;
+  h->dev_idx = dev->idx;
+  h->time_ns = r->time_ns;
+  h->num_byte = num_byte;
+  memcpy(h->byte, r->byte, num_byte);
+}
+
+void print_clock_offset(void) {
+  int k;
+  for (k=1; k<num_rx_dev; k++) {
+    printf("clock: board %d started %.1fus after board 0, drift corrected by %.1fus from %llu advertising events\n",
+      k, (double)(rx_dev[k].account.t0_us - rx_dev[0].account.t0_us), rx_dev[k].clock_corr_ns/1000.0,
+      (unsigned long long)num_clock_match[k]);
+  }
+}
+//----------------------------------clock offset estimation----------------------------------
+
+//----------------------------------packet output----------------------------------
+#define MAX_MERGE_WAIT_US (200000) // a board that delivers nothing does not hold back the others longer
+#define OUTPUT_WAIT_US (1000)       // poll interval of output_thread while there is nothing to print
+#define OUTPUT_LL_WAIT_US (50)      // the same with -l
+
+bool ad_enable; // -A
+bool toa_enable; // -t
+volatile bool output_exit = false;
+pthread_t output_thread_id;
+
+static inline int64_t pkt_time_ns(RX_DEV *dev, PKT_RECORD *r) {
+  return( r->time_ns - dev->clock_corr_ns );
+}
+
+static void write_cte(RX_DEV *dev, PKT_RECORD *r) {
+  CTE_RECORD c;
+
+  c.access_addr = r->access_addr;
+  c.time_ns = pkt_time_ns(dev, r);
+  c.channel_number = r->channel_number;
+  c.cte_info = r->cte_info;
+  c.flags = (cte_cfo_remove? CTE_FLAG_CFO_REMOVED : 0) | (r->torn_flag? CTE_FLAG_TORN : 0);
+  c.cfo_hz = r->cte_cfo_hz;
+  cte_layout(r->cte_info, CTE_AOA_SLOT_US, &(c.layout));
+  if ( cte_file_write(&cte_file, &c, r->cte_iq) != 0 ) {
+    cte_file_close(&cte_file); // the disk is full or gone: no message per packet
+  }
+}
+
+// From the end of a packet on the air (its CRC, as the board's sample clock dates it) to its
+// line on stdout, over the last LEN_LATENCY_WINDOW packets. output_thread writes the window,
+// the metrics publisher and main take quantiles of it
+#define LEN_LATENCY_WINDOW 1024 // must be 2^x
+#define NUM_LATENCY_QUANTILE 4
+static const double LATENCY_QUANTILE[NUM_LATENCY_QUANTILE] = {0.5, 0.9, 0.99, 1.0};
+static const char *LATENCY_QUANTILE_LABEL[NUM_LATENCY_QUANTILE] = {"quantile=\"0.5\"", "quantile=\"0.9\"", "quantile=\"0.99\"", "quantile=\"1\""};
+
+volatile int32_t latency_us[LEN_LATENCY_WINDOW];
+volatile uint64_t num_latency;
+volatile double latency_quantile_us[NUM_LATENCY_QUANTILE]; // update_metrics
+
+static int cmp_int32(const void *a, const void *b) {
+  int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+  return( (x > y) - (x < y) );
+}
+
+// quantile_us gets the LATENCY_QUANTILE quantiles (nearest rank). returns the packets they are over
+static int latency_quantile(double *quantile_us) {
+  int32_t v[LEN_LATENCY_WINDOW];
+  int n, i, k;
+
+  n = (int)( num_latency < LEN_LATENCY_WINDOW? num_latency : LEN_LATENCY_WINDOW );
+  for (i=0; i<n; i++) {
+    v[i] = latency_us[i];
+  }
+  qsort(v, n, sizeof(v[0]), cmp_int32);
+  for (i=0; i<NUM_LATENCY_QUANTILE; i++) {
+    k = (int)ceil(LATENCY_QUANTILE[i]*n) - 1;
+    quantile_us[i] = ( n == 0? 0 : (double)v[k < 0? 0 : k] );
+  }
+  return(n);
+}
+
+void print_latency(void) {
+  double quantile_us[NUM_LATENCY_QUANTILE];
+  int n = latency_quantile(quantile_us);
+
+  if (n > 0) {
+    printf("output latency: %.0fus median, %.0fus 90%%, %.0fus 99%%, %.0fus max over the last %d packets%s\n", quantile_us[0], quantile_us[1], quantile_us[2], quantile_us[3], n, (low_latency? "" : ". -l for less"));
+  }
+}
+
+// The board whose next packet is the earliest, or NULL if nothing can be printed yet:
+// a board with an empty ring may still deliver an earlier packet, up to its watermark.
+static RX_DEV* merge_next(bool flush) {
+  static struct timeval time_blocked;
+  static bool blocked = false;
+  struct timeval time_current;
+  RX_DEV *dev, *dev_min = NULL;
+  int64_t t, t_min = INT64_MAX, watermark[MAX_NUM_RX_DEV];
+  int i;
+
+  for (i=0; i<num_rx_dev; i++) {
+    watermark[i] = rx_dev[i].watermark_ns; // before looking at the ring, see demod_thread
+  }
+  memory_barrier();
+
+  for (i=0; i<num_rx_dev; i++) {
+    dev = rx_dev + i;
+    if (dev->pkt_ring_tail == dev->pkt_ring_head) {
+      continue;
+    }
+    t = pkt_time_ns(dev, dev->pkt_ring + (dev->pkt_ring_tail&(LEN_PKT_RING-1)));
+    if (t < t_min) {
+      t_min = t;
+      dev_min = dev;
+    }
+  }
+  if (dev_min == NULL || flush) {
+    blocked = false;
+    return(dev_min);
+  }
+
+  for (i=0; i<num_rx_dev; i++) {
+    dev = rx_dev + i;
+    if ( dev->pkt_ring_tail == dev->pkt_ring_head && (watermark[i] - dev->clock_corr_ns) < t_min ) {
+      break;
+    }
+  }
+  if (i == num_rx_dev) {
+    blocked = false;
+    return(dev_min);
+  }
+
+  gettimeofday(&time_current, NULL);
+  if (!blocked) {
+    blocked = true;
+    time_blocked = time_current;
+  }
+  if (TimevalDiff64(&time_current, &time_blocked) > MAX_MERGE_WAIT_US) {
+    return(dev_min);
+  }
+  return(NULL);
+}
+
+void *output_thread(void *arg) {
+  ADV_PDU_PAYLOAD adv_pdu_payload;
+  PKT_RECORD *r;
+  RX_DEV *dev;
+  int pkt_count = 0, time_diff, llid, nesn, sn, md, payload_len;
+  char addr[13];
+  int64_t t, t_pre = 0;
+  struct timeval time_out;
+  bool flush;
+
+  while (1) {
+    flush = output_exit; // set after the demod threads are gone: every packet is in a ring
+    memory_barrier();
+    dev = merge_next(flush);
+    if (dev == NULL) {
+      if (flush) {
+        break;
+      }
+      usleep(low_latency? OUTPUT_LL_WAIT_US : OUTPUT_WAIT_US);
+      continue;
+    }
+    memory_barrier(); // head before record content
+
+    r = dev->pkt_ring + (dev->pkt_ring_tail&(LEN_PKT_RING-1));
+    t = pkt_time_ns(dev, r);
+    if (pkt_count == 0) {
+      t_pre = dev->account.t0_us*1000;
+    }
+    time_diff = (int)( (t - t_pre)/1000 );
+    t_pre = t;
+    pkt_count++;
+    printf("%dus Pkt%d ", time_diff, pkt_count);
+    if (toa_enable) {
+      printf("ToA:%lld.%09llds ", (long long)(t/1000000000), (long long)(t%1000000000));
+    }
+    if (r->bis > 0) {
+      printf("Ch%d AA:%08X BIG BIS%d ", r->channel_number, r->access_addr, r->bis);
+      if (r->payload == BIS_PAYLOAD_UNKNOWN) {
+        printf("Payload? ");
+      } else {
+        printf("Payload%llu ", (unsigned long long)r->payload);
+      }
+      print_bis_pdu(r->byte, r->crc_flag, r->torn_flag);
+    } else if (r->sync_idx >= 0) {
+      addr_str(dev->sync[r->sync_idx].adv_a, addr);
+      printf("Ch%d AA:%08X Sync%d:%s paEvent%u PDU_t%d:AUX_SYNC_IND PloadL%d ", r->channel_number, r->access_addr, r->sync_idx, addr, r->pa_event, r->pdu_type, r->payload_len);
+      print_ext_adv(r->byte+2, r->payload_len, r->crc_flag, r->torn_flag, ad_enable);
+    } else if (r->data_pdu) {
+      parse_data_pdu_header_byte(r->byte, &llid, &nesn, &sn, &md, &payload_len);
+      printf("Ch%d AA:%08X LLID%d:%s NESN%d SN%d MD%d PloadL%d ", r->channel_number, r->access_addr, llid, LLID_STR[llid], nesn, sn, md, payload_len);
+      print_data_pdu_payload(r->byte+2, llid, payload_len, r->crc_flag, r->torn_flag);
+    } else {
+      printf("Ch%d AA:%08X PDU_t%d:%s T%d R%d PloadL%d ", r->channel_number, r->access_addr, r->pdu_type, PDU_TYPE_STR[r->pdu_type], r->tx_add, r->rx_add, r->payload_len);
+      if (r->pdu_type == ADV_EXT_PDU_TYPE) {
+        print_ext_adv(r->byte+2, r->payload_len, r->crc_flag, r->torn_flag, ad_enable);
+      } else if (parse_adv_pdu_payload_byte(r->byte+2, r->payload_len, r->pdu_type, (void *)(&adv_pdu_payload) ) == 0 ) {
+        print_pdu_payload((void *)(&adv_pdu_payload), r->pdu_type, r->payload_len, r->crc_flag, r->torn_flag, ad_enable);
+      }
+    }
+    if (low_latency) {
+      fflush(stdout); // a pipe or file would hold the line back until the stdio buffer is full
+    }
+    gettimeofday(&time_out, NULL);
+    latency_us[num_latency&(LEN_LATENCY_WINDOW-1)] = (int32_t)( ((int64_t)time_out.tv_sec*1000000000 + (int64_t)time_out.tv_usec*1000 - r->end_ns)/1000 );
+    num_latency++;
+    if (num_rx_dev > 1 && r->crc_flag == 0 && !r->data_pdu && r->access_addr == ADV_ACCESS_ADDR && r->payload_len <= 37) {
+      clock_observe(dev, r);
+    }
+    if (r->cte_info >= 0 && cte_file.fp != NULL) {
+      write_cte(dev, r);
+    }
+
+    memory_barrier(); // done with the record before handing the slot back
+    dev->pkt_ring_tail = dev->pkt_ring_tail + 1;
+    METRICS_INC(dev->stat.num_pkt_out);
+  }
+
+  fflush(stdout);
+  cte_file_close(&cte_file);
+  return(NULL);
+}
+
+int start_output_thread(void) {
+  output_exit = false;
+  clock_init();
+  if ( pthread_create(&output_thread_id, NULL, output_thread, NULL) != 0 ) {
+    printf("start_output_thread: pthread_create failed!\n");
+    return(-1);
+  }
+  return(0);
+}
+
+// prints what is still queued, then returns
+void stop_output_thread(void) {
+  output_exit = true;
+  pthread_join(output_thread_id, NULL);
+}
+//----------------------------------packet output----------------------------------
+
+//----------------------------------metrics----------------------------------
+void update_metrics(void) {
+  static struct timeval time_pre;
+  static bool first_run = true;
+  struct timeval time_current;
+  RX_DEV *dev;
+  RX_GAUGE *g;
+  uint64_t num_crc_ok, num_crc_err, consumed, demod_us;
+  double time_s = 0, quantile_us[NUM_LATENCY_QUANTILE];
+  int i;
+
+  gettimeofday(&time_current, NULL);
+  if (!first_run) {
+    time_s = (double)TimevalDiff64(&time_current, &time_pre)/1000000.0;
+  }
+
+  for (i=0; i<num_rx_dev; i++) {
+    dev = rx_dev + i;
+    g = &(dev->gauge);
+    num_crc_ok = dev->stat.phy.num_crc_ok;
+    num_crc_err = dev->stat.phy.num_crc_err;
+    consumed = dev->account.consumed;
+    demod_us = dev->stat.demod_us.sum;
+
+    if (!first_run) {
+      if (time_s > 0) {
+        g->pkt_rate = (double)( (num_crc_ok - g->num_crc_ok_pre) + (num_crc_err - g->num_crc_err_pre) )/time_s;
+      }
+      if ( (num_crc_ok - g->num_crc_ok_pre) + (num_crc_err - g->num_crc_err_pre) != 0 ) {
+        g->crc_ok_ratio = (double)(num_crc_ok - g->num_crc_ok_pre)/(double)( (num_crc_ok - g->num_crc_ok_pre) + (num_crc_err - g->num_crc_err_pre) );
+      }
+      // demod time relative to the air time of the blocks: approaching 1 means saturation
+      if (consumed != g->consumed_pre) {
+        g->demod_load = (double)(demod_us - g->demod_us_pre)/( sample_idx_to_ms(consumed - g->consumed_pre)*1000.0 );
+      }
+    }
+    g->num_crc_ok_pre = num_crc_ok;
+    g->num_crc_err_pre = num_crc_err;
+    g->consumed_pre = consumed;
+    g->demod_us_pre = demod_us;
+
+    g->ring_fill_ratio = (double)dev->stat.ring_fill_percent/100.0;
+    g->output_backlog = (double)(dev->pkt_ring_head - dev->pkt_ring_tail);
+    g->clock_corr_us = (double)dev->clock_corr_ns/1000.0;
+    g->gain_db = (double)dev->agc.gain;
+  }
+  latency_quantile(quantile_us);
+  for (i=0; i<NUM_LATENCY_QUANTILE; i++) {
+    latency_quantile_us[i] = quantile_us[i];
+  }
+  first_run = false;
+  time_pre = time_current;
+}
+
+// one series per board, so that series of the same name stay together.
+// label and val are offsets into RX_DEV
+#define DEV_OFFSET(field) offsetof(RX_DEV, field)
+#define DEV_LABEL(dev, label) ( ((char *)(dev))[label]? ((char *)(dev))+(label) : NULL )
+
+static void add_dev_counter(const char *name, size_t label, const char *help, size_t val) {
+  int i;
+  for (i=0; i<num_rx_dev; i++) {
+    metrics_add_counter(name, DEV_LABEL(rx_dev+i, label), help, (volatile uint64_t *)( ((char *)(rx_dev+i))+val ));
+  }
+}
+
+static void add_dev_gauge(const char *name, size_t label, const char *help, size_t val) {
+  int i;
+  for (i=0; i<num_rx_dev; i++) {
+    metrics_add_gauge(name, DEV_LABEL(rx_dev+i, label), help, (volatile double *)( ((char *)(rx_dev+i))+val ));
+  }
+}
+
+static void add_dev_histogram(const char *name, size_t label, const char *help, size_t val) {
+  int i;
+  for (i=0; i<num_rx_dev; i++) {
+    metrics_add_histogram(name, DEV_LABEL(rx_dev+i, label), help, (METRICS_HIST *)( ((char *)(rx_dev+i))+val ));
+  }
+}
+
+int init_metrics(char *metrics_target, int metrics_interval_ms) {
+  const size_t label = DEV_OFFSET(label);
+  int i;
+
+  for (i=0; i<num_rx_dev; i++) {
+    metrics_hist_init(&(rx_dev[i].stat.demod_us), demod_us_bound, sizeof(demod_us_bound)/sizeof(demod_us_bound[0]));
+    metrics_hist_init(&(rx_dev[i].stat.ring_fill), ring_fill_bound, sizeof(ring_fill_bound)/sizeof(ring_fill_bound[0]));
+    metrics_hist_init(&(rx_dev[i].stat.retune_us), retune_us_bound, sizeof(retune_us_bound)/sizeof(retune_us_bound[0]));
+    metrics_hist_init(&(rx_dev[i].stat.retune_late_us), retune_late_us_bound, sizeof(retune_late_us_bound)/sizeof(retune_late_us_bound[0]));
+  }
+
+  if (metrics_target == NULL) {
+    return(0);
+  }
+
+  add_dev_counter("btle_rx_samples_produced_total", label, "IQ_TYPE elements written to rx_buf by the rx callback", DEV_OFFSET(account.produced));
+  add_dev_counter("btle_rx_samples_consumed_total", label, "IQ_TYPE elements handed over to the demodulator", DEV_OFFSET(account.consumed));
+  add_dev_counter("btle_rx_transfers_total", label, "USB transfers received", DEV_OFFSET(account.num_transfer));
+  add_dev_counter("btle_rx_overruns_total", label, "times the demodulator was lapped by the rx callback", DEV_OFFSET(account.num_overrun));
+  add_dev_counter("btle_rx_overrun_samples_total", label, "IQ samples skipped because of overrun", DEV_OFFSET(account.overrun_sample));
+  add_dev_counter("btle_rx_stream_gaps_total", label, "stream gaps inferred from sample count vs. host clock", DEV_OFFSET(account.num_gap));
+  add_dev_counter("btle_rx_stream_gap_samples_total", label, "IQ samples estimated lost in stream gaps", DEV_OFFSET(account.gap_sample));
+  add_dev_counter("btle_rx_torn_packets_total", label, "packets whose samples were overwritten while demodulating", DEV_OFFSET(account.num_torn_pkt));
+  add_dev_counter("btle_rx_blocks_total", label, "sample blocks demodulated", DEV_OFFSET(stat.num_block));
+  add_dev_counter("btle_rx_correlator_hits_total", label, "preamble and access address matches", DEV_OFFSET(stat.phy.num_hit));
+  add_dev_counter("btle_rx_header_rejects_total", label, "correlator hits dropped because of an invalid PDU header", DEV_OFFSET(stat.phy.num_header_reject));
+  for (i=0; i<NUM_FILTER_STAGE; i++) { // same name for all stages
+    int j;
+    for (j=0; j<num_rx_dev; j++) {
+      metrics_add_counter("btle_rx_filter_rejects_total", rx_dev[j].label_stage[i], "packets dropped by the filter, by the stage that rejected them", &(rx_dev[j].stat.phy.num_filter_reject[i]));
+    }
+  }
+  add_dev_counter("btle_rx_packets_total", DEV_OFFSET(label_crc[0]), "demodulated packets by CRC result", DEV_OFFSET(stat.phy.num_crc_ok));
+  add_dev_counter("btle_rx_packets_total", DEV_OFFSET(label_crc[1]), "demodulated packets by CRC result", DEV_OFFSET(stat.phy.num_crc_err));
+  add_dev_counter("btle_rx_output_packets_total", label, "packets printed by the output thread", DEV_OFFSET(stat.num_pkt_out));
+  add_dev_counter("btle_rx_output_drops_total", label, "packets dropped because the output ring was full", DEV_OFFSET(stat.num_pkt_drop));
+  add_dev_histogram("btle_rx_demod_block_microseconds", label, "demodulation time per block", DEV_OFFSET(stat.demod_us));
+  add_dev_histogram("btle_rx_ring_fill_percent", label, "rx_buf occupancy when a block is started", DEV_OFFSET(stat.ring_fill));
+  add_dev_gauge("btle_rx_packet_rate", label, "packets per second over the last interval", DEV_OFFSET(gauge.pkt_rate));
+  add_dev_gauge("btle_rx_crc_ok_ratio", label, "CRC pass ratio over the last interval", DEV_OFFSET(gauge.crc_ok_ratio));
+  add_dev_gauge("btle_rx_demod_load", label, "demodulation time / block air time over the last interval. 1 means saturated", DEV_OFFSET(gauge.demod_load));
+  add_dev_gauge("btle_rx_ring_fill_ratio", label, "rx_buf occupancy when the last block was started", DEV_OFFSET(gauge.ring_fill_ratio));
+  add_dev_gauge("btle_rx_output_backlog", label, "packets waiting in the output ring", DEV_OFFSET(gauge.output_backlog));
+  if (agc_enable) {
+    add_dev_gauge("btle_rx_gain_db", label, "rx gain set by the AGC", DEV_OFFSET(gauge.gain_db));
+    add_dev_counter("btle_rx_gain_changes_total", label, "board retuned by the AGC", DEV_OFFSET(stat.num_gain_change));
+    add_dev_counter("btle_rx_clipped_samples_total", label, "IQ samples at full scale", DEV_OFFSET(stat.num_clip));
+  }
+  if (record_enable) {
+    add_dev_counter("btle_rx_record_snippets_total", label, "captures cut around triggers", DEV_OFFSET(rec.num_snippet));
+    add_dev_counter("btle_rx_record_trigger_drops_total", label, "triggers dropped because the trigger queue was full", DEV_OFFSET(rec.num_trig_drop));
+    add_dev_counter("btle_rx_record_lost_samples_total", label, "IQ samples not recorded because the disk was too slow", DEV_OFFSET(rec.num_lost_sample));
+  }
+  if (hop_enable || sync_enable) {
+    add_dev_counter("btle_rx_retunes_total", label, "board moved to another channel to follow a connection or periodic advertising", DEV_OFFSET(stat.num_retune));
+    add_dev_counter("btle_rx_retunes_late_total", label, "events there was no time to retune for", DEV_OFFSET(stat.num_retune_late));
+    add_dev_histogram("btle_rx_retune_microseconds", label, "time the board took to change channel", DEV_OFFSET(stat.retune_us));
+  }
+  if (big_enable) {
+    add_dev_histogram("btle_rx_retune_late_microseconds", label, "how late a BIS subevent retune was issued against its plan", DEV_OFFSET(stat.retune_late_us));
+  }
+  if (cte_enable) {
+    add_dev_counter("btle_rx_cte_packets_total", label, "packets whose Constant Tone Extension was written to the -E file", DEV_OFFSET(stat.num_cte));
+    add_dev_counter("btle_rx_cte_cut_total", label, "Constant Tone Extensions a retune cut short", DEV_OFFSET(stat.num_cte_cut));
+  }
+  for (i=0; i<NUM_LATENCY_QUANTILE; i++) {
+    metrics_add_gauge("btle_rx_output_latency_microseconds", LATENCY_QUANTILE_LABEL[i], "from the end of a packet on the air to its line on stdout, over the last 1024 packets", latency_quantile_us+i);
+  }
+  if (num_rx_dev > 1) {
+    add_dev_gauge("btle_rx_clock_correction_microseconds", label, "drift correction against board 0, estimated from advertising events", DEV_OFFSET(gauge.clock_corr_us));
+  }
+
+  return( metrics_start(metrics_target, metrics_interval_ms, update_metrics) );
+}
+//----------------------------------metrics----------------------------------
+
+// stops what has been started, in reverse
+static void stop_rx_dev(int num_started) {
+  int i;
+  do_exit = true;
+  for (i=0; i<num_started; i++) {
+    pthread_join(rx_dev[i].demod_thread_id, NULL);
+  }
+  for (i=0; i<num_started; i++) {
+    if ( (hop_enable && rx_dev[i].follow != NULL) || rx_dev[i].num_sync > 0 ) {
+      pthread_join(rx_dev[i].follow_thread_id, NULL);
+    }
+  }
+  for (i=0; i<num_rx_dev; i++) {
+    stop_close_board(rx_dev[i].rf_dev);
+    rx_dev[i].rf_dev = NULL;
+  }
+  // after the boards: nothing is written to the recorder any more
+  for (i=0; i<num_rx_dev; i++) {
+    if (rx_dev[i].rec.running) {
+      iq_rec_close(&(rx_dev[i].rec));
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  int gain, chan, rate, metrics_interval_ms, record_seconds, i;
+  char *metrics_target, *record_prefix, *cte_name;
+  char prefix[MAX_LEN_RECORD_PREFIX+16];
+  char *serial[MAX_NUM_RX_DEV];
+  int dev_chan[MAX_NUM_RX_DEV];
+  RX_DEV *dev;
+
+  parse_commandline(argc, argv, &chan, &gain, &agc_enable, &iq_corr_enable, &rate, &record_prefix, &record_seconds, &rec_trigger, &metrics_target, &metrics_interval_ms, &rx_filter, &rx_link, &promisc_enable, &hop_enable, &hop_csa, &sync_enable, &big_enable, &ad_enable, &cte_name, &cte_cfo_remove, &toa_enable, &low_latency, &rt_conf, &num_rx_dev, serial, dev_chan);
+  rx_filter_active = ( filter_is_active(&rx_filter)? &rx_filter : NULL );
+  oversample = rate/SAMPLE_PER_SYMBOL;
+  record_enable = (record_prefix != NULL);
+  pkt_trigger_enable = filter_is_active(&(rec_trigger.pkt));
+  cte_enable = (cte_name != NULL);
+  if ( cte_enable && cte_file_create(&cte_file, cte_name) != 0 ) {
+    return(1);
+  }
+  aa_table_init(&aa_table);
+  hop_est_init(&hop_est, (rx_link.data_pdu? rx_link.access_addr : 0), hop_csa);
+  if (rx_link.data_pdu) {
+    printf("link: AA %08X CRCInit %06X, data channel PDUs\n", rx_link.access_addr, rx_link.crc_init);
+  }
+  rt_check(&rt_conf, num_rx_dev*( (LEN_BUF + LEN_BUF_MAX_NUM_PHY_SAMPLE)*sizeof(IQ_TYPE) + (record_enable? LEN_IQREC_STAGE : 0) ));
+  for (i=0; i<num_rx_dev; i++) {
+    dev = rx_dev + i;
+    init_rx_dev(dev, i, serial[i], dev_chan[i], gain);
+    printf("cmd line input: chan %d, freq %ldMHz, rx %ddB%s, %dMsps (%s%s%s)\n", dev->chan, dev->freq_hz/1000000, gain, (agc_enable? " AGC" : ""), rate, board_name, (dev->serial? " " : ""), (dev->serial? dev->serial : ""));
+    if ( rt_alloc(&(dev->rx_mem), (LEN_BUF + LEN_BUF_MAX_NUM_PHY_SAMPLE)*sizeof(IQ_TYPE), rt_conf.mem) != 0 ) {
+      return(1);
+    }
+    dev->rx_buf = (volatile IQ_TYPE *)dev->rx_mem.p;
+    if (rt_conf.mem != RT_MEM_DEFAULT) {
+      printf("rx_buf%s: %llukB%s%s\n", dev->tag, (unsigned long long)dev->rx_mem.len/1024,
+        (dev->rx_mem.huge == 1? ", huge pages" : (dev->rx_mem.huge == 2? ", transparent huge pages" : "")), (dev->rx_mem.locked? ", locked" : ", NOT locked"));
+    }
+  }
+  
+  // init receiver
+  receiver_init();
+
+  // run cyclic recv in background
+  do_exit = false;
+  if ( init_metrics(metrics_target, metrics_interval_ms) != 0 ) {
+    return(1);
+  }
+  if ( start_output_thread() != 0 ) {
+    metrics_stop();
+    return(1);
+  }
+  rt_thread_apply(rt_conf.thread+RT_THREAD_OUTPUT, output_thread_id, -1, RT_THREAD_STR[RT_THREAD_OUTPUT], "");
+  set_signal_handler();
+  for (i=0; record_enable && i<num_rx_dev; i++) {
+    if (num_rx_dev > 1) {
+      snprintf(prefix, sizeof(prefix), "%s_b%d", record_prefix, i);
+    } else {
+      snprintf(prefix, sizeof(prefix), "%s", record_prefix);
+    }
+    if ( iq_rec_open(&(rx_dev[i].rec), prefix, record_seconds, rec_trigger.pre_ms, rec_trigger.post_ms, oversample, rx_dev[i].freq_hz, &(rx_dev[i].account.t0_us), rt_conf.mem) != 0 ) {
+      stop_rx_dev(0);
+      stop_output_thread();
+      metrics_stop();
+      return(1);
+    }
+  }
+  for (i=0; i<num_rx_dev; i++) {
+    dev = rx_dev + i;
+    if ( config_run_board(dev->serial, dev->freq_hz, rate*1000000ul, gain, low_latency, rx_callback, (void *)dev, &(dev->rf_dev)) != 0 ){
+      stop_rx_dev(0);
+      stop_output_thread();
+      metrics_stop();
+      return(1);
+    }
+  }
+  
+  // scan: one demod thread per board
+  for (i=0; i<num_rx_dev; i++) {
+    if ( pthread_create(&(rx_dev[i].demod_thread_id), NULL, demod_thread, (void *)(rx_dev+i)) != 0 ) {
+      printf("main: pthread_create failed!\n");
+      stop_rx_dev(i);
+      stop_output_thread();
+      metrics_stop();
+      return(1);
+    }
+    rt_thread_apply(rt_conf.thread+RT_THREAD_DEMOD, rx_dev[i].demod_thread_id, i, RT_THREAD_STR[RT_THREAD_DEMOD], rx_dev[i].tag);
+  }
+  if (rt_conf.mem != RT_MEM_DEFAULT) {
+    rt_lock_all();
+  }
+  while(do_exit == false) {
+    usleep(100000);
+  }
+
+  stop_rx_dev(num_rx_dev);
+  stop_output_thread();
+  metrics_stop();
+  for (i=0; i<num_rx_dev; i++) {
+    dev = rx_dev + i;
+    print_sample_account(&(dev->account), dev->tag);
+    if (dev->stat.num_pkt_drop != 0) {
+      printf("output: %llu packets dropped because the output ring was full%s\n", (unsigned long long)dev->stat.num_pkt_drop, dev->tag);
+    }
+    if (iq_corr_enable) {
+      printf("IQ correction%s: DC %d/%d, Q' = %.4f*I' + %.4f*Q\n", dev->tag, dev->iq_corr.dc_i, dev->iq_corr.dc_q,
+        (float)dev->iq_corr.coef_qi/(1<<IQ_CORR_COEF_SHIFT), (float)dev->iq_corr.coef_qq/(1<<IQ_CORR_COEF_SHIFT));
+    }
+    if (record_enable) {
+      printf("Record%s: %llu captures, %llu triggers dropped, %llu IQ samples lost%s\n", dev->tag, (unsigned long long)dev->rec.num_snippet,
+        (unsigned long long)dev->rec.num_trig_drop, (unsigned long long)dev->rec.num_lost_sample, (dev->rec.direct_io? "" : ", page cache (no O_DIRECT)"));
+    }
+    if (hop_enable && dev->follow != NULL) {
+      print_follow(dev);
+    }
+    if (dev->num_sync > 0) {
+      print_sync(dev);
+    }
+    if (dev->big_started) {
+      print_big(dev);
+    }
+    if (cte_enable) {
+      printf("CTE%s: %llu written, %llu cut short by a retune\n", dev->tag, (unsigned long long)dev->stat.num_cte, (unsigned long long)dev->stat.num_cte_cut);
+    }
+    if (agc_enable) {
+      printf("AGC%s: %llu gain changes, %llu clipped IQ samples, final gain %ddB\n", dev->tag, (unsigned long long)dev->stat.num_gain_change, (unsigned long long)dev->stat.num_clip, dev->agc.gain);
+    }
+  }
+  print_clock_offset();
+  print_latency();
+  if (promisc_enable) {
+    aa_table_print(&aa_table, 2);
+  }
+  for (i=0; i<num_rx_dev; i++) {
+    rt_free(&(rx_dev[i].rx_mem));
+  }
   
   return(0);
 }
@@ -0,0 +1,375 @@
+// Runtime metrics for btle_rx
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <pthread.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/un.h>
+#else
+#include <windows.h>
+#define usleep(a) Sleep( ((a)+999)/1000 )
+#endif
+
+typedef enum {
+  METRICS_COUNTER,
+  METRICS_GAUGE,
+  METRICS_HISTOGRAM
+} METRICS_TYPE;
+
+static const char *METRICS_TYPE_STR[] = {
+  "counter",
+  "gauge",
+  "histogram"
+};
+
+typedef struct {
+  METRICS_TYPE type;
+  const char *name;
+  const char *labels;
+  const char *help;
+  volatile uint64_t *counter;
+  volatile double *gauge;
+  METRICS_HIST *hist;
+} METRICS_SERIES;
+
+static METRICS_SERIES metrics_series[METRICS_MAX_SERIES];
+static int metrics_num_series = 0;
+
+static char metrics_render_buf[METRICS_LEN_RENDER_BUF];
+static char metrics_target[256];
+static int metrics_interval_ms;
+static void (*metrics_update)(void);
+static volatile int metrics_stop_flag;
+static pthread_t metrics_thread;
+static int metrics_running = 0;
+
+//----------------------------------histogram----------------------------------
+void metrics_hist_init(METRICS_HIST *hist, const uint64_t *bound, int num_bound) {
+  memset((void *)hist, 0, sizeof(METRICS_HIST));
+  hist->bound = bound;
+  hist->num_bound = (num_bound>METRICS_MAX_BUCKET? METRICS_MAX_BUCKET : num_bound);
+}
+
+void metrics_hist_observe(METRICS_HIST *hist, uint64_t val) {
+  int i;
+  for (i=0; i<hist->num_bound; i++) {
+    if (val <= hist->bound[i]) {
+      break;
+    }
+  }
+  METRICS_INC(hist->bucket[i]);
+  METRICS_ADD(hist->sum, val);
+  METRICS_INC(hist->count);
+}
+//----------------------------------histogram----------------------------------
+
+//----------------------------------registry----------------------------------
+static int metrics_add(METRICS_TYPE type, const char *name, const char *labels, const char *help, volatile uint64_t *counter, volatile double *gauge, METRICS_HIST *hist) {
+  METRICS_SERIES *s;
+
+  if (metrics_num_series == METRICS_MAX_SERIES) {
+    printf("metrics_add: too many series! %s is not registered.\n", name);
+    return(-1);
+  }
+
+  s = metrics_series + metrics_num_series;
+  s->type = type;
+  s->name = name;
+  s->labels = labels;
+  s->help = help;
+  s->counter = counter;
+  s->gauge = gauge;
+  s->hist = hist;
+  metrics_num_series++;
+  return(0);
+}
+
+int metrics_add_counter(const char *name, const char *labels, const char *help, volatile uint64_t *val) {
+  return( metrics_add(METRICS_COUNTER, name, labels, help, val, NULL, NULL) );
+}
+
+int metrics_add_gauge(const char *name, const char *labels, const char *help, volatile double *val) {
+  return( metrics_add(METRICS_GAUGE, name, labels, help, NULL, val, NULL) );
+}
+
+int metrics_add_histogram(const char *name, const char *labels, const char *help, METRICS_HIST *hist) {
+  return( metrics_add(METRICS_HISTOGRAM, name, labels, help, NULL, NULL, hist) );
+}
+//----------------------------------registry----------------------------------
+
+//----------------------------------Prometheus text format----------------------------------
+// append to metrics_render_buf. returns the new length, output is truncated when it is full.
+static int render_printf(int len, const char *fmt, ...) {
+  va_list ap;
+  int n;
+
+  if (len >= (METRICS_LEN_RENDER_BUF-1)) {
+    return(len);
+  }
+
+  va_start(ap, fmt);
+  n = vsnprintf(metrics_render_buf+len, METRICS_LEN_RENDER_BUF-len, fmt, ap);
+  va_end(ap);
+
+  if (n < 0) {
+    return(len);
+  }
+  len = len + n;
+  return( len>(METRICS_LEN_RENDER_BUF-1)? (METRICS_LEN_RENDER_BUF-1) : len );
+}
+
+static int render_series(int len, METRICS_SERIES *s) {
+  char labels[256];
+  const char *sep = ( (s->labels==NULL || s->labels[0]==0)? "" : "," );
+  uint64_t cum;
+  int i;
+
+  // "{...}" or nothing at all
+  if (sep[0] == 0) {
+    labels[0] = 0;
+  } else {
+    snprintf(labels, sizeof(labels), "{%s}", s->labels);
+  }
+
+  if (s->type == METRICS_COUNTER) {
+    len = render_printf(len, "%s%s %llu\n", s->name, labels, (unsigned long long)(*(s->counter)));
+  } else if (s->type == METRICS_GAUGE) {
+    len = render_printf(len, "%s%s %.6g\n", s->name, labels, *(s->gauge));
+  } else {
+    // buckets are read one by one while the owner may be updating them: a snapshot can be
+    // off by the observations made during rendering, which Prometheus tolerates
+    cum = 0;
+    for (i=0; i<=s->hist->num_bound; i++) {
+      cum = cum + s->hist->bucket[i];
+      if (i < s->hist->num_bound) {
+        len = render_printf(len, "%s_bucket{%s%sle=\"%llu\"} %llu\n", s->name, (sep[0]==0? "" : s->labels), sep, (unsigned long long)(s->hist->bound[i]), (unsigned long long)cum);
+      } else {
+        len = render_printf(len, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", s->name, (sep[0]==0? "" : s->labels), sep, (unsigned long long)cum);
+      }
+    }
+    len = render_printf(len, "%s_sum%s %llu\n", s->name, labels, (unsigned long long)(s->hist->sum));
+    len = render_printf(len, "%s_count%s %llu\n", s->name, labels, (unsigned long long)cum);
+  }
+
+  return(len);
+}
+
+static int render_all(void) {
+  int i, len = 0;
+
+  for (i=0; i<metrics_num_series; i++) {
+    if (i==0 || strcmp(metrics_series[i].name, metrics_series[i-1].name) != 0) {
+      len = render_printf(len, "# HELP %s %s\n", metrics_series[i].name, metrics_series[i].help);
+      len = render_printf(len, "# TYPE %s %s\n", metrics_series[i].name, METRICS_TYPE_STR[metrics_series[i].type]);
+    }
+    len = render_series(len, metrics_series+i);
+  }
+
+  return(len);
+}
+//----------------------------------Prometheus text format----------------------------------
+
+//----------------------------------publisher----------------------------------
+static int publish_file(const char *filename, int len) {
+  char tmp_filename[sizeof(metrics_target)+8];
+  FILE *fp;
+
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+  fp = fopen(tmp_filename, "w");
+  if (fp == NULL) {
+    printf("publish_file: fopen %s failed: %s\n", tmp_filename, strerror(errno));
+    return(-1);
+  }
+
+  if ( fwrite(metrics_render_buf, 1, len, fp) != (size_t)len ) {
+    printf("publish_file: fwrite %s failed!\n", tmp_filename);
+    fclose(fp);
+    return(-1);
+  }
+  fclose(fp);
+
+  // rename is atomic, so a collector never sees a half written file
+  if ( rename(tmp_filename, filename) != 0 ) {
+    printf("publish_file: rename to %s failed: %s\n", filename, strerror(errno));
+    return(-1);
+  }
+
+  return(0);
+}
+
+#ifndef _WIN32
+static int open_unix_socket(const char *path) {
+  struct sockaddr_un addr;
+  int fd;
+
+  if ( strlen(path) >= sizeof(addr.sun_path) ) {
+    printf("open_unix_socket: path %s is too long!\n", path);
+    return(-1);
+  }
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    printf("open_unix_socket: socket() failed: %s\n", strerror(errno));
+    return(-1);
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  unlink(path);
+
+  if ( bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0 ) {
+    printf("open_unix_socket: bind/listen %s failed: %s\n", path, strerror(errno));
+    close(fd);
+    return(-1);
+  }
+
+  return(fd);
+}
+
+// waits up to timeout_ms for clients and hands each one the last snapshot
+static void serve_unix_socket(int listen_fd, int len, int timeout_ms) {
+  struct timeval tv;
+  fd_set rfds;
+  int fd, n, num_written;
+
+  while (timeout_ms > 0 && metrics_stop_flag == 0) {
+    FD_ZERO(&rfds);
+    FD_SET(listen_fd, &rfds);
+    n = (timeout_ms>100? 100 : timeout_ms);
+    tv.tv_sec = 0;
+    tv.tv_usec = n*1000;
+    timeout_ms = timeout_ms - n;
+
+    if ( select(listen_fd+1, &rfds, NULL, NULL, &tv) <= 0 ) {
+      continue;
+    }
+
+    fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+    num_written = 0;
+    while (num_written < len) {
+      n = write(fd, metrics_render_buf+num_written, len-num_written);
+      if (n <= 0) {
+        break;
+      }
+      num_written = num_written + n;
+    }
+    close(fd);
+  }
+}
+#endif
+
+static void sleep_ms_or_stop(int ms) {
+  while (ms > 0 && metrics_stop_flag == 0) {
+    usleep( (ms>100? 100 : ms)*1000 );
+    ms = ms - 100;
+  }
+}
+
+static void *metrics_thread_func(void *arg) {
+  int len, listen_fd = -1;
+  int is_socket = (strncmp(metrics_target, "unix:", 5) == 0);
+
+  if (is_socket) {
+  #ifndef _WIN32
+    listen_fd = open_unix_socket(metrics_target+5);
+  #endif
+    if (listen_fd < 0) {
+      return(NULL);
+    }
+  }
+
+  while (metrics_stop_flag == 0) {
+    if (metrics_update != NULL) {
+      (*metrics_update)();
+    }
+    len = render_all();
+
+    if (is_socket) {
+    #ifndef _WIN32
+      serve_unix_socket(listen_fd, len, metrics_interval_ms);
+    #endif
+    } else {
+      publish_file(metrics_target, len);
+      sleep_ms_or_stop(metrics_interval_ms);
+    }
+  }
+
+#ifndef _WIN32
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    unlink(metrics_target+5);
+  }
+#endif
+  return(NULL);
+}
+
+int metrics_start(const char *target, int interval_ms, void (*update)(void)) {
+  if ( strlen(target) >= sizeof(metrics_target) ) {
+    printf("metrics_start: target %s is too long!\n", target);
+    return(-1);
+  }
+
+  strcpy(metrics_target, target);
+  metrics_interval_ms = interval_ms;
+  metrics_update = update;
+  metrics_stop_flag = 0;
+
+  if ( pthread_create(&metrics_thread, NULL, metrics_thread_func, NULL) != 0 ) {
+    printf("metrics_start: pthread_create failed!\n");
+    return(-1);
+  }
+  metrics_running = 1;
+
+  return(0);
+}
+
+void metrics_stop(void) {
+  if (metrics_running == 0) {
+    return;
+  }
+
+  metrics_stop_flag = 1;
+  pthread_join(metrics_thread, NULL);
+  metrics_running = 0;
+
+  // final snapshot, so totals at exit are not lost for file targets
+  if ( strncmp(metrics_target, "unix:", 5) != 0 ) {
+    if (metrics_update != NULL) {
+      (*metrics_update)();
+    }
+    publish_file(metrics_target, render_all());
+  }
+}
+//----------------------------------publisher----------------------------------
@@ -0,0 +1,44 @@
+// Runtime metrics for btle_rx
+//
+// Counters and histograms are plain 64-bit values, each owned by exactly one writer thread
+// (USB callback, demodulator, output), so updating them needs no lock and no atomic
+// read-modify-write. A publisher thread periodically renders all registered series in
+// Prometheus text format to a file (written to file.tmp then renamed) or serves them on a
+// Unix domain socket (target "unix:/path").
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#define METRICS_MAX_BUCKET (16)
+#define METRICS_MAX_SERIES (256)
+#define METRICS_LEN_RENDER_BUF (65536)
+
+// only the owner thread may use these on a given value
+#define METRICS_INC(c)    ( (c) = (c) + 1 )
+#define METRICS_ADD(c, n) ( (c) = (c) + (n) )
+
+typedef struct {
+  int num_bound;
+  const uint64_t *bound;                           // ascending upper bounds (Prometheus "le")
+  volatile uint64_t bucket[METRICS_MAX_BUCKET+1];  // per bucket, not cumulative. last one is +Inf
+  volatile uint64_t count;
+  volatile uint64_t sum;
+} METRICS_HIST;
+
+void metrics_hist_init(METRICS_HIST *hist, const uint64_t *bound, int num_bound);
+void metrics_hist_observe(METRICS_HIST *hist, uint64_t val);
+
+// name must be a valid Prometheus metric name. labels is NULL or like: thread="demod"
+// series with the same name must be registered one after another.
+int metrics_add_counter(const char *name, const char *labels, const char *help, volatile uint64_t *val);
+int metrics_add_gauge(const char *name, const char *labels, const char *help, volatile double *val);
+int metrics_add_histogram(const char *name, const char *labels, const char *help, METRICS_HIST *hist);
+
+// update (may be NULL) is called in the publisher thread right before each snapshot,
+// so derived gauges (rates, fill levels) can be computed there.
+int metrics_start(const char *target, int interval_ms, void (*update)(void));
+void metrics_stop(void);
+
+#endif